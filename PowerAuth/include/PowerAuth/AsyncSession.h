@@ -0,0 +1,201 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <PowerAuth/Session.h>
+#include <PowerAuth/Executor.h>
+#include <atomic>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /**
+     The AsyncOperation class represents an operation started from AsyncSession.
+     The object allows to cancel the operation and test whether it's already finished.
+     */
+    class AsyncOperation
+    {
+    public:
+        AsyncOperation() :
+            _cancelled(false),
+            _finished(false)
+        {
+        }
+        
+        /**
+         Requests the operation's cancellation. The cancellation is cooperative:
+         if the operation is still waiting in the executor's queue, then it's
+         completed with EC_Cancelled without touching the session. If the operation
+         is already running, then it's cancelled only during the password-based
+         key derivation. Once that phase is over, the operation completes normally.
+         */
+        void cancel()
+        {
+            _cancelled = true;
+        }
+        
+        /**
+         Returns true if cancel() has been called.
+         */
+        bool isCancelled() const
+        {
+            return _cancelled;
+        }
+        
+        /**
+         Returns true if the operation is finished and its completion
+         callback has already returned.
+         */
+        bool isFinished() const
+        {
+            return _finished;
+        }
+        
+    private:
+        
+        friend class AsyncSession;
+        
+        std::atomic<bool> _cancelled;
+        std::atomic<bool> _finished;
+    };
+    
+    /**
+     Shared pointer to AsyncOperation.
+     */
+    typedef std::shared_ptr<AsyncOperation> AsyncOperationPtr;
+    
+    /**
+     The progress callback receives a value from 0.0 to 1.0, reporting the progress
+     of the password-based key derivation. The callback is called from the executor's
+     thread.
+     */
+    typedef std::function<void(double progress)> AsyncProgressCallback;
+    
+    /**
+     The AsyncSession class runs the computationally expensive Session operations
+     asynchronously, on a configurable Executor. Each method returns immediately,
+     with an AsyncOperation object, and reports the result to its completion callback.
+     The callback is called exactly once, from the executor's thread.
+     
+     The class doesn't own the Session object, so the session must outlive
+     all operations started from AsyncSession. The AsyncSession object itself can
+     be destroyed while the operations are still running. The order in which
+     the operations are executed depends on the executor, so if you need to keep
+     the order, then start the next operation from the completion of the previous one.
+     */
+    class AsyncSession
+    {
+    public:
+        
+        /**
+         Constructs an asynchronous interface for |session|. If |executor| is not
+         provided, then the shared instance returned from `Executor::defaultExecutor()`
+         is used.
+         */
+        AsyncSession(Session & session, std::shared_ptr<Executor> executor = nullptr);
+        
+        /**
+         Returns session associated to this object.
+         */
+        Session & session() const
+        {
+            return _session;
+        }
+        
+        /**
+         Returns executor used for the operations.
+         */
+        std::shared_ptr<Executor> executor() const
+        {
+            return _executor;
+        }
+        
+        // MARK: - Activation -
+        
+        /**
+         Asynchronous variant of `Session::startActivation()`. The operation can be
+         cancelled only before it starts.
+         */
+        AsyncOperationPtr startActivation(const ActivationStep1Param & param,
+                                          std::function<void(ErrorCode, const ActivationStep1Result &)> completion);
+        
+        /**
+         Asynchronous variant of `Session::validateActivationResponse()`. The operation
+         can be cancelled only before it starts.
+         */
+        AsyncOperationPtr validateActivationResponse(const ActivationStep2Param & param,
+                                                     std::function<void(ErrorCode, const ActivationStep2Result &)> completion);
+        
+        /**
+         Asynchronous variant of `Session::completeActivation()`. The operation can be
+         cancelled only before it starts, because cancelling the running operation
+         would reset the session's state. The |progress| callback is optional.
+         */
+        AsyncOperationPtr completeActivation(const SignatureUnlockKeys & keys,
+                                             std::function<void(ErrorCode)> completion,
+                                             AsyncProgressCallback progress = nullptr);
+        
+        // MARK: - Signatures -
+        
+        /**
+         Asynchronous variant of `Session::signHTTPRequestData()`. The operation can be
+         cancelled until the signature keys are unlocked. The cancelled operation doesn't
+         change the signature counter. The |progress| callback is optional.
+         */
+        AsyncOperationPtr signHTTPRequestData(const HTTPRequestData & request_data,
+                                              const SignatureUnlockKeys & keys,
+                                              SignatureFactor signature_factor,
+                                              std::function<void(ErrorCode, const HTTPRequestDataSignature &)> completion,
+                                              AsyncProgressCallback progress = nullptr);
+        
+        // MARK: - Password -
+        
+        /**
+         Asynchronous variant of `Session::changeUserPassword()`. The operation can be
+         cancelled until the key derivations from both passwords are finished. The
+         cancelled operation keeps the old password. The |progress| callback is optional
+         and reports both derivations as one continuous progress.
+         */
+        AsyncOperationPtr changeUserPassword(const cc7::ByteArray & old_password,
+                                             const cc7::ByteArray & new_password,
+                                             std::function<void(ErrorCode)> completion,
+                                             AsyncProgressCallback progress = nullptr);
+        
+    private:
+        
+        /**
+         Schedules |task| to the executor and calls |completion| with its result.
+         If |cancellable| is true, then the task can be cancelled during the key
+         derivation. The |derivations| parameter is the expected number of key
+         derivations performed by the task, used to calculate the progress.
+         */
+        AsyncOperationPtr dispatch(std::function<ErrorCode()> task,
+                                   std::function<void(ErrorCode)> completion,
+                                   AsyncProgressCallback progress,
+                                   bool cancellable,
+                                   unsigned derivations);
+        
+        Session & _session;
+        std::shared_ptr<Executor> _executor;
+    };
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <PowerAuth/PublicTypes.h>
+#include <mutex>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /*
+     Forward declaration for private objects
+     */
+    namespace protocol
+    {
+        struct PersistentData;
+    }
+    
+    /**
+     The CounterJournal class keeps the signature counter of one activation in a small
+     append-only file. If the journal is assigned to the Session, then each change of
+     the signature counter appends a fixed-size record to the journal, so the application
+     doesn't need to save the whole session's state after each signature. The full state
+     needs to be saved only when `shouldWriteSnapshot()` returns true, or when the
+     Session's documentation requires it for other reasons, like the password change.
+     
+     When the state is loaded into the Session with the journal, then the records are
+     replayed and the counter is moved forward to the last valid record. The counter never
+     moves backward during the replay, so records written before the loaded state are ignored.
+     Each record is authenticated with a MAC, calculated with a key provided by the application.
+     */
+    class CounterJournal
+    {
+    public:
+        
+        /**
+         The SyncPolicy enumeration defines when the journal's file is flushed
+         to the storage.
+         */
+        enum SyncPolicy
+        {
+            /**
+             The file is flushed after each record.
+             */
+            JSP_Always,
+            /**
+             The file is flushed after each `syncInterval` records, and when
+             `sync()` is called.
+             */
+            JSP_Periodic,
+            /**
+             The file is flushed only when `sync()` is called. Otherwise, the operating
+             system decides when the data is written.
+             */
+            JSP_Never
+        };
+        
+        /**
+         Opens or creates journal at |path|. The |mac_key| must be at least 16 bytes long and
+         should be kept secret, for example in the system keychain. The |sync_interval| is used
+         only for JSP_Periodic policy. The |snapshot_interval| defines the number of records,
+         after which `shouldWriteSnapshot()` returns true. The incomplete record at the end of file,
+         left by the interrupted write, is removed.
+         */
+        CounterJournal(const std::string & path,
+                       const cc7::ByteRange & mac_key,
+                       SyncPolicy sync_policy = JSP_Always,
+                       size_t sync_interval = 16,
+                       size_t snapshot_interval = 64);
+        ~CounterJournal();
+        
+        /**
+         Returns true if the journal's file is opened and all writes succeeded.
+         */
+        bool isValid() const;
+        
+        /**
+         Returns number of records in the journal.
+         */
+        size_t recordsCount() const;
+        
+        /**
+         Returns true if the application should save the whole session's state and then call
+         `reset()`. This happens when the number of records reached the snapshot interval,
+         or when the journal failed to write a record.
+         */
+        bool shouldWriteSnapshot() const;
+        
+        /**
+         Removes all records from the journal. You should call this method right after the whole
+         session's state is saved. If the application is terminated between the save and this call,
+         then the obsolete records are simply ignored during the next replay.
+         
+         Returns EC_Ok,             if operation succeeded
+                 EC_GeneralFailure, if the file cannot be truncated
+         */
+        ErrorCode reset();
+        
+        /**
+         Flushes the journal's file to the storage.
+         */
+        void sync();
+        
+    private:
+        
+        friend class Session;
+        
+        CounterJournal(const CounterJournal &) = delete;
+        CounterJournal & operator=(const CounterJournal &) = delete;
+        
+        /**
+         Appends record with the current counter from |pd|.
+         */
+        bool append(const protocol::PersistentData & pd);
+        
+        /**
+         Replays all valid records on |pd|. Returns number of applied records.
+         */
+        size_t replay(protocol::PersistentData & pd) const;
+        
+        mutable std::mutex _lock;
+        int _fd;
+        cc7::ByteArray _macKey;
+        SyncPolicy _syncPolicy;
+        size_t _syncInterval;
+        size_t _snapshotInterval;
+        size_t _recordsCount;
+        size_t _unsyncedCount;
+        bool _failed;
+    };
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
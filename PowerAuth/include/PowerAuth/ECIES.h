@@ -212,6 +212,13 @@ namespace powerAuth
         static const size_t IvSize = 16;
 
     private:
+        
+        friend class ECIESEncryptor;
+        
+        /// Creates a new instance of ECIESEnvelopeKey from EC |public_key|, like the public `fromPublicKey()`.
+        /// If |is_validated_point| is true, then the key must be an uncompressed point of already validated key.
+        static ECIESEnvelopeKey fromPublicKey(const cc7::ByteRange & public_key, bool is_validated_point, const cc7::ByteRange & shared_info1, cc7::ByteArray & out_ephemeral_key);
+        
         /// Envelope key's data
         cc7::ByteArray _key;
     };
@@ -284,6 +291,8 @@ namespace powerAuth
         
     private:
         
+        friend class Session;
+        
         /// A data for public key.
         cc7::ByteArray _public_key;
         /// Content of shared info1 optional parameter.
@@ -294,6 +303,9 @@ namespace powerAuth
         ECIESEnvelopeKey _envelope_key;
         /// IV for response decryption
         cc7::ByteArray _iv_for_decryption;
+        /// Optional uncompressed point of already validated public key. If present, then
+        /// it's used for the encryption instead of `_public_key`. Only Session can set this value.
+        cc7::ByteArray _validated_public_key;
     };
     
     
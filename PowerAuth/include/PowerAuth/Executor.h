@@ -0,0 +1,103 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <vector>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /**
+     The Executor class is an abstract interface for objects that run tasks
+     scheduled by the asynchronous operations. You can implement your own executor
+     to dispatch tasks into the platform's native queues.
+     */
+    class Executor
+    {
+    public:
+        virtual ~Executor() {}
+        
+        /**
+         Schedules |task| for an execution. The task must be executed exactly
+         once, on an arbitrary thread.
+         */
+        virtual void execute(std::function<void()> task) = 0;
+        
+        /**
+         Returns shared instance of the default executor. The default executor
+         is ThreadPoolExecutor, with number of threads equal to number of CPU cores,
+         and is created on the first use.
+         */
+        static std::shared_ptr<Executor> defaultExecutor();
+    };
+    
+    /**
+     The ThreadPoolExecutor implements Executor interface with a fixed set
+     of worker threads, processing tasks in FIFO order.
+     */
+    class ThreadPoolExecutor : public Executor
+    {
+    public:
+        /**
+         Constructs a thread pool with |threads_count| worker threads. If zero
+         is provided, then the number of threads is equal to number of CPU cores.
+         */
+        explicit ThreadPoolExecutor(size_t threads_count = 0);
+        
+        /**
+         Destroys the thread pool. All already scheduled tasks are executed before
+         the worker threads are joined, so you must not destroy the executor
+         from its own worker thread.
+         */
+        ~ThreadPoolExecutor();
+        
+        /**
+         Schedules |task| for an execution on one of the worker threads.
+         */
+        void execute(std::function<void()> task) override;
+        
+        /**
+         Returns number of worker threads.
+         */
+        size_t threadsCount() const;
+        
+    private:
+        
+        ThreadPoolExecutor(const ThreadPoolExecutor &) = delete;
+        ThreadPoolExecutor & operator=(const ThreadPoolExecutor &) = delete;
+        
+        void workerLoop();
+        
+        std::mutex _lock;
+        std::condition_variable _condition;
+        std::deque<std::function<void()>> _tasks;
+        std::vector<std::thread> _threads;
+        bool _stopping;
+    };
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
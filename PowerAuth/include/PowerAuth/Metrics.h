@@ -0,0 +1,72 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <PowerAuth/PublicTypes.h>
+
+/*
+ The process-wide metrics are collected only if the library is compiled with
+ PA_ENABLE_METRICS macro defined. Otherwise, all measurement points are compiled
+ out and the exported metrics contain no samples.
+ */
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /**
+     The MetricsFormat enumeration defines formats supported by `ExportMetrics()` function.
+     */
+    enum MetricsFormat
+    {
+        /**
+         Prometheus text exposition format, version 0.0.4. Latencies are exported
+         as histograms in seconds, with the same fixed set of buckets for each
+         operation. The bucket bounds are powers of two nanoseconds.
+         */
+        MF_Prometheus,
+        /**
+         JSON object with counters and histograms. Latencies are in nanoseconds
+         and each histogram contains also precomputed percentiles.
+         */
+        MF_JSON
+    };
+    
+    /**
+     Returns true if the library is compiled with the metrics collection.
+     */
+    bool MetricsAvailable();
+    
+    /**
+     Returns metrics aggregated from all sessions and all threads in the process,
+     in requested |format|. The function can be called from any thread and doesn't
+     block the threads that are recording new samples.
+     */
+    std::string ExportMetrics(MetricsFormat format);
+    
+    /**
+     Resets all metrics to zero. Samples recorded concurrently with the reset may
+     or may not be included in the next export.
+     */
+    void ResetMetrics();
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
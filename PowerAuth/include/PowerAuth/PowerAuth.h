@@ -22,5 +22,12 @@
  */
 
 #include <PowerAuth/Session.h>
+#include <PowerAuth/AsyncSession.h>
+#include <PowerAuth/SessionManager.h>
+#include <PowerAuth/SessionStore.h>
+#include <PowerAuth/CounterJournal.h>
+#include <PowerAuth/WarmUp.h>
+#include <PowerAuth/Metrics.h>
+#include <PowerAuth/Tracing.h>
 #include <PowerAuth/ECIES.h>
 #include <PowerAuth/Debug.h>
@@ -17,6 +17,8 @@
 #pragma once
 
 #include <cc7/ByteArray.h>
+#include <atomic>
+#include <vector>
 
 namespace com
 {
@@ -153,7 +155,13 @@ namespace powerAuth
          returned when underlying implementation fails. For example, if PRNG
          generator could not produce a sequence of bytes.
          */
-        EC_GeneralFailure
+        EC_GeneralFailure,
+        /**
+         The operation has been cancelled before it could complete. This code
+         is produced only by the asynchronous operations started from
+         AsyncSession class.
+         */
+        EC_Cancelled
     };
     
     /**
@@ -276,6 +284,32 @@ namespace powerAuth
     };
     
     
+    /**
+     The UnlockedSignatureKeysLimits structure defines how long the signature keys,
+     unlocked with `Session::unlockSignatureKeys()` method, remain usable. At least
+     one limit must be set.
+     */
+    struct UnlockedSignatureKeysLimits
+    {
+        /**
+         Maximum number of successful operations which can use the unlocked keys.
+         If zero, then the number of operations is not limited.
+         */
+        cc7::U32 maxUseCount;
+        /**
+         Maximum time interval in milliseconds, since the keys were unlocked.
+         If zero, then the keys are not limited in time.
+         */
+        cc7::U32 maxTimeInterval;
+        
+        UnlockedSignatureKeysLimits(cc7::U32 max_use_count = 0, cc7::U32 max_time_interval = 0) :
+            maxUseCount(max_use_count),
+            maxTimeInterval(max_time_interval)
+        {
+        }
+    };
+    
+    
     /**
      The HTTPRequestData structure contains all data required for calculating signature 
      from HTTP request. You have to provide values at least non-empty strings to `method` 
@@ -374,6 +408,83 @@ namespace powerAuth
         std::string buildAuthHeaderValue() const;
     };
     
+    /**
+     The SignatureCounterReservation class contains a range of consecutive signature
+     counter values, reserved with `Session::reserveSignatureCounters()`. Each slot
+     in the reservation can be used for exactly one signature, calculated with
+     `Session::signHTTPRequestDataWithReservation()`. Signatures for different slots
+     can be calculated in parallel, from multiple threads. The unused slots should be
+     returned to the session with `Session::releaseSignatureCounters()`. The released
+     reservation keeps its storage until it's destroyed or filled again, so the release
+     can run while signatures for its slots are still being calculated.
+     
+     The object cannot be copied, because each counter value must be used only once.
+     */
+    class SignatureCounterReservation
+    {
+    public:
+        
+        SignatureCounterReservation() :
+            _isV3(false),
+            _released(false),
+            _firstCounterByte(0),
+            _hasCounterByte(false),
+            _endCounterByte(0),
+            _endCounter(0)
+        {
+        }
+        
+        /**
+         Returns number of reserved slots.
+         */
+        size_t count() const
+        {
+            return _released ? 0 : _counters.size();
+        }
+        
+        /**
+         Returns true if the reservation contains no slots, or if it was already released.
+         */
+        bool empty() const
+        {
+            return count() == 0;
+        }
+        
+        /**
+         Returns true if |slot| has been already used for a signature.
+         */
+        bool isSlotUsed(size_t slot) const
+        {
+            return slot < _used.size() && _used[slot];
+        }
+        
+    private:
+        
+        friend class Session;
+        
+        SignatureCounterReservation(const SignatureCounterReservation &) = delete;
+        SignatureCounterReservation & operator=(const SignatureCounterReservation &) = delete;
+        
+        /// Activation identifier, for which the counters were reserved.
+        std::string _activationId;
+        /// Whether counters are V3 hash-based values.
+        bool _isV3;
+        /// Counter values in form prepared for the signature calculation.
+        std::vector<cc7::ByteArray> _counters;
+        /// Flags for already used slots.
+        std::vector<std::atomic<bool>> _used;
+        /// Whether the reservation was released. All slots are marked as used in such case.
+        std::atomic<bool> _released;
+        /// Value of signature counter byte for the first slot.
+        cc7::byte _firstCounterByte;
+        /// Whether the session had signature counter byte, and its value after the reservation.
+        bool _hasCounterByte;
+        cc7::byte _endCounterByte;
+        /// Session's counter after the reservation, to detect whether the slots can be returned.
+        cc7::U64 _endCounter;
+        cc7::ByteArray _endCounterData;
+    };
+    
     /**
      The SignedData structure contains data and signature calculated from data.
      */
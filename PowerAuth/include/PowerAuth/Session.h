@@ -17,9 +17,20 @@
 #pragma once
 
 #include <PowerAuth/PublicTypes.h>
+#include <PowerAuth/SessionStatistics.h>
 #include <map>
+#include <vector>
+#include <memory>
 #include <mutex>
 
+/*
+ The thread synchronization policy of the Session class is selected in compile time.
+ By default, the Session is thread safe. If you're using the Session only from one
+ thread, then you can define PA_SESSION_SINGLE_THREADED macro to compile the class
+ without any locking. Note that the macro affects the layout of the class, so it must
+ be defined equally for all compilation units.
+ */
+
 namespace com
 {
 namespace wultra
@@ -30,6 +41,7 @@ namespace powerAuth
      Forward declaration for public objects
      */
     class ECIESEncryptor;
+    class CounterJournal;
     
     /*
      Forward declaration for private objects
@@ -38,6 +50,14 @@ namespace powerAuth
     {
         struct PersistentData;
         struct ActivationData;
+        struct SignatureKeys;
+        struct UnlockedSignatureKeys;
+        struct TransportKeys;
+        struct SignatureBatchItem;
+    }
+    namespace utils
+    {
+        struct StatisticsCollector;
     }
     
     /**
@@ -155,6 +175,54 @@ namespace powerAuth
          */
         ErrorCode loadSessionState(const cc7::ByteRange & serialized_state);
         
+        /**
+         Loads state of session from previously saved sequence of bytes, like `loadSessionState()`,
+         but without copying the data. The function only checks the structure of the serialized state
+         and keeps views into the provided memory. The data is copied and validated later, when some
+         operation requires the activation's keys or modifies the state. The state probing methods, like
+         `hasValidActivation()` or `activationIdentifier()`, never require the data copy, so you can use
+         this method to load a large number of states, for example from memory-mapped file.
+         
+         The memory referenced by |serialized_state| must remain valid and unchanged until the state
+         is materialized, or until the session is reset, the other state is loaded, or the session is
+         destroyed. Call `materializeSessionState()` if you need to release the memory earlier.
+         If the counter journal is assigned, then the state is always loaded with `loadSessionState()`.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_WrongParam, if the serialized state is malformed
+         */
+        ErrorCode loadSessionStateLazily(const cc7::ByteRange & serialized_state);
+        
+        /**
+         Returns true if the session's state was loaded with `loadSessionStateLazily()` and still
+         references the memory provided to that function.
+         */
+        bool hasLazySessionState() const;
+        
+        /**
+         Copies and validates the state loaded with `loadSessionStateLazily()`, so the memory provided to
+         that function is no longer referenced. If the state is not lazy, then does nothing.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_WrongState, if the session has no valid activation
+                 EC_WrongParam, if the lazily loaded state contains invalid data
+         */
+        ErrorCode materializeSessionState();
+        
+        /**
+         Assigns |journal| to the session. The journal then receives each change of the signature
+         counter and its records are replayed in `loadSessionState()`, so the application doesn't
+         need to save the whole session's state after each signature. Check `CounterJournal` class
+         for details. You should assign the journal before the session's state is loaded. You can
+         pass nullptr to remove the journal from the session.
+         */
+        void setCounterJournal(std::shared_ptr<CounterJournal> journal);
+        
+        /**
+         Returns journal assigned to the session, or nullptr if there's no journal.
+         */
+        std::shared_ptr<CounterJournal> counterJournal() const;
+        
         
         // MARK: - Activation -
         
@@ -253,7 +321,45 @@ namespace powerAuth
                  Counter_CalculateSignature,   if counter is close to deadlock, so an online siganture calculation is recommended.
                  Counter_Invalid,              if counter cannot be sychnronized and the activation is technically blocked.
          */
-        ActivationStatus::CounterState trySynchronizeCounter(const ActivationStatus & status, const cc7::ByteRange & transport_key) const;
+        ActivationStatus::CounterState trySynchronizeCounter(const ActivationStatus & status, const protocol::TransportKeys & transport_keys) const;
+        
+        /**
+         The private method updates counter's state in already decrypted |status|, with using unlocked
+         |transport_keys|. The method must be called with the lock acquired.
+         */
+        void applyCounterState(ActivationStatus & status, const protocol::TransportKeys & transport_keys) const;
+        
+        /**
+         The private method validates whether the |request| can be signed with the current state of the session.
+         
+         Returns EC_Ok,         if request can be signed.
+                 EC_WrongState, if the session has no valid activation, or offline signature is not available.
+                 EC_WrongParam, if request contains wrong data.
+         */
+        ErrorCode validateRequestForSigning(const HTTPRequestData & request) const;
+        
+        /**
+         The private method calculates signature for |request| with already unlocked |plain_keys| and moves
+         the counter forward. The |normalized_data| and |nonce| must be prepared for the request in advance.
+         The |factor_string| is the signature factor converted to the string. The method must be called
+         with the lock acquired.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_Encryption, if some cryptographic operation failed
+         */
+        ErrorCode calculateRequestSignature(const HTTPRequestData & request, const cc7::ByteRange & normalized_data,
+                                            const std::string & nonce, const protocol::SignatureKeys & plain_keys,
+                                            SignatureFactor signature_factor, const std::string & factor_string,
+                                            HTTPRequestDataSignature & out);
+        
+        /**
+         The private method prepares signature |item| for |request| and fills all values in |out| structure,
+         except the signature itself. The counter is not moved forward. The |normalized_data| must exist
+         until the signature for the item is calculated. The method must be called with the lock acquired.
+         */
+        void prepareRequestSignature(const HTTPRequestData & request, const cc7::ByteRange & normalized_data,
+                                     const std::string & nonce, const std::string & factor_string,
+                                     protocol::SignatureBatchItem & item, HTTPRequestDataSignature & out) const;
         
     public:
         
@@ -268,10 +374,28 @@ namespace powerAuth
          Compatibility note
          
          This interface doesn't support multiple values for the same key. This is a known limitation, due to fact, that
-         std::map<> doesn't allow duplicit keys. The arrays in GET requests are so rare that I've decided to do not support
-         them. You can still implement your own data normalization, if this is your situation.
+         std::map<> doesn't allow duplicit keys. Use `prepareKeyValuePairsForDataSigning()` if you need to sign
+         GET request with arrays.
          */
         static cc7::ByteArray prepareKeyValueMapForDataSigning(const std::map<std::string, std::string> & key_value_map);
+        
+        /**
+         Converts list of key-value pairs into normalized data, suitable for data signing. Unlike the map based
+         variant, this method accepts multiple values for the same key. You have to provide |count| pairs in
+         |pairs| array. The pairs are sorted by key and then by value, with using stable sort, so the result
+         doesn't depend on order of the pairs in the array. The result is equal to the map based variant
+         if there are no duplicit keys.
+         */
+        static cc7::ByteArray prepareKeyValuePairsForDataSigning(const std::pair<std::string, std::string> * pairs, size_t count);
+        
+        /**
+         Converts vector of key-value pairs into normalized data, suitable for data signing.
+         See `prepareKeyValuePairsForDataSigning(pairs, count)` for details.
+         */
+        static cc7::ByteArray prepareKeyValuePairsForDataSigning(const std::vector<std::pair<std::string, std::string>> & pairs)
+        {
+            return prepareKeyValuePairsForDataSigning(pairs.data(), pairs.size());
+        }
 
         /**
          Calculates signature from given |request_data| structure. You have to provide all involved unlock keys
@@ -298,6 +422,41 @@ namespace powerAuth
                                       const SignatureUnlockKeys & keys, SignatureFactor signature_factor,
                                       HTTPRequestDataSignature & out_signature);
         
+        /**
+         Calculates signatures for |count| requests provided in |requests| array. The method is equivalent
+         to calling `signHTTPRequestData()` for each request in the array, but the signature keys are unlocked
+         only once, so the expensive key derivation for the knowledge factor is not repeated for each request.
+         Online and offline requests can be mixed in the batch. The signatures are calculated with consecutive
+         values of the counter, in the order of requests in the array.
+         
+         The operation is atomic. If all signatures are calculated, then the counter is moved forward
+         by |count| steps and |out_signatures| contains exactly |count| results. If any signature calculation
+         fails, then the counter is not changed and |out_signatures| is left untouched.
+         
+         WARNING
+         
+         You have to save session's state after the successful operation, due to internal counter change.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_Encryption, if some cryptographic operation failed
+                 EC_WrongState, if the session has no valid activation
+                 EC_WrongParam, if some required parameter is missing or the batch is empty
+         */
+        ErrorCode signHTTPRequestDataBatch(const HTTPRequestData * requests, size_t count,
+                                           const SignatureUnlockKeys & keys, SignatureFactor signature_factor,
+                                           std::vector<HTTPRequestDataSignature> & out_signatures);
+        
+        /**
+         Calculates signatures for all requests in |requests| vector.
+         See `signHTTPRequestDataBatch(requests, count, ...)` for details.
+         */
+        ErrorCode signHTTPRequestDataBatch(const std::vector<HTTPRequestData> & requests,
+                                           const SignatureUnlockKeys & keys, SignatureFactor signature_factor,
+                                           std::vector<HTTPRequestDataSignature> & out_signatures)
+        {
+            return signHTTPRequestDataBatch(requests.data(), requests.size(), keys, signature_factor, out_signatures);
+        }
+        
         /**
          Returns name of authorization header. The value is constant and is equal to "X-PowerAuth-Authorization".
          You can calculate appropriate value with using signHTTPRequest() method.
@@ -315,6 +474,123 @@ namespace powerAuth
         ErrorCode verifyServerSignedData(const SignedData & data) const;
 
         
+        // MARK: - Unlocked signature keys -
+        
+        /**
+         Unlocks signature keys for |signature_factor| and keeps them in the session's memory, so they
+         can be used for a limited number of operations, or for a limited time, without providing the unlock
+         keys again. This is useful when several requests are signed in a short time, because the expensive
+         key derivation for the knowledge factor is performed only once. The |limits| structure must define
+         at least one limit. If the possession factor is involved, then also the transport key is unlocked,
+         so the activation status can be decoded with `decodeActivationStatusWithUnlockedKeys()`.
+         
+         The session keeps only one set of unlocked keys, so the previously unlocked keys are discarded.
+         The keys are wiped from the memory when the limit is reached, when `lockSignatureKeys()` is called,
+         or automatically by `resetSession()`, `loadSessionState()`, `changeUserPassword()`,
+         `removeBiometryFactor()` and by all methods manipulating with the external encryption key.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_Encryption, if keys cannot be unlocked
+                 EC_WrongState, if the session has no valid activation
+                 EC_WrongParam, if signature factor is invalid, or no limit is set
+         */
+        ErrorCode unlockSignatureKeys(const SignatureUnlockKeys & keys, SignatureFactor signature_factor,
+                                      const UnlockedSignatureKeysLimits & limits);
+        
+        /**
+         Returns true if the session contains unlocked signature keys, which can be still used.
+         */
+        bool hasUnlockedSignatureKeys() const;
+        
+        /**
+         Wipes previously unlocked signature keys from the memory.
+         */
+        void lockSignatureKeys();
+        
+        /**
+         Calculates signature from given |request_data| structure, with using the keys unlocked with
+         `unlockSignatureKeys()`. The signature factor is the same as was used for keys unlock.
+         Each successful call consumes one use of the unlocked keys. Check `signHTTPRequestData()` for details.
+         
+         You have to save session's state after the successful operation, due to internal counter change.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_Encryption, if some cryptographic operation failed
+                 EC_WrongState, if the session has no valid activation, or there are no usable unlocked keys
+                 EC_WrongParam, if some required parameter is missing
+         */
+        ErrorCode signHTTPRequestDataWithUnlockedKeys(const HTTPRequestData & request_data,
+                                                      HTTPRequestDataSignature & out_signature);
+        
+        /**
+         Decodes activation status, with using the transport key unlocked with `unlockSignatureKeys()`.
+         The keys must be unlocked with the possession factor. Each successful call consumes one use of
+         the unlocked keys. Check `decodeActivationStatus()` for details.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_Encryption, if general encryption error occurs
+                 EC_WrongState, if the session has no valid activation, or there are no usable unlocked keys
+                                with the possession factor
+                 EC_WrongParam, if some required parameter is missing
+         */
+        ErrorCode decodeActivationStatusWithUnlockedKeys(const EncryptedActivationStatus & encrypted_status,
+                                                         ActivationStatus & out_status);
+        
+        
+        // MARK: - Signature counter reservation -
+        
+        /**
+         Atomically reserves |count| consecutive signature counter values and moves the session's counter
+         after the reserved range. The reserved values are stored in |out_reservation|, so the signatures
+         can be later calculated in parallel, without touching the session's counter. The number of slots
+         is limited to 10, because the unused slots are skipped on the server's side and the gap must fit
+         into the server's look ahead window. The previous content of |out_reservation| is replaced, so
+         the object must not be used by other threads at the same time.
+         
+         You have to save session's state after the successful operation, due to internal counter change.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_WrongState, if the session has no valid activation
+                 EC_WrongParam, if |count| is zero or greater than 10
+         */
+        ErrorCode reserveSignatureCounters(size_t count, SignatureCounterReservation & out_reservation);
+        
+        /**
+         Calculates signature from given |request_data| structure, with using the counter value from
+         |slot| in |reservation|. The method doesn't change the session's counter and the lock is held
+         only while the request is validated, so multiple threads can calculate signatures for different
+         slots at the same time. Each slot can be used only once. Check `signHTTPRequestData()` for details.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_Encryption, if some cryptographic operation failed
+                 EC_WrongState, if the session has no valid activation, or the reservation doesn't belong
+                                to the current activation, or the protocol version has been changed
+                 EC_WrongParam, if some required parameter is missing, or the slot is invalid or already used
+         */
+        ErrorCode signHTTPRequestDataWithReservation(SignatureCounterReservation & reservation, size_t slot,
+                                                     const HTTPRequestData & request_data,
+                                                     const SignatureUnlockKeys & keys,
+                                                     SignatureFactor signature_factor,
+                                                     HTTPRequestDataSignature & out_signature);
+        
+        /**
+         Releases all unused slots in |reservation| and marks all its slots as used. If the session's counter
+         didn't move since the reservation, then the counter is moved back to the first unused slot after
+         the last used one, so these values will be used for the next signatures. Otherwise, the unused
+         slots are skipped and the server resynchronizes its counter with the next signature, because the
+         gap is always within its look ahead window. The counter is also not moved back if the signature
+         counter byte has been changed since the reservation. The method can be called while signatures
+         for the reservation are still being calculated in other threads. Such signatures for the released
+         slots then fail with EC_WrongParam.
+         
+         You have to save session's state after the successful operation, due to possible counter change.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_WrongParam, if the reservation is empty
+         */
+        ErrorCode releaseSignatureCounters(SignatureCounterReservation & reservation);
+        
+        
         // MARK: - Signature keys management -
         
         /**
@@ -615,6 +891,33 @@ namespace powerAuth
          */
         ErrorCode getActivationRecoveryData(const std::string & c_vault_key, const SignatureUnlockKeys & keys, RecoveryData & out_recovery_data);
         
+    public:
+        
+        // MARK: - Statistics -
+        
+        /**
+         Enables or disables collection of the session's statistics. The collection is disabled
+         by default. Disabling the collection keeps already collected values, so they can be
+         still retrieved with `statistics()`.
+         */
+        void setStatisticsEnabled(bool enabled);
+        
+        /**
+         Returns true if collection of the session's statistics is enabled.
+         */
+        bool isStatisticsEnabled() const;
+        
+        /**
+         Returns snapshot of statistics collected since the collection was enabled for the first
+         time, or since the last call to `resetStatistics()`.
+         */
+        SessionStatistics statistics() const;
+        
+        /**
+         Sets all collected statistics to zero.
+         */
+        void resetStatistics();
+        
     public:
         
         /**
@@ -648,10 +951,51 @@ namespace powerAuth
         
         // MARK: - Private section -
         
+#if !defined(PA_SESSION_SINGLE_THREADED)
         /**
-         Thread synchronization primitive
+         Thread synchronization primitive. The lock is acquired by all methods, except
+         the state probing methods, which are using the published state snapshot.
          */
         mutable std::recursive_mutex _lock;
+#endif
+        
+        /**
+         Immutable snapshot of information returned from the state probing methods.
+         The structure is defined in the implementation file.
+         */
+        struct StateSnapshot;
+        
+        /**
+         The latest published snapshot. The pointer is always accessed atomically,
+         so the state probing methods don't need to acquire the lock.
+         */
+        std::shared_ptr<const StateSnapshot> _snapshot;
+        
+        /**
+         Version of the session's state, increased each time when a new state snapshot is published.
+         The operations performing expensive computations out of the lock use the version to detect
+         whether the state has been changed in the meantime.
+         */
+        cc7::U32 _stateVersion;
+        
+        /**
+         Persistent data loaded with `loadSessionStateLazily()`. The structure is defined
+         in the implementation file.
+         */
+        struct LazyState;
+        
+        /**
+         Copy of protected signature keys and all other information required for the keys
+         unlock. The structure is defined in the implementation file.
+         */
+        struct KeysSnapshot;
+        
+        /**
+         Cache for values derived from the session's setup and from the transport key, which
+         otherwise would be recalculated in each operation. The structure is defined
+         in the implementation file.
+         */
+        struct DerivedConstants;
         
         /**
          Current session's state.
@@ -665,9 +1009,10 @@ namespace powerAuth
 
         /**
          Pointer to private persistent data structure. The pointer is valid only
-         after the correctly finished activation of the session.
+         after the correctly finished activation of the session, or after the lazily
+         loaded state is materialized. The materialization may happen in const methods.
          */
-        protocol::PersistentData * _pd;
+        mutable protocol::PersistentData * _pd;
         
         /**
          Pointer to private activation data structure. The pointer is valid only
@@ -676,10 +1021,47 @@ namespace powerAuth
         protocol::ActivationData * _ad;
         
         /**
-         Commits a |new_pd| and |new_state| as a new valid session state.
+         Pointer to signature keys unlocked with `unlockSignatureKeys()` method.
+         The pointer is valid only when keys are unlocked.
+         */
+        protocol::UnlockedSignatureKeys * _uk;
+        
+        /**
+         Pointer to lazily loaded persistent data. The pointer is valid only when the state
+         was loaded with `loadSessionStateLazily()` and is not materialized yet. Only one
+         of `_pd` and `_lazy` pointers can be valid at the same time.
+         */
+        mutable LazyState * _lazy;
+        
+        /**
+         Optional journal for the signature counter.
+         */
+        std::shared_ptr<CounterJournal> _journal;
+        
+        /**
+         Pointer to the cache of derived constants. The pointer is valid only if some
+         value has been already cached.
+         */
+        mutable DerivedConstants * _derived;
+        
+        /**
+         Pointer to the statistics collector. The pointer is valid since the collection
+         is enabled for the first time and then it's never changed.
+         */
+        std::atomic<utils::StatisticsCollector*> _statistics;
+        
+        /**
+         Commits a |new_pd| or |new_lazy| and |new_state| as a new valid session state.
          Check documentation in method's implementation for details.
          */
-        void commitNewPersistentState(protocol::PersistentData * new_pd, State new_state);
+        void commitNewPersistentState(protocol::PersistentData * new_pd, State new_state, LazyState * new_lazy = nullptr);
+        
+        /**
+         Returns true if the session has valid activation and the persistent data is available
+         in `_pd`. If the state was loaded lazily, then materializes it at first. The method must
+         be called with the lock acquired, before the persistent data is accessed.
+         */
+        bool hasPersistentData() const;
         
         /**
          Changes internal state to a new one. If code is compiled with DEBUG build flags
@@ -687,6 +1069,50 @@ namespace powerAuth
          */
         void changeState(State new_state);
         
+        /**
+         Creates a new snapshot from the current state and publishes it for the state probing
+         methods. The method must be called with the lock acquired, after each change of
+         information provided in the snapshot.
+         */
+        void publishStateSnapshot();
+        
+        /**
+         Returns the latest published state snapshot.
+         */
+        std::shared_ptr<const StateSnapshot> stateSnapshot() const;
+        
+        /**
+         Fills |out| structure with a copy of protected keys and the current state version.
+         The method must be called with the lock acquired and with a valid activation.
+         */
+        void makeKeysSnapshot(KeysSnapshot & out) const;
+        
+        /**
+         Returns the cache of derived constants. If the cache doesn't exist yet, then creates
+         a new one, with values derived from the session's setup. The method must be called
+         with the lock acquired and with a valid setup.
+         */
+        DerivedConstants & derivedConstants() const;
+        
+        /**
+         Makes sure that the cache of derived constants contains values derived from
+         |transport_key|. Returns false if derivation failed. The method must be called
+         with the lock acquired and with a valid setup.
+         */
+        bool prepareActivationConstants(const cc7::ByteRange & transport_key) const;
+        
+        /**
+         Invalidates the cache of derived constants. If |setup_changed| is false, then only values
+         derived from the transport key are removed. The method must be called with the lock acquired.
+         */
+        void invalidateDerivedConstants(bool setup_changed) const;
+        
+        /**
+         Appends the current signature counter to the journal, if the journal is assigned.
+         The method must be called with the lock acquired and with a valid activation.
+         */
+        void journalCounter() const;
+        
         /**
          Returns non-null pointer to ByteArray with EEK if session works with EEK.
          */
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <PowerAuth/Session.h>
+#include <PowerAuth/Executor.h>
+#include <PowerAuth/WarmUp.h>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /**
+     The SessionStateRecord structure contains serialized state of one session,
+     managed by SessionManager.
+     */
+    struct SessionStateRecord
+    {
+        /**
+         Application key, identifying the setup registered in SessionManager.
+         */
+        std::string applicationKey;
+        /**
+         Activation identifier. The value is optional when the record is loaded
+         into the manager, but if present, then it must match the loaded state.
+         */
+        std::string activationId;
+        /**
+         Serialized session's state, produced by `Session::saveSessionState()`.
+         */
+        cc7::ByteArray state;
+    };
+    
+    /**
+     The SessionStatusRequest structure contains data required for decoding
+     activation status of one session, managed by SessionManager.
+     */
+    struct SessionStatusRequest
+    {
+        std::string applicationKey;
+        std::string activationId;
+        EncryptedActivationStatus encryptedStatus;
+        SignatureUnlockKeys keys;
+    };
+    
+    /**
+     The SessionStatusResult structure contains result of one activation status
+     decoding, performed by `SessionManager::decodeActivationStatuses()`.
+     */
+    struct SessionStatusResult
+    {
+        ErrorCode code = EC_WrongParam;
+        ActivationStatus status;
+    };
+    
+    /**
+     The SessionManager class keeps a large number of activated sessions, indexed by
+     application key and activation identifier. The class is designed for applications
+     hosting sessions for multiple applications and activations at once:
+     
+      - The index is split into independently locked shards, so lookups for different
+        sessions rarely contend on the same lock.
+      - The SessionSetup structure is registered once per application key, so the bulk
+        load doesn't need to carry the setup with each record.
+      - The bulk operations are executed in parallel, on the provided executor.
+     
+     The manager doesn't observe changes in the managed sessions, so you have to call
+     `markDirty()` after the operation that changes the session's state, like the signature
+     calculation. All methods are thread safe.
+     */
+    class SessionManager
+    {
+    public:
+        
+        /**
+         Constructs a manager which executes the bulk operations on |executor|. If
+         executor is not provided, then `Executor::defaultExecutor()` is used.
+         */
+        SessionManager(std::shared_ptr<Executor> executor = nullptr);
+        ~SessionManager();
+        
+        // MARK: - Setup -
+        
+        /**
+         Registers |setup| for its application key. All sessions later created for that application
+         key are created with this setup. The previously registered setup is replaced, but sessions already
+         created with it are not affected.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_WrongParam, if setup has no application key
+         */
+        ErrorCode registerSetup(const SessionSetup & setup);
+        
+        /**
+         Returns setup registered for |application_key|, or nullptr if there's no such setup.
+         */
+        std::shared_ptr<const SessionSetup> sessionSetup(const std::string & application_key) const;
+        
+        /**
+         Performs the library warm-up with master server public keys from all registered setups.
+         See `WarmUp()` function for details.
+         */
+        ErrorCode warmUp(WarmUpTimings & out_timings) const;
+        
+        // MARK: - Sessions -
+        
+        /**
+         Adds an already activated |session| to the manager. The session is indexed by application
+         key from its setup and by its activation identifier. A session previously registered with
+         the same keys is replaced.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_WrongState, if session has no valid activation
+                 EC_WrongParam, if session is nullptr
+         */
+        ErrorCode addSession(std::shared_ptr<Session> session, bool dirty = true);
+        
+        /**
+         Returns session for |application_key| and |activation_id|, or nullptr if there's no such session.
+         */
+        std::shared_ptr<Session> findSession(const std::string & application_key, const std::string & activation_id) const;
+        
+        /**
+         Removes session for |application_key| and |activation_id|. Returns false if there was no such session.
+         */
+        bool removeSession(const std::string & application_key, const std::string & activation_id);
+        
+        /**
+         Marks session as modified, so it will be serialized in the next `saveDirtySessions()` call.
+         Returns false if there's no such session.
+         */
+        bool markDirty(const std::string & application_key, const std::string & activation_id);
+        
+        /**
+         Returns number of managed sessions.
+         */
+        size_t sessionsCount() const;
+        
+        // MARK: - Bulk operations -
+        
+        /**
+         Creates and loads sessions from all |records|, in parallel. Each record must refer to the setup
+         previously registered with `registerSetup()`. The |out_results| vector receives result for each
+         record: EC_WrongSetup if there's no setup for the application key, EC_WrongData if the state
+         is invalid or activation identifier doesn't match, and EC_WrongState if the state contains
+         no activation. Successfully loaded sessions are not dirty.
+         
+         Returns EC_Ok if all records were loaded, otherwise the first error from |out_results|.
+         */
+        ErrorCode loadSessions(const std::vector<SessionStateRecord> & records, std::vector<ErrorCode> & out_results);
+        
+        /**
+         Serializes all dirty sessions, in parallel, into |out_records| and clears their dirty flag.
+         Returns number of serialized sessions.
+         */
+        size_t saveDirtySessions(std::vector<SessionStateRecord> & out_records);
+        
+        /**
+         Decodes activation statuses for all |requests|, in parallel. The |out_results| vector receives
+         result for each request: EC_WrongState if there's no such session, otherwise the result of
+         `Session::decodeActivationStatus()`. The session is marked as dirty after the successful decode,
+         because it may synchronize its signature counter.
+         */
+        void decodeActivationStatuses(const std::vector<SessionStatusRequest> & requests, std::vector<SessionStatusResult> & out_results);
+        
+    private:
+        
+        struct Entry;
+        struct Shard;
+        
+        SessionManager(const SessionManager &) = delete;
+        SessionManager & operator=(const SessionManager &) = delete;
+        
+        /**
+         Returns shard for given keys.
+         */
+        Shard & shardFor(const std::string & application_key, const std::string & activation_id) const;
+        
+        /**
+         Returns entry for given keys, or nullptr.
+         */
+        std::shared_ptr<Entry> findEntry(const std::string & application_key, const std::string & activation_id) const;
+        
+        /**
+         Inserts a new entry for |session|, replacing the previous one.
+         */
+        void insertEntry(const std::string & application_key, const std::string & activation_id, std::shared_ptr<Session> session, bool dirty);
+        
+        /**
+         Calls |body| for each index from 0 to |count| - 1, in parallel.
+         */
+        void parallelFor(size_t count, const std::function<void(size_t)> & body);
+        
+        std::shared_ptr<Executor> _executor;
+        std::unique_ptr<Shard[]> _shards;
+        
+        mutable std::mutex _setupsLock;
+        std::map<std::string, std::shared_ptr<const SessionSetup>> _setups;
+    };
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <PowerAuth/PublicTypes.h>
+#include <chrono>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /**
+     The SessionStatistics structure is a snapshot of statistics collected by the Session,
+     after the collection is enabled with `Session::setStatisticsEnabled()`.
+     
+     Each public operation that acquires the session's lock is counted, together with the time
+     spent in the operation. The time is also split into categories, like waiting for the lock
+     or PBKDF2 calculation. Nested categories are not double-counted, so for example, the ECC
+     time spent during the state deserialization is not included in the serialization time.
+     */
+    struct SessionStatistics
+    {
+        /**
+         The Operation enumeration identifies the public operations of the Session.
+         */
+        enum Operation
+        {
+            SO_SetSessionSetup,
+            SO_ResetSession,
+            SO_SaveSessionState,
+            SO_LoadSessionState,
+            SO_LoadSessionStateLazily,
+            SO_MaterializeSessionState,
+            SO_ActivationFingerprint,
+            SO_StartActivation,
+            SO_ValidateActivationResponse,
+            SO_CompleteActivation,
+            SO_DecodeActivationStatus,
+            SO_SignHTTPRequestData,
+            SO_SignHTTPRequestDataBatch,
+            SO_VerifyServerSignedData,
+            SO_UnlockSignatureKeys,
+            SO_LockSignatureKeys,
+            SO_SignHTTPRequestDataWithUnlockedKeys,
+            SO_DecodeActivationStatusWithUnlockedKeys,
+            SO_ReserveSignatureCounters,
+            SO_SignHTTPRequestDataWithReservation,
+            SO_ReleaseSignatureCounters,
+            SO_ChangeUserPassword,
+            SO_AddBiometryFactor,
+            SO_RemoveBiometryFactor,
+            SO_DeriveCryptographicKeyFromVaultKey,
+            SO_SignDataWithDevicePrivateKey,
+            SO_SetExternalEncryptionKey,
+            SO_AddExternalEncryptionKey,
+            SO_RemoveExternalEncryptionKey,
+            SO_GetEciesEncryptor,
+            SO_StartProtocolUpgrade,
+            SO_ApplyProtocolUpgradeData,
+            SO_FinishProtocolUpgrade,
+            SO_GetActivationRecoveryData,
+            /**
+             Number of operations. This is not a valid operation.
+             */
+            SO_Count
+        };
+        
+        /**
+         The OperationStatistics structure contains statistics for one operation.
+         */
+        struct OperationStatistics
+        {
+            /**
+             Number of calls.
+             */
+            cc7::U64 calls;
+            /**
+             Total time spent in all calls.
+             */
+            std::chrono::microseconds time;
+            
+            OperationStatistics() :
+                calls(0),
+                time(0)
+            {
+            }
+        };
+        
+        /**
+         Statistics for each operation, indexed by the Operation enumeration.
+         */
+        OperationStatistics operations[SO_Count];
+        
+        /**
+         Time spent waiting for the session's lock, when the lock was already acquired by other thread.
+         */
+        std::chrono::microseconds lockWait;
+        /**
+         Time spent in PBKDF2 calculations.
+         */
+        std::chrono::microseconds pbkdf2;
+        /**
+         Time spent in elliptic curve operations, like key import, ECDSA or ECDH.
+         */
+        std::chrono::microseconds ecc;
+        /**
+         Time spent in symmetric cryptography, like AES or HMAC.
+         */
+        std::chrono::microseconds symmetricCrypto;
+        /**
+         Time spent in the session's state serialization and deserialization.
+         */
+        std::chrono::microseconds serialization;
+        
+        /**
+         Number of signature keys unlocks.
+         */
+        cc7::U64 keyUnlocks;
+        /**
+         Number of signature counter advances.
+         */
+        cc7::U64 counterAdvances;
+        /**
+         Number of counter values evaluated in the look ahead window, during the counter synchronization.
+         */
+        cc7::U64 lookAheadIterations;
+        /**
+         Number of PRNG reseeds.
+         */
+        cc7::U64 prngReseeds;
+        
+        SessionStatistics() :
+            lockWait(0),
+            pbkdf2(0),
+            ecc(0),
+            symmetricCrypto(0),
+            serialization(0),
+            keyUnlocks(0),
+            counterAdvances(0),
+            lookAheadIterations(0),
+            prngReseeds(0)
+        {
+        }
+    };
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
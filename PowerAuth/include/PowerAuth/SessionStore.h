@@ -0,0 +1,184 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <PowerAuth/PublicTypes.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /**
+     The SessionStore class keeps serialized states of multiple sessions in one file,
+     indexed by activation identifier. The file is memory mapped, so opening the store
+     costs one mmap and parsing the index. The records are loaded and validated lazily,
+     on the first access.
+     
+     The file is never modified in place. Each update appends new records and a new index
+     at the end of the file, and then switches one of two header slots, so the interrupted
+     update always leaves the previous content intact. The records and the index are protected
+     with a checksum. The space occupied by obsolete records is reclaimed by compaction, which
+     is performed automatically, when the obsolete data exceeds the live data.
+     
+     All methods are thread safe. The file must not be opened by multiple SessionStore
+     instances at the same time.
+     */
+    class SessionStore
+    {
+    public:
+        
+        SessionStore();
+        ~SessionStore();
+        
+        /**
+         Opens store at |path|. If the file doesn't exist, then the new, empty store is created.
+         
+         Returns EC_Ok,             if operation succeeded
+                 EC_WrongState,     if the store is already opened
+                 EC_WrongData,      if the file is not a valid store
+                 EC_GeneralFailure, if the file cannot be opened or created
+         */
+        ErrorCode open(const std::string & path);
+        
+        /**
+         Closes the store.
+         */
+        void close();
+        
+        /**
+         Returns true if store is opened.
+         */
+        bool isOpened() const;
+        
+        /**
+         Returns list of all stored activation identifiers.
+         */
+        std::vector<std::string> activationIds() const;
+        
+        /**
+         Returns true if there's a record for |activation_id|.
+         */
+        bool contains(const std::string & activation_id) const;
+        
+        /**
+         Loads serialized session's state for |activation_id| into |out_state|.
+         
+         Returns EC_Ok,         if operation succeeded
+                 EC_WrongState, if the store is not opened
+                 EC_WrongParam, if there's no record for the activation
+                 EC_WrongData,  if the record is corrupted
+         */
+        ErrorCode load(const std::string & activation_id, cc7::ByteArray & out_state) const;
+        
+        /**
+         Stores serialized session's |state| for |activation_id|. The previous record
+         for the same activation is replaced.
+         
+         Returns EC_Ok,             if operation succeeded
+                 EC_WrongState,     if the store is not opened
+                 EC_WrongParam,     if activation identifier or state is empty
+                 EC_GeneralFailure, if the file cannot be written
+         */
+        ErrorCode store(const std::string & activation_id, const cc7::ByteRange & state);
+        
+        /**
+         Removes record for |activation_id|. Check `update()` for return codes.
+         */
+        ErrorCode remove(const std::string & activation_id);
+        
+        /**
+         Atomically stores all records from |states| and removes all records listed in |removals|.
+         Removal of not existing record is not treated as an error.
+         
+         Returns EC_Ok,             if operation succeeded
+                 EC_WrongState,     if the store is not opened
+                 EC_WrongParam,     if some activation identifier or state is empty
+                 EC_GeneralFailure, if the file cannot be written
+         */
+        ErrorCode update(const std::map<std::string, cc7::ByteArray> & states, const std::vector<std::string> & removals);
+        
+        /**
+         Rewrites the store into a new file, containing only the live records. If the operation
+         fails, then the store stays opened.
+         
+         Returns EC_Ok,             if operation succeeded
+                 EC_WrongState,     if the store is not opened
+                 EC_GeneralFailure, if the file cannot be written
+         */
+        ErrorCode compact();
+        
+        /**
+         Returns size of the store's file in bytes.
+         */
+        size_t fileSize() const;
+        
+        /**
+         Returns number of bytes occupied by obsolete records and indexes.
+         */
+        size_t unusedSize() const;
+        
+    private:
+        
+        /**
+         Location of one record in the file.
+         */
+        struct RecordLocation
+        {
+            cc7::U64 offset;
+            cc7::U32 size;
+        };
+        
+        typedef std::map<std::string, RecordLocation> Index;
+        
+        SessionStore(const SessionStore &) = delete;
+        SessionStore & operator=(const SessionStore &) = delete;
+        
+        ErrorCode openFile(const std::string & path);
+        void closeFile();
+        bool mapFile(size_t size);
+        bool readHeader();
+        ErrorCode commit(const Index & index, const cc7::ByteArray & records, cc7::U64 records_offset);
+        ErrorCode compactFile();
+        size_t liveSize() const;
+        
+        mutable std::mutex _lock;
+        std::string _path;
+        int _fd;
+        const cc7::byte * _map;
+        size_t _mapSize;
+        
+        /// Generation of the active header slot.
+        cc7::U64 _generation;
+        /// Index of the active header slot.
+        size_t _activeSlot;
+        /// Position of the current index in the file.
+        cc7::U64 _indexOffset;
+        cc7::U32 _indexSize;
+        /// End of valid data in the file.
+        cc7::U64 _dataEnd;
+        
+        Index _index;
+    };
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <PowerAuth/PublicTypes.h>
+
+/*
+ The trace points are compiled only if the library is compiled with PA_ENABLE_TRACING
+ macro defined. Otherwise, all trace points compile to nothing and the registered
+ listener is never called.
+ 
+ On Linux, if <sys/sdt.h> header is available, each trace point also fires USDT probes
+ "powerauth:begin" and "powerauth:end" with three arguments: the trace point's name,
+ the TracePoint value and the trace point's argument. For example:
+ 
+    bpftrace -e 'usdt:libPowerAuthCore.so:powerauth:begin { @[str(arg0)] = count(); }'
+ */
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /**
+     The TracePoint enumeration defines scopes reported to the tracing.
+     */
+    enum TracePoint
+    {
+        /**
+         Public method of Session class. The argument is the operation's value
+         from SessionStatistics::Operation enumeration. Public methods called
+         from other public method of the same session are not reported.
+         */
+        TP_SessionOperation,
+        /**
+         Unlock of signature keys. The argument is the combination of
+         requested signature factors.
+         */
+        TP_UnlockSignatureKeys,
+        /**
+         Calculation of one signature or a batch of signatures. The argument is
+         the number of calculated signatures.
+         */
+        TP_CalculateSignature,
+        /**
+         Look-ahead search for the counter distance. The argument is the maximum
+         number of iterations.
+         */
+        TP_CalculateHashCounterDistance,
+        /**
+         ECIES encryption. The argument is the size of plaintext.
+         */
+        TP_ECIESEncrypt,
+        /**
+         ECIES decryption. The argument is the size of ciphertext.
+         */
+        TP_ECIESDecrypt,
+        /**
+         PBKDF2 key derivation. The argument is the number of iterations.
+         */
+        TP_PBKDF2,
+        
+        TP_Count
+    };
+    
+    /**
+     Returns name of trace |point|, for example "ECIESEncrypt".
+     */
+    const char * TracePointName(TracePoint point);
+    
+    /**
+     The TraceListener class receives begin and end of each trace point. The methods
+     are called from the thread that executes the traced code, so the implementation
+     should return as soon as possible and must not call back to the library.
+     */
+    class TraceListener
+    {
+    public:
+        virtual ~TraceListener() {}
+        
+        /**
+         Called when the scope of trace |point| begins.
+         */
+        virtual void traceBegin(TracePoint point, cc7::U64 argument) = 0;
+        
+        /**
+         Called when the scope of trace |point| ends. Each end is reported to the
+         same listener that received the matching begin.
+         */
+        virtual void traceEnd(TracePoint point, cc7::U64 argument) = 0;
+    };
+    
+    /**
+     Returns true if the library is compiled with the trace points.
+     */
+    bool TracingAvailable();
+    
+    /**
+     Sets the process-wide |listener| or removes the current one if nullptr is provided.
+     The listener is not retained. It must remain valid until it's removed and all traced
+     scopes that started while it was set have finished. In practice, set a listener that
+     lives for the rest of the process lifetime.
+     */
+    void SetTraceListener(TraceListener * listener);
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
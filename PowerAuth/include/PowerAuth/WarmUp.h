@@ -0,0 +1,97 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <PowerAuth/PublicTypes.h>
+#include <PowerAuth/Executor.h>
+#include <chrono>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /**
+     The WarmUpTimings structure contains duration of each step performed
+     in the library warm-up.
+     */
+    struct WarmUpTimings
+    {
+        /**
+         Initial seed of the pseudo random number generator.
+         */
+        std::chrono::microseconds prngSeed;
+        /**
+         Initialization of the crypto library, including the first use of all
+         symmetric algorithms required by the protocol.
+         */
+        std::chrono::microseconds cryptoLibrary;
+        /**
+         Construction of the elliptic curve and the first use of ECDSA and ECDH.
+         */
+        std::chrono::microseconds ellipticCurve;
+        /**
+         Import and validation of all provided master server public keys.
+         */
+        std::chrono::microseconds masterKeys;
+        /**
+         Duration of the whole warm-up.
+         */
+        std::chrono::microseconds total;
+        
+        WarmUpTimings() :
+            prngSeed(0),
+            cryptoLibrary(0),
+            ellipticCurve(0),
+            masterKeys(0),
+            total(0)
+        {
+        }
+    };
+    
+    /**
+     Performs all one-time initializations that would otherwise happen during the first
+     cryptographic operation, like the initial seed of PRNG, initialization of the crypto
+     library, or construction of the elliptic curve. Each master server public key from
+     |master_server_public_keys| vector, in Base64 format, is imported and validated.
+     The duration of each step is stored into |out_timings|.
+     
+     You can call the function at the application's startup, to move all first-call costs
+     off the critical path. Calling the function is optional and it's safe to call it
+     multiple times or concurrently with other library operations.
+     
+     Returns EC_Ok,         if all steps succeeded
+             EC_WrongParam, if some master server public key is invalid
+             EC_Encryption, if some cryptographic operation failed
+     */
+    ErrorCode WarmUp(const std::vector<std::string> & master_server_public_keys, WarmUpTimings & out_timings);
+    
+    /**
+     Performs the same warm-up as `WarmUp()` function, but on the |executor|. If the executor
+     is not provided, then the shared instance returned from `Executor::defaultExecutor()` is
+     used. The optional |completion| is called from the executor's thread, once the warm-up
+     is finished.
+     */
+    void WarmUpInBackground(const std::vector<std::string> & master_server_public_keys,
+                            std::function<void(ErrorCode, const WarmUpTimings &)> completion = nullptr,
+                            std::shared_ptr<Executor> executor = nullptr);
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
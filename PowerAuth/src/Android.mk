@@ -39,6 +39,12 @@ LOCAL_C_INCLUDES := \
 # Multiplatform sources
 LOCAL_SRC_FILES := \
 	PowerAuth/Session.cpp \
+	PowerAuth/AsyncSession.cpp \
+	PowerAuth/Executor.cpp \
+	PowerAuth/SessionManager.cpp \
+	PowerAuth/SessionStore.cpp \
+	PowerAuth/CounterJournal.cpp \
+	PowerAuth/WarmUp.cpp \
 	PowerAuth/PublicTypes.cpp \
 	PowerAuth/Password.cpp \
 	PowerAuth/Debug.cpp \
@@ -48,7 +54,12 @@ LOCAL_SRC_FILES := \
 	PowerAuth/crypto/Hash.cpp \
 	PowerAuth/crypto/KDF.cpp \
 	PowerAuth/crypto/MAC.cpp \
+	PowerAuth/crypto/BNContext.cpp \
 	PowerAuth/crypto/ECC.cpp \
+	PowerAuth/crypto/EVPCache.cpp \
+	PowerAuth/crypto/CryptoProvider.cpp \
+	PowerAuth/crypto/SHA256Engine.cpp \
+	PowerAuth/crypto/SHA256MultiBuffer.cpp \
 	PowerAuth/crypto/PKCS7Padding.cpp \
 	PowerAuth/crypto/PRNG.cpp \
 	PowerAuth/protocol/Constants.cpp \
@@ -57,7 +68,11 @@ LOCAL_SRC_FILES := \
 	PowerAuth/utils/DataReader.cpp \
 	PowerAuth/utils/DataWriter.cpp \
 	PowerAuth/utils/URLEncoding.cpp \
-	PowerAuth/utils/CRC16.cpp
+	PowerAuth/utils/Base64.cpp \
+	PowerAuth/utils/CRC16.cpp \
+	PowerAuth/utils/Statistics.cpp \
+	PowerAuth/utils/Metrics.cpp \
+	PowerAuth/utils/Tracing.cpp
 
 include $(BUILD_STATIC_LIBRARY)
 
@@ -87,6 +102,8 @@ LOCAL_C_INCLUDES := \
 LOCAL_SRC_FILES := \
 	PowerAuthTests/PowerAuthTestsList.cpp \
 	PowerAuthTests/pa2CryptoAESTests.cpp \
+	PowerAuthTests/pa2CryptoSHA256Tests.cpp \
+	PowerAuthTests/pa2CryptoProviderTests.cpp \
 	PowerAuthTests/pa2CryptoHMACTests.cpp \
 	PowerAuthTests/pa2CryptoPKCS7PaddingTests.cpp \
 	PowerAuthTests/pa2CryptoECCTests.cpp \
@@ -98,14 +115,21 @@ LOCAL_SRC_FILES := \
 	PowerAuthTests/pa2ProtocolUtilsTests.cpp \
 	PowerAuthTests/pa2RecoveryCodeTests.cpp \
 	PowerAuthTests/pa2SessionTests.cpp \
+	PowerAuthTests/pa2AsyncSessionTests.cpp \
+	PowerAuthTests/pa2SessionManagerTests.cpp \
+	PowerAuthTests/pa2SessionStoreTests.cpp \
+	PowerAuthTests/pa2WarmUpTests.cpp \
 	PowerAuthTests/pa2SignatureCalculationTests.cpp \
 	PowerAuthTests/pa2SignatureKeysDerivationTest.cpp \
 	PowerAuthTests/pa2PublicKeyFingerprintTests.cpp \
 	PowerAuthTests/pa2ActivationStatusBlobTests.cpp \
 	PowerAuthTests/pa2URLEncodingTests.cpp \
+	PowerAuthTests/pa2Base64Tests.cpp \
 	PowerAuthTests/pa2ActivationCodeTests.cpp \
 	PowerAuthTests/pa2ECIESTests.cpp \
 	PowerAuthTests/pa2CRC16Tests.cpp \
+	PowerAuthTests/pa2MetricsTests.cpp \
+	PowerAuthTests/pa2TracingTests.cpp \
 	PowerAuthTests/TestData/pa2.generated/g_pa2Files.cpp
 
 include $(BUILD_STATIC_LIBRARY)
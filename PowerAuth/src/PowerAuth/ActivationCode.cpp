@@ -16,9 +16,9 @@
 
 
 #include <PowerAuth/ActivationCode.h>
-#include <cc7/Base64.h>
 #include <cc7/Base32.h>
 #include "utils/CRC16.h"
+#include "utils/Base64.h"
 
 namespace com
 {
@@ -140,7 +140,7 @@ namespace powerAuth
     bool ActivationCodeUtil::validateSignature(const std::string &signature)
     {
         cc7::ByteArray foo_data;
-        if (cc7::Base64_Decode(signature, 0, foo_data)) {
+        if (utils::Base64_Decode(signature, foo_data)) {
             return !foo_data.empty();
         }
         return false;
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PowerAuth/AsyncSession.h>
+#include "crypto/KDF.h"
+#include <algorithm>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    // MARK: - Private helpers -
+    
+    /**
+     The _OperationKDFDelegate connects PBKDF2 calculations running on the executor's
+     thread with the AsyncOperation object and the progress callback.
+     */
+    class _OperationKDFDelegate : public crypto::KDFProgressDelegate
+    {
+    public:
+        _OperationKDFDelegate(const AsyncOperation & operation, const AsyncProgressCallback & progress, bool cancellable, unsigned derivations) :
+            _operation(operation),
+            _progress(progress),
+            _cancellable(cancellable),
+            _derivations(std::max(derivations, 1u)),
+            _finished(0)
+        {
+        }
+        
+        bool kdfProgress(cc7::U32 completed, cc7::U32 total) override
+        {
+            if (_progress) {
+                double value = (_finished + (double)completed / total) / _derivations;
+                _progress(std::min(value, 1.0));
+            }
+            if (completed == total) {
+                ++_finished;
+            }
+            return !(_cancellable && _operation.isCancelled());
+        }
+        
+    private:
+        const AsyncOperation & _operation;
+        const AsyncProgressCallback & _progress;
+        const bool _cancellable;
+        const unsigned _derivations;
+        unsigned _finished;
+    };
+    
+    
+    // MARK: - AsyncSession -
+    
+    AsyncSession::AsyncSession(Session & session, std::shared_ptr<Executor> executor) :
+        _session(session),
+        _executor(executor ? executor : Executor::defaultExecutor())
+    {
+    }
+    
+    AsyncOperationPtr AsyncSession::dispatch(std::function<ErrorCode()> task,
+                                             std::function<void(ErrorCode)> completion,
+                                             AsyncProgressCallback progress,
+                                             bool cancellable,
+                                             unsigned derivations)
+    {
+        auto operation = std::make_shared<AsyncOperation>();
+        _executor->execute([=]() {
+            ErrorCode code;
+            if (operation->isCancelled()) {
+                code = EC_Cancelled;
+            } else {
+                // The progressive PBKDF2 is slower, so the delegate is installed only
+                // when the progress is reported, or when the operation can be cancelled.
+                _OperationKDFDelegate delegate(*operation, progress, cancellable, derivations);
+                crypto::ScopedKDFProgressDelegate scope(progress || cancellable ? &delegate : nullptr);
+                code = task();
+                // The task fails when the key derivation is cancelled. If the task
+                // succeeded, then the cancel request came too late and the result
+                // must be reported, because the session's state might be changed.
+                if (code != EC_Ok && cancellable && operation->isCancelled()) {
+                    code = EC_Cancelled;
+                }
+            }
+            if (completion) {
+                completion(code);
+            }
+            operation->_finished = true;
+        });
+        return operation;
+    }
+    
+    AsyncOperationPtr AsyncSession::startActivation(const ActivationStep1Param & param,
+                                                    std::function<void(ErrorCode, const ActivationStep1Result &)> completion)
+    {
+        Session * session = &_session;
+        auto result = std::make_shared<ActivationStep1Result>();
+        return dispatch([=]() {
+            return session->startActivation(param, *result);
+        }, [=](ErrorCode code) {
+            if (completion) {
+                completion(code, *result);
+            }
+        }, nullptr, false, 0);
+    }
+    
+    AsyncOperationPtr AsyncSession::validateActivationResponse(const ActivationStep2Param & param,
+                                                               std::function<void(ErrorCode, const ActivationStep2Result &)> completion)
+    {
+        Session * session = &_session;
+        auto result = std::make_shared<ActivationStep2Result>();
+        return dispatch([=]() {
+            return session->validateActivationResponse(param, *result);
+        }, [=](ErrorCode code) {
+            if (completion) {
+                completion(code, *result);
+            }
+        }, nullptr, false, 0);
+    }
+    
+    AsyncOperationPtr AsyncSession::completeActivation(const SignatureUnlockKeys & keys,
+                                                       std::function<void(ErrorCode)> completion,
+                                                       AsyncProgressCallback progress)
+    {
+        Session * session = &_session;
+        return dispatch([=]() {
+            return session->completeActivation(keys);
+        }, completion, progress, false, 1);
+    }
+    
+    AsyncOperationPtr AsyncSession::signHTTPRequestData(const HTTPRequestData & request_data,
+                                                        const SignatureUnlockKeys & keys,
+                                                        SignatureFactor signature_factor,
+                                                        std::function<void(ErrorCode, const HTTPRequestDataSignature &)> completion,
+                                                        AsyncProgressCallback progress)
+    {
+        Session * session = &_session;
+        auto result = std::make_shared<HTTPRequestDataSignature>();
+        return dispatch([=]() {
+            return session->signHTTPRequestData(request_data, keys, signature_factor, *result);
+        }, [=](ErrorCode code) {
+            if (completion) {
+                completion(code, *result);
+            }
+        }, progress, true, 1);
+    }
+    
+    AsyncOperationPtr AsyncSession::changeUserPassword(const cc7::ByteArray & old_password,
+                                                       const cc7::ByteArray & new_password,
+                                                       std::function<void(ErrorCode)> completion,
+                                                       AsyncProgressCallback progress)
+    {
+        Session * session = &_session;
+        return dispatch([=]() {
+            return session->changeUserPassword(old_password, new_password);
+        }, completion, progress, true, 2);
+    }
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
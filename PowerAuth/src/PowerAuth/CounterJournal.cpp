@@ -0,0 +1,298 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PowerAuth/CounterJournal.h>
+#include "protocol/PrivateTypes.h"
+#include "protocol/ProtocolUtils.h"
+#include "protocol/Constants.h"
+#include "crypto/MAC.h"
+#include <cc7/Endian.h>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /*
+     Each journal record has a fixed size, 48 bytes:
+     
+        [0]   MAGIC ('P', 'J')
+        [2]   VERSION
+        [3]   FLAGS
+        [4]   CTR_BYTE
+        [5]   (reserved, zeros)
+        [8]   V2 COUNTER (U64, big endian)
+        [16]  V3 CTR_DATA (16 bytes, zeros for V2)
+        [32]  MAC (16 bytes) = HMAC-SHA256(MAC_KEY, ACTIVATION_ID || RECORD[0..31])
+     
+     The incomplete record at the end of file, which may be produced by the interrupted
+     write, is truncated when the journal is opened, or right after the failed write.
+     Otherwise all following records would be misaligned.
+     */
+    
+    static const size_t RECORD_SIZE         = 48;
+    static const size_t RECORD_BODY_SIZE    = 32;
+    static const size_t RECORD_CTR_SIZE     = 16;
+    static const cc7::byte RECORD_VERSION   = 1;
+    static const size_t MAC_KEY_MIN_SIZE    = 16;
+    
+    static const cc7::byte FLAG_V3          = 0x01;
+    static const cc7::byte FLAG_CTR_BYTE    = 0x02;
+    
+    /**
+     Returns MAC for the record's body.
+     */
+    static cc7::ByteArray _RecordMAC(const cc7::ByteRange & key, const std::string & activation_id, const cc7::ByteRange & body)
+    {
+        cc7::ByteArray data;
+        data.reserve(activation_id.size() + body.size());
+        data.append(cc7::MakeRange(activation_id));
+        data.append(body);
+        return crypto::HMAC_SHA256(data, key, RECORD_SIZE - RECORD_BODY_SIZE);
+    }
+    
+    
+    // MARK: - Construction / Destruction -
+    
+    CounterJournal::CounterJournal(const std::string & path,
+                                   const cc7::ByteRange & mac_key,
+                                   SyncPolicy sync_policy,
+                                   size_t sync_interval,
+                                   size_t snapshot_interval) :
+        _fd(-1),
+        _macKey(mac_key),
+        _syncPolicy(sync_policy),
+        _syncInterval(std::max<size_t>(sync_interval, 1)),
+        _snapshotInterval(std::max<size_t>(snapshot_interval, 1)),
+        _recordsCount(0),
+        _unsyncedCount(0),
+        _failed(true)
+    {
+        if (mac_key.size() < MAC_KEY_MIN_SIZE) {
+            CC7_LOG("CounterJournal %p: MAC key is too short.", this);
+            return;
+        }
+        _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0600);
+        if (_fd < 0) {
+            CC7_LOG("CounterJournal %p: Unable to open file. Error %d.", this, errno);
+            return;
+        }
+        struct stat st;
+        if (fstat(_fd, &st) != 0) {
+            ::close(_fd);
+            _fd = -1;
+            return;
+        }
+        _recordsCount = (size_t)st.st_size / RECORD_SIZE;
+        if ((size_t)st.st_size != _recordsCount * RECORD_SIZE) {
+            // Remove the incomplete record.
+            if (ftruncate(_fd, (off_t)(_recordsCount * RECORD_SIZE)) != 0 || fsync(_fd) != 0) {
+                CC7_LOG("CounterJournal %p: Unable to truncate incomplete record. Error %d.", this, errno);
+                ::close(_fd);
+                _fd = -1;
+                _recordsCount = 0;
+                return;
+            }
+        }
+        _failed = false;
+    }
+    
+    CounterJournal::~CounterJournal()
+    {
+        if (_fd >= 0) {
+            if (_unsyncedCount > 0 && _syncPolicy != JSP_Never) {
+                fsync(_fd);
+            }
+            ::close(_fd);
+        }
+        _macKey.secureClear();
+    }
+    
+    bool CounterJournal::isValid() const
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        return !_failed;
+    }
+    
+    size_t CounterJournal::recordsCount() const
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        return _recordsCount;
+    }
+    
+    bool CounterJournal::shouldWriteSnapshot() const
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        return _failed || _recordsCount >= _snapshotInterval;
+    }
+    
+    ErrorCode CounterJournal::reset()
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_fd < 0) {
+            return EC_GeneralFailure;
+        }
+        if (ftruncate(_fd, 0) != 0 || fsync(_fd) != 0) {
+            CC7_LOG("CounterJournal %p: Unable to truncate file. Error %d.", this, errno);
+            _failed = true;
+            return EC_GeneralFailure;
+        }
+        _recordsCount = 0;
+        _unsyncedCount = 0;
+        _failed = false;
+        return EC_Ok;
+    }
+    
+    void CounterJournal::sync()
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_fd >= 0 && _unsyncedCount > 0) {
+            if (fsync(_fd) != 0) {
+                _failed = true;
+            }
+            _unsyncedCount = 0;
+        }
+    }
+    
+    
+    // MARK: - Private methods -
+    
+    bool CounterJournal::append(const protocol::PersistentData & pd)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_fd < 0) {
+            return false;
+        }
+        cc7::byte record[RECORD_SIZE];
+        memset(record, 0, sizeof(record));
+        record[0] = 'P';
+        record[1] = 'J';
+        record[2] = RECORD_VERSION;
+        record[3] = (pd.isV3() ? FLAG_V3 : 0) | (pd.flags.hasSignatureCounterByte ? FLAG_CTR_BYTE : 0);
+        record[4] = pd.signatureCounterByte;
+        const cc7::U64 be_counter = cc7::ToBigEndian(pd.signatureCounter);
+        memcpy(record + 8, &be_counter, sizeof(be_counter));
+        if (pd.isV3() && pd.signatureCounterData.size() == RECORD_CTR_SIZE) {
+            memcpy(record + 16, pd.signatureCounterData.data(), RECORD_CTR_SIZE);
+        }
+        const cc7::ByteArray mac = _RecordMAC(_macKey, pd.activationId, cc7::ByteRange(record, RECORD_BODY_SIZE));
+        memcpy(record + RECORD_BODY_SIZE, mac.data(), mac.size());
+        
+        // The file is opened in append mode, so the record is always written at the end.
+        ssize_t written;
+        do {
+            written = write(_fd, record, RECORD_SIZE);
+        } while (written < 0 && errno == EINTR);
+        if (written != (ssize_t)RECORD_SIZE) {
+            CC7_LOG("CounterJournal %p: Unable to write record. Error %d.", this, errno);
+            if (written > 0) {
+                // Remove the partially written record, to keep the next records aligned.
+                if (ftruncate(_fd, (off_t)(_recordsCount * RECORD_SIZE)) != 0) {
+                    CC7_LOG("CounterJournal %p: Unable to truncate incomplete record. Error %d.", this, errno);
+                }
+            }
+            _failed = true;
+            return false;
+        }
+        _recordsCount++;
+        _unsyncedCount++;
+        if (_syncPolicy == JSP_Always || (_syncPolicy == JSP_Periodic && _unsyncedCount >= _syncInterval)) {
+            if (fsync(_fd) != 0) {
+                CC7_LOG("CounterJournal %p: Unable to sync file. Error %d.", this, errno);
+                _failed = true;
+                return false;
+            }
+            _unsyncedCount = 0;
+        }
+        return true;
+    }
+    
+    size_t CounterJournal::replay(protocol::PersistentData & pd) const
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_fd < 0 || _recordsCount == 0) {
+            return 0;
+        }
+        // Read all complete records.
+        cc7::ByteArray data(_recordsCount * RECORD_SIZE, 0);
+        size_t offset = 0;
+        while (offset < data.size()) {
+            ssize_t result = pread(_fd, data.data() + offset, data.size() - offset, (off_t)offset);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                break;
+            }
+            offset += result;
+        }
+        size_t applied = 0;
+        const bool is_v3 = pd.isV3();
+        for (size_t pos = 0; pos + RECORD_SIZE <= offset; pos += RECORD_SIZE) {
+            const cc7::ByteRange record(data.data() + pos, RECORD_SIZE);
+            const cc7::ByteRange body = record.subRangeTo(RECORD_BODY_SIZE);
+            if (record[0] != 'P' || record[1] != 'J' || record[2] != RECORD_VERSION) {
+                continue;
+            }
+            if (_RecordMAC(_macKey, pd.activationId, body) != record.subRangeFrom(RECORD_BODY_SIZE)) {
+                CC7_LOG("CounterJournal %p: Record %zu has invalid MAC.", this, pos / RECORD_SIZE);
+                continue;
+            }
+            const cc7::byte flags = record[3];
+            if (((flags & FLAG_V3) != 0) != is_v3) {
+                continue;
+            }
+            // Move counter forward, if the record is ahead, within the look ahead window.
+            if (is_v3) {
+                const cc7::ByteRange record_ctr = record.subRange(16, RECORD_CTR_SIZE);
+                cc7::ByteArray ctr = pd.signatureCounterData;
+                for (size_t distance = 0; distance <= protocol::LOOK_AHEAD_MAX; distance++) {
+                    if (distance > 0) {
+                        ctr = protocol::CalculateNextCounterData(ctr);
+                    }
+                    if (ctr == record_ctr) {
+                        pd.signatureCounterData = ctr;
+                        if (flags & FLAG_CTR_BYTE) {
+                            pd.flags.hasSignatureCounterByte = 1;
+                            pd.signatureCounterByte = record[4];
+                        }
+                        applied++;
+                        break;
+                    }
+                }
+            } else {
+                cc7::U64 be_counter;
+                memcpy(&be_counter, record.data() + 8, sizeof(be_counter));
+                const cc7::U64 counter = cc7::FromBigEndian(be_counter);
+                if (counter > pd.signatureCounter && counter - pd.signatureCounter <= protocol::LOOK_AHEAD_MAX) {
+                    pd.signatureCounter = counter;
+                    applied++;
+                }
+            }
+        }
+        return applied;
+    }
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
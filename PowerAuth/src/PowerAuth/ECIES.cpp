@@ -18,6 +18,8 @@
 #include "crypto/CryptoUtils.h"
 #include "protocol/ProtocolUtils.h"
 #include "protocol/Constants.h"
+#include "utils/Metrics.h"
+#include "utils/Tracing.h"
 
 namespace com
 {
@@ -74,12 +76,19 @@ namespace powerAuth
     }
     
     ECIESEnvelopeKey ECIESEnvelopeKey::fromPublicKey(const cc7::ByteRange & public_key, const cc7::ByteRange & shared_info1, cc7::ByteArray & out_ephemeral_key)
+    {
+        return fromPublicKey(public_key, false, shared_info1, out_ephemeral_key);
+    }
+    
+    ECIESEnvelopeKey ECIESEnvelopeKey::fromPublicKey(const cc7::ByteRange & public_key, bool is_validated_point, const cc7::ByteRange & shared_info1, cc7::ByteArray & out_ephemeral_key)
     {
         crypto::BNContext ctx;
         EC_KEY *pubk = nullptr, *ephemeral = nullptr;
         ECIESEnvelopeKey ek;
         do {
-            pubk = crypto::ECC_ImportPublicKey(nullptr, public_key, ctx);
+            pubk = is_validated_point
+                    ? crypto::ECC_ImportValidatedPublicKey(nullptr, public_key, ctx)
+                    : crypto::ECC_ImportPublicKey(nullptr, public_key, ctx);
             if (!pubk) {
                 break;
             }
@@ -119,11 +128,11 @@ namespace powerAuth
         ECIESEnvelopeKey ek;
         
         do {
-            privk = crypto::ECC_ImportPrivateKey(nullptr, private_key);
+            privk = crypto::ECC_ImportPrivateKey(nullptr, private_key, ctx);
             if (!privk) {
                 break;
             }
-            ephemeral = crypto::ECC_ImportPublicKey(nullptr, ephemeral_key);
+            ephemeral = crypto::ECC_ImportPublicKey(nullptr, ephemeral_key, ctx);
             if (!ephemeral) {
                 break;
             }
@@ -154,6 +163,7 @@ namespace powerAuth
     
     static ErrorCode _Encrypt(const ECIESEnvelopeKey & ek, const cc7::ByteRange & info2, const cc7::ByteRange & data, const cc7::ByteRange & iv, ECIESCryptogram & out_cryptogram)
     {
+        PA_TRACE_SCOPE(TP_ECIESEncrypt, data.size());
         if (iv.size() != ECIESEnvelopeKey::IvSize) {
             return EC_Encryption;
         }
@@ -171,11 +181,13 @@ namespace powerAuth
         }
         // set encrypted data size back to original value
         out_cryptogram.body.resize(encryptedDataSize);
+        PA_METRICS_COUNT(MC_ECIES_EncryptedBytes, data.size());
         return EC_Ok;
     }
     
     static ErrorCode _Decrypt(const ECIESEnvelopeKey & ek, const cc7::ByteRange & info2, const ECIESCryptogram & cryptogram, const cc7::ByteRange & iv, cc7::ByteArray & out_data)
     {
+        PA_TRACE_SCOPE(TP_ECIESDecrypt, cryptogram.body.size());
         if (iv.size() != ECIESEnvelopeKey::IvSize) {
             return EC_Encryption;
         }
@@ -190,7 +202,11 @@ namespace powerAuth
         // Decrypt data
         bool error = true;
         out_data = crypto::AES_CBC_Decrypt_Padding(ek.encKey(), iv, cryptogram.body, &error);
-        return error ? EC_Encryption : EC_Ok;
+        if (error) {
+            return EC_Encryption;
+        }
+        PA_METRICS_COUNT(MC_ECIES_DecryptedBytes, out_data.size());
+        return EC_Ok;
     }
     
     // ----------------------------------------------------------------------------------------------
@@ -264,7 +280,11 @@ namespace powerAuth
     ErrorCode ECIESEncryptor::encryptRequest(const cc7::ByteRange & data, ECIESCryptogram & out_cryptogram)
     {
         if (canEncryptRequest()) {
-            _envelope_key = ECIESEnvelopeKey::fromPublicKey(_public_key, _shared_info1, out_cryptogram.key);
+            if (!_validated_public_key.empty()) {
+                _envelope_key = ECIESEnvelopeKey::fromPublicKey(_validated_public_key, true, _shared_info1, out_cryptogram.key);
+            } else {
+                _envelope_key = ECIESEnvelopeKey::fromPublicKey(_public_key, _shared_info1, out_cryptogram.key);
+            }
             if (_envelope_key.isValid()) {
                 out_cryptogram.nonce = crypto::GetRandomData(ECIESEnvelopeKey::NonceSize);
                 _iv_for_decryption = _envelope_key.deriveIvForNonce(out_cryptogram.nonce);
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PowerAuth/Executor.h>
+#include <algorithm>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    // MARK: - Executor -
+    
+    std::shared_ptr<Executor> Executor::defaultExecutor()
+    {
+        static std::shared_ptr<Executor> s_executor = std::make_shared<ThreadPoolExecutor>();
+        return s_executor;
+    }
+    
+    
+    // MARK: - ThreadPoolExecutor -
+    
+    ThreadPoolExecutor::ThreadPoolExecutor(size_t threads_count) :
+        _stopping(false)
+    {
+        if (threads_count == 0) {
+            threads_count = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        _threads.reserve(threads_count);
+        for (size_t i = 0; i < threads_count; i++) {
+            _threads.emplace_back(&ThreadPoolExecutor::workerLoop, this);
+        }
+    }
+    
+    ThreadPoolExecutor::~ThreadPoolExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _stopping = true;
+        }
+        _condition.notify_all();
+        for (auto & thread : _threads) {
+            thread.join();
+        }
+    }
+    
+    void ThreadPoolExecutor::execute(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _tasks.push_back(std::move(task));
+        }
+        _condition.notify_one();
+    }
+    
+    size_t ThreadPoolExecutor::threadsCount() const
+    {
+        return _threads.size();
+    }
+    
+    void ThreadPoolExecutor::workerLoop()
+    {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> guard(_lock);
+                _condition.wait(guard, [this] { return _stopping || !_tasks.empty(); });
+                if (_tasks.empty()) {
+                    // Stopping and there's nothing left to do.
+                    return;
+                }
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+            task();
+        }
+    }
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
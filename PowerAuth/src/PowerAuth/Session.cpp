@@ -17,14 +17,17 @@
 #include <PowerAuth/Session.h>
 #include <PowerAuth/ECIES.h>
 #include <PowerAuth/ActivationCode.h>
+#include <PowerAuth/CounterJournal.h>
 
-#include <cc7/Base64.h>
 #include "protocol/ProtocolUtils.h"
 #include "protocol/Constants.h"
 #include "crypto/CryptoUtils.h"
 #include "utils/URLEncoding.h"
+#include "utils/Base64.h"
 #include "utils/DataReader.h"
 #include "utils/DataWriter.h"
+#include "utils/Statistics.h"
+#include "utils/Tracing.h"
 #include <algorithm>
 
 using namespace cc7;
@@ -36,23 +39,213 @@ namespace wultra
 namespace powerAuth
 {
     
-#define LOCK_GUARD() std::lock_guard<std::recursive_mutex> _lock_guard(_lock)
+#if defined(PA_SESSION_SINGLE_THREADED)
+#define LOCK_GUARD()
+#else
+#define LOCK_GUARD() _LockGuard _lock_guard(_lock)
+    
+    /**
+     The _LockGuard class holds the session's lock for its lifetime. If the lock is already
+     acquired by other thread, then the time spent waiting is added to the session's statistics.
+     */
+    class _LockGuard
+    {
+    public:
+        _LockGuard(std::recursive_mutex & lock) : _lock(lock)
+        {
+            if (!_lock.try_lock()) {
+                utils::ScopedStatisticsTimer timer(utils::ST_LockWait);
+                _lock.lock();
+            }
+        }
+        ~_LockGuard()
+        {
+            _lock.unlock();
+        }
+    private:
+        std::recursive_mutex & _lock;
+    };
+#endif
+    
+    /**
+     Traces the public operation |op| and measures it in the session's statistics, if the
+     collection is enabled. Nested operations of the same session are neither traced nor
+     measured. The macro must be used before the lock is acquired, so the time spent waiting
+     for the lock is included.
+     */
+#define SESSION_OPERATION(op) \
+    PA_TRACE_OPERATION(this, TP_SessionOperation, SessionStatistics::op); \
+    utils::ScopedStatisticsOperation _statistics_operation(_statistics.load(std::memory_order_acquire), SessionStatistics::op)
+    
+    /**
+     The StateSnapshot structure contains precalculated results of the state probing
+     methods. The snapshot is never modified after it's published, so it can be
+     safely read without acquiring the session's lock.
+     */
+    struct Session::StateSnapshot
+    {
+        bool hasValidSetup                  = false;
+        bool canStartActivation             = false;
+        bool hasPendingActivation           = false;
+        bool hasValidActivation             = false;
+        bool hasProtocolUpgradeAvailable    = false;
+        bool hasPendingProtocolUpgrade      = false;
+        bool hasBiometryFactor              = false;
+        bool hasExternalEncryptionKey       = false;
+        bool hasActivationRecoveryData      = false;
+        Version protocolVersion             = Version_Latest;
+        Version pendingUpgradeVersion       = Version_NA;
+        std::string activationId;
+    };
+    
+    /**
+     The KeysSnapshot structure contains a copy of protected signature keys, taken with
+     the lock acquired. The keys can be then unlocked without holding the lock.
+     */
+    struct Session::KeysSnapshot
+    {
+        protocol::SignatureKeys sk;
+        cc7::ByteArray passwordSalt;
+        cc7::U32 passwordIterations         = 0;
+        cc7::ByteArray externalEncryptionKey;
+        bool hasExternalEncryptionKey       = false;
+        cc7::U32 stateVersion               = 0;
+        
+        /**
+         Returns non-null pointer to EEK if session works with EEK.
+         */
+        const cc7::ByteArray * eek() const
+        {
+            return hasExternalEncryptionKey ? &externalEncryptionKey : nullptr;
+        }
+        
+        /**
+         Unlocks keys for |factor| into |plain| structure, with using provided unlock |keys|.
+         */
+        bool unlock(protocol::SignatureKeys & plain, SignatureFactor factor, const SignatureUnlockKeys & keys) const
+        {
+            protocol::SignatureUnlockKeysReq unlock_request(factor, &keys, eek(), &passwordSalt, passwordIterations);
+            return protocol::UnlockSignatureKeys(plain, sk, unlock_request);
+        }
+    };
+    
+    /**
+     The LazyState structure contains views into the serialized state, provided
+     to `loadSessionStateLazily()`.
+     */
+    struct Session::LazyState
+    {
+        protocol::PersistentDataView view;
+        cc7::ByteRange serializedState;
+    };
+    
+    /**
+     The DerivedConstants structure contains values derived from the session's setup and
+     from the transport key. All secret values are wiped from the memory when the structure
+     is destroyed or when the values are invalidated.
+     */
+    struct Session::DerivedConstants
+    {
+        /**
+         Values derived from the transport key.
+         */
+        struct Activation
+        {
+            /**
+             Transport key and keys derived from it. Empty if values are not calculated yet.
+             */
+            protocol::TransportKeys transportKeys;
+            /**
+             HMAC_SHA256(key: KEY_TRANSPORT, data: APP_SECRET), sharedInfo2 for the activation scoped ECIES.
+             */
+            cc7::ByteArray eciesSharedInfo2;
+            
+            ~Activation()
+            {
+                eciesSharedInfo2.secureClear();
+            }
+            
+            /**
+             Returns true if values were derived from |transport_key|.
+             */
+            bool isDerivedFrom(const cc7::ByteRange & transport_key) const
+            {
+                return !transportKeys.empty() && transportKeys.transportKey == transport_key;
+            }
+            
+            /**
+             Derives all values from |transport_key| and |app_secret|. Returns false if derivation failed.
+             */
+            bool derive(const cc7::ByteRange & transport_key, const std::string & app_secret)
+            {
+                if (!protocol::DeriveTransportKeys(transport_key, transportKeys)) {
+                    return false;
+                }
+                eciesSharedInfo2 = crypto::HMAC_SHA256(cc7::MakeRange(app_secret), transport_key);
+                return true;
+            }
+            
+            /**
+             Wipes all values from the memory.
+             */
+            void clear()
+            {
+                transportKeys.clear();
+                eciesSharedInfo2.secureClear();
+            }
+        };
+        
+        /**
+         SHA256(APP_SECRET), sharedInfo2 for the application scoped ECIES.
+         */
+        cc7::ByteArray eciesSharedInfo2;
+        /**
+         Master server public key, decoded from Base64.
+         */
+        cc7::ByteArray masterServerPublicKey;
+        /**
+         Values derived from the transport key.
+         */
+        Activation activation;
+        
+        ~DerivedConstants()
+        {
+            eciesSharedInfo2.secureClear();
+        }
+    };
+    
+    /**
+     Maximum number of attempts to commit the result of operation calculated out of the lock.
+     The operation is repeated only if the session's state is changed during the calculation.
+     */
+    static const int MAX_COMMIT_ATTEMPTS = 3;
     
     // MARK: Construction / Destruction -
     
     Session::Session() :
+        _stateVersion(0),
         _state(SS_Invalid),
         _pd(nullptr),
-        _ad(nullptr)
+        _ad(nullptr),
+        _uk(nullptr),
+        _lazy(nullptr),
+        _derived(nullptr),
+        _statistics(nullptr)
     {
+        publishStateSnapshot();
         CC7_LOG("Session %:: Object created with no SessionSetup", this);
     }
 
     Session::Session(const SessionSetup & setup) :
+        _stateVersion(0),
         _state(SS_Empty),
         _setup(setup),
         _pd(nullptr),
-        _ad(nullptr)
+        _ad(nullptr),
+        _uk(nullptr),
+        _lazy(nullptr),
+        _derived(nullptr),
+        _statistics(nullptr)
     {
         if (protocol::ValidateSessionSetup(_setup, false)) {
             CC7_LOG("Session %p: Object created.", this);
@@ -60,27 +253,36 @@ namespace powerAuth
             _state = SS_Invalid;
             CC7_LOG("Session %p: Object created, but SessionSetup is invalid!", this);
         }
+        publishStateSnapshot();
     }
     
     Session::~Session()
     {
         delete _pd;
         delete _ad;
+        delete _uk;
+        delete _lazy;
+        delete _derived;
+        delete _statistics.load();
         
         CC7_LOG("Session %p: Object destroyed.", this);
     }
 
     bool Session::setSessionSetup(const SessionSetup & setup)
     {
+        SESSION_OPERATION(SO_SetSessionSetup);
         LOCK_GUARD();
         resetSession();
+        invalidateDerivedConstants(true);
         _setup = setup;
         if (protocol::ValidateSessionSetup(_setup, false)) {
             _state = SS_Empty;
+            publishStateSnapshot();
             CC7_LOG("Session %p: Assigned new SessionSetup.", this);
             return true;
         } else {
             _state = SS_Invalid;
+            publishStateSnapshot();
             CC7_LOG("Session %: Invalid SessionSetup provided!", this);
             return false;
         }
@@ -88,6 +290,7 @@ namespace powerAuth
     
     void Session::resetSession()
     {
+        SESSION_OPERATION(SO_ResetSession);
         LOCK_GUARD();
         if (_state >= SS_Empty) {
             commitNewPersistentState(nullptr, SS_Empty);
@@ -96,7 +299,6 @@ namespace powerAuth
     
     const SessionSetup * Session::sessionSetup() const
     {
-        LOCK_GUARD();
         return hasValidSetup() ? &_setup : nullptr;
     }
     
@@ -105,69 +307,37 @@ namespace powerAuth
     
     bool Session::hasValidSetup() const
     {
-        LOCK_GUARD();
-        return _state >= SS_Empty;
+        return stateSnapshot()->hasValidSetup;
     }
     
     bool Session::canStartActivation() const
     {
-        LOCK_GUARD();
-        if (_state == SS_Empty) {
-            if (CC7_CHECK(_pd == nullptr && _ad == nullptr, "Internal error. PD should be null when state is SS_Empty")) {
-                return true;
-            }
-        }
-        return false;
+        return stateSnapshot()->canStartActivation;
     }
     
     bool Session::hasPendingActivation() const
     {
-        LOCK_GUARD();
-        if (_state == SS_Activation1 || _state == SS_Activation2) {
-            if (CC7_CHECK(_pd == nullptr && _ad != nullptr, "Internal error. Only AD should be valid during the pending activation.")) {
-                return true;
-            }
-        }
-        return false;
+        return stateSnapshot()->hasPendingActivation;
     }
     
     bool Session::hasValidActivation() const
     {
-        LOCK_GUARD();
-        if (_state == SS_Activated) {
-            if (CC7_CHECK(_pd != nullptr && _ad == nullptr, "Internal error. Only PD & setup should be valid when activated.")) {
-                return true;
-            }
-        }
-        return false;
+        return stateSnapshot()->hasValidActivation;
     }
     
     bool Session::hasProtocolUpgradeAvailable() const
     {
-        LOCK_GUARD();
-        if (hasValidActivation()) {
-            return _pd->protocolVersion() != Version_Latest &&
-                    _pd->flags.pendingUpgradeVersion == Version_NA;
-        }
-        return false;
+        return stateSnapshot()->hasProtocolUpgradeAvailable;
     }
 
     bool Session::hasPendingProtocolUpgrade() const
     {
-        LOCK_GUARD();
-        if (hasValidActivation()) {
-            return _pd->flags.pendingUpgradeVersion != Version_NA;
-        }
-        return false;
+        return stateSnapshot()->hasPendingProtocolUpgrade;
     }
     
     Version Session::protocolVersion() const
     {
-        LOCK_GUARD();
-        if (hasValidActivation()) {
-            return _pd->protocolVersion();
-        }
-        return Version_Latest;
+        return stateSnapshot()->protocolVersion;
     }
     
     // MARK: - Serialization -
@@ -179,7 +349,12 @@ namespace powerAuth
     
     cc7::ByteArray Session::saveSessionState() const
     {
+        SESSION_OPERATION(SO_SaveSessionState);
         LOCK_GUARD();
+        if (_lazy) {
+            // The state is not materialized yet, so it's still the same as the loaded one.
+            return cc7::ByteArray(_lazy->serializedState.begin(), _lazy->serializedState.end());
+        }
         cc7:byte flags = 0;
         if (hasValidActivation()) {
             flags |= HAS_PERSISTENT_DATA;
@@ -199,6 +374,7 @@ namespace powerAuth
     
     ErrorCode Session::loadSessionState(const cc7::ByteRange & serialized_state)
     {
+        SESSION_OPERATION(SO_LoadSessionState);
         LOCK_GUARD();
         utils::DataReader reader(serialized_state);
         cc7::byte flags = 0;
@@ -217,38 +393,103 @@ namespace powerAuth
         } else {
             result = false;
         }
+        if (has_data && _journal) {
+            // Move the counter forward to the last value stored in the journal.
+            _journal->replay(*new_data);
+        }
         
         State new_state = has_data ? SS_Activated : SS_Empty;
         commitNewPersistentState(new_data, new_state);
         return result ? EC_Ok : EC_WrongParam;
     }
     
+    ErrorCode Session::loadSessionStateLazily(const cc7::ByteRange & serialized_state)
+    {
+        SESSION_OPERATION(SO_LoadSessionStateLazily);
+        LOCK_GUARD();
+        if (_journal) {
+            // The journal's replay requires the materialized data.
+            return loadSessionState(serialized_state);
+        }
+        utils::DataReader reader(serialized_state);
+        cc7::byte flags = 0;
+        
+        bool has_data = false;
+        auto new_lazy = new LazyState();
+        
+        bool result = reader.openVersion(DATA_TAG, DATA_VER) &&
+                      reader.readByte(flags);
+        
+        if (result && (flags != 'M')) {
+            if (flags & HAS_PERSISTENT_DATA) {
+                result = protocol::DeserializePersistentDataView(new_lazy->view, reader) &&
+                         !new_lazy->view.activationId.empty();
+                has_data = result;
+            }
+        } else {
+            result = false;
+        }
+        new_lazy->serializedState = serialized_state;
+        
+        State new_state = has_data ? SS_Activated : SS_Empty;
+        commitNewPersistentState(nullptr, new_state, new_lazy);
+        return result ? EC_Ok : EC_WrongParam;
+    }
+    
+    bool Session::hasLazySessionState() const
+    {
+        LOCK_GUARD();
+        return _lazy != nullptr;
+    }
+    
+    ErrorCode Session::materializeSessionState()
+    {
+        SESSION_OPERATION(SO_MaterializeSessionState);
+        LOCK_GUARD();
+        if (!hasValidActivation()) {
+            CC7_LOG("Session %p: Materialize: There's no valid activation.", this);
+            return EC_WrongState;
+        }
+        return hasPersistentData() ? EC_Ok : EC_WrongParam;
+    }
+    
+    void Session::setCounterJournal(std::shared_ptr<CounterJournal> journal)
+    {
+        LOCK_GUARD();
+        _journal = journal;
+    }
+    
+    std::shared_ptr<CounterJournal> Session::counterJournal() const
+    {
+        LOCK_GUARD();
+        return _journal;
+    }
+    
     
     
     // MARK: - Activation -
     
     std::string Session::activationIdentifier() const
     {
-        LOCK_GUARD();
-        if (hasValidActivation()) {
-            return _pd->activationId;
-        } else if (hasPendingActivation()) {
-            return _ad->activationId;
-        }
-        return std::string();
+        return stateSnapshot()->activationId;
     }
     
     std::string Session::activationFingerprint() const
     {
+        SESSION_OPERATION(SO_ActivationFingerprint);
         LOCK_GUARD();
         std::string result;
-        if (hasValidActivation() || (hasPendingActivation() && _state == SS_Activation2)) {
+        if (hasPersistentData() || (hasPendingActivation() && _state == SS_Activation2)) {
             if (_state == SS_Activation2) {
-                // Still pending activation
-                result = protocol::CalculateActivationFingerprint(_ad->devicePublicKeyData, _ad->serverPublicKeyData, _ad->activationId, Version_Latest);
+                // Still pending activation, the fingerprint was calculated in step 2.
+                result = _ad->activationFingerprint;
+            } else if (!_pd->activationFingerprint.empty()) {
+                // Has valid activation, with the cached fingerprint.
+                result = _pd->activationFingerprint;
             } else {
-                // Has valid activation
+                // Has valid activation, so calculate the fingerprint and keep it in PD.
                 result = protocol::CalculateActivationFingerprint(_pd->devicePublicKey, _pd->serverPublicKey, _pd->activationId, _pd->protocolVersion());
+                _pd->activationFingerprint = result;
             }
             if (result.empty()) {
                 CC7_LOG("Session %p: ActivationFingerprint: Unable to calculate activation fingerprint.", this);
@@ -259,6 +500,7 @@ namespace powerAuth
     
     ErrorCode Session::startActivation(const ActivationStep1Param & param, ActivationStep1Result & result)
     {
+        SESSION_OPERATION(SO_StartActivation);
         LOCK_GUARD();
         // Validate state & parameters
         if (!hasValidSetup()) {
@@ -311,7 +553,7 @@ namespace powerAuth
             
             // V3 activation is much simpler than V2. We need to just store device's public key
             // in Base64 format. The data encryption & protection is achieved by the ECIES.
-            result.devicePublicKey = ad->devicePublicKeyData.base64String();
+            result.devicePublicKey = utils::ToBase64String(ad->devicePublicKeyData);
             
             // Finally, everything is OK
             error_code = EC_Ok;
@@ -331,6 +573,7 @@ namespace powerAuth
     
     ErrorCode Session::validateActivationResponse(const ActivationStep2Param & param, ActivationStep2Result & result)
     {
+        SESSION_OPERATION(SO_ValidateActivationResponse);
         LOCK_GUARD();
         // Validate state & parameters
         if (!hasPendingActivation() || _state != SS_Activation1) {
@@ -345,6 +588,7 @@ namespace powerAuth
         }
         
         auto error_code = EC_Encryption;
+        crypto::BNContext ctx;
         do {
             // Validate (optional) recovery data
             if (!protocol::ValidateRecoveryData(param.activationRecovery)) {
@@ -352,14 +596,14 @@ namespace powerAuth
                 return EC_WrongParam;
             }
             // Validate CTR_DATA
-            if (!_ad->ctrData.readFromBase64String(param.ctrData) || _ad->ctrData.size() != protocol::SIGNATURE_KEY_SIZE) {
+            if (!utils::Base64_Decode(param.ctrData, _ad->ctrData) || _ad->ctrData.size() != protocol::SIGNATURE_KEY_SIZE) {
                 // Note that we treat all B64 decode failures as an encryption error.
                 CC7_LOG("Session %p: Step 2: CTR_DATA is invalid.", this);
                 break;
             }
             // Now try to import server's public key
-            _ad->serverPublicKeyData.readFromBase64String(param.serverPublicKey);
-            _ad->serverPublicKey = crypto::ECC_ImportPublicKey(nullptr, _ad->serverPublicKeyData);
+            utils::Base64_Decode(param.serverPublicKey, _ad->serverPublicKeyData);
+            _ad->serverPublicKey = crypto::ECC_ImportPublicKey(nullptr, _ad->serverPublicKeyData, ctx);
             if (!_ad->serverPublicKey) {
                 CC7_LOG("Session %p: Step 2: Server's public key is not valid.", this);
                 break;
@@ -378,6 +622,7 @@ namespace powerAuth
                 CC7_LOG("Session %p: Step 2: Unable to calculate activation fingerprint.", this);
                 break;
             }
+            _ad->activationFingerprint = result.activationFingerprint;
             
             // Everything is OK, keep other data for later
             _ad->activationId = param.activationId;
@@ -399,6 +644,7 @@ namespace powerAuth
     
     ErrorCode Session::completeActivation(const SignatureUnlockKeys & keys)
     {
+        SESSION_OPERATION(SO_CompleteActivation);
         LOCK_GUARD();
         // Validate state & parameters
         if (!hasPendingActivation() || _state != SS_Activation2) {
@@ -411,6 +657,7 @@ namespace powerAuth
         }
         auto error_code = EC_Encryption;
         auto pd = new protocol::PersistentData();
+        crypto::BNContext ctx;
         do {
             // Keep all required information in the PD
             pd->signatureCounter        = 0;
@@ -420,7 +667,11 @@ namespace powerAuth
             pd->passwordSalt            = crypto::GetRandomData(protocol::PBKDF2_SALT_SIZE, true);
             pd->devicePublicKey         = _ad->devicePublicKeyData;
             pd->serverPublicKey         = _ad->serverPublicKeyData;
+            pd->activationFingerprint   = _ad->activationFingerprint;
             pd->flagsU32                = 0;
+            // Server's public key has been validated in step 2, so keep its uncompressed form.
+            pd->serverPublicKeyPoint    = crypto::ECC_ExportPublicKeyUncompressed(_ad->serverPublicKey, ctx);
+            pd->flags.hasValidatedServerPublicKey = !pd->serverPublicKeyPoint.empty();
             // Keep information about external key usage in the flags
             pd->flags.usesExternalKey = eek() ? 1 : 0;
             // V3.1 activation, set counter byte to 0.
@@ -440,7 +691,7 @@ namespace powerAuth
                 break;
             }
             
-            cc7::ByteArray device_private_key_data = crypto::ECC_ExportPrivateKey(_ad->devicePrivateKey);
+            cc7::ByteArray device_private_key_data = crypto::ECC_ExportPrivateKey(_ad->devicePrivateKey, ctx);
             if (device_private_key_data.empty()) {
                 CC7_LOG("Session %p: Step 3: Device private key export failed.", this);
                 break;
@@ -478,48 +729,126 @@ namespace powerAuth
     
     
     
-    // MARK: - Status -
+    // MARK: - Server public key -
     
-    ErrorCode Session::decodeActivationStatus(const EncryptedActivationStatus & enc_status, const SignatureUnlockKeys & keys, ActivationStatus & status) const
+    /**
+     Imports server's public key from |pd|. If PD contains already validated uncompressed key,
+     then the cheap import is used. Otherwise, the compressed key is imported and validated, and
+     its uncompressed form is stored back to PD, so the next import will be fast. The function
+     must be called with the lock acquired.
+     */
+    static EC_KEY * _ImportServerPublicKey(protocol::PersistentData & pd, BN_CTX * ctx)
     {
-        LOCK_GUARD();
-        if (!hasValidActivation()) {
-            CC7_LOG("Session %p: Status: Called in wrong state.", this);
-            return EC_WrongState;
-        }
-        if (enc_status.challenge.empty() || enc_status.encryptedStatusBlob.empty() || enc_status.nonce.empty()) {
-            CC7_LOG("Session %p: Status: All parameters are required in EncryptedActivationStatus.", this);
-            return EC_WrongParam;
+        if (pd.flags.hasValidatedServerPublicKey) {
+            EC_KEY * key = crypto::ECC_ImportValidatedPublicKey(nullptr, pd.serverPublicKeyPoint, ctx);
+            if (key) {
+                return key;
+            }
+            pd.flags.hasValidatedServerPublicKey = 0;
+            pd.serverPublicKeyPoint.clear();
         }
-        protocol::SignatureKeys signature_keys;
-        protocol::SignatureUnlockKeysReq unlock_request(protocol::SF_Transport, &keys, eek(), nullptr, 0);
-        if (!protocol::UnlockSignatureKeys(signature_keys, _pd->sk, unlock_request)) {
-            CC7_LOG("Session %p: Status: You have to provide valid possession key.", this);
-            return EC_WrongParam;
+        EC_KEY * key = crypto::ECC_ImportPublicKey(nullptr, pd.serverPublicKey, ctx);
+        if (key) {
+            pd.serverPublicKeyPoint = crypto::ECC_ExportPublicKeyUncompressed(key, ctx);
+            pd.flags.hasValidatedServerPublicKey = !pd.serverPublicKeyPoint.empty();
         }
+        return key;
+    }
+    
+    
+    // MARK: - Status -
+    
+    /**
+     Decrypts |enc_status| into |status| with using unlocked |transport_keys|. The function
+     doesn't access the session's state, so it can be called without holding the lock.
+     */
+    static ErrorCode _DecryptActivationStatus(const EncryptedActivationStatus & enc_status, const protocol::TransportKeys & transport_keys, ActivationStatus & status)
+    {
         // Decode blob from B64 string
         cc7::ByteArray encrypted_status_blob;
         cc7::ByteArray status_nonce;
         cc7::ByteArray status_challenge;
-        bool result = encrypted_status_blob.readFromBase64String(enc_status.encryptedStatusBlob);
-        result = result && status_challenge.readFromBase64String(enc_status.challenge);
-        result = result && status_nonce.readFromBase64String(enc_status.nonce);
+        bool result = utils::Base64_Decode(enc_status.encryptedStatusBlob, encrypted_status_blob);
+        result = result && utils::Base64_Decode(enc_status.challenge, status_challenge);
+        result = result && utils::Base64_Decode(enc_status.nonce, status_nonce);
         if (!result) {
             return EC_Encryption;
         }
-        if (EC_Ok != protocol::DecryptEncryptedStatusBlob(encrypted_status_blob, status_challenge, status_nonce, signature_keys.transportKey, status)) {
+        if (EC_Ok != protocol::DecryptEncryptedStatusBlob(encrypted_status_blob, status_challenge, status_nonce, transport_keys, status)) {
             return EC_Encryption;
         }
+        return EC_Ok;
+    }
+    
+    ErrorCode Session::decodeActivationStatus(const EncryptedActivationStatus & enc_status, const SignatureUnlockKeys & keys, ActivationStatus & status) const
+    {
+        SESSION_OPERATION(SO_DecodeActivationStatus);
+        for (int attempt = 0; attempt < MAX_COMMIT_ATTEMPTS; attempt++) {
+            // Validate session's state and take a snapshot of protected keys and cached constants.
+            KeysSnapshot snapshot;
+            DerivedConstants::Activation constants;
+            std::string app_secret;
+            {
+                LOCK_GUARD();
+                if (!hasPersistentData()) {
+                    CC7_LOG("Session %p: Status: Called in wrong state.", this);
+                    return EC_WrongState;
+                }
+                if (enc_status.challenge.empty() || enc_status.encryptedStatusBlob.empty() || enc_status.nonce.empty()) {
+                    CC7_LOG("Session %p: Status: All parameters are required in EncryptedActivationStatus.", this);
+                    return EC_WrongParam;
+                }
+                makeKeysSnapshot(snapshot);
+                constants = derivedConstants().activation;
+                app_secret = _setup.applicationSecret;
+            }
+            // Unlock the transport key and decrypt the status without holding the lock.
+            protocol::SignatureKeys signature_keys;
+            if (!snapshot.unlock(signature_keys, protocol::SF_Transport, keys)) {
+                CC7_LOG("Session %p: Status: You have to provide valid possession key.", this);
+                return EC_WrongParam;
+            }
+            bool constants_derived = false;
+            if (!constants.isDerivedFrom(signature_keys.transportKey)) {
+                if (!constants.derive(signature_keys.transportKey, app_secret)) {
+                    return EC_Encryption;
+                }
+                constants_derived = true;
+            }
+            signature_keys.transportKey.secureClear();
+            ErrorCode code = _DecryptActivationStatus(enc_status, constants.transportKeys, status);
+            if (code != EC_Ok) {
+                return code;
+            }
+            // Synchronize the counter, if the state is still the same.
+            {
+                LOCK_GUARD();
+                if (snapshot.stateVersion == _stateVersion) {
+                    if (constants_derived) {
+                        derivedConstants().activation = constants;
+                    }
+                    applyCounterState(status, constants.transportKeys);
+                    return EC_Ok;
+                }
+                CC7_LOG("Session %p: Status: State has been changed during the status decode, retrying.", this);
+            }
+        }
+        return EC_WrongState;
+    }
+    
+    void Session::applyCounterState(ActivationStatus & status, const protocol::TransportKeys & transport_keys) const
+    {
         // Try to synchronize local counter
-        status.counterState     = trySynchronizeCounter(status, signature_keys.transportKey);
+        status.counterState     = trySynchronizeCounter(status, transport_keys);
         // If counter's state is invalid, then set state to "deadlock".
         if (status.counterState == ActivationStatus::Counter_Invalid) {
             status.state = ActivationStatus::Deadlock;
+        } else if (status.counterState == ActivationStatus::Counter_Updated) {
+            journalCounter();
         }
-        return EC_Ok;
     }
     
-    ActivationStatus::CounterState Session::trySynchronizeCounter(const ActivationStatus & status, const cc7::ByteRange & transport_key) const
+    ActivationStatus::CounterState Session::trySynchronizeCounter(const ActivationStatus & status, const protocol::TransportKeys & transport_keys) const
     {
         // If activation is still in V2 version, then we cannot determine counter's status.
         // In this case, it's OK to set Counter_OK.
@@ -532,7 +861,7 @@ namespace powerAuth
         
         // At first, try to check whether the counter hash is OK
         auto local_ctr_data = _pd->signatureCounterData;
-        auto hash_distance = protocol::CalculateHashCounterDistance(local_ctr_data, status.ctrDataHash, transport_key, look_ahead_window);
+        auto hash_distance = protocol::CalculateHashCounterDistance(local_ctr_data, status.ctrDataHash, transport_keys, look_ahead_window);
         if (!has_ctr_byte) {
             // We don't have captured counter byte yet, so test whether the hash is OK and if yes, then keep the received byte.
             if (hash_distance == 0) {
@@ -583,43 +912,234 @@ namespace powerAuth
     
     // MARK: - Data signing -
     
+    /**
+     Appends URL encoded |key| and |value| into |out| buffer, in 'key=value' format. If |out| is not
+     at the beginning of the buffer, then '&' is appended before the pair.
+     */
+    static inline cc7::byte * _AppendKeyValuePair(cc7::byte * out, const cc7::byte * begin, const std::string & key, const std::string & value)
+    {
+        if (out != begin) {
+            *out++ = '&';
+        }
+        out += utils::ConvertStringToUrlEncodedBuffer(cc7::MakeRange(key), out);
+        *out++ = '=';
+        out += utils::ConvertStringToUrlEncodedBuffer(cc7::MakeRange(value), out);
+        return out;
+    }
+    
     cc7::ByteArray Session::prepareKeyValueMapForDataSigning(const std::map<std::string, std::string> & map)
     {
-        // Create a vector of keys
-        std::vector<const std::string *> keys;
-        keys.reserve(map.size());
+        // The map is already sorted by keys, so we can produce the output directly.
         size_t expected_result_size = 0;
         for (auto && kvpair : map) {
             expected_result_size += 2 + kvpair.first.length() + kvpair.second.length();
-            keys.push_back(&kvpair.first);
         }
-        // Sort that keys
-        std::sort(keys.begin(), keys.end(), [](const std::string * a, const std::string * b) {
-            return a->compare(*b) < 0;
+        // Concat sorted keys & values into: 'key1=value1&keyN=valueN' byte blob.
+        // The buffer is allocated for the worst case, where all characters are escaped,
+        // so all keys and values are encoded directly into the buffer.
+        cc7::ByteArray result(utils::URLEncodingMaxLength(expected_result_size), 0);
+        cc7::byte * out = result.data();
+        for (auto && kvpair : map) {
+            out = _AppendKeyValuePair(out, result.data(), kvpair.first, kvpair.second);
+        }
+        result.resize(out - result.data());
+        return result;
+    }
+    
+    cc7::ByteArray Session::prepareKeyValuePairsForDataSigning(const std::pair<std::string, std::string> * pairs, size_t count)
+    {
+        typedef std::pair<std::string, std::string> KeyValuePair;
+        // Create a vector of pointers to pairs
+        std::vector<const KeyValuePair *> sorted;
+        sorted.reserve(count);
+        size_t expected_result_size = 0;
+        for (size_t i = 0; i < count; i++) {
+            expected_result_size += 2 + pairs[i].first.length() + pairs[i].second.length();
+            sorted.push_back(&pairs[i]);
+        }
+        // Sort pairs by keys and then by values
+        std::stable_sort(sorted.begin(), sorted.end(), [](const KeyValuePair * a, const KeyValuePair * b) {
+            int cmp = a->first.compare(b->first);
+            return cmp != 0 ? cmp < 0 : a->second.compare(b->second) < 0;
         });
-        // Concat sorted keys & values into: 'key1=value1&keyN=valueN' byte blob
-        cc7::ByteArray result;
-        result.reserve(expected_result_size);
-        for (auto && key_ptr : keys) {
-            const std::string & key   = *key_ptr;
-            const std::string & value = map.find(key)->second;
-            if (!result.empty()) {
-                result.append('&');
-            }
-            result.append(utils::ConvertStringToUrlEncodedData(key));
-            result.append('=');
-            result.append(utils::ConvertStringToUrlEncodedData(value));
+        // Concat sorted keys & values into: 'key1=value1&keyN=valueN' byte blob.
+        cc7::ByteArray result(utils::URLEncodingMaxLength(expected_result_size), 0);
+        cc7::byte * out = result.data();
+        for (auto && pair_ptr : sorted) {
+            out = _AppendKeyValuePair(out, result.data(), pair_ptr->first, pair_ptr->second);
         }
+        result.resize(out - result.data());
         return result;
     }
-        
+    
+    /**
+     Prepares |out_nonce| and |out_data| for signing |request|. The function doesn't access
+     the session's state, so it can be called without holding the lock.
+     */
+    static bool _PrepareDataForSigning(const HTTPRequestData & request, const std::string & app_secret, std::string & out_nonce, cc7::ByteArray & out_data)
+    {
+        // Get NONCE from request structure, or generate a new one.
+        if (!request.isOfflineRequest()) {
+            out_nonce = utils::ToBase64String(crypto::GetRandomData(protocol::SIGNATURE_KEY_SIZE, true));
+        } else {
+            cc7::ByteArray nonce;
+            if (!utils::Base64_Decode(request.offlineNonce, nonce)) {
+                CC7_LOG("Sign: request.offlineNonce is invalid.");
+                return false;
+            }
+            out_nonce = request.offlineNonce;   // already in valid Base64 format
+        }
+        // Normalize data
+        out_data = protocol::NormalizeDataForSignature(request.method, request.uri, out_nonce, request.body, app_secret);
+        return true;
+    }
+    
     ErrorCode Session::signHTTPRequestData(const HTTPRequestData & request,
                                            const SignatureUnlockKeys & keys, SignatureFactor signature_factor,
                                            HTTPRequestDataSignature & out)
     {
-        LOCK_GUARD();
-        // Validate session's state & parameters
-        if (!hasValidActivation()) {
+        SESSION_OPERATION(SO_SignHTTPRequestData);
+        std::string factor_string = protocol::ConvertSignatureFactorToString(signature_factor);
+        for (int attempt = 0; attempt < MAX_COMMIT_ATTEMPTS; attempt++) {
+            // Validate session's state & parameters and take a snapshot of protected keys.
+            KeysSnapshot snapshot;
+            std::string app_secret;
+            {
+                LOCK_GUARD();
+                ErrorCode code = validateRequestForSigning(request);
+                if (code != EC_Ok) {
+                    return code;
+                }
+                if (factor_string.empty()) {
+                    CC7_LOG("Session %p: Sign: Wrong signature factor 0x%04x.", this, signature_factor);
+                    return EC_WrongParam;
+                }
+                makeKeysSnapshot(snapshot);
+                app_secret = request.isOfflineRequest() ? protocol::PA_OFFLINE_APP_SECRET : _setup.applicationSecret;
+            }
+            
+            // Re-seed OpenSSL's PRNG.
+            crypto::ReseedPRNG();
+            
+            // Unlock keys and prepare data without holding the lock. The keys unlock also validates
+            // whether the provided unlock keys are present or not.
+            protocol::SignatureKeys plain_keys;
+            if (!snapshot.unlock(plain_keys, signature_factor, keys)) {
+                CC7_LOG("Session %p: Sign: Unable to unlock signature keys.", this);
+                return EC_Encryption;
+            }
+            std::string nonce;
+            cc7::ByteArray data;
+            if (!_PrepareDataForSigning(request, app_secret, nonce, data)) {
+                return EC_Encryption;
+            }
+            
+            // Calculate signature and move counter forward, if the state is still the same.
+            {
+                LOCK_GUARD();
+                if (snapshot.stateVersion == _stateVersion) {
+                    ErrorCode code = calculateRequestSignature(request, data, nonce, plain_keys, signature_factor, factor_string, out);
+                    if (code == EC_Ok) {
+                        journalCounter();
+                    }
+                    return code;
+                }
+                CC7_LOG("Session %p: Sign: State has been changed during the signature calculation, retrying.", this);
+            }
+        }
+        return EC_WrongState;
+    }
+    
+    ErrorCode Session::signHTTPRequestDataBatch(const HTTPRequestData * requests, size_t count,
+                                                const SignatureUnlockKeys & keys, SignatureFactor signature_factor,
+                                                std::vector<HTTPRequestDataSignature> & out_signatures)
+    {
+        SESSION_OPERATION(SO_SignHTTPRequestDataBatch);
+        if (!requests || count == 0) {
+            CC7_LOG("Session %p: SignBatch: Empty batch.", this);
+            return EC_WrongParam;
+        }
+        std::string factor_string = protocol::ConvertSignatureFactorToString(signature_factor);
+        for (int attempt = 0; attempt < MAX_COMMIT_ATTEMPTS; attempt++) {
+            // Validate session's state & parameters and take a snapshot of protected keys.
+            KeysSnapshot snapshot;
+            std::string app_secret;
+            {
+                LOCK_GUARD();
+                for (size_t i = 0; i < count; i++) {
+                    ErrorCode code = validateRequestForSigning(requests[i]);
+                    if (code != EC_Ok) {
+                        return code;
+                    }
+                }
+                if (factor_string.empty()) {
+                    CC7_LOG("Session %p: SignBatch: Wrong signature factor 0x%04x.", this, signature_factor);
+                    return EC_WrongParam;
+                }
+                makeKeysSnapshot(snapshot);
+                app_secret = _setup.applicationSecret;
+            }
+            
+            // Re-seed OpenSSL's PRNG.
+            crypto::ReseedPRNG();
+            
+            // Unlock keys, only once for the whole batch, and prepare data for all requests.
+            protocol::SignatureKeys plain_keys;
+            if (!snapshot.unlock(plain_keys, signature_factor, keys)) {
+                CC7_LOG("Session %p: SignBatch: Unable to unlock signature keys.", this);
+                return EC_Encryption;
+            }
+            std::vector<std::string> nonces(count);
+            std::vector<cc7::ByteArray> data(count);
+            for (size_t i = 0; i < count; i++) {
+                const std::string & request_app_secret = requests[i].isOfflineRequest() ? protocol::PA_OFFLINE_APP_SECRET : app_secret;
+                if (!_PrepareDataForSigning(requests[i], request_app_secret, nonces[i], data[i])) {
+                    return EC_Encryption;
+                }
+            }
+            
+            // Calculate all signatures, if the state is still the same.
+            {
+                LOCK_GUARD();
+                if (snapshot.stateVersion != _stateVersion) {
+                    CC7_LOG("Session %p: SignBatch: State has been changed during the signature calculation, retrying.", this);
+                    continue;
+                }
+                // Keep the current counter, to restore it when some signature fails.
+                const cc7::U64 counter = _pd->signatureCounter;
+                const cc7::ByteArray counter_data = _pd->signatureCounterData;
+                const cc7::byte counter_byte = _pd->signatureCounterByte;
+                
+                // Prepare all requests with consecutive counters, then calculate all signatures at once.
+                std::vector<HTTPRequestDataSignature> signatures(count);
+                std::vector<protocol::SignatureBatchItem> items(count);
+                for (size_t i = 0; i < count; i++) {
+                    prepareRequestSignature(requests[i], data[i], nonces[i], factor_string, items[i], signatures[i]);
+                    protocol::CalculateNextCounterValue(*_pd);
+                }
+                bool result = protocol::CalculateSignatures(plain_keys, signature_factor, items);
+                for (size_t i = 0; i < count && result; i++) {
+                    result = !items[i].signature.empty();
+                    signatures[i].signature.swap(items[i].signature);
+                }
+                if (!result) {
+                    CC7_LOG("Session %p: SignBatch: Signature calculation failed.", this);
+                    _pd->signatureCounter = counter;
+                    _pd->signatureCounterData = counter_data;
+                    _pd->signatureCounterByte = counter_byte;
+                    return EC_Encryption;
+                }
+                journalCounter();
+                out_signatures.swap(signatures);
+                return EC_Ok;
+            }
+        }
+        return EC_WrongState;
+    }
+    
+    ErrorCode Session::validateRequestForSigning(const HTTPRequestData & request) const
+    {
+        if (!hasPersistentData()) {
             CC7_LOG("Session %p: Sign: There's no valid activation.", this);
             return EC_WrongState;
         }
@@ -627,47 +1147,24 @@ namespace powerAuth
             CC7_LOG("Session %p: Sign: Wrong request data.", this);
             return EC_WrongParam;
         }
-        out.factor = protocol::ConvertSignatureFactorToString(signature_factor);
-        if (out.factor.empty()) {
-            CC7_LOG("Session %p: Sign: Wrong signature factor 0x%04x.", this, signature_factor);
-            return EC_WrongParam;
-        }
         // Check combination of offlineNonce & vaultUnlock.
         if (request.isOfflineRequest() && hasPendingProtocolUpgrade()) {
             CC7_LOG("Session %p: Sign: Offline signature is not available during the pending protocol upgrade.", this);
             return EC_WrongState;
         }
+        return EC_Ok;
+    }
+    
+    ErrorCode Session::calculateRequestSignature(const HTTPRequestData & request, const cc7::ByteRange & data,
+                                                 const std::string & nonce, const protocol::SignatureKeys & plain_keys,
+                                                 SignatureFactor signature_factor, const std::string & factor_string,
+                                                 HTTPRequestDataSignature & out)
+    {
+        protocol::SignatureBatchItem item;
+        prepareRequestSignature(request, data, nonce, factor_string, item, out);
         
-        // Re-seed OpenSSL's PRNG.
-        crypto::ReseedPRNG();
-        
-        // Get NONCE from request structure, or generate a new one.
-        cc7::ByteArray nonce;
-        if (!request.isOfflineRequest()) {
-            nonce = crypto::GetRandomData(protocol::SIGNATURE_KEY_SIZE, true);
-            out.nonce = nonce.base64String();
-        } else {
-            if (!cc7::Base64_Decode(request.offlineNonce, 0, nonce)) {
-                CC7_LOG("Session %p: Sign: request.offlineNonce is invalid.", this);
-                return EC_Encryption;
-            }
-            out.nonce = request.offlineNonce;   // already in valid Base64 format
-        }
-        
-        // Unlock keys. This also validates whether the provided unlock keys are present or not.
-        protocol::SignatureKeys plain_keys;
-        protocol::SignatureUnlockKeysReq unlock_request(signature_factor, &keys, eek(), &_pd->passwordSalt, _pd->passwordIterations);
-        if (!protocol::UnlockSignatureKeys(plain_keys, _pd->sk, unlock_request)) {
-            CC7_LOG("Session %p: Sign: Unable to unlock signature keys.", this);
-            return EC_Encryption;
-        }
-        
-        // Normalize data and calculate signature
-        const std::string & app_secret = request.isOfflineRequest() ? protocol::PA_OFFLINE_APP_SECRET : _setup.applicationSecret;
-        cc7::ByteArray data = protocol::NormalizeDataForSignature(request.method, request.uri, out.nonce, request.body, app_secret);
-        cc7::ByteArray ctr_data = _pd->isV3() ? _pd->signatureCounterData : protocol::SignatureCounterToData(_pd->signatureCounter);
-        const bool base64_sig_format = !request.isOfflineRequest() && _pd->isV3();
-        out.signature = protocol::CalculateSignature(plain_keys, signature_factor, ctr_data, data, base64_sig_format);
+        // Calculate signature
+        out.signature = protocol::CalculateSignature(plain_keys, signature_factor, item.ctrData, item.data, item.base64Format);
         if (out.signature.empty()) {
             CC7_LOG("Session %p: Sign: Signature calculation failed.", this);
             return EC_Encryption;
@@ -676,12 +1173,22 @@ namespace powerAuth
         // Move counter forward
         protocol::CalculateNextCounterValue(*_pd);
         
-        // Fill the rest of values to out structure
+        return EC_Ok;
+    }
+    
+    void Session::prepareRequestSignature(const HTTPRequestData & request, const cc7::ByteRange & data,
+                                          const std::string & nonce, const std::string & factor_string,
+                                          protocol::SignatureBatchItem & item, HTTPRequestDataSignature & out) const
+    {
+        item.ctrData        = _pd->isV3() ? _pd->signatureCounterData : protocol::SignatureCounterToData(_pd->signatureCounter);
+        item.data           = data;
+        item.base64Format   = !request.isOfflineRequest() && _pd->isV3();
+        
+        out.factor          = factor_string;
+        out.nonce           = nonce;
         out.version         = maxSupportedHttpProtocolVersion(_pd->protocolVersion());
         out.activationId    = _pd->activationId;
         out.applicationKey  = request.isOfflineRequest() ? protocol::PA_OFFLINE_APP_SECRET : _setup.applicationKey;
-        
-        return EC_Ok;
     }
     
     const std::string & Session::httpAuthHeaderName() const
@@ -691,13 +1198,14 @@ namespace powerAuth
     
     ErrorCode Session::verifyServerSignedData(const SignedData & data) const
     {
+        SESSION_OPERATION(SO_VerifyServerSignedData);
         LOCK_GUARD();
         if (!hasValidSetup()) {
             CC7_LOG("Session %p: ServerSig: Session has no valid setup.", this);
             return EC_WrongState;
         }
         bool use_master_server_key = data.signingKey == SignedData::ECDSA_MasterServerKey;
-        if (!use_master_server_key && !hasValidActivation()) {
+        if (!use_master_server_key && !hasPersistentData()) {
             CC7_LOG("Session %p: ServerSig: There's no valid activation.", this);
             return EC_WrongState;
         }
@@ -714,7 +1222,7 @@ namespace powerAuth
             ec_public_key = crypto::ECC_ImportPublicKeyFromB64(nullptr, _setup.masterServerPublicKey, ctx);
         } else {
             // Import server public key, which is personalized and associated with this session.
-            ec_public_key = crypto::ECC_ImportPublicKey(nullptr, _pd->serverPublicKey);
+            ec_public_key = _ImportServerPublicKey(*_pd, ctx);
         }
         if (nullptr != ec_public_key) {
             // validate signature
@@ -729,50 +1237,347 @@ namespace powerAuth
         return success ? EC_Ok : EC_WrongSignature;
     }
     
-    // MARK: - Signature keys management -
     
-    ErrorCode Session::changeUserPassword(const cc7::ByteRange & old_password, const cc7::ByteRange & new_password)
+    // MARK: - Unlocked signature keys -
+    
+    ErrorCode Session::unlockSignatureKeys(const SignatureUnlockKeys & keys, SignatureFactor signature_factor,
+                                           const UnlockedSignatureKeysLimits & limits)
     {
+        SESSION_OPERATION(SO_UnlockSignatureKeys);
         LOCK_GUARD();
-        if (!hasValidActivation()) {
-            CC7_LOG("Session %p: PasswordChange: There's no valid activation.", this);
+        // Previously unlocked keys are always discarded.
+        lockSignatureKeys();
+        if (!hasPersistentData()) {
+            CC7_LOG("Session %p: UnlockKeys: There's no valid activation.", this);
+            return EC_WrongState;
+        }
+        if (protocol::ConvertSignatureFactorToString(signature_factor).empty()) {
+            CC7_LOG("Session %p: UnlockKeys: Wrong signature factor 0x%04x.", this, signature_factor);
+            return EC_WrongParam;
+        }
+        if (limits.maxUseCount == 0 && limits.maxTimeInterval == 0) {
+            CC7_LOG("Session %p: UnlockKeys: At least one limit must be set.", this);
+            return EC_WrongParam;
+        }
+        // Transport key is protected with the same key as possession, so unlock it together.
+        SignatureFactor unlock_factor = signature_factor;
+        if (signature_factor & SF_Possession) {
+            unlock_factor |= protocol::SF_Transport;
+        }
+        protocol::UnlockedSignatureKeys * uk = new protocol::UnlockedSignatureKeys(signature_factor, limits);
+        protocol::SignatureUnlockKeysReq unlock_request(unlock_factor, &keys, eek(), &_pd->passwordSalt, _pd->passwordIterations);
+        if (!protocol::UnlockSignatureKeys(uk->keys, _pd->sk, unlock_request)) {
+            CC7_LOG("Session %p: UnlockKeys: Unable to unlock signature keys.", this);
+            delete uk;
+            return EC_Encryption;
+        }
+        _uk = uk;
+        return EC_Ok;
+    }
+    
+    bool Session::hasUnlockedSignatureKeys() const
+    {
+        LOCK_GUARD();
+        return _uk != nullptr && _uk->canBeUsed();
+    }
+    
+    void Session::lockSignatureKeys()
+    {
+        SESSION_OPERATION(SO_LockSignatureKeys);
+        LOCK_GUARD();
+        delete _uk;
+        _uk = nullptr;
+    }
+    
+    ErrorCode Session::signHTTPRequestDataWithUnlockedKeys(const HTTPRequestData & request, HTTPRequestDataSignature & out)
+    {
+        SESSION_OPERATION(SO_SignHTTPRequestDataWithUnlockedKeys);
+        LOCK_GUARD();
+        ErrorCode code = validateRequestForSigning(request);
+        if (code != EC_Ok) {
+            return code;
+        }
+        if (!hasUnlockedSignatureKeys()) {
+            CC7_LOG("Session %p: Sign: There are no usable unlocked keys.", this);
+            lockSignatureKeys();
             return EC_WrongState;
         }
         
-        // Prepare lock / unlock structures. In this one particular case session keeps these
-        // structures hidden in implementation and allows you to use password directly.
+        // Re-seed OpenSSL's PRNG.
+        crypto::ReseedPRNG();
         
-        SignatureUnlockKeys old_keys;
-        old_keys.userPassword = old_password;
-        SignatureUnlockKeys new_keys;
-        new_keys.userPassword = new_password;
+        std::string nonce;
+        cc7::ByteArray data;
+        const std::string & app_secret = request.isOfflineRequest() ? protocol::PA_OFFLINE_APP_SECRET : _setup.applicationSecret;
+        if (_PrepareDataForSigning(request, app_secret, nonce, data)) {
+            const std::string factor_string = protocol::ConvertSignatureFactorToString(_uk->factor);
+            code = calculateRequestSignature(request, data, nonce, _uk->keys, _uk->factor, factor_string, out);
+            if (code == EC_Ok) {
+                // Only the successful operation consumes the use of unlocked keys.
+                _uk->markUsed();
+                journalCounter();
+            }
+        } else {
+            code = EC_Encryption;
+        }
+        if (!_uk->canBeUsed()) {
+            lockSignatureKeys();
+        }
+        return code;
+    }
+    
+    ErrorCode Session::decodeActivationStatusWithUnlockedKeys(const EncryptedActivationStatus & enc_status, ActivationStatus & status)
+    {
+        SESSION_OPERATION(SO_DecodeActivationStatusWithUnlockedKeys);
+        LOCK_GUARD();
+        if (!hasPersistentData()) {
+            CC7_LOG("Session %p: Status: Called in wrong state.", this);
+            return EC_WrongState;
+        }
+        if (enc_status.challenge.empty() || enc_status.encryptedStatusBlob.empty() || enc_status.nonce.empty()) {
+            CC7_LOG("Session %p: Status: All parameters are required in EncryptedActivationStatus.", this);
+            return EC_WrongParam;
+        }
+        if (!hasUnlockedSignatureKeys() || (_uk->factor & SF_Possession) == 0) {
+            CC7_LOG("Session %p: Status: There are no usable unlocked keys with possession factor.", this);
+            return EC_WrongState;
+        }
+        
+        ErrorCode code = EC_Encryption;
+        if (prepareActivationConstants(_uk->keys.transportKey)) {
+            const protocol::TransportKeys & transport_keys = _derived->activation.transportKeys;
+            code = _DecryptActivationStatus(enc_status, transport_keys, status);
+            if (code == EC_Ok) {
+                _uk->markUsed();
+                applyCounterState(status, transport_keys);
+            }
+        }
+        if (!_uk->canBeUsed()) {
+            lockSignatureKeys();
+        }
+        return code;
+    }
+    
+    // MARK: - Signature counter reservation -
+    
+    ErrorCode Session::reserveSignatureCounters(size_t count, SignatureCounterReservation & reservation)
+    {
+        SESSION_OPERATION(SO_ReserveSignatureCounters);
+        LOCK_GUARD();
+        if (!hasPersistentData()) {
+            CC7_LOG("Session %p: Reserve: There's no valid activation.", this);
+            return EC_WrongState;
+        }
+        if (count == 0 || count > protocol::COUNTER_RESERVATION_MAX) {
+            CC7_LOG("Session %p: Reserve: Wrong number of counters %zu.", this, count);
+            return EC_WrongParam;
+        }
+        const bool is_v3 = _pd->isV3();
+        std::vector<cc7::ByteArray> counters;
+        counters.reserve(count);
+        reservation._firstCounterByte = _pd->signatureCounterByte;
+        for (size_t i = 0; i < count; i++) {
+            counters.push_back(is_v3 ? _pd->signatureCounterData : protocol::SignatureCounterToData(_pd->signatureCounter));
+            protocol::CalculateNextCounterValue(*_pd);
+        }
+        reservation._activationId = _pd->activationId;
+        reservation._isV3 = is_v3;
+        reservation._counters.swap(counters);
+        std::vector<std::atomic<bool>>(count).swap(reservation._used);
+        reservation._released = false;
+        reservation._hasCounterByte = _pd->flags.hasSignatureCounterByte;
+        reservation._endCounterByte = _pd->signatureCounterByte;
+        reservation._endCounter = _pd->signatureCounter;
+        reservation._endCounterData = _pd->signatureCounterData;
+        journalCounter();
+        return EC_Ok;
+    }
+    
+    ErrorCode Session::signHTTPRequestDataWithReservation(SignatureCounterReservation & reservation, size_t slot,
+                                                          const HTTPRequestData & request,
+                                                          const SignatureUnlockKeys & keys, SignatureFactor signature_factor,
+                                                          HTTPRequestDataSignature & out)
+    {
+        SESSION_OPERATION(SO_SignHTTPRequestDataWithReservation);
+        if (slot >= reservation.count()) {
+            CC7_LOG("Session %p: Sign: Wrong reservation slot %zu.", this, slot);
+            return EC_WrongParam;
+        }
+        if (reservation._used[slot]) {
+            CC7_LOG("Session %p: Sign: Reservation slot %zu is already used.", this, slot);
+            return EC_WrongParam;
+        }
+        const std::string factor_string = protocol::ConvertSignatureFactorToString(signature_factor);
+        if (factor_string.empty()) {
+            CC7_LOG("Session %p: Sign: Wrong signature factor 0x%04x.", this, signature_factor);
+            return EC_WrongParam;
+        }
+        // Validate session's state & parameters and take a snapshot of protected keys.
+        KeysSnapshot snapshot;
+        std::string app_secret;
+        cc7::ByteArray counter;
+        {
+            LOCK_GUARD();
+            if (reservation._released) {
+                CC7_LOG("Session %p: Sign: Reservation is already released.", this);
+                return EC_WrongParam;
+            }
+            ErrorCode code = validateRequestForSigning(request);
+            if (code != EC_Ok) {
+                return code;
+            }
+            if (reservation._activationId != _pd->activationId || reservation._isV3 != _pd->isV3()) {
+                CC7_LOG("Session %p: Sign: Reservation doesn't match the current activation.", this);
+                return EC_WrongState;
+            }
+            counter = reservation._counters[slot];
+            makeKeysSnapshot(snapshot);
+            app_secret = request.isOfflineRequest() ? protocol::PA_OFFLINE_APP_SECRET : _setup.applicationSecret;
+            out.version         = maxSupportedHttpProtocolVersion(_pd->protocolVersion());
+            out.activationId    = _pd->activationId;
+            out.applicationKey  = request.isOfflineRequest() ? protocol::PA_OFFLINE_APP_SECRET : _setup.applicationKey;
+        }
+        
+        // Re-seed OpenSSL's PRNG.
+        crypto::ReseedPRNG();
         
-        // Unlock knowledge key with using old password
+        // The rest of the calculation doesn't touch the session's state.
         protocol::SignatureKeys plain_keys;
-        protocol::SignatureUnlockKeysReq unlock_request(SF_Knowledge, &old_keys, eek(), &_pd->passwordSalt, _pd->passwordIterations);
-        if (false == protocol::UnlockSignatureKeys(plain_keys, _pd->sk, unlock_request)) {
+        if (!snapshot.unlock(plain_keys, signature_factor, keys)) {
+            CC7_LOG("Session %p: Sign: Unable to unlock signature keys.", this);
             return EC_Encryption;
         }
-        
-        // Generate new salt and protect knowledge key with a new password
-        const cc7::U32 new_iterations_count = protocol::PBKDF2_PASS_ITERATIONS;
-        cc7::ByteArray new_salt = crypto::GetRandomData(protocol::PBKDF2_SALT_SIZE, true);
-        protocol::SignatureKeys encrypted_keys;
-        protocol::SignatureUnlockKeysReq lock_request(SF_Knowledge, &new_keys, eek(), &new_salt, new_iterations_count);
-        if (false == protocol::LockSignatureKeys(encrypted_keys, plain_keys, lock_request)) {
+        std::string nonce;
+        cc7::ByteArray data;
+        if (!_PrepareDataForSigning(request, app_secret, nonce, data)) {
             return EC_Encryption;
         }
-
-        // Store change to the PD and return success
-        _pd->sk.knowledgeKey    = encrypted_keys.knowledgeKey;
-        _pd->passwordSalt       = new_salt;
-        _pd->passwordIterations = new_iterations_count;
+        const bool base64_sig_format = !request.isOfflineRequest() && reservation._isV3;
+        std::string signature = protocol::CalculateSignature(plain_keys, signature_factor, counter, data, base64_sig_format);
+        if (signature.empty()) {
+            CC7_LOG("Session %p: Sign: Signature calculation failed.", this);
+            return EC_Encryption;
+        }
+        // Claim the slot. If other thread was faster, or if the reservation was released in the meantime,
+        // then the signature must be thrown away. The release marks all slots as used.
+        if (reservation._used[slot].exchange(true)) {
+            CC7_LOG("Session %p: Sign: Reservation slot %zu is already used.", this, slot);
+            return EC_WrongParam;
+        }
+        out.factor      = factor_string;
+        out.nonce       = nonce;
+        out.signature   = signature;
+        return EC_Ok;
+    }
+    
+    ErrorCode Session::releaseSignatureCounters(SignatureCounterReservation & reservation)
+    {
+        SESSION_OPERATION(SO_ReleaseSignatureCounters);
+        LOCK_GUARD();
+        if (reservation.empty()) {
+            CC7_LOG("Session %p: Release: The reservation is empty.", this);
+            return EC_WrongParam;
+        }
+        // Claim the unused tail of the reservation, from the last slot. If a signature for the claimed
+        // slot is still being calculated, then it's thrown away. The first already used slot stops
+        // the claim, so the counter is never moved back behind a value used for the signature.
+        const size_t count = reservation.count();
+        size_t tail = count;
+        while (tail > 0 && !reservation._used[tail - 1].exchange(true)) {
+            --tail;
+        }
+        // Other unused slots are skipped. The storage is kept, because other threads may still read it.
+        for (size_t slot = 0; slot < tail; slot++) {
+            reservation._used[slot].store(true);
+        }
+        reservation._released = true;
         
+        const size_t unused_tail = count - tail;
+        if (unused_tail > 0 && hasPersistentData() && reservation._activationId == _pd->activationId && reservation._isV3 == _pd->isV3()) {
+            // Move counter back only if nobody moved it since the reservation. The journal is not updated,
+            // because its replay never moves the counter backward. The gap is then skipped after the replay.
+            if (reservation._isV3) {
+                const bool has_ctr_byte = _pd->flags.hasSignatureCounterByte;
+                if (reservation._endCounterData == _pd->signatureCounterData &&
+                    reservation._hasCounterByte == has_ctr_byte &&
+                    (!has_ctr_byte || reservation._endCounterByte == _pd->signatureCounterByte)) {
+                    _pd->signatureCounterData = reservation._counters[tail];
+                    if (has_ctr_byte) {
+                        _pd->signatureCounterByte = (cc7::byte)(reservation._firstCounterByte + tail);
+                    }
+                }
+            } else {
+                if (reservation._endCounter == _pd->signatureCounter) {
+                    _pd->signatureCounter -= unused_tail;
+                }
+            }
+        }
         return EC_Ok;
     }
+    
+    // MARK: - Signature keys management -
+    
+    ErrorCode Session::changeUserPassword(const cc7::ByteRange & old_password, const cc7::ByteRange & new_password)
+    {
+        SESSION_OPERATION(SO_ChangeUserPassword);
+        // Prepare lock / unlock structures. In this one particular case session keeps these
+        // structures hidden in implementation and allows you to use password directly.
+        
+        SignatureUnlockKeys old_keys;
+        old_keys.userPassword = old_password;
+        SignatureUnlockKeys new_keys;
+        new_keys.userPassword = new_password;
+        
+        for (int attempt = 0; attempt < MAX_COMMIT_ATTEMPTS; attempt++) {
+            // Validate session's state and take a snapshot of protected keys.
+            KeysSnapshot snapshot;
+            {
+                LOCK_GUARD();
+                // Unlocked keys must not survive the change of protected keys.
+                lockSignatureKeys();
+                if (!hasPersistentData()) {
+                    CC7_LOG("Session %p: PasswordChange: There's no valid activation.", this);
+                    return EC_WrongState;
+                }
+                makeKeysSnapshot(snapshot);
+            }
+            
+            // Unlock knowledge key with using old password
+            protocol::SignatureKeys plain_keys;
+            if (false == snapshot.unlock(plain_keys, SF_Knowledge, old_keys)) {
+                return EC_Encryption;
+            }
+            
+            // Generate new salt and protect knowledge key with a new password
+            const cc7::U32 new_iterations_count = protocol::PBKDF2_PASS_ITERATIONS;
+            cc7::ByteArray new_salt = crypto::GetRandomData(protocol::PBKDF2_SALT_SIZE, true);
+            protocol::SignatureKeys encrypted_keys;
+            protocol::SignatureUnlockKeysReq lock_request(SF_Knowledge, &new_keys, snapshot.eek(), &new_salt, new_iterations_count);
+            if (false == protocol::LockSignatureKeys(encrypted_keys, plain_keys, lock_request)) {
+                return EC_Encryption;
+            }
+            
+            // Store change to the PD and return success, if the state is still the same.
+            {
+                LOCK_GUARD();
+                if (snapshot.stateVersion == _stateVersion) {
+                    lockSignatureKeys();
+                    _pd->sk.knowledgeKey    = encrypted_keys.knowledgeKey;
+                    _pd->passwordSalt       = new_salt;
+                    _pd->passwordIterations = new_iterations_count;
+                    // Publish the new state, so operations running concurrently will not use the old keys.
+                    publishStateSnapshot();
+                    return EC_Ok;
+                }
+                CC7_LOG("Session %p: PasswordChange: State has been changed during the password change, retrying.", this);
+            }
+        }
+        return EC_WrongState;
+    }
 
     ErrorCode Session::addBiometryFactor(const std::string & c_vault_key, const SignatureUnlockKeys & keys)
     {
+        SESSION_OPERATION(SO_AddBiometryFactor);
         LOCK_GUARD();
         if (keys.biometryUnlockKey.empty()) {
             CC7_LOG("Session %p: addBiometryKey: The required biometryUnlockKey is missing.", this);
@@ -804,7 +1609,7 @@ namespace powerAuth
             }
             // Import device's private & server's public key
             device_private_key = crypto::ECC_ImportPrivateKey(nullptr, device_private_key_data, ctx);
-            server_public_key  = crypto::ECC_ImportPublicKey(nullptr, _pd->serverPublicKey, ctx);
+            server_public_key  = _ImportServerPublicKey(*_pd, ctx);
             cc7::ByteArray master_secret = protocol::ReduceSharedSecret(crypto::ECDH_SharedSecret(server_public_key, device_private_key));
             if (master_secret.empty()) {
                 break;
@@ -826,6 +1631,7 @@ namespace powerAuth
             }
             // Everything looks fine
             code = EC_Ok;
+            publishStateSnapshot();
 
         } while (false);
 
@@ -837,18 +1643,21 @@ namespace powerAuth
     
     bool Session::hasBiometryFactor() const
     {
-        LOCK_GUARD();
-        if (!hasValidActivation()) {
+        auto snapshot = stateSnapshot();
+        if (!snapshot->hasValidActivation) {
             CC7_LOG("Session %p: hasBiometryFactor: There's no valid activation.", this);
             return false;
         }
-        return !_pd->sk.biometryKey.empty();
+        return snapshot->hasBiometryFactor;
     }
     
     ErrorCode Session::removeBiometryFactor()
     {
+        SESSION_OPERATION(SO_RemoveBiometryFactor);
         LOCK_GUARD();
-        if (!hasValidActivation()) {
+        // Unlocked keys must not survive the change of protected keys.
+        lockSignatureKeys();
+        if (!hasPersistentData()) {
             CC7_LOG("Session %p: removeBiometryKey: There's no valid activation.", this);
             return EC_WrongState;
         }
@@ -858,6 +1667,7 @@ namespace powerAuth
 
         // Clear encrypted biometry key and reset waiting for vault flag.
         _pd->sk.biometryKey.clear();
+        publishStateSnapshot();
         return EC_Ok;
     }
     
@@ -867,6 +1677,7 @@ namespace powerAuth
     ErrorCode Session::deriveCryptographicKeyFromVaultKey(const std::string & c_vault_key, const SignatureUnlockKeys & keys,
                                                           cc7::U64 key_index, cc7::ByteArray & out_key)
     {
+        SESSION_OPERATION(SO_DeriveCryptographicKeyFromVaultKey);
         LOCK_GUARD();
         cc7::ByteArray vault_key;
         ErrorCode code = decryptVaultKey(c_vault_key, keys, vault_key);
@@ -883,6 +1694,7 @@ namespace powerAuth
     ErrorCode Session::signDataWithDevicePrivateKey(const std::string & c_vault_key, const SignatureUnlockKeys & keys,
                                                     const cc7::ByteRange & in_data, cc7::ByteArray & out_signature)
     {
+        SESSION_OPERATION(SO_SignDataWithDevicePrivateKey);
         LOCK_GUARD();
         cc7::ByteArray vault_key;
         ErrorCode code = decryptVaultKey(c_vault_key, keys, vault_key);
@@ -920,7 +1732,7 @@ namespace powerAuth
     ErrorCode Session::decryptVaultKey(const std::string & c_vault_key, const SignatureUnlockKeys & keys, cc7::ByteArray & out_key)
     {
         LOCK_GUARD();
-        if (!hasValidActivation()) {
+        if (!hasPersistentData()) {
             CC7_LOG("Session %p: Vault: There's no valid activation.", this);
             return EC_WrongState;
         }
@@ -931,7 +1743,7 @@ namespace powerAuth
             return EC_WrongParam;
         }
         cc7::ByteArray encrypted_vault_key;
-        bool bResult = encrypted_vault_key.readFromBase64String(c_vault_key);
+        bool bResult = utils::Base64_Decode(c_vault_key, encrypted_vault_key);
         if (!bResult || encrypted_vault_key.empty()) {
             // Treat wrong B64 format as attack on the protocol.
             CC7_LOG("Session %p: Vault: The provided vault key is wrong.", this);
@@ -974,20 +1786,22 @@ namespace powerAuth
     
     bool Session::hasExternalEncryptionKey() const
     {
-        LOCK_GUARD();
-        return eek() != nullptr;
+        return stateSnapshot()->hasExternalEncryptionKey;
     }
     
     ErrorCode Session::setExternalEncryptionKey(const cc7::ByteRange & eek)
     {
+        SESSION_OPERATION(SO_SetExternalEncryptionKey);
         LOCK_GUARD();
+        // Unlocked keys must not survive the change of protected keys.
+        lockSignatureKeys();
         if (hasExternalEncryptionKey()) {
             if (_setup.externalEncryptionKey == eek) {
                 return EC_Ok;
             }
             CC7_LOG("Session %p: EEK: Setting different EEK is not allowed.", this);
         } else {
-            if (hasValidActivation()) {
+            if (hasPersistentData()) {
                 // If session is activated, then we can check whether the EEK is really used or not.
                 if (!_pd->flags.usesExternalKey) {
                     // Setting EEK while session doesn't use it is invalid. You'll not able to sign data anymore.
@@ -998,6 +1812,8 @@ namespace powerAuth
             if (_setup.externalEncryptionKey.empty()) {
                 if (eek.size() == protocol::SIGNATURE_KEY_SIZE) {
                     _setup.externalEncryptionKey = eek;
+                    invalidateDerivedConstants(false);
+                    publishStateSnapshot();
                     return EC_Ok;
                 } else {
                     CC7_LOG("Session %p: EEK: Wrong size of EEK.", this);
@@ -1011,8 +1827,11 @@ namespace powerAuth
     
     ErrorCode Session::addExternalEncryptionKey(const cc7::ByteArray &eek)
     {
+        SESSION_OPERATION(SO_AddExternalEncryptionKey);
         LOCK_GUARD();
-        if (!hasValidActivation()) {
+        // Unlocked keys must not survive the change of protected keys.
+        lockSignatureKeys();
+        if (!hasPersistentData()) {
             CC7_LOG("Session %p: EEK: Session has no valid activation.", this);
             return EC_WrongState;
         }
@@ -1030,13 +1849,18 @@ namespace powerAuth
         }
         _setup.externalEncryptionKey = eek;
         _pd->flags.usesExternalKey = true;
+        invalidateDerivedConstants(false);
+        publishStateSnapshot();
         return EC_Ok;
     }
     
     ErrorCode Session::removeExternalEncryptionKey()
     {
+        SESSION_OPERATION(SO_RemoveExternalEncryptionKey);
         LOCK_GUARD();
-        if (!hasValidActivation()) {
+        // Unlocked keys must not survive the change of protected keys.
+        lockSignatureKeys();
+        if (!hasPersistentData()) {
             CC7_LOG("Session %p: EEK: Session has no valid activation.", this);
             return EC_WrongState;
         }
@@ -1054,6 +1878,8 @@ namespace powerAuth
         }
         _setup.externalEncryptionKey.clear();
         _pd->flags.usesExternalKey = false;
+        invalidateDerivedConstants(false);
+        publishStateSnapshot();
         return EC_Ok;
     }
     
@@ -1071,48 +1897,80 @@ namespace powerAuth
     
     ErrorCode Session::getEciesEncryptor(ECIESEncryptorScope scope, const SignatureUnlockKeys & keys, const cc7::ByteRange & sharedInfo1, ECIESEncryptor & out_encryptor) const
     {
-        LOCK_GUARD();
-        if (!hasValidSetup()) {
-            CC7_LOG("Session %p: ECIES: Session has no valid setup.", this);
-            return EC_WrongState;
-        }
+        SESSION_OPERATION(SO_GetEciesEncryptor);
+        // Take a copy of all information required for the encryptor. The encryptor doesn't change
+        // the session's state, so there's no need to check the state after the keys unlock.
+        std::string app_secret;
+        cc7::ByteArray server_public_key;
+        cc7::ByteArray server_public_key_point;
+        KeysSnapshot snapshot;
+        DerivedConstants::Activation constants;
         // Other parameters for ECIES encryptor
         cc7::ByteArray ecPublicKey;
         cc7::ByteArray sharedInfo2;
-        //
-        if (scope == ECIES_ApplicationScope) {
-            // For "application" scope, the setup is quite simple.
-            // We have to just compute hash from APP_SECRET (as is) and use
-            // the master server public key.
-            sharedInfo2 = crypto::SHA256(cc7::MakeRange(_setup.applicationSecret));
-            ecPublicKey = cc7::FromBase64String(_setup.masterServerPublicKey);
-            //
-        } else if (scope == ECIES_ActivationScope) {
-            // For the "activation" scope, we need to at first validate whether there's
-            // some activation.
-            if (!hasValidActivation()) {
-                CC7_LOG("Session %p: ECIES: Session has no valid activation.", this);
+        {
+            LOCK_GUARD();
+            if (!hasValidSetup()) {
+                CC7_LOG("Session %p: ECIES: Session has no valid setup.", this);
                 return EC_WrongState;
             }
+            if (scope == ECIES_ApplicationScope) {
+                // For "application" scope, the setup is quite simple.
+                // We have to just use hash from APP_SECRET (as is) and
+                // the master server public key. Both values are cached.
+                const DerivedConstants & dc = derivedConstants();
+                sharedInfo2 = dc.eciesSharedInfo2;
+                ecPublicKey = dc.masterServerPublicKey;
+            } else if (scope == ECIES_ActivationScope) {
+                // For the "activation" scope, we need to at first validate whether there's
+                // some activation.
+                if (!hasPersistentData()) {
+                    CC7_LOG("Session %p: ECIES: Session has no valid activation.", this);
+                    return EC_WrongState;
+                }
+                makeKeysSnapshot(snapshot);
+                server_public_key = _pd->serverPublicKey;
+                if (!_pd->flags.hasValidatedServerPublicKey) {
+                    // Validate the key only once, then the uncompressed form is kept in PD.
+                    EC_KEY_free(_ImportServerPublicKey(*_pd, nullptr));
+                }
+                if (_pd->flags.hasValidatedServerPublicKey) {
+                    server_public_key_point = _pd->serverPublicKeyPoint;
+                }
+                constants = derivedConstants().activation;
+                app_secret = _setup.applicationSecret;
+            } else {
+                // Scope is not known
+                CC7_LOG("Session %p: ECIES: Unsupported scope.", this);
+                return EC_WrongParam;
+            }
+        }
+        if (scope == ECIES_ActivationScope) {
             // Acquire the transport key
             protocol::SignatureKeys plain_keys;
-            protocol::SignatureUnlockKeysReq unlock_request(protocol::SF_Transport, &keys, eek(), &_pd->passwordSalt, _pd->passwordIterations);
-            if (!protocol::UnlockSignatureKeys(plain_keys, _pd->sk, unlock_request)) {
+            if (!snapshot.unlock(plain_keys, protocol::SF_Transport, keys)) {
                 CC7_LOG("Session %p: ECIES: You have to provide valid possession key.", this);
                 return EC_Encryption;
             }
             // The sharedInfo2 is defined as HMAC_SHA256(key: KEY_TRANSPORT, data: APP_SECRET)
+            // The value is cached together with the transport key it was derived from.
+            if (!constants.isDerivedFrom(plain_keys.transportKey)) {
+                if (!constants.derive(plain_keys.transportKey, app_secret)) {
+                    return EC_Encryption;
+                }
+                LOCK_GUARD();
+                if (snapshot.stateVersion == _stateVersion) {
+                    derivedConstants().activation = constants;
+                }
+            }
+            plain_keys.transportKey.secureClear();
+            sharedInfo2 = constants.eciesSharedInfo2;
             // We need to also use the server's public key as EC public key.
-            sharedInfo2 = crypto::HMAC_SHA256(cc7::MakeRange(_setup.applicationSecret), plain_keys.transportKey);
-            ecPublicKey = _pd->serverPublicKey;
-            //
-        } else {
-            // Scope is not known
-            CC7_LOG("Session %p: ECIES: Unsupported scope.", this);
-            return EC_WrongParam;
+            ecPublicKey = server_public_key;
         }
         // Now construct the encryptor with prepared setup.
         out_encryptor = ECIESEncryptor(ecPublicKey, sharedInfo1, sharedInfo2);
+        out_encryptor._validated_public_key = server_public_key_point;
         return EC_Ok;
     }
     
@@ -1120,14 +1978,16 @@ namespace powerAuth
     
     ErrorCode Session::startProtocolUpgrade()
     {
+        SESSION_OPERATION(SO_StartProtocolUpgrade);
         LOCK_GUARD();
-        if (!hasValidActivation()) {
+        if (!hasPersistentData()) {
             CC7_LOG("Session %p: StartUpgrade: Session has no valid activation.", this);
             return EC_WrongState;
         }
         switch (_pd->protocolVersion()) {
             case Version_V2:
                 _pd->flags.pendingUpgradeVersion = Version_V3;
+                publishStateSnapshot();
                 return EC_Ok;
             default:
                 break;
@@ -1139,18 +1999,15 @@ namespace powerAuth
     
     Version Session::pendingProtocolUpgradeVersion() const
     {
-        LOCK_GUARD();
-        if (!hasValidActivation()) {
-            return Version_NA;
-        }
-        return (Version) _pd->flags.pendingUpgradeVersion;
+        return stateSnapshot()->pendingUpgradeVersion;
     }
     
     
     ErrorCode Session::applyProtocolUpgradeData(const ProtocolUpgradeData & upgrade_data)
     {
+        SESSION_OPERATION(SO_ApplyProtocolUpgradeData);
         LOCK_GUARD();
-        if (!hasValidActivation()) {
+        if (!hasPersistentData()) {
             CC7_LOG("Session %p: ApplyUpgradeData: Session has no valid activation.", this);
             return EC_WrongState;
         }
@@ -1162,17 +2019,21 @@ namespace powerAuth
                     return EC_WrongState;
                 }
                 cc7::ByteArray ctr_data;
-                if (!cc7::Base64_Decode(upgrade_data.toV3.ctrData, 0, ctr_data) || ctr_data.size() != protocol::SIGNATURE_KEY_SIZE) {
+                if (!utils::Base64_Decode(upgrade_data.toV3.ctrData, ctr_data) || ctr_data.size() != protocol::SIGNATURE_KEY_SIZE) {
                     CC7_LOG("Session %p: ApplyUpgradeData: Wrong V3 upgrade data.", this);
                     return EC_WrongParam;
                 }
                 // Everything looks fine, we can commit new data.
                 _pd->signatureCounterData = ctr_data;
                 _pd->signatureCounter = 0;
+                // The fingerprint depends on the protocol version.
+                _pd->activationFingerprint.clear();
                 _pd->flags.waitingForVaultUnlock = 0;
+                invalidateDerivedConstants(false);
                 // V3.1: Despite the fact that we still have a local counter, it might be still out of the sync.
                 //       So, mark the counter byte as invalid, just like we do for migration from V3 to V3.1.
                 _pd->flags.hasSignatureCounterByte = 0;
+                publishStateSnapshot();
                 return EC_Ok;
             }
             default:
@@ -1185,8 +2046,9 @@ namespace powerAuth
     
     ErrorCode Session::finishProtocolUpgrade()
     {
+        SESSION_OPERATION(SO_FinishProtocolUpgrade);
         LOCK_GUARD();
-        if (!hasValidActivation()) {
+        if (!hasPersistentData()) {
             CC7_LOG("Session %p: FinishUpgrade: Session has no valid activation.", this);
             return EC_WrongState;
         }
@@ -1195,6 +2057,7 @@ namespace powerAuth
                 if (_pd->protocolVersion() == Version_V3) {
                     // Upgrade to V3 succeeded.
                     _pd->flags.pendingUpgradeVersion = Version_NA;
+                    publishStateSnapshot();
                     return EC_Ok;
                 }
                 CC7_LOG("Session %p: FinishUpgrade: Upgrade to V3 is not finished yet.", this);
@@ -1225,15 +2088,15 @@ namespace powerAuth
     
     bool Session::hasActivationRecoveryData() const
     {
-        LOCK_GUARD();
-        return hasValidActivation() && !_pd->cRecoveryData.empty();
+        return stateSnapshot()->hasActivationRecoveryData;
     }
     
     
     ErrorCode Session::getActivationRecoveryData(const std::string & c_vault_key, const SignatureUnlockKeys & keys, RecoveryData & out_recovery_data)
     {
+        SESSION_OPERATION(SO_GetActivationRecoveryData);
         LOCK_GUARD();
-        if (!hasValidActivation()) {
+        if (!hasPersistentData()) {
             CC7_LOG("Session %p: RecoveryData: Session has no valid activation.", this);
             return EC_WrongState;
         }
@@ -1252,6 +2115,46 @@ namespace powerAuth
         return ec;
     }
     
+    // MARK: - Statistics -
+    
+    void Session::setStatisticsEnabled(bool enabled)
+    {
+        LOCK_GUARD();
+        utils::StatisticsCollector * collector = _statistics.load();
+        if (!collector) {
+            if (!enabled) {
+                return;
+            }
+            collector = new utils::StatisticsCollector();
+            _statistics.store(collector, std::memory_order_release);
+        }
+        collector->enabled = enabled;
+    }
+    
+    bool Session::isStatisticsEnabled() const
+    {
+        utils::StatisticsCollector * collector = _statistics.load(std::memory_order_acquire);
+        return collector && collector->enabled;
+    }
+    
+    SessionStatistics Session::statistics() const
+    {
+        SessionStatistics result;
+        utils::StatisticsCollector * collector = _statistics.load(std::memory_order_acquire);
+        if (collector) {
+            collector->snapshot(result);
+        }
+        return result;
+    }
+    
+    void Session::resetStatistics()
+    {
+        utils::StatisticsCollector * collector = _statistics.load(std::memory_order_acquire);
+        if (collector) {
+            collector->reset();
+        }
+    }
+    
     // MARK: - Private methods -
     
     /*
@@ -1267,23 +2170,33 @@ namespace powerAuth
      
      All other combination of parameters leads to fallback state.
      */
-    void Session::commitNewPersistentState(protocol::PersistentData *new_pd, Session::State new_state)
+    void Session::commitNewPersistentState(protocol::PersistentData *new_pd, Session::State new_state, LazyState * new_lazy)
     {
         // At first, delete possible activation data. In all cases, commit must clear
         // any instance of activation data.
         delete _ad;
         _ad = nullptr;
+        // Also wipe possible unlocked keys, they're no longer related to the new state.
+        delete _uk;
+        _uk = nullptr;
+        // Values derived from the transport key belongs to the previous activation.
+        invalidateDerivedConstants(false);
         
-        // The next structure is PersistentData. We have to delete possible previous instance
-        // of PD and if state is correct, then keep the new one.
+        // The next structure is PersistentData, or its lazily loaded variant. We have to delete
+        // possible previous instances and if state is correct, then keep the new one.
+        CC7_ASSERT(new_pd == nullptr || new_lazy == nullptr, "Internal error. Only PD or lazy state can be committed.");
         delete _pd;
-        if (new_pd != nullptr && new_state == SS_Activated) {
+        delete _lazy;
+        if ((new_pd != nullptr || new_lazy != nullptr) && new_state == SS_Activated) {
             // Ok, keep the new structure
             _pd = new_pd;
+            _lazy = new_lazy;
         } else {
             // Delete everything
             delete new_pd;
+            delete new_lazy;
             _pd = nullptr;
+            _lazy = nullptr;
             // PD was not commited, so, we have to adjust new state.
             new_state = SS_Empty;
         }
@@ -1322,6 +2235,137 @@ namespace powerAuth
         if (CC7_CHECK(new_state >= SS_Empty, "Internal error. Changing to SS_Invalid is not allowed!")) {
             _state = new_state;
         }
+        publishStateSnapshot();
+    }
+    
+    void Session::publishStateSnapshot()
+    {
+        _stateVersion++;
+        auto snapshot = std::make_shared<StateSnapshot>();
+        snapshot->hasValidSetup = _state >= SS_Empty;
+        if (_state == SS_Empty) {
+            snapshot->canStartActivation = CC7_CHECK(_pd == nullptr && _ad == nullptr, "Internal error. PD should be null when state is SS_Empty");
+        } else if (_state == SS_Activation1 || _state == SS_Activation2) {
+            snapshot->hasPendingActivation = CC7_CHECK(_pd == nullptr && _ad != nullptr, "Internal error. Only AD should be valid during the pending activation.");
+            if (snapshot->hasPendingActivation) {
+                snapshot->activationId = _ad->activationId;
+            }
+        } else if (_state == SS_Activated) {
+            snapshot->hasValidActivation = CC7_CHECK((_pd != nullptr || _lazy != nullptr) && _ad == nullptr, "Internal error. Only PD & setup should be valid when activated.");
+            if (snapshot->hasValidActivation) {
+                if (_pd) {
+                    snapshot->protocolVersion = _pd->protocolVersion();
+                    snapshot->pendingUpgradeVersion = (Version) _pd->flags.pendingUpgradeVersion;
+                    snapshot->hasBiometryFactor = !_pd->sk.biometryKey.empty();
+                    snapshot->hasActivationRecoveryData = !_pd->cRecoveryData.empty();
+                    snapshot->activationId = _pd->activationId;
+                } else {
+                    // Lazily loaded state provides the same information without the materialization.
+                    snapshot->protocolVersion = _lazy->view.protocolVersion();
+                    snapshot->pendingUpgradeVersion = (Version) _lazy->view.flags.pendingUpgradeVersion;
+                    snapshot->hasBiometryFactor = !_lazy->view.biometryKey.empty();
+                    snapshot->hasActivationRecoveryData = !_lazy->view.cRecoveryData.empty();
+                    snapshot->activationId = _lazy->view.activationIdString();
+                }
+                snapshot->hasProtocolUpgradeAvailable = snapshot->protocolVersion != Version_Latest &&
+                                                        snapshot->pendingUpgradeVersion == Version_NA;
+                snapshot->hasPendingProtocolUpgrade = snapshot->pendingUpgradeVersion != Version_NA;
+            }
+        }
+        snapshot->hasExternalEncryptionKey = snapshot->hasValidSetup && _setup.externalEncryptionKey.size() == protocol::SIGNATURE_KEY_SIZE;
+        
+#if defined(PA_SESSION_SINGLE_THREADED)
+        _snapshot = snapshot;
+#else
+        std::atomic_store(&_snapshot, std::shared_ptr<const StateSnapshot>(snapshot));
+#endif
+    }
+    
+    std::shared_ptr<const Session::StateSnapshot> Session::stateSnapshot() const
+    {
+#if defined(PA_SESSION_SINGLE_THREADED)
+        return _snapshot;
+#else
+        return std::atomic_load(&_snapshot);
+#endif
+    }
+    
+    void Session::makeKeysSnapshot(KeysSnapshot & out) const
+    {
+        out.sk                  = _pd->sk;
+        out.passwordSalt        = _pd->passwordSalt;
+        out.passwordIterations  = _pd->passwordIterations;
+        const cc7::ByteArray * ext_key = eek();
+        out.hasExternalEncryptionKey = ext_key != nullptr;
+        if (ext_key) {
+            out.externalEncryptionKey = *ext_key;
+        }
+        out.stateVersion        = _stateVersion;
+    }
+    
+    bool Session::hasPersistentData() const
+    {
+        if (!hasValidActivation()) {
+            return false;
+        }
+        if (_lazy) {
+            // Copy and validate the lazily loaded data. The published snapshot is still valid,
+            // because the materialized data contains the same information.
+            auto new_pd = new protocol::PersistentData();
+            if (!protocol::MaterializePersistentData(_lazy->view, *new_pd)) {
+                CC7_LOG("Session %p: Lazily loaded state contains invalid data.", this);
+                delete new_pd;
+                return false;
+            }
+            delete _lazy;
+            _lazy = nullptr;
+            _pd = new_pd;
+        }
+        return _pd != nullptr;
+    }
+    
+    Session::DerivedConstants & Session::derivedConstants() const
+    {
+        if (!_derived) {
+            _derived = new DerivedConstants();
+            _derived->eciesSharedInfo2 = crypto::SHA256(cc7::MakeRange(_setup.applicationSecret));
+            _derived->masterServerPublicKey = utils::FromBase64String(_setup.masterServerPublicKey);
+        }
+        return *_derived;
+    }
+    
+    bool Session::prepareActivationConstants(const cc7::ByteRange & transport_key) const
+    {
+        DerivedConstants::Activation & activation = derivedConstants().activation;
+        if (activation.isDerivedFrom(transport_key)) {
+            return true;
+        }
+        if (!activation.derive(transport_key, _setup.applicationSecret)) {
+            activation.clear();
+            return false;
+        }
+        return true;
+    }
+    
+    void Session::invalidateDerivedConstants(bool setup_changed) const
+    {
+        if (_derived) {
+            if (setup_changed) {
+                delete _derived;
+                _derived = nullptr;
+            } else {
+                _derived->activation.clear();
+            }
+        }
+    }
+    
+    void Session::journalCounter() const
+    {
+        if (_journal) {
+            if (!_journal->append(*_pd)) {
+                CC7_LOG("Session %p: Unable to append counter to the journal.", this);
+            }
+        }
     }
     
     
@@ -0,0 +1,341 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PowerAuth/SessionManager.h>
+#include <unordered_map>
+#include <atomic>
+#include <algorithm>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /**
+     Expected size of CPU cache line. The frequently modified structures are padded
+     to this size, to avoid false sharing between CPU cores. The padding is used instead
+     of alignas(), because C++11 doesn't guarantee the extended alignment for the heap
+     allocated objects.
+     */
+    static const size_t CACHE_LINE_SIZE = 64;
+    
+    /**
+     Number of index shards. Must be power of two.
+     */
+    static const size_t SHARDS_COUNT = 32;
+    
+    struct SessionManager::Entry
+    {
+        std::shared_ptr<Session> session;
+        std::atomic<bool> dirty;
+        char padding[CACHE_LINE_SIZE];
+        
+        Entry(std::shared_ptr<Session> session, bool dirty) :
+            session(session),
+            dirty(dirty)
+        {
+        }
+    };
+    
+    struct SessionManager::Shard
+    {
+        std::mutex lock;
+        std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+        char padding[CACHE_LINE_SIZE];
+    };
+    
+    /**
+     Returns key for the shard's map.
+     */
+    static inline std::string _EntryKey(const std::string & application_key, const std::string & activation_id)
+    {
+        std::string key;
+        key.reserve(application_key.size() + activation_id.size() + 1);
+        key.append(application_key).append(1, '\n').append(activation_id);
+        return key;
+    }
+    
+    
+    // MARK: - Construction / Destruction -
+    
+    SessionManager::SessionManager(std::shared_ptr<Executor> executor) :
+        _executor(executor ? executor : Executor::defaultExecutor()),
+        _shards(new Shard[SHARDS_COUNT])
+    {
+    }
+    
+    SessionManager::~SessionManager()
+    {
+    }
+    
+    
+    // MARK: - Setup -
+    
+    ErrorCode SessionManager::registerSetup(const SessionSetup & setup)
+    {
+        if (setup.applicationKey.empty()) {
+            CC7_LOG("SessionManager %p: Setup has no application key.", this);
+            return EC_WrongParam;
+        }
+        auto shared_setup = std::make_shared<const SessionSetup>(setup);
+        std::lock_guard<std::mutex> guard(_setupsLock);
+        _setups[setup.applicationKey] = shared_setup;
+        return EC_Ok;
+    }
+    
+    std::shared_ptr<const SessionSetup> SessionManager::sessionSetup(const std::string & application_key) const
+    {
+        std::lock_guard<std::mutex> guard(_setupsLock);
+        auto it = _setups.find(application_key);
+        return it != _setups.end() ? it->second : nullptr;
+    }
+    
+    ErrorCode SessionManager::warmUp(WarmUpTimings & out_timings) const
+    {
+        std::vector<std::string> master_keys;
+        {
+            std::lock_guard<std::mutex> guard(_setupsLock);
+            master_keys.reserve(_setups.size());
+            for (auto && item : _setups) {
+                master_keys.push_back(item.second->masterServerPublicKey);
+            }
+        }
+        return WarmUp(master_keys, out_timings);
+    }
+    
+    
+    // MARK: - Sessions -
+    
+    ErrorCode SessionManager::addSession(std::shared_ptr<Session> session, bool dirty)
+    {
+        if (!session) {
+            return EC_WrongParam;
+        }
+        if (!session->hasValidActivation()) {
+            CC7_LOG("SessionManager %p: Session %p has no valid activation.", this, session.get());
+            return EC_WrongState;
+        }
+        insertEntry(session->sessionSetup()->applicationKey, session->activationIdentifier(), session, dirty);
+        return EC_Ok;
+    }
+    
+    std::shared_ptr<Session> SessionManager::findSession(const std::string & application_key, const std::string & activation_id) const
+    {
+        auto entry = findEntry(application_key, activation_id);
+        return entry ? entry->session : nullptr;
+    }
+    
+    bool SessionManager::removeSession(const std::string & application_key, const std::string & activation_id)
+    {
+        Shard & shard = shardFor(application_key, activation_id);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        return shard.entries.erase(_EntryKey(application_key, activation_id)) > 0;
+    }
+    
+    bool SessionManager::markDirty(const std::string & application_key, const std::string & activation_id)
+    {
+        auto entry = findEntry(application_key, activation_id);
+        if (!entry) {
+            return false;
+        }
+        entry->dirty = true;
+        return true;
+    }
+    
+    size_t SessionManager::sessionsCount() const
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < SHARDS_COUNT; i++) {
+            std::lock_guard<std::mutex> guard(_shards[i].lock);
+            count += _shards[i].entries.size();
+        }
+        return count;
+    }
+    
+    
+    // MARK: - Bulk operations -
+    
+    ErrorCode SessionManager::loadSessions(const std::vector<SessionStateRecord> & records, std::vector<ErrorCode> & out_results)
+    {
+        std::vector<ErrorCode> results(records.size(), EC_WrongData);
+        parallelFor(records.size(), [&](size_t index) {
+            const SessionStateRecord & record = records[index];
+            auto setup = sessionSetup(record.applicationKey);
+            if (!setup) {
+                CC7_LOG("SessionManager %p: There's no setup for application key '%s'.", this, record.applicationKey.c_str());
+                results[index] = EC_WrongSetup;
+                return;
+            }
+            auto session = std::make_shared<Session>(*setup);
+            if (session->loadSessionState(record.state) != EC_Ok) {
+                results[index] = EC_WrongData;
+                return;
+            }
+            if (!session->hasValidActivation()) {
+                results[index] = EC_WrongState;
+                return;
+            }
+            const std::string activation_id = session->activationIdentifier();
+            if (!record.activationId.empty() && record.activationId != activation_id) {
+                CC7_LOG("SessionManager %p: Loaded state belongs to a different activation.", this);
+                results[index] = EC_WrongData;
+                return;
+            }
+            insertEntry(record.applicationKey, activation_id, session, false);
+            results[index] = EC_Ok;
+        });
+        ErrorCode code = EC_Ok;
+        for (auto result : results) {
+            if (result != EC_Ok) {
+                code = result;
+                break;
+            }
+        }
+        out_results.swap(results);
+        return code;
+    }
+    
+    size_t SessionManager::saveDirtySessions(std::vector<SessionStateRecord> & out_records)
+    {
+        // Collect dirty entries. The flag is cleared before the serialization, so the change
+        // made during the save will be saved again next time.
+        std::vector<std::pair<std::string, std::shared_ptr<Entry>>> dirty;
+        for (size_t i = 0; i < SHARDS_COUNT; i++) {
+            std::lock_guard<std::mutex> guard(_shards[i].lock);
+            for (auto && pair : _shards[i].entries) {
+                if (pair.second->dirty.exchange(false)) {
+                    dirty.push_back(pair);
+                }
+            }
+        }
+        std::vector<SessionStateRecord> records(dirty.size());
+        parallelFor(dirty.size(), [&](size_t index) {
+            const Session & session = *dirty[index].second->session;
+            SessionStateRecord & record = records[index];
+            record.applicationKey = session.sessionSetup()->applicationKey;
+            record.activationId = session.activationIdentifier();
+            record.state = session.saveSessionState();
+        });
+        out_records.swap(records);
+        return out_records.size();
+    }
+    
+    void SessionManager::decodeActivationStatuses(const std::vector<SessionStatusRequest> & requests, std::vector<SessionStatusResult> & out_results)
+    {
+        std::vector<SessionStatusResult> results(requests.size());
+        parallelFor(requests.size(), [&](size_t index) {
+            const SessionStatusRequest & request = requests[index];
+            SessionStatusResult & result = results[index];
+            auto entry = findEntry(request.applicationKey, request.activationId);
+            if (!entry) {
+                result.code = EC_WrongState;
+                return;
+            }
+            result.code = entry->session->decodeActivationStatus(request.encryptedStatus, request.keys, result.status);
+            if (result.code == EC_Ok) {
+                entry->dirty = true;
+            }
+        });
+        out_results.swap(results);
+    }
+    
+    
+    // MARK: - Private methods -
+    
+    SessionManager::Shard & SessionManager::shardFor(const std::string & application_key, const std::string & activation_id) const
+    {
+        const size_t hash = std::hash<std::string>()(activation_id) ^ (std::hash<std::string>()(application_key) * 31);
+        return _shards[hash & (SHARDS_COUNT - 1)];
+    }
+    
+    std::shared_ptr<SessionManager::Entry> SessionManager::findEntry(const std::string & application_key, const std::string & activation_id) const
+    {
+        Shard & shard = shardFor(application_key, activation_id);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        auto it = shard.entries.find(_EntryKey(application_key, activation_id));
+        return it != shard.entries.end() ? it->second : nullptr;
+    }
+    
+    void SessionManager::insertEntry(const std::string & application_key, const std::string & activation_id, std::shared_ptr<Session> session, bool dirty)
+    {
+        auto entry = std::make_shared<Entry>(session, dirty);
+        Shard & shard = shardFor(application_key, activation_id);
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.entries[_EntryKey(application_key, activation_id)] = entry;
+    }
+    
+    /**
+     The _ParallelJob structure keeps state shared between the caller of
+     `SessionManager::parallelFor()` and the helper tasks.
+     */
+    struct _ParallelJob
+    {
+        const std::function<void(size_t)> & body;
+        const size_t count;
+        std::atomic<size_t> next;
+        std::atomic<size_t> finished;
+        std::mutex lock;
+        std::condition_variable condition;
+        
+        _ParallelJob(const std::function<void(size_t)> & body, size_t count) :
+            body(body),
+            count(count),
+            next(0),
+            finished(0)
+        {
+        }
+        
+        void run()
+        {
+            size_t processed = 0;
+            size_t index;
+            while ((index = next++) < count) {
+                body(index);
+                ++processed;
+            }
+            if (processed > 0 && (finished += processed) == count) {
+                std::lock_guard<std::mutex> guard(lock);
+                condition.notify_all();
+            }
+        }
+    };
+    
+    void SessionManager::parallelFor(size_t count, const std::function<void(size_t)> & body)
+    {
+        if (count == 0) {
+            return;
+        }
+        // The calling thread processes items too, so the operation never waits for the executor
+        // to start helper tasks. The helper that starts after all items are taken, ends immediately
+        // and never touches the body.
+        auto job = std::make_shared<_ParallelJob>(body, count);
+        const size_t helpers = std::min<size_t>(count - 1, std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        for (size_t i = 0; i < helpers; i++) {
+            _executor->execute([job]() {
+                job->run();
+            });
+        }
+        job->run();
+        std::unique_lock<std::mutex> guard(job->lock);
+        job->condition.wait(guard, [&job]() {
+            return job->finished == job->count;
+        });
+    }
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -0,0 +1,571 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <PowerAuth/SessionStore.h>
+#include "crypto/Hash.h"
+#include "utils/DataReader.h"
+#include "utils/DataWriter.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    /*
+     The store's file has following layout:
+     
+        [0]     header slot A   (64 bytes)
+        [64]    header slot B   (64 bytes)
+        [128]   records & indexes, in order as they were appended
+     
+     Header slot:   MAGIC(4) | GENERATION(U64) | INDEX_OFFSET(U64) | INDEX_SIZE(U32) | DATA_END(U64) |
+                    INDEX_CHECKSUM(16) | SLOT_CHECKSUM(16)
+     Record:        RECORD_MAGIC(4) | ACTIVATION_ID(string) | STATE(data) | CHECKSUM(16)
+     Index:         COUNT | { ACTIVATION_ID(string) | OFFSET(U64) | SIZE(U32) } * COUNT
+     
+     The valid slot with higher generation is the active one. The update always writes
+     the inactive slot, after the appended data is flushed to the storage.
+     */
+    
+    static const cc7::byte STORE_MAGIC[]    = { 'P', 'A', 'S', 'T' };
+    static const cc7::byte RECORD_MAGIC[]   = { 'P', 'A', 'R', 'C' };
+    
+    static const size_t HEADER_SLOT_SIZE    = 64;
+    static const size_t HEADER_AREA_SIZE    = 2 * HEADER_SLOT_SIZE;
+    static const size_t CHECKSUM_SIZE       = 16;
+    
+    // Minimal size of file, which is automatically compacted.
+    static const size_t COMPACTION_MIN_SIZE = 64 * 1024;
+    
+    /**
+     Returns checksum calculated from |data|.
+     */
+    static cc7::ByteArray _Checksum(const cc7::ByteRange & data)
+    {
+        cc7::ByteArray hash = crypto::SHA256(data);
+        hash.resize(CHECKSUM_SIZE);
+        return hash;
+    }
+    
+    /**
+     Writes whole |data| at |offset| to file.
+     */
+    static bool _WriteAll(int fd, const cc7::ByteRange & data, cc7::U64 offset)
+    {
+        const cc7::byte * ptr = data.data();
+        size_t remaining = data.size();
+        while (remaining > 0) {
+            ssize_t written = pwrite(fd, ptr, remaining, (off_t)offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                CC7_LOG("SessionStore: Write failed with error %d.", errno);
+                return false;
+            }
+            ptr += written;
+            offset += written;
+            remaining -= written;
+        }
+        return true;
+    }
+    
+    /**
+     Flushes file's content to the storage.
+     */
+    static bool _Sync(int fd)
+    {
+        if (fsync(fd) != 0) {
+            CC7_LOG("SessionStore: Sync failed with error %d.", errno);
+            return false;
+        }
+        return true;
+    }
+    
+    /**
+     Flushes the directory containing |path| to the storage, so the renamed file
+     survives the power loss.
+     */
+    static bool _SyncDirectory(const std::string & path)
+    {
+        const size_t separator = path.find_last_of('/');
+        const std::string directory = separator == std::string::npos ? "." : (separator == 0 ? "/" : path.substr(0, separator));
+        int fd = ::open(directory.c_str(), O_RDONLY);
+        if (fd < 0) {
+            CC7_LOG("SessionStore: Unable to open directory. Error %d.", errno);
+            return false;
+        }
+        bool result = _Sync(fd);
+        ::close(fd);
+        return result;
+    }
+    
+    /**
+     Serializes |index| into byte array.
+     */
+    template <typename IndexMap>
+    static cc7::ByteArray _SerializeIndex(const IndexMap & index)
+    {
+        utils::DataWriter writer;
+        writer.writeCount(index.size());
+        for (auto && item : index) {
+            writer.writeString(item.first);
+            writer.writeU64(item.second.offset);
+            writer.writeU32(item.second.size);
+        }
+        return writer.serializedData();
+    }
+    
+    /**
+     Serializes header slot.
+     */
+    static cc7::ByteArray _SerializeHeader(cc7::U64 generation, cc7::U64 index_offset, const cc7::ByteRange & index_data, cc7::U64 data_end)
+    {
+        utils::DataWriter writer;
+        writer.writeMemory(cc7::MakeRange(STORE_MAGIC));
+        writer.writeU64(generation);
+        writer.writeU64(index_offset);
+        writer.writeU32((cc7::U32)index_data.size());
+        writer.writeU64(data_end);
+        writer.writeMemory(_Checksum(index_data));
+        cc7::ByteArray header = writer.serializedData();
+        header.append(_Checksum(header));
+        return header;
+    }
+    
+    /**
+     Serializes one record.
+     */
+    static cc7::ByteArray _SerializeRecord(const std::string & activation_id, const cc7::ByteRange & state)
+    {
+        utils::DataWriter writer;
+        writer.writeMemory(cc7::MakeRange(RECORD_MAGIC));
+        writer.writeString(activation_id);
+        writer.writeData(state);
+        cc7::ByteArray record = writer.serializedData();
+        record.append(_Checksum(record));
+        return record;
+    }
+    
+    
+    // MARK: - Construction / Destruction -
+    
+    SessionStore::SessionStore() :
+        _fd(-1),
+        _map(nullptr),
+        _mapSize(0)
+    {
+        closeFile();
+    }
+    
+    SessionStore::~SessionStore()
+    {
+        close();
+    }
+    
+    ErrorCode SessionStore::open(const std::string & path)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_fd >= 0) {
+            CC7_LOG("SessionStore %p: Store is already opened.", this);
+            return EC_WrongState;
+        }
+        return openFile(path);
+    }
+    
+    void SessionStore::close()
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        closeFile();
+    }
+    
+    bool SessionStore::isOpened() const
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        return _fd >= 0;
+    }
+    
+    
+    // MARK: - Records -
+    
+    std::vector<std::string> SessionStore::activationIds() const
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        std::vector<std::string> result;
+        result.reserve(_index.size());
+        for (auto && item : _index) {
+            result.push_back(item.first);
+        }
+        return result;
+    }
+    
+    bool SessionStore::contains(const std::string & activation_id) const
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        return _index.find(activation_id) != _index.end();
+    }
+    
+    ErrorCode SessionStore::load(const std::string & activation_id, cc7::ByteArray & out_state) const
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_fd < 0) {
+            return EC_WrongState;
+        }
+        auto it = _index.find(activation_id);
+        if (it == _index.end()) {
+            return EC_WrongParam;
+        }
+        const RecordLocation & location = it->second;
+        if (location.size <= CHECKSUM_SIZE || location.offset + location.size > _mapSize) {
+            CC7_LOG("SessionStore %p: Record for '%s' is out of file.", this, activation_id.c_str());
+            return EC_WrongData;
+        }
+        const cc7::ByteRange record(_map + location.offset, location.size);
+        const cc7::ByteRange record_data = record.subRangeTo(location.size - CHECKSUM_SIZE);
+        if (_Checksum(record_data) != record.subRangeFrom(location.size - CHECKSUM_SIZE)) {
+            CC7_LOG("SessionStore %p: Record for '%s' is corrupted.", this, activation_id.c_str());
+            return EC_WrongData;
+        }
+        // Parse record, the state is referenced directly in the mapped memory.
+        utils::DataReader reader(record_data);
+        cc7::ByteRange magic, state;
+        std::string record_id;
+        if (!reader.readMemoryRange(magic, sizeof(RECORD_MAGIC)) || magic != cc7::MakeRange(RECORD_MAGIC) ||
+            !reader.readString(record_id) || record_id != activation_id ||
+            !reader.readRange(state) || state.empty()) {
+            CC7_LOG("SessionStore %p: Record for '%s' is invalid.", this, activation_id.c_str());
+            return EC_WrongData;
+        }
+        out_state.assign(state.begin(), state.end());
+        return EC_Ok;
+    }
+    
+    ErrorCode SessionStore::store(const std::string & activation_id, const cc7::ByteRange & state)
+    {
+        std::map<std::string, cc7::ByteArray> states;
+        states[activation_id].assign(state.begin(), state.end());
+        return update(states, std::vector<std::string>());
+    }
+    
+    ErrorCode SessionStore::remove(const std::string & activation_id)
+    {
+        return update(std::map<std::string, cc7::ByteArray>(), std::vector<std::string>(1, activation_id));
+    }
+    
+    ErrorCode SessionStore::update(const std::map<std::string, cc7::ByteArray> & states, const std::vector<std::string> & removals)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_fd < 0) {
+            return EC_WrongState;
+        }
+        // Prepare new index and records, appended after the current data.
+        Index new_index = _index;
+        for (auto && id : removals) {
+            new_index.erase(id);
+        }
+        cc7::ByteArray records;
+        for (auto && item : states) {
+            if (item.first.empty() || item.second.empty()) {
+                CC7_LOG("SessionStore %p: Empty activation identifier or state.", this);
+                return EC_WrongParam;
+            }
+            RecordLocation location;
+            location.offset = _dataEnd + records.size();
+            records.append(_SerializeRecord(item.first, item.second));
+            location.size = (cc7::U32)(_dataEnd + records.size() - location.offset);
+            new_index[item.first] = location;
+        }
+        ErrorCode code = commit(new_index, records, _dataEnd);
+        if (code != EC_Ok) {
+            return code;
+        }
+        // Compact the file, if it's mostly occupied by obsolete data.
+        const size_t live_size = liveSize();
+        if (_dataEnd >= COMPACTION_MIN_SIZE && _dataEnd - live_size > live_size) {
+            if (compactFile() != EC_Ok) {
+                // The update is already committed and the failed compaction keeps the store
+                // opened, so the failure is not reported.
+                CC7_LOG("SessionStore %p: Automatic compaction failed.", this);
+            }
+        }
+        return EC_Ok;
+    }
+    
+    
+    // MARK: - Compaction -
+    
+    ErrorCode SessionStore::compact()
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        if (_fd < 0) {
+            return EC_WrongState;
+        }
+        return compactFile();
+    }
+    
+    size_t SessionStore::fileSize() const
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        return _dataEnd;
+    }
+    
+    size_t SessionStore::unusedSize() const
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        return _dataEnd > 0 ? _dataEnd - liveSize() : 0;
+    }
+    
+    
+    // MARK: - Private methods -
+    
+    size_t SessionStore::liveSize() const
+    {
+        size_t size = HEADER_AREA_SIZE + _indexSize;
+        for (auto && item : _index) {
+            size += item.second.size;
+        }
+        return size;
+    }
+    
+    ErrorCode SessionStore::openFile(const std::string & path)
+    {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+        if (fd < 0) {
+            CC7_LOG("SessionStore %p: Unable to open file. Error %d.", this, errno);
+            return EC_GeneralFailure;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return EC_GeneralFailure;
+        }
+        _fd = fd;
+        _path = path;
+        if (st.st_size == 0) {
+            // New store, write an empty index.
+            ErrorCode code = commit(Index(), cc7::ByteArray(), HEADER_AREA_SIZE);
+            if (code != EC_Ok) {
+                closeFile();
+            }
+            return code;
+        }
+        if (st.st_size < (off_t)HEADER_AREA_SIZE || !mapFile(st.st_size) || !readHeader()) {
+            CC7_LOG("SessionStore %p: File is not a valid store.", this);
+            closeFile();
+            return EC_WrongData;
+        }
+        return EC_Ok;
+    }
+    
+    void SessionStore::closeFile()
+    {
+        mapFile(0);
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+        _fd = -1;
+        _path.clear();
+        _generation = 0;
+        _activeSlot = 1;
+        _indexOffset = 0;
+        _indexSize = 0;
+        _dataEnd = 0;
+        _index.clear();
+    }
+    
+    bool SessionStore::mapFile(size_t size)
+    {
+        if (_map) {
+            munmap((void*)_map, _mapSize);
+            _map = nullptr;
+            _mapSize = 0;
+        }
+        if (size == 0) {
+            return true;
+        }
+        void * map = mmap(nullptr, size, PROT_READ, MAP_SHARED, _fd, 0);
+        if (map == MAP_FAILED) {
+            CC7_LOG("SessionStore %p: Unable to map file. Error %d.", this, errno);
+            return false;
+        }
+        _map = (const cc7::byte*)map;
+        _mapSize = size;
+        return true;
+    }
+    
+    bool SessionStore::readHeader()
+    {
+        bool found = false;
+        for (size_t slot = 0; slot < 2; slot++) {
+            const cc7::ByteRange slot_data(_map + slot * HEADER_SLOT_SIZE, HEADER_SLOT_SIZE);
+            utils::DataReader reader(slot_data);
+            cc7::ByteRange magic, index_checksum;
+            cc7::U64 generation, index_offset, data_end;
+            cc7::U32 index_size;
+            if (!reader.readMemoryRange(magic, sizeof(STORE_MAGIC)) || magic != cc7::MakeRange(STORE_MAGIC) ||
+                !reader.readU64(generation) ||
+                !reader.readU64(index_offset) ||
+                !reader.readU32(index_size) ||
+                !reader.readU64(data_end) ||
+                !reader.readMemoryRange(index_checksum, CHECKSUM_SIZE)) {
+                continue;
+            }
+            const size_t header_size = reader.currentOffset();
+            if (_Checksum(slot_data.subRangeTo(header_size)) != slot_data.subRange(header_size, CHECKSUM_SIZE)) {
+                continue;
+            }
+            if (data_end > _mapSize || index_offset < HEADER_AREA_SIZE || index_offset + index_size > data_end) {
+                continue;
+            }
+            const cc7::ByteRange index_data(_map + index_offset, index_size);
+            if (_Checksum(index_data) != index_checksum) {
+                continue;
+            }
+            if (found && generation <= _generation) {
+                continue;
+            }
+            // Parse index
+            Index index;
+            utils::DataReader index_reader(index_data);
+            size_t count;
+            bool valid = index_reader.readCount(count);
+            for (size_t i = 0; valid && i < count; i++) {
+                std::string id;
+                RecordLocation location;
+                valid = index_reader.readString(id) && index_reader.readU64(location.offset) && index_reader.readU32(location.size);
+                if (valid) {
+                    index[id] = location;
+                }
+            }
+            if (!valid) {
+                continue;
+            }
+            found = true;
+            _generation = generation;
+            _activeSlot = slot;
+            _indexOffset = index_offset;
+            _indexSize = index_size;
+            _dataEnd = data_end;
+            _index.swap(index);
+        }
+        return found;
+    }
+    
+    ErrorCode SessionStore::commit(const Index & index, const cc7::ByteArray & records, cc7::U64 records_offset)
+    {
+        // Append records and index and make sure they're stored, before the header is switched.
+        const cc7::ByteArray index_data = _SerializeIndex(index);
+        const cc7::U64 index_offset = records_offset + records.size();
+        const cc7::U64 data_end = index_offset + index_data.size();
+        cc7::ByteArray data;
+        data.reserve(records.size() + index_data.size());
+        data.append(records);
+        data.append(index_data);
+        if (!_WriteAll(_fd, data, records_offset) || !_Sync(_fd)) {
+            return EC_GeneralFailure;
+        }
+        const size_t slot = 1 - _activeSlot;
+        const cc7::ByteArray header = _SerializeHeader(_generation + 1, index_offset, index_data, data_end);
+        if (!_WriteAll(_fd, header, slot * HEADER_SLOT_SIZE) || !_Sync(_fd)) {
+            return EC_GeneralFailure;
+        }
+        // Update the state and remap the file.
+        _generation++;
+        _activeSlot = slot;
+        _indexOffset = index_offset;
+        _indexSize = (cc7::U32)index_data.size();
+        _dataEnd = data_end;
+        _index = index;
+        if (!mapFile(data_end)) {
+            return EC_GeneralFailure;
+        }
+        return EC_Ok;
+    }
+    
+    ErrorCode SessionStore::compactFile()
+    {
+        // Copy live records into a new file.
+        Index new_index;
+        cc7::ByteArray data(HEADER_AREA_SIZE, 0);
+        for (auto && item : _index) {
+            if (item.second.offset + item.second.size > _mapSize) {
+                return EC_WrongData;
+            }
+            RecordLocation location;
+            location.offset = data.size();
+            location.size = item.second.size;
+            data.append(cc7::ByteRange(_map + item.second.offset, item.second.size));
+            new_index[item.first] = location;
+        }
+        const cc7::ByteArray index_data = _SerializeIndex(new_index);
+        const cc7::U64 index_offset = data.size();
+        data.append(index_data);
+        const cc7::U64 header_generation = _generation + 1;
+        const cc7::ByteArray header = _SerializeHeader(header_generation, index_offset, index_data, data.size());
+        std::copy(header.begin(), header.end(), data.begin());
+        
+        const std::string path = _path;
+        const std::string temp_path = path + ".compact";
+        int fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0) {
+            CC7_LOG("SessionStore %p: Unable to create temporary file. Error %d.", this, errno);
+            return EC_GeneralFailure;
+        }
+        // Map the new file before the old one is replaced, so the failure keeps the store
+        // opened with the old file.
+        void * map = MAP_FAILED;
+        if (_WriteAll(fd, data, 0) && _Sync(fd)) {
+            map = mmap(nullptr, data.size(), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        if (map == MAP_FAILED || rename(temp_path.c_str(), path.c_str()) != 0) {
+            CC7_LOG("SessionStore %p: Unable to replace the store's file. Error %d.", this, errno);
+            if (map != MAP_FAILED) {
+                munmap(map, data.size());
+            }
+            ::close(fd);
+            unlink(temp_path.c_str());
+            return EC_GeneralFailure;
+        }
+        // Switch to the compacted file. Its header is in the first slot.
+        closeFile();
+        _fd = fd;
+        _path = path;
+        _map = (const cc7::byte*)map;
+        _mapSize = data.size();
+        _generation = header_generation;
+        _activeSlot = 0;
+        _indexOffset = index_offset;
+        _indexSize = (cc7::U32)index_data.size();
+        _dataEnd = data.size();
+        _index.swap(new_index);
+        // Make the rename durable. The store is already switched, because the old file is unlinked.
+        if (!_SyncDirectory(path)) {
+            return EC_GeneralFailure;
+        }
+        return EC_Ok;
+    }
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
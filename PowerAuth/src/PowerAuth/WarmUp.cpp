@@ -0,0 +1,154 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <PowerAuth/WarmUp.h>
+#include "crypto/CryptoUtils.h"
+#include "crypto/EVPCache.h"
+#include "protocol/Constants.h"
+#include <openssl/crypto.h>
+
+using namespace cc7;
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    typedef std::chrono::steady_clock _Clock;
+    
+    /**
+     Returns time elapsed since |start|.
+     */
+    static inline std::chrono::microseconds _ElapsedSince(const _Clock::time_point & start)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(_Clock::now() - start);
+    }
+    
+    /**
+     Initializes the crypto library and uses all symmetric algorithms required by the protocol once.
+     */
+    static bool _WarmUpCryptoLibrary()
+    {
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L && !defined(OPENSSL_IS_BORINGSSL)
+        OPENSSL_init_crypto(OPENSSL_INIT_LOAD_CRYPTO_STRINGS | OPENSSL_INIT_ADD_ALL_CIPHERS | OPENSSL_INIT_ADD_ALL_DIGESTS, nullptr);
+#endif
+        bool result = true;
+#if defined(PA_OPENSSL3)
+        // Fetch all algorithms cached for the process.
+        const crypto::EVPAlgorithms & algorithms = crypto::EVP_Algorithms();
+        result = algorithms.sha256 && algorithms.sha1 && algorithms.hmac && algorithms.pbkdf2 &&
+                 algorithms.aes128Cbc && algorithms.aes192Cbc && algorithms.aes256Cbc;
+#endif
+        const cc7::ByteArray key(protocol::SIGNATURE_KEY_SIZE, 0x55);
+        const cc7::ByteArray data = cc7::MakeRange("PowerAuth warm-up");
+        result = result && !crypto::SHA256(data).empty();
+        result = result && !crypto::HMAC_SHA256(data, key).empty();
+        result = result && !crypto::PBKDF2_HMAC_SHA1(data, key, 1, protocol::SIGNATURE_KEY_SIZE).empty();
+        result = result && !crypto::AES_CBC_Encrypt_Padding(key, protocol::ZERO_IV, data).empty();
+        result = result && !crypto::ECDH_KDF_X9_63_SHA256(key, data, protocol::SIGNATURE_KEY_SIZE).empty();
+        return result;
+    }
+    
+    /**
+     Constructs the elliptic curve and uses ECDSA and ECDH once.
+     */
+    static bool _WarmUpEllipticCurve()
+    {
+        EC_KEY * key = crypto::ECC_GenerateKeyPair();
+        if (!key) {
+            return false;
+        }
+        const cc7::ByteArray data = cc7::MakeRange("PowerAuth warm-up");
+        cc7::ByteArray signature;
+        bool result = crypto::ECDSA_ComputeSignature(data, key, signature);
+        result = result && crypto::ECDSA_ValidateSignature(data, signature, key);
+        result = result && !crypto::ECDH_SharedSecret(key, key).empty();
+        EC_KEY_free(key);
+        return result;
+    }
+    
+    ErrorCode WarmUp(const std::vector<std::string> & master_server_public_keys, WarmUpTimings & out_timings)
+    {
+        ErrorCode code = EC_Ok;
+        const auto start = _Clock::now();
+        
+        // PRNG
+        auto step_start = _Clock::now();
+        crypto::ReseedPRNG();
+        crypto::GetRandomData(protocol::SIGNATURE_KEY_SIZE);
+        out_timings.prngSeed = _ElapsedSince(step_start);
+        
+        // Crypto library
+        step_start = _Clock::now();
+        if (!_WarmUpCryptoLibrary()) {
+            CC7_LOG("WarmUp: Crypto library initialization failed.");
+            code = EC_Encryption;
+        }
+        out_timings.cryptoLibrary = _ElapsedSince(step_start);
+        
+        // Elliptic curve
+        step_start = _Clock::now();
+        if (!_WarmUpEllipticCurve()) {
+            CC7_LOG("WarmUp: Elliptic curve initialization failed.");
+            code = EC_Encryption;
+        }
+        out_timings.ellipticCurve = _ElapsedSince(step_start);
+        
+        // Master server public keys
+        step_start = _Clock::now();
+        crypto::BNContext ctx;
+        for (auto && master_key : master_server_public_keys) {
+            EC_KEY * key = crypto::ECC_ImportPublicKeyFromB64(nullptr, master_key, ctx);
+            if (!key) {
+                CC7_LOG("WarmUp: Invalid master server public key: %s", master_key.c_str());
+                if (code == EC_Ok) {
+                    code = EC_WrongParam;
+                }
+            }
+            EC_KEY_free(key);
+        }
+        out_timings.masterKeys = _ElapsedSince(step_start);
+        
+        out_timings.total = _ElapsedSince(start);
+        CC7_LOG("WarmUp: Finished in %lld us (PRNG %lld us, crypto %lld us, EC %lld us, master keys %lld us).",
+                (long long)out_timings.total.count(), (long long)out_timings.prngSeed.count(),
+                (long long)out_timings.cryptoLibrary.count(), (long long)out_timings.ellipticCurve.count(),
+                (long long)out_timings.masterKeys.count());
+        return code;
+    }
+    
+    void WarmUpInBackground(const std::vector<std::string> & master_server_public_keys,
+                            std::function<void(ErrorCode, const WarmUpTimings &)> completion,
+                            std::shared_ptr<Executor> executor)
+    {
+        if (!executor) {
+            executor = Executor::defaultExecutor();
+        }
+        std::vector<std::string> keys = master_server_public_keys;
+        executor->execute([keys, completion]() {
+            WarmUpTimings timings;
+            ErrorCode code = WarmUp(keys, timings);
+            if (completion) {
+                completion(code, timings);
+            }
+        });
+    }
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
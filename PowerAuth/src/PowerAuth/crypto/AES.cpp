@@ -16,6 +16,9 @@
 
 #include "AES.h"
 #include "PKCS7Padding.h"
+#include "CryptoProvider.h"
+#include "../utils/Statistics.h"
+#include "../utils/Metrics.h"
 #include <openssl/aes.h>
 
 
@@ -30,33 +33,24 @@ namespace crypto
     
     cc7::ByteArray AES_CBC_Encrypt(const cc7::ByteRange & key, const cc7::ByteRange & iv, const cc7::ByteRange & data)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_Symmetric);
+        PA_METRICS_TIMER(MH_AES);
         cc7::ByteArray out(data.size(), 0);
-        cc7::ByteArray ivec = iv;
-        AES_KEY aes_key;
-        
-        int res = AES_set_encrypt_key(key.data(), (int)key.size() * 8, &aes_key);
-        if (res == 0) {
-            AES_cbc_encrypt(data.data(), out.data(), data.size(), &aes_key, ivec.data(), AES_ENCRYPT);
-        } else {
+        if (!CryptoProvider::AES_CBC(key, iv, data, true, out.data())) {
             out.clear();
-            CC7_LOG("AES_set_encrypt_key failed");
+            CC7_LOG("AES_CBC_Encrypt failed");
         }
         return out;
     }
     
-    
     cc7::ByteArray AES_CBC_Decrypt(const cc7::ByteRange & key, const cc7::ByteRange & iv, const cc7::ByteRange & data)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_Symmetric);
+        PA_METRICS_TIMER(MH_AES);
         cc7::ByteArray out(data.size(), 0);
-        cc7::ByteArray ivec(iv);
-        AES_KEY aes_key;
-        
-        int res = AES_set_decrypt_key(key.data(), (int)key.size() * 8, &aes_key);
-        if (res == 0) {
-            AES_cbc_encrypt(data.data(), out.data(), data.size(), &aes_key, ivec.data(), AES_DECRYPT);
-        } else {
+        if (!CryptoProvider::AES_CBC(key, iv, data, false, out.data())) {
             out.clear();
-            CC7_LOG("AES_set_decrypt_key failed");
+            CC7_LOG("AES_CBC_Decrypt failed");
         }
         return out;
     }
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "BNContext.h"
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace crypto
+{
+    /**
+     The ThreadBNContext structure owns BN_CTX reused on one thread.
+     */
+    struct ThreadBNContext
+    {
+        BN_CTX * ctx;
+        
+        ThreadBNContext() :
+            ctx(BN_CTX_new())
+        {
+        }
+        
+        ~ThreadBNContext()
+        {
+            // BN_CTX_free() also clears all BIGNUMs kept in the context.
+            BN_CTX_free(ctx);
+        }
+    };
+    
+    BN_CTX * BNContext::threadContext()
+    {
+        static thread_local ThreadBNContext s_context;
+        return s_context.ctx;
+    }
+    
+} // com::wultra::powerAuth::crypto
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
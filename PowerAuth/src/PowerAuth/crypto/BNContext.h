@@ -34,9 +34,15 @@ namespace crypto
 {   
     /**
      BNContext is a helper class for managing BN_CTX structure.
-     If you do not provide context then the helper will create
-     new one internally. The internally created context is
-     automatically destroyed with the BNContext object.
+     If you do not provide context then the helper uses a context
+     reused by all BNContext objects created on the current thread,
+     so no context is allocated in the typical case.
+     
+     The helper always starts a new BN_CTX frame in its constructor
+     and ends it in its destructor. All BIGNUMs acquired with BN_CTX_get()
+     are therefore returned back to the context, once the helper is
+     destroyed. The helper objects must be destroyed in the reverse
+     order of their construction, which is guaranteed for local variables.
      
      The class implements casting operator to BN_CTX and
      therefore can be easily used as a parameter to
@@ -45,20 +51,17 @@ namespace crypto
     class BNContext
     {
     public:
-        BNContext(BN_CTX * ctx = nullptr)
+        BNContext(BN_CTX * ctx = nullptr) :
+            _ctx(ctx != nullptr ? ctx : threadContext())
         {
-            if (ctx == nullptr) {
-                _ctx = BN_CTX_new();
-                _delete_ctx = true;
-            } else {
-                _ctx = ctx;
-                _delete_ctx = false;
+            if (_ctx) {
+                BN_CTX_start(_ctx);
             }
         }
         ~BNContext()
         {
-            if (_delete_ctx && _ctx) {
-                BN_CTX_free(_ctx);
+            if (_ctx) {
+                BN_CTX_end(_ctx);
             }
         }
         
@@ -67,9 +70,18 @@ namespace crypto
         // Cast BNContext to BN_CTX pointer
         operator BN_CTX * () const  { return _ctx; }
         
+        /**
+         Returns BN_CTX reused on the current thread. The context is created
+         on the first use and is released when the thread exits. Returns nullptr
+         only if the context allocation failed.
+         */
+        static BN_CTX * threadContext();
+        
     private:
         BN_CTX * _ctx;
-        bool     _delete_ctx;
+        
+        BNContext(const BNContext &) = delete;
+        BNContext & operator=(const BNContext &) = delete;
     };
     
 } // com::wultra::powerAuth::crypto
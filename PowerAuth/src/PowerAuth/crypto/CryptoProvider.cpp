@@ -0,0 +1,325 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "CryptoProvider.h"
+#include "SHA256Engine.h"
+#include <openssl/aes.h>
+#include <openssl/sha.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/ecdsa.h>
+#include <openssl/ecdh.h>
+#include <openssl/err.h>
+#include <openssl/crypto.h>
+
+#if defined(PA_CRYPTO_BACKEND_OPENSSL3)
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace crypto
+{
+    // -------------------------------------------------------------------------------------------
+    // MARK: - Common implementation -
+    //
+    
+    bool OpenSSLCommonProvider::AES_CBC(const cc7::ByteRange & key, const cc7::ByteRange & iv, const cc7::ByteRange & data, bool encrypt, cc7::byte * out)
+    {
+        if (iv.size() != AES_BLOCK_SIZE) {
+            return false;
+        }
+        cc7::byte ivec[AES_BLOCK_SIZE];
+        memcpy(ivec, iv.data(), AES_BLOCK_SIZE);
+        AES_KEY aes_key;
+        int res = encrypt
+                ? AES_set_encrypt_key(key.data(), (int)key.size() * 8, &aes_key)
+                : AES_set_decrypt_key(key.data(), (int)key.size() * 8, &aes_key);
+        if (res == 0) {
+            AES_cbc_encrypt(data.data(), out, data.size(), &aes_key, ivec, encrypt ? AES_ENCRYPT : AES_DECRYPT);
+        }
+        OPENSSL_cleanse(&aes_key, sizeof(aes_key));
+        return res == 0;
+    }
+    
+    bool OpenSSLCommonProvider::HMAC_SHA256(const cc7::ByteRange & key, const cc7::ByteRange & data, cc7::byte * out)
+    {
+        // Empty key must not be null, because OpenSSL 3 rejects null key in HMAC().
+        static const unsigned char s_empty_key = 0;
+        const unsigned char * key_ptr = key.empty() ? &s_empty_key : key.data();
+        
+        unsigned int digest_length = SHA256_DIGEST_LENGTH;
+        const unsigned char * result = HMAC(EVP_sha256(), key_ptr, (int)key.size(), data.data(), (int)data.size(), out, &digest_length);
+        return (result != NULL) && (digest_length == SHA256_DIGEST_LENGTH);
+    }
+    
+    bool OpenSSLCommonProvider::PBKDF2_HMAC(const EVP_MD * md, const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, cc7::byte * out, size_t out_size)
+    {
+        return 1 == PKCS5_PBKDF2_HMAC((const char*)pass.data(), (int)pass.size(), salt.data(), (int)salt.size(), (int)iterations, md, (int)out_size, out);
+    }
+    
+    OpenSSLCommonProvider::KeyedHMAC::KeyedHMAC(const EVP_MD * md, const cc7::ByteRange & key) :
+        _inner(EVP_MD_CTX_new()),
+        _outer(EVP_MD_CTX_new()),
+        _work(EVP_MD_CTX_new()),
+        _size(EVP_MD_size(md)),
+        _valid(false)
+    {
+        const size_t block_size = EVP_MD_block_size(md);
+        if (!_inner || !_outer || !_work || block_size > MAX_BLOCK_SIZE) {
+            return;
+        }
+        cc7::byte pad[MAX_BLOCK_SIZE];
+        memset(pad, 0, sizeof(pad));
+        bool result = true;
+        if (key.size() > block_size) {
+            // Long key is replaced with its digest.
+            unsigned int digest_size = 0;
+            result = 1 == EVP_Digest(key.data(), key.size(), pad, &digest_size, md, nullptr);
+        } else if (!key.empty()) {
+            memcpy(pad, key.data(), key.size());
+        }
+        // K ^ ipad
+        for (size_t i = 0; i < block_size; i++) {
+            pad[i] ^= 0x36;
+        }
+        result = result &&
+                 1 == EVP_DigestInit_ex(_inner, md, nullptr) &&
+                 1 == EVP_DigestUpdate(_inner, pad, block_size);
+        // K ^ opad
+        for (size_t i = 0; i < block_size; i++) {
+            pad[i] ^= 0x36 ^ 0x5c;
+        }
+        result = result &&
+                 1 == EVP_DigestInit_ex(_outer, md, nullptr) &&
+                 1 == EVP_DigestUpdate(_outer, pad, block_size);
+        OPENSSL_cleanse(pad, sizeof(pad));
+        _valid = result;
+    }
+    
+    OpenSSLCommonProvider::KeyedHMAC::~KeyedHMAC()
+    {
+        // EVP_MD_CTX_free() also wipes the keyed states.
+        EVP_MD_CTX_free(_work);
+        EVP_MD_CTX_free(_outer);
+        EVP_MD_CTX_free(_inner);
+    }
+    
+    bool OpenSSLCommonProvider::KeyedHMAC::calculate(const cc7::ByteRange & data1, const cc7::ByteRange & data2, cc7::byte * out)
+    {
+        unsigned int out_size = 0;
+        return _valid &&
+               1 == EVP_MD_CTX_copy_ex(_work, _inner) &&
+               1 == EVP_DigestUpdate(_work, data1.data(), data1.size()) &&
+               1 == EVP_DigestUpdate(_work, data2.data(), data2.size()) &&
+               1 == EVP_DigestFinal_ex(_work, out, &out_size) &&
+               1 == EVP_MD_CTX_copy_ex(_work, _outer) &&
+               1 == EVP_DigestUpdate(_work, out, _size) &&
+               1 == EVP_DigestFinal_ex(_work, out, &out_size);
+    }
+    
+    bool OpenSSLCommonProvider::RandomBytes(cc7::byte * out, size_t size)
+    {
+        return 1 == RAND_bytes(out, (int)size);
+    }
+    
+    void OpenSSLCommonProvider::SeedRandom(const cc7::ByteRange & seed)
+    {
+        RAND_seed(seed.data(), (int)seed.size());
+    }
+    
+    bool OpenSSLCommonProvider::ECDSA_Sign(const cc7::ByteRange & digest, EC_KEY * private_key, cc7::ByteArray & signature)
+    {
+        int expected_size = ECDSA_size(private_key);
+        if (expected_size <= 0) {
+            return false;
+        }
+        signature.resize(expected_size);
+        unsigned int signature_size = expected_size;
+        int result = ECDSA_sign(0,
+                                digest.data(), (int)digest.size(),
+                                signature.data(), &signature_size,
+                                private_key);
+        if (result != 1) {
+            return false;
+        }
+        signature.resize(signature_size);
+        return true;
+    }
+    
+    bool OpenSSLCommonProvider::ECDSA_Verify(const cc7::ByteRange & digest, const cc7::ByteRange & signature, EC_KEY * public_key)
+    {
+        int result = ECDSA_verify(0,
+                                  digest.data(),    (int)digest.size(),
+                                  signature.data(), (int)signature.size(),
+                                  public_key);
+        return result == 1;
+    }
+    
+    bool OpenSSLCommonProvider::ECDH(EC_KEY * public_key, EC_KEY * private_key, cc7::byte * out, size_t out_size)
+    {
+        const EC_POINT * pub_point = EC_KEY_get0_public_key(public_key);
+        if (!pub_point) {
+            // You have provided key without public point
+            return false;
+        }
+        int returned_size = ECDH_compute_key(out, out_size, pub_point, private_key, nullptr);
+        if (returned_size < 0 || (out_size != (size_t)returned_size)) {
+#ifdef DEBUG
+            ERR_print_errors_fp(stderr);
+#endif
+            return false;
+        }
+        return true;
+    }
+    
+#if defined(PA_CRYPTO_BACKEND_OPENSSL11)
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - OpenSSL 1.1 -
+    //
+    
+    /**
+     Cipher context reused on the current thread, released when the thread exits.
+     */
+    struct _ThreadCipherContext
+    {
+        EVP_CIPHER_CTX * ctx = EVP_CIPHER_CTX_new();
+        ~_ThreadCipherContext() { EVP_CIPHER_CTX_free(ctx); }
+    };
+    
+    static const EVP_CIPHER * _AES_CBC_Cipher(size_t key_size)
+    {
+        switch (key_size) {
+            case 16: return EVP_aes_128_cbc();
+            case 24: return EVP_aes_192_cbc();
+            case 32: return EVP_aes_256_cbc();
+            default: return nullptr;
+        }
+    }
+    
+    bool OpenSSL11Provider::AES_CBC(const cc7::ByteRange & key, const cc7::ByteRange & iv, const cc7::ByteRange & data, bool encrypt, cc7::byte * out)
+    {
+        static thread_local _ThreadCipherContext s_cipher;
+        EVP_CIPHER_CTX * ctx = s_cipher.ctx;
+        const EVP_CIPHER * cipher = _AES_CBC_Cipher(key.size());
+        int update_length = 0;
+        int final_length = 0;
+        bool result = ctx != nullptr && cipher != nullptr && iv.size() == AES_BLOCK_SIZE &&
+                      1 == EVP_CipherInit_ex(ctx, cipher, nullptr, key.data(), iv.data(), encrypt ? 1 : 0) &&
+                      1 == EVP_CIPHER_CTX_set_padding(ctx, 0) &&
+                      1 == EVP_CipherUpdate(ctx, out, &update_length, data.data(), (int)data.size()) &&
+                      1 == EVP_CipherFinal_ex(ctx, out + update_length, &final_length) &&
+                      (size_t)(update_length + final_length) == data.size();
+        if (ctx) {
+            // Wipe the key schedule.
+            EVP_CIPHER_CTX_reset(ctx);
+        }
+        return result;
+    }
+    
+#endif // PA_CRYPTO_BACKEND_OPENSSL11
+    
+#if defined(PA_CRYPTO_BACKEND_OPENSSL3)
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - OpenSSL 3 -
+    //
+    
+    bool OpenSSL3Provider::AES_CBC(const cc7::ByteRange & key, const cc7::ByteRange & iv, const cc7::ByteRange & data, bool encrypt, cc7::byte * out)
+    {
+        EVP_CIPHER_CTX * ctx = EVP_ThreadContexts().cipher;
+        const EVP_CIPHER * cipher = EVP_AES_CBC_Cipher(key.size());
+        int update_length = 0;
+        int final_length = 0;
+        bool result = ctx != nullptr && cipher != nullptr && iv.size() == AES_BLOCK_SIZE &&
+                      1 == EVP_CipherInit_ex2(ctx, cipher, key.data(), iv.data(), encrypt ? 1 : 0, nullptr) &&
+                      1 == EVP_CIPHER_CTX_set_padding(ctx, 0) &&
+                      1 == EVP_CipherUpdate(ctx, out, &update_length, data.data(), (int)data.size()) &&
+                      1 == EVP_CipherFinal_ex(ctx, out + update_length, &final_length) &&
+                      (size_t)(update_length + final_length) == data.size();
+        if (ctx) {
+            // Wipe the key schedule.
+            EVP_CIPHER_CTX_reset(ctx);
+        }
+        return result;
+    }
+    
+    bool OpenSSL3Provider::HMAC_SHA256(const cc7::ByteRange & key, const cc7::ByteRange & data, cc7::byte * out)
+    {
+        // Empty, but not null key must be used, because null key means
+        // that the key from the previous initialization is reused.
+        static const unsigned char s_empty_key = 0;
+        const unsigned char * key_ptr = key.empty() ? &s_empty_key : key.data();
+        
+        EVP_MAC_CTX * ctx = EVP_ThreadContexts().hmac;
+        if (!ctx) {
+            return false;
+        }
+        size_t digest_length = 0;
+        bool result = 1 == EVP_MAC_init(ctx, key_ptr, key.size(), nullptr) &&
+                      1 == EVP_MAC_update(ctx, data.data(), data.size()) &&
+                      1 == EVP_MAC_final(ctx, out, &digest_length, SHA256_DIGEST_LENGTH) &&
+                      digest_length == SHA256_DIGEST_LENGTH;
+        // Replace the key in the reused context.
+        EVP_MAC_init(ctx, &s_empty_key, 0, nullptr);
+        return result;
+    }
+    
+    bool OpenSSL3Provider::PBKDF2_HMAC(const EVP_MD * md, const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, cc7::byte * out, size_t out_size)
+    {
+        // Use already fetched KDF. The PKCS5 mode disables SP 800-132 limits, just like in PKCS5_PBKDF2_HMAC.
+        EVP_KDF_CTX * ctx = EVP_KDF_CTX_new(EVP_Algorithms().pbkdf2);
+        int pkcs5_mode = 1;
+        uint64_t iter = iterations;
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PASSWORD, (void*)pass.data(), pass.size()),
+            OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT, (void*)salt.data(), salt.size()),
+            OSSL_PARAM_construct_uint64(OSSL_KDF_PARAM_ITER, &iter),
+            OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST, (char*)EVP_MD_get0_name(md), 0),
+            OSSL_PARAM_construct_int(OSSL_KDF_PARAM_PKCS5, &pkcs5_mode),
+            OSSL_PARAM_construct_end()
+        };
+        bool success = ctx != nullptr && 1 == EVP_KDF_derive(ctx, out, out_size, params);
+        EVP_KDF_CTX_free(ctx);
+        return success;
+    }
+    
+#endif // PA_CRYPTO_BACKEND_OPENSSL3
+    
+#if defined(PA_CRYPTO_BACKEND_BORINGSSL)
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - BoringSSL -
+    //
+    
+    void BoringSSLProvider::SeedRandom(const cc7::ByteRange & seed)
+    {
+        // BoringSSL ignores the additional seed.
+    }
+    
+#endif // PA_CRYPTO_BACKEND_BORINGSSL
+    
+} // com::wultra::powerAuth::crypto
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -0,0 +1,222 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cc7/ByteArray.h>
+#include "EVPCache.h"
+#include <openssl/ec.h>
+
+/*
+ The crypto provider is a set of static functions implementing the primitive operations
+ on top of a particular crypto library. The functions in AES.h, MAC.h, KDF.h, PRNG.h and
+ ECC.h are thin wrappers, calling the provider selected at compile time, so there's
+ no dynamic dispatch involved.
+ 
+ The backend is selected with one of the following macros:
+ 
+  - PA_CRYPTO_BACKEND_OPENSSL3   - OpenSSL 3.x, with algorithms fetched once per process
+  - PA_CRYPTO_BACKEND_OPENSSL11  - OpenSSL 1.1 API. Can be used also with OpenSSL 3.x headers,
+                                   to compare both backends on the same build of the library.
+  - PA_CRYPTO_BACKEND_BORINGSSL  - BoringSSL
+ 
+ If no macro is defined, then the backend is derived from the headers of the crypto library.
+ 
+ SHA-256 and ANSI X9.63 KDF are implemented in SHA256Engine.h, so they're the same
+ for all backends. The EC key management is also shared, because all supported
+ libraries provide the same EC_KEY interface.
+ */
+
+#if !defined(PA_CRYPTO_BACKEND_OPENSSL3) && !defined(PA_CRYPTO_BACKEND_OPENSSL11) && !defined(PA_CRYPTO_BACKEND_BORINGSSL)
+    #if defined(OPENSSL_IS_BORINGSSL)
+        #define PA_CRYPTO_BACKEND_BORINGSSL
+    #elif defined(PA_OPENSSL3)
+        #define PA_CRYPTO_BACKEND_OPENSSL3
+    #else
+        #define PA_CRYPTO_BACKEND_OPENSSL11
+    #endif
+#endif
+
+#if (defined(PA_CRYPTO_BACKEND_OPENSSL3) + defined(PA_CRYPTO_BACKEND_OPENSSL11) + defined(PA_CRYPTO_BACKEND_BORINGSSL)) != 1
+    #error Only one crypto backend can be selected.
+#endif
+#if defined(PA_CRYPTO_BACKEND_OPENSSL3) && !defined(PA_OPENSSL3)
+    #error PA_CRYPTO_BACKEND_OPENSSL3 requires OpenSSL 3.x headers.
+#endif
+#if defined(PA_CRYPTO_BACKEND_BORINGSSL) && !defined(OPENSSL_IS_BORINGSSL)
+    #error PA_CRYPTO_BACKEND_BORINGSSL requires BoringSSL headers.
+#endif
+#if defined(PA_CRYPTO_BACKEND_OPENSSL11) && defined(OPENSSL_IS_BORINGSSL)
+    #error PA_CRYPTO_BACKEND_OPENSSL11 cannot be used with BoringSSL headers.
+#endif
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace crypto
+{
+    /**
+     The OpenSSLCommonProvider implements all operations with using API available
+     in OpenSSL 1.1, OpenSSL 3.x and BoringSSL. Other providers derive from this
+     structure and hide functions they implement in a better way.
+     */
+    struct OpenSSLCommonProvider
+    {
+        /**
+         Encrypts (if |encrypt| is true) or decrypts |data| with AES in CBC mode, without padding,
+         into |out| buffer, which must be at least `data.size()` bytes long. The size of data must
+         be aligned to the AES block size. Returns false on failure.
+         */
+        static bool AES_CBC(const cc7::ByteRange & key, const cc7::ByteRange & iv, const cc7::ByteRange & data, bool encrypt, cc7::byte * out);
+        
+        /**
+         Calculates HMAC-SHA256 for |data| and |key| into |out| buffer, which must be
+         at least 32 bytes long. Returns false on failure.
+         */
+        static bool HMAC_SHA256(const cc7::ByteRange & key, const cc7::ByteRange & data, cc7::byte * out);
+        
+        /**
+         Derives |out_size| bytes into |out| buffer with PBKDF2, using HMAC with |md| digest.
+         Returns false on failure.
+         */
+        static bool PBKDF2_HMAC(const EVP_MD * md, const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, cc7::byte * out, size_t out_size);
+        
+        /**
+         The KeyedHMAC class calculates HMAC with |md| digest and the key processed only once,
+         in the constructor. The inner and outer digest states are prepared from the padded key
+         and each calculation starts from their copies, so one HMAC costs only two digest
+         finalizations. The class is used for PBKDF2 calculated iteration by iteration.
+         */
+        class KeyedHMAC
+        {
+        public:
+            KeyedHMAC(const EVP_MD * md, const cc7::ByteRange & key);
+            ~KeyedHMAC();
+            
+            /**
+             Returns size of HMAC result in bytes.
+             */
+            size_t size() const
+            {
+                return _size;
+            }
+            
+            /**
+             Calculates HMAC for |data1| concatenated with |data2| into |out| buffer,
+             which must be at least `size()` bytes long. Returns false on failure.
+             */
+            bool calculate(const cc7::ByteRange & data1, const cc7::ByteRange & data2, cc7::byte * out);
+            
+        private:
+            /**
+             The largest block size of supported digests (SHA-512).
+             */
+            static const size_t MAX_BLOCK_SIZE = 128;
+            
+            EVP_MD_CTX * _inner;
+            EVP_MD_CTX * _outer;
+            EVP_MD_CTX * _work;
+            size_t _size;
+            bool _valid;
+            
+            KeyedHMAC(const KeyedHMAC &) = delete;
+            KeyedHMAC & operator=(const KeyedHMAC &) = delete;
+        };
+        
+        /**
+         Fills |out| buffer with |size| random bytes. Returns false on failure.
+         */
+        static bool RandomBytes(cc7::byte * out, size_t size);
+        
+        /**
+         Adds |seed| to the state of PRNG.
+         */
+        static void SeedRandom(const cc7::ByteRange & seed);
+        
+        /**
+         Computes DER encoded ECDSA signature for already calculated |digest|.
+         Returns false on failure.
+         */
+        static bool ECDSA_Sign(const cc7::ByteRange & digest, EC_KEY * private_key, cc7::ByteArray & signature);
+        
+        /**
+         Validates DER encoded ECDSA |signature| for already calculated |digest|.
+         */
+        static bool ECDSA_Verify(const cc7::ByteRange & digest, const cc7::ByteRange & signature, EC_KEY * public_key);
+        
+        /**
+         Calculates ECDH shared secret into |out| buffer, which must be exactly |out_size|
+         bytes long. Returns false on failure.
+         */
+        static bool ECDH(EC_KEY * public_key, EC_KEY * private_key, cc7::byte * out, size_t out_size);
+    };
+    
+#if defined(PA_CRYPTO_BACKEND_OPENSSL11)
+    /**
+     The OpenSSL11Provider uses EVP cipher context reused on each thread for AES, because
+     unlike the low level AES functions, EVP ciphers use the hardware acceleration.
+     */
+    struct OpenSSL11Provider : public OpenSSLCommonProvider
+    {
+        static const char * name() { return "OpenSSL 1.1"; }
+        
+        static bool AES_CBC(const cc7::ByteRange & key, const cc7::ByteRange & iv, const cc7::ByteRange & data, bool encrypt, cc7::byte * out);
+    };
+    
+    typedef OpenSSL11Provider CryptoProvider;
+#endif
+    
+#if defined(PA_CRYPTO_BACKEND_OPENSSL3)
+    /**
+     The OpenSSL3Provider uses algorithms fetched once per process and EVP
+     contexts reused on each thread. See EVPCache.h for details.
+     */
+    struct OpenSSL3Provider : public OpenSSLCommonProvider
+    {
+        static const char * name() { return "OpenSSL 3"; }
+        
+        static bool AES_CBC(const cc7::ByteRange & key, const cc7::ByteRange & iv, const cc7::ByteRange & data, bool encrypt, cc7::byte * out);
+        static bool HMAC_SHA256(const cc7::ByteRange & key, const cc7::ByteRange & data, cc7::byte * out);
+        static bool PBKDF2_HMAC(const EVP_MD * md, const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, cc7::byte * out, size_t out_size);
+    };
+    
+    typedef OpenSSL3Provider CryptoProvider;
+#endif
+    
+#if defined(PA_CRYPTO_BACKEND_BORINGSSL)
+    /**
+     The BoringSSLProvider uses the common implementation, because BoringSSL's low level
+     AES and HMAC functions are already hardware accelerated. Only the PRNG seeding is
+     skipped, because BoringSSL always uses the system entropy source.
+     */
+    struct BoringSSLProvider : public OpenSSLCommonProvider
+    {
+        static const char * name() { return "BoringSSL"; }
+        
+        static void SeedRandom(const cc7::ByteRange & seed);
+    };
+    
+    typedef BoringSSLProvider CryptoProvider;
+#endif
+    
+} // com::wultra::powerAuth::crypto
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -29,5 +29,7 @@
 #include "PRNG.h"
 #include "ECC.h"
 #include "Hash.h"
+#include "SHA256Engine.h"
+#include "SHA256MultiBuffer.h"
 #include "KDF.h"
 #include "MAC.h"
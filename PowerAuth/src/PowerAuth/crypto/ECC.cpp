@@ -16,12 +16,11 @@
 
 #include "CryptoUtils.h"
 
-#include <openssl/evp.h>
-#include <openssl/ecdsa.h>
-#include <openssl/ecdh.h>
-#include <openssl/err.h>
+#include "CryptoProvider.h"
 
-#include <cc7/Base64.h>
+#include "../utils/Base64.h"
+#include "../utils/Statistics.h"
+#include "../utils/Metrics.h"
 
 namespace com
 {
@@ -39,6 +38,7 @@ namespace crypto
     
     EC_KEY * ECC_ImportPublicKey(EC_KEY * key, const cc7::ByteRange & publicKey, BN_CTX * c)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_ECC);
         bool result = false;
         
         BNContext ctx(c);
@@ -77,7 +77,7 @@ namespace crypto
     
     EC_KEY * ECC_ImportPublicKeyFromB64(EC_KEY * key, const std::string & publicKey, BN_CTX * c)
     {
-        cc7::ByteArray keyData = cc7::FromBase64String(publicKey);
+        cc7::ByteArray keyData = utils::FromBase64String(publicKey);
         if (keyData.empty()) {
             if (key) {
                 // we don't care if key was created outside.
@@ -91,36 +91,93 @@ namespace crypto
     }
     
     
-    cc7::ByteArray ECC_ExportPublicKey(EC_KEY * key, BN_CTX * c)
+    EC_KEY * ECC_ImportValidatedPublicKey(EC_KEY * key, const cc7::ByteRange & publicKey, BN_CTX * c)
+    {
+        utils::ScopedStatisticsTimer timer(utils::ST_ECC);
+        bool result = false;
+        
+        BNContext ctx(c);
+        
+        if (!key) {
+            // Create a new key if key object is null.
+            key = EC_KEY_new_by_curve_name(ECC_CURVE);
+        }
+        const EC_GROUP * group = key ? EC_KEY_get0_group(key) : nullptr;
+        EC_POINT *       point = key ? EC_POINT_new(group)    : nullptr;
+        
+        // Uncompressed point is encoded as 0x04 || X || Y
+        const size_t coord_size = group ? (EC_GROUP_get_degree(group) + 7) / 8 : 0;
+        if (point && publicKey.size() == 1 + 2 * coord_size && publicKey[0] == POINT_CONVERSION_UNCOMPRESSED) {
+            BIGNUM * x = BN_CTX_get(ctx);
+            BIGNUM * y = BN_CTX_get(ctx);
+            if (x && y &&
+                BN_bin2bn(publicKey.data() + 1, (int)coord_size, x) &&
+                BN_bin2bn(publicKey.data() + 1 + coord_size, (int)coord_size, y)) {
+                // Setting coordinates still checks whether the point is on the curve, but unlike
+                // EC_KEY_check_key(), doesn't multiply the point by the group order.
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L || defined(OPENSSL_IS_BORINGSSL)
+                result = (1 == EC_POINT_set_affine_coordinates(group, point, x, y, ctx));
+#else
+                result = (1 == EC_POINT_set_affine_coordinates_GFp(group, point, x, y, ctx));
+#endif
+                result = result && (1 == EC_KEY_set_public_key(key, point));
+            }
+        }
+        
+        if (point) {
+            EC_POINT_free(point);
+        }
+        if (!result) {
+            if (key) {
+                EC_KEY_free(key);
+                key = nullptr;
+            }
+        }
+        return key;
+    }
+    
+    
+    static cc7::ByteArray _ExportPublicKey(EC_KEY * key, point_conversion_form_t form, BN_CTX * c)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_ECC);
         BNContext ctx(c);
         if (!key) {
             return cc7::ByteArray();
         }
         const EC_POINT * publicKey = EC_KEY_get0_public_key(key);
-        size_t expected_len = EC_POINT_point2oct(EC_KEY_get0_group(key), publicKey, POINT_CONVERSION_COMPRESSED, nullptr, 0, ctx);
+        size_t expected_len = EC_POINT_point2oct(EC_KEY_get0_group(key), publicKey, form, nullptr, 0, ctx);
         if (expected_len == 0) {
             return cc7::ByteArray();
         }
         cc7::ByteArray out(expected_len, 0);
-        size_t written_len  = EC_POINT_point2oct(EC_KEY_get0_group(key), publicKey, POINT_CONVERSION_COMPRESSED, out.data(), out.size(), ctx);
+        size_t written_len  = EC_POINT_point2oct(EC_KEY_get0_group(key), publicKey, form, out.data(), out.size(), ctx);
         if (expected_len != written_len) {
             out.clear();
         }
         return out;
-        
+    }
+    
+    cc7::ByteArray ECC_ExportPublicKey(EC_KEY * key, BN_CTX * c)
+    {
+        return _ExportPublicKey(key, POINT_CONVERSION_COMPRESSED, c);
+    }
+    
+    cc7::ByteArray ECC_ExportPublicKeyUncompressed(EC_KEY * key, BN_CTX * c)
+    {
+        return _ExportPublicKey(key, POINT_CONVERSION_UNCOMPRESSED, c);
     }
     
     
     std::string ECC_ExportPublicKeyToB64(EC_KEY * key, BN_CTX * c)
     {
         auto keyData = ECC_ExportPublicKey(key, c);
-        return cc7::ToBase64String(keyData);
+        return utils::ToBase64String(keyData);
     }
     
     
     cc7::ByteArray ECC_ExportPublicKeyToNormalizedForm(EC_KEY * key, BN_CTX * c)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_ECC);
         cc7::ByteArray out;
         do {
             if (!key) {
@@ -151,6 +208,7 @@ namespace crypto
     
     EC_KEY * ECC_ImportPrivateKey(EC_KEY * key, const cc7::ByteRange & privateKeyData, BN_CTX * c)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_ECC);
         bool result = false;
         BNContext ctx(c);
         if (!key) {
@@ -160,6 +218,10 @@ namespace crypto
         if (s && nullptr != BN_bin2bn(privateKeyData.data(), (int)privateKeyData.size(), s)) {
             result = (1 == EC_KEY_set_private_key(key, s));
         }
+        if (s) {
+            // The key makes its own copy, so don't leave the secret in the reused context.
+            BN_clear(s);
+        }
         if (!result) {
             EC_KEY_free(key);
             key = nullptr;
@@ -179,6 +241,8 @@ namespace crypto
     
     EC_KEY * ECC_GenerateKeyPair()
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_ECC);
+        PA_METRICS_TIMER(MH_ECC_KeyGen);
         EC_KEY * key = EC_KEY_new_by_curve_name(ECC_CURVE);
         if (key) {
             if (1 != EC_KEY_generate_key(key)) {
@@ -195,6 +259,8 @@ namespace crypto
     
     bool ECDSA_ValidateSignature(const cc7::ByteRange & signedData, const cc7::ByteRange & signature, EC_KEY * publicKey)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_ECC);
+        PA_METRICS_TIMER(MH_ECDSA_Verify);
         if (!publicKey) {
             CC7_ASSERT(false, "Missing public key");
             return false;
@@ -203,15 +269,13 @@ namespace crypto
         if (signedDataHash.size() == 0) {
             return false;
         }
-        int result = ECDSA_verify(0,
-                                  signedDataHash.data(), (int)signedDataHash.size(),
-                                  signature.data(),      (int)signature.size(),
-                                  publicKey);
-        return result == 1;
+        return CryptoProvider::ECDSA_Verify(signedDataHash, signature, publicKey);
     }
     
     bool ECDSA_ComputeSignature(const cc7::ByteRange & data, EC_KEY * privateKey, cc7::ByteArray & signature)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_ECC);
+        PA_METRICS_TIMER(MH_ECDSA_Sign);
         if (!privateKey) {
             CC7_ASSERT(false, "Missing private key");
             return false;
@@ -220,21 +284,7 @@ namespace crypto
         if (dataHash.size() == 0) {
             return false;
         }
-        int expectedSize = ECDSA_size(privateKey);
-        if (expectedSize <= 0) {
-            return false;
-        }
-        signature.resize(expectedSize);
-        unsigned int signatureSize = expectedSize;
-        int result = ECDSA_sign(0,
-                                dataHash.data(), (int)dataHash.size(),
-                                signature.data(), &signatureSize,
-                                privateKey);
-        if (result != 1) {
-            return false;
-        }
-        signature.resize(signatureSize);
-        return true;
+        return CryptoProvider::ECDSA_Sign(dataHash, privateKey, signature);
     }
     
     // -------------------------------------------------------------------------------------------
@@ -243,14 +293,11 @@ namespace crypto
     
     cc7::ByteArray ECDH_SharedSecret(EC_KEY * pubKey, EC_KEY * priKey)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_ECC);
+        PA_METRICS_TIMER(MH_ECDH);
         if (!pubKey || !priKey) {
             return cc7::ByteArray();
         }
-        const EC_POINT * pubPoint =  EC_KEY_get0_public_key(pubKey);
-        if (!pubPoint) {
-            // You have provided key without public point
-            return cc7::ByteArray();
-        }
         // Calculate an expected size for shared secret.
         //  (check https://wiki.openssl.org/index.php/Elliptic_Curve_Diffie_Hellman for details)
         
@@ -258,11 +305,7 @@ namespace crypto
         size_t expectedSize = (EC_GROUP_get_degree(group) + 7) / 8;
         
         cc7::ByteArray secret(expectedSize, 0);
-        int returnedSize = ECDH_compute_key(secret.data(), secret.size(), pubPoint, priKey, nullptr);
-        if (returnedSize < 0 || (expectedSize != (size_t)returnedSize)) {
-#ifdef DEBUG
-            ERR_print_errors_fp(stderr);
-#endif
+        if (!CryptoProvider::ECDH(pubKey, priKey, secret.data(), secret.size())) {
             return cc7::ByteArray();
         }
         return secret;
@@ -49,6 +49,15 @@ namespace crypto
      If key parameter is not null and import fails then deletes key automatically.
      */
     EC_KEY *        ECC_ImportPublicKeyFromB64(EC_KEY * key, const std::string & publicKey, BN_CTX * c = nullptr);
+    /**
+     Creates a new EC_KEY structure from public key in uncompressed form, previously exported
+     with `ECC_ExportPublicKeyUncompressed()` from already validated key. The function only sets
+     the affine coordinates of the point and skips the expensive key validation, so use it only
+     for data from a trusted storage.
+     If key parameter is null then creates a new key.
+     If key parameter is not null and import fails then deletes key automatically.
+     */
+    EC_KEY *        ECC_ImportValidatedPublicKey(EC_KEY * key, const cc7::ByteRange & publicKey, BN_CTX * c = nullptr);
     /**
      Exports public key into compressed format.
      */
@@ -57,6 +66,10 @@ namespace crypto
      Exports public key into compressed format, encoded into B64 string.
      */
     std::string     ECC_ExportPublicKeyToB64(EC_KEY * key, BN_CTX * c = nullptr);
+    /**
+     Exports public key into uncompressed format.
+     */
+    cc7::ByteArray  ECC_ExportPublicKeyUncompressed(EC_KEY * key, BN_CTX * c = nullptr);
     /**
      Exports public key into normalized form, suitable for decimalization.
      This is equivalent operation to Java's: eccPublicKey.getW().getAffineX().toByteArray();
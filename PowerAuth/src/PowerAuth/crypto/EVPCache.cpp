@@ -0,0 +1,134 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "EVPCache.h"
+
+#if defined(PA_OPENSSL3)
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace crypto
+{
+#if defined(PA_OPENSSL3)
+    
+    // MARK: - OpenSSL 3 -
+    
+    /**
+     Fetches all algorithms from the default provider.
+     */
+    static EVPAlgorithms * _FetchAlgorithms()
+    {
+        EVPAlgorithms * algs = new EVPAlgorithms();
+        algs->sha256    = EVP_MD_fetch(nullptr, "SHA256", nullptr);
+        algs->sha1      = EVP_MD_fetch(nullptr, "SHA1", nullptr);
+        algs->hmac      = EVP_MAC_fetch(nullptr, "HMAC", nullptr);
+        algs->pbkdf2    = EVP_KDF_fetch(nullptr, "PBKDF2", nullptr);
+        algs->aes128Cbc = EVP_CIPHER_fetch(nullptr, "AES-128-CBC", nullptr);
+        algs->aes192Cbc = EVP_CIPHER_fetch(nullptr, "AES-192-CBC", nullptr);
+        algs->aes256Cbc = EVP_CIPHER_fetch(nullptr, "AES-256-CBC", nullptr);
+        CC7_ASSERT(algs->sha256 && algs->sha1 && algs->hmac && algs->pbkdf2 &&
+                   algs->aes128Cbc && algs->aes192Cbc && algs->aes256Cbc, "Failed to fetch OpenSSL algorithms.");
+        return algs;
+    }
+    
+    const EVPAlgorithms & EVP_Algorithms()
+    {
+        // The structure is intentionally leaked, see EVPAlgorithms documentation.
+        static const EVPAlgorithms * s_algorithms = _FetchAlgorithms();
+        return *s_algorithms;
+    }
+    
+    EVPThreadContexts::EVPThreadContexts()
+    {
+        const EVPAlgorithms & algs = EVP_Algorithms();
+        cipher = EVP_CIPHER_CTX_new();
+        if (algs.hmac) {
+            hmac = EVP_MAC_CTX_new(algs.hmac);
+            if (hmac) {
+                char digest_name[] = "SHA256";
+                OSSL_PARAM params[] = {
+                    OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest_name, 0),
+                    OSSL_PARAM_construct_end()
+                };
+                if (1 != EVP_MAC_CTX_set_params(hmac, params)) {
+                    EVP_MAC_CTX_free(hmac);
+                    hmac = nullptr;
+                }
+            }
+        }
+    }
+    
+    EVPThreadContexts::~EVPThreadContexts()
+    {
+        EVP_MAC_CTX_free(hmac);
+        EVP_CIPHER_CTX_free(cipher);
+    }
+    
+    EVPThreadContexts & EVP_ThreadContexts()
+    {
+        static thread_local EVPThreadContexts s_contexts;
+        return s_contexts;
+    }
+    
+    const EVP_CIPHER * EVP_AES_CBC_Cipher(size_t key_size)
+    {
+        const EVPAlgorithms & algs = EVP_Algorithms();
+        switch (key_size) {
+            case 16: return algs.aes128Cbc;
+            case 24: return algs.aes192Cbc;
+            case 32: return algs.aes256Cbc;
+            default: return nullptr;
+        }
+    }
+    
+    const EVP_MD * EVP_SHA256_Digest()
+    {
+        return EVP_Algorithms().sha256;
+    }
+    
+    const EVP_MD * EVP_SHA1_Digest()
+    {
+        return EVP_Algorithms().sha1;
+    }
+    
+#else
+    
+    // MARK: - OpenSSL 1.1 and compatible -
+    
+    const EVP_MD * EVP_SHA256_Digest()
+    {
+        return EVP_sha256();
+    }
+    
+    const EVP_MD * EVP_SHA1_Digest()
+    {
+        return EVP_sha1();
+    }
+    
+#endif // PA_OPENSSL3
+    
+} // com::wultra::powerAuth::crypto
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cc7/Platform.h>
+#include <openssl/opensslv.h>
+#include <openssl/evp.h>
+
+/*
+ Note that all functionality provided by this header will
+ be replaced with a similar cc7 implementation.
+ */
+
+/*
+ PA_OPENSSL3 is defined when the library is compiled against OpenSSL 3.x. In this case,
+ the algorithms are fetched explicitly, once per process, and the EVP contexts are reused
+ on each thread. Otherwise the implicitly fetched algorithms are used.
+ */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_IS_BORINGSSL) && !defined(LIBRESSL_VERSION_NUMBER)
+#define PA_OPENSSL3 1
+#include <openssl/kdf.h>
+#endif
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace crypto
+{
+    /**
+     Returns SHA-256 message digest. On OpenSSL 3, the digest is fetched
+     only once per process.
+     */
+    const EVP_MD * EVP_SHA256_Digest();
+    
+    /**
+     Returns SHA-1 message digest. On OpenSSL 3, the digest is fetched
+     only once per process.
+     */
+    const EVP_MD * EVP_SHA1_Digest();
+    
+#if defined(PA_OPENSSL3)
+    
+    /**
+     The EVPAlgorithms structure contains all algorithms fetched from the default
+     provider. The algorithms are fetched on the first use and are never released,
+     because they must outlive all threads using them.
+     */
+    struct EVPAlgorithms
+    {
+        EVP_MD *        sha256      = nullptr;
+        EVP_MD *        sha1        = nullptr;
+        EVP_MAC *       hmac        = nullptr;
+        EVP_KDF *       pbkdf2      = nullptr;
+        EVP_CIPHER *    aes128Cbc   = nullptr;
+        EVP_CIPHER *    aes192Cbc   = nullptr;
+        EVP_CIPHER *    aes256Cbc   = nullptr;
+    };
+    
+    /**
+     Returns algorithms fetched once per process.
+     */
+    const EVPAlgorithms & EVP_Algorithms();
+    
+    /**
+     The EVPThreadContexts structure contains EVP contexts reused by all cryptographic
+     operations performed on the current thread. Each operation must fully re-initialize
+     the context before its use. The contexts are released when the thread exits.
+     */
+    struct EVPThreadContexts
+    {
+        /**
+         HMAC context, with SHA-256 digest already configured.
+         */
+        EVP_MAC_CTX *       hmac    = nullptr;
+        /**
+         Symmetric cipher context.
+         */
+        EVP_CIPHER_CTX *    cipher  = nullptr;
+        
+        EVPThreadContexts();
+        ~EVPThreadContexts();
+        
+    private:
+        EVPThreadContexts(const EVPThreadContexts &) = delete;
+        EVPThreadContexts & operator=(const EVPThreadContexts &) = delete;
+    };
+    
+    /**
+     Returns EVP contexts for the current thread. Any context in the structure
+     can be nullptr if its allocation failed.
+     */
+    EVPThreadContexts & EVP_ThreadContexts();
+    
+    /**
+     Returns AES-CBC cipher for key with |key_size| bytes, or nullptr for unsupported size.
+     */
+    const EVP_CIPHER * EVP_AES_CBC_Cipher(size_t key_size);
+    
+#endif // PA_OPENSSL3
+    
+} // com::wultra::powerAuth::crypto
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -15,8 +15,7 @@
  */
 
 #include "Hash.h"
-#include <openssl/sha.h>
-#include <openssl/hmac.h>
+#include "SHA256Engine.h"
 
 
 namespace com
@@ -34,14 +33,8 @@ namespace crypto
     
     cc7::ByteArray SHA256(const cc7::ByteRange & data)
     {
-        cc7::ByteArray hash(SHA256_DIGEST_LENGTH, 0);
-        
-        SHA256_CTX sha256;
-        SHA256_Init(&sha256);
-        SHA256_Update(&sha256, data.data(), data.size());
-        SHA256_Final(hash.data(), &sha256);
-        OPENSSL_cleanse(&sha256, sizeof(sha256));
-        
+        cc7::ByteArray hash(SHA256Context::DigestSize, 0);
+        SHA256_OneShot(data, hash.data());
         return hash;
     }
     
@@ -16,8 +16,13 @@
 
 #include "KDF.h"
 #include "Hash.h"
+#include "SHA256Engine.h"
+#include "CryptoProvider.h"
+#include "../utils/Statistics.h"
+#include "../utils/Metrics.h"
+#include "../utils/Tracing.h"
 #include <openssl/evp.h>
-#include <openssl/ecdh.h>
+#include <openssl/crypto.h>
 #include <cc7/Endian.h>
 
 namespace com
@@ -33,26 +38,110 @@ namespace crypto
     // MARK: - PBKDF2 -
     //
     
-    cc7::ByteArray PBKDF2_HMAC_SHA1(const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, size_t output_bytes)
+    /**
+     Number of iterations between two progress reports.
+     */
+    static const cc7::U32 PBKDF2_PROGRESS_STEP = 1024;
+    
+    /**
+     Delegate installed for the current thread.
+     */
+    static thread_local KDFProgressDelegate * s_kdf_delegate = nullptr;
+    
+    ScopedKDFProgressDelegate::ScopedKDFProgressDelegate(KDFProgressDelegate * delegate) :
+        _previous(s_kdf_delegate)
     {
-        cc7::ByteArray result(output_bytes, 0);
-        if (1 != PKCS5_PBKDF2_HMAC((const char*)pass.data(), (int)pass.size(), salt.data(), (int)salt.size(), (int)iterations, EVP_sha1(), (int)output_bytes, result.data())) {
-            CC7_LOG("PKCS5_PBKDF2_HMAC has failed!");
-            result.clear();
+        s_kdf_delegate = delegate;
+    }
+    
+    ScopedKDFProgressDelegate::~ScopedKDFProgressDelegate()
+    {
+        s_kdf_delegate = _previous;
+    }
+    
+    /**
+     Progressive PBKDF2 implementation (RFC 8018, section 5.2), reporting the progress
+     to |delegate| after each PBKDF2_PROGRESS_STEP iterations. The HMAC is calculated
+     by the crypto provider. The function produces the same result as PKCS5_PBKDF2_HMAC,
+     but is slightly slower, so it's used only when the delegate is installed.
+     */
+    static bool _PBKDF2_Progressive(KDFProgressDelegate * delegate, const EVP_MD * md, const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, cc7::ByteArray & out)
+    {
+        CryptoProvider::KeyedHMAC hmac(md, pass);
+        const size_t md_size = hmac.size();
+        const size_t blocks = (out.size() + md_size - 1) / md_size;
+        const cc7::U32 total = (cc7::U32)(iterations * blocks);
+        cc7::U32 completed = 0;
+        cc7::byte u[EVP_MAX_MD_SIZE];
+        cc7::byte t[EVP_MAX_MD_SIZE];
+        bool result = false;
+        
+        for (size_t block = 1; block <= blocks; block++) {
+            // U1 = PRF(P, S || INT(i))
+            cc7::U32 be_block = cc7::ToBigEndian((cc7::U32)block);
+            if (!hmac.calculate(salt, cc7::MakeRange(be_block), u)) {
+                goto finish;
+            }
+            memcpy(t, u, md_size);
+            // Uj = PRF(P, Uj-1), T = U1 ^ U2 ^ ... ^ Uc
+            for (cc7::U32 j = 1; j < iterations; j++) {
+                if (!hmac.calculate(cc7::ByteRange(u, md_size), cc7::ByteRange(), u)) {
+                    goto finish;
+                }
+                for (size_t k = 0; k < md_size; k++) {
+                    t[k] ^= u[k];
+                }
+                if ((++completed % PBKDF2_PROGRESS_STEP) == 0) {
+                    if (!delegate->kdfProgress(completed, total)) {
+                        goto finish;
+                    }
+                }
+            }
+            ++completed;
+            const size_t offset = (block - 1) * md_size;
+            memcpy(out.data() + offset, t, std::min(md_size, out.size() - offset));
         }
+        result = delegate->kdfProgress(total, total);
+        
+    finish:
+        OPENSSL_cleanse(u, sizeof(u));
+        OPENSSL_cleanse(t, sizeof(t));
         return result;
     }
-
-    cc7::ByteArray PBKDF2_HMAC_SHA256(const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, size_t output_bytes)
+    
+    /**
+     Common PBKDF2 implementation for all supported digests.
+     */
+    static cc7::ByteArray _PBKDF2_HMAC(const EVP_MD * md, const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, size_t output_bytes)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_PBKDF2);
+        PA_METRICS_TIMER(MH_PBKDF2);
+        PA_TRACE_SCOPE(TP_PBKDF2, iterations);
         cc7::ByteArray result(output_bytes, 0);
-        if (1 != PKCS5_PBKDF2_HMAC((const char*)pass.data(), (int)pass.size(), salt.data(), (int)salt.size(), (int)iterations, EVP_sha256(), (int)output_bytes, result.data())) {
-            CC7_LOG("PKCS5_PBKDF2_HMAC has failed!");
+        KDFProgressDelegate * delegate = s_kdf_delegate;
+        if (delegate && iterations > 0) {
+            if (!_PBKDF2_Progressive(delegate, md, pass, salt, iterations, result)) {
+                result.secureClear();
+            }
+            return result;
+        }
+        if (!CryptoProvider::PBKDF2_HMAC(md, pass, salt, iterations, result.data(), output_bytes)) {
+            CC7_LOG("PBKDF2 has failed!");
             result.clear();
         }
         return result;
     }
     
+    cc7::ByteArray PBKDF2_HMAC_SHA1(const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, size_t output_bytes)
+    {
+        return _PBKDF2_HMAC(EVP_SHA1_Digest(), pass, salt, iterations, output_bytes);
+    }
+
+    cc7::ByteArray PBKDF2_HMAC_SHA256(const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, size_t output_bytes)
+    {
+        return _PBKDF2_HMAC(EVP_SHA256_Digest(), pass, salt, iterations, output_bytes);
+    }
+    
     
     // -------------------------------------------------------------------------------------------
     // MARK: - ECDH ANSI X9.63 -
@@ -61,10 +150,21 @@ namespace crypto
     cc7::ByteArray ECDH_KDF_X9_63_SHA256(const cc7::ByteRange & secret, const cc7::ByteRange & info1, size_t output_bytes)
     {
         cc7::ByteArray result(output_bytes, 0);
-        if (1 != ECDH_KDF_X9_62(result.data(), (int)output_bytes, secret.data(), (int)secret.size(), info1.data(), (int)info1.size(), EVP_sha256())) {
-            CC7_LOG("ECDH_KDF_X9_62 has failed!");
-            result.clear();
+        SHA256Context ctx;
+        cc7::byte digest[SHA256Context::DigestSize];
+        size_t offset = 0;
+        for (cc7::U32 i = 1; offset < output_bytes; i++) {
+            // Data for SHA256: secret || i || info1, counter must be in big endian
+            cc7::U32 be_i = cc7::ToBigEndian(i);
+            ctx.update(secret);
+            ctx.update(cc7::MakeRange(be_i));
+            ctx.update(info1);
+            ctx.finalize(digest);
+            const size_t to_copy = std::min(output_bytes - offset, sizeof(digest));
+            memcpy(result.data() + offset, digest, to_copy);
+            offset += to_copy;
         }
+        OPENSSL_cleanse(digest, sizeof(digest));
         return result;
     }
     
@@ -31,6 +31,43 @@ namespace powerAuth
 {
 namespace crypto
 {
+    /**
+     The KDFProgressDelegate interface allows to observe and cancel long running
+     PBKDF2 calculations. The delegate is installed per thread, with using
+     ScopedKDFProgressDelegate class.
+     */
+    class KDFProgressDelegate
+    {
+    public:
+        virtual ~KDFProgressDelegate() {}
+        
+        /**
+         Called periodically from PBKDF2 calculation, with number of |completed|
+         iterations from |total|. If the method returns false, then the calculation
+         is cancelled and PBKDF2 function returns an empty result.
+         */
+        virtual bool kdfProgress(cc7::U32 completed, cc7::U32 total) = 0;
+    };
+    
+    /**
+     The ScopedKDFProgressDelegate installs |delegate| for all PBKDF2 calculations
+     performed on the current thread. The previous delegate is restored
+     in the destructor. If |delegate| is nullptr, then PBKDF2 calculations in
+     the scope are not observed, even if the previous delegate is installed.
+     */
+    class ScopedKDFProgressDelegate
+    {
+    public:
+        ScopedKDFProgressDelegate(KDFProgressDelegate * delegate);
+        ~ScopedKDFProgressDelegate();
+        
+    private:
+        KDFProgressDelegate * _previous;
+        
+        ScopedKDFProgressDelegate(const ScopedKDFProgressDelegate &) = delete;
+        ScopedKDFProgressDelegate & operator=(const ScopedKDFProgressDelegate &) = delete;
+    };
+    
     // PBKDF with HMAC & SHA1
     cc7::ByteArray PBKDF2_HMAC_SHA1(const cc7::ByteRange & pass, const cc7::ByteRange & salt, cc7::U32 iterations, size_t output_bytes);
     
@@ -15,8 +15,10 @@
  */
 
 #include "MAC.h"
+#include "CryptoProvider.h"
+#include "../utils/Statistics.h"
+#include "../utils/Metrics.h"
 #include <openssl/sha.h>
-#include <openssl/hmac.h>
 
 
 namespace com
@@ -34,13 +36,10 @@ namespace crypto
     
     cc7::ByteArray HMAC_SHA256(const cc7::ByteRange & data, const cc7::ByteRange & key, size_t outputBytes)
     {
-        const unsigned char * key_ptr = key.empty() ? NULL : key.data();
-        
+        utils::ScopedStatisticsTimer timer(utils::ST_Symmetric);
+        PA_METRICS_TIMER(MH_HMAC);
         cc7::ByteArray digest(SHA256_DIGEST_LENGTH, 0);
-        unsigned int digest_length = SHA256_DIGEST_LENGTH;
-        const unsigned char * result = HMAC(EVP_sha256(), key_ptr, (int)key.size(), data.data(), (int)data.size(), digest.data(), &digest_length);
-        
-        if ((result != NULL) && (digest_length == digest.size())) {
+        if (CryptoProvider::HMAC_SHA256(key, data, digest.data())) {
             if (outputBytes > 0 && outputBytes < SHA256_DIGEST_LENGTH) {
                 digest.resize(outputBytes);
             }
@@ -48,7 +47,18 @@ namespace crypto
         }
         CC7_LOG("HMAC_SHA256 has failed!");
         return cc7::ByteArray();
-    }   
+    }
+    
+    bool HMAC_SHA256_ToBuffer(const cc7::ByteRange & data, const cc7::ByteRange & key, cc7::byte * out)
+    {
+        utils::ScopedStatisticsTimer timer(utils::ST_Symmetric);
+        PA_METRICS_TIMER(MH_HMAC);
+        if (CryptoProvider::HMAC_SHA256(key, data, out)) {
+            return true;
+        }
+        CC7_LOG("HMAC_SHA256_ToBuffer has failed!");
+        return false;
+    }
     
 } // com::wultra::powerAuth::crypto
 } // com::wultra::powerAuth
@@ -34,6 +34,14 @@ namespace crypto
     // HMAC with SHA256
     cc7::ByteArray HMAC_SHA256(const cc7::ByteRange & data, const cc7::ByteRange & key, size_t outputBytes = 0);
     
+    /**
+     Calculates HMAC-SHA256 for |data| and |key| and stores the result into |out| buffer,
+     which must be at least 32 bytes long. Unlike `HMAC_SHA256()`, the function doesn't
+     allocate memory, so it's suitable for tight loops working with stack buffers.
+     Returns false if the calculation fails.
+     */
+    bool HMAC_SHA256_ToBuffer(const cc7::ByteRange & data, const cc7::ByteRange & key, cc7::byte * out);
+    
 } // com::wultra::powerAuth::crypto
 } // com::wultra::powerAuth
 } // com::wultra
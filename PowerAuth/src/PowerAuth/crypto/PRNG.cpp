@@ -15,7 +15,10 @@
  */
 
 #include "PRNG.h"
-#include <openssl/rand.h>
+#include "CryptoProvider.h"
+#include "../utils/Statistics.h"
+#include "../utils/Metrics.h"
+#include <atomic>
 
 #if defined(CC7_APPLE) || defined(CC7_ANDROID)
 #include <fcntl.h>
@@ -41,8 +44,8 @@ namespace crypto
         cc7::ByteArray zeros;
         size_t attempts = 16;
         while (size > 0) {
-            int rc = RAND_bytes(data.data(), (int)size);
-            if (rc != 1 || attempts == 0) {
+            bool rc = CryptoProvider::RandomBytes(data.data(), size);
+            if (!rc || attempts == 0) {
                 CC7_ASSERT(false, "Random data generation failed!");
                 return cc7::ByteArray();
             }
@@ -66,8 +69,8 @@ namespace crypto
         cc7::ByteArray data(size, 0);
         size_t attempts = 16;
         while (size > 0) {
-            int rc = RAND_bytes(data.data(), (int)size);
-            if (rc != 1 || attempts == 0) {
+            bool rc = CryptoProvider::RandomBytes(data.data(), size);
+            if (!rc || attempts == 0) {
                 CC7_ASSERT(false, "Random data generation failed!");
                 return cc7::ByteArray();
             }
@@ -89,16 +92,17 @@ namespace crypto
 
     void ReseedPRNG()
     {
-        static bool s_initial_seed = true;
+        utils::Statistics_Count(utils::SC_PRNGReseed);
+        PA_METRICS_COUNT(MC_PRNG_Reseeds, 1);
+        static std::atomic<bool> s_initial_seed(true);
         size_t nbytes;
-        if (s_initial_seed) {
+        if (s_initial_seed.exchange(false)) {
             // This is an initial seed. The recommended size for OpenSSL's PRNG is 1024 bytes
-            s_initial_seed = false;
             nbytes = 1024;
         } else {
             // All subsequent re-seeds may be shorter.
             unsigned char count = 16;
-            RAND_bytes(&count, sizeof(unsigned char));
+            CryptoProvider::RandomBytes(&count, sizeof(unsigned char));
             if (count < 16) {
                 count = 16;
             } else if (count > 64) {
@@ -109,7 +113,7 @@ namespace crypto
         
         uint8_t * buffer = new uint8_t[nbytes];
         if (CC7_CHECK(GetBytesFromSystemGenerator(buffer, nbytes), "Unable to seed PRNG")) {
-            RAND_seed(buffer, (int)nbytes);
+            CryptoProvider::SeedRandom(cc7::ByteRange(buffer, nbytes));
         }
         delete []buffer;
     }
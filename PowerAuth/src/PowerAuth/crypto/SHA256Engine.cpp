@@ -0,0 +1,445 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "SHA256Engine.h"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+// SHA-NI kernel is compiled with target attribute and enabled at runtime.
+#define PA_SHA256_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+// ARMv8 kernel is available only if the compiler targets CPU with cryptographic extensions.
+#define PA_SHA256_ARMV8 1
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace crypto
+{
+    // -------------------------------------------------------------------------------------------
+    // MARK: - Constants -
+    //
+    
+    alignas(16) static const cc7::U32 s_K[64] =
+    {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+    
+    static const cc7::U32 s_IV[8] =
+    {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    
+    /**
+     Block compression function. Processes |blocks| of 64 bytes from |data| and updates |state|.
+     */
+    typedef void (*_SHA256_BlockFunction)(cc7::U32 state[8], const cc7::byte * data, size_t blocks);
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - Generic -
+    //
+    
+    static inline cc7::U32 _ROTR(cc7::U32 x, int n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+    
+    static inline cc7::U32 _LoadBE32(const cc7::byte * p)
+    {
+        return ((cc7::U32)p[0] << 24) | ((cc7::U32)p[1] << 16) | ((cc7::U32)p[2] << 8) | (cc7::U32)p[3];
+    }
+    
+    static inline void _StoreBE32(cc7::byte * p, cc7::U32 v)
+    {
+        p[0] = (cc7::byte)(v >> 24);
+        p[1] = (cc7::byte)(v >> 16);
+        p[2] = (cc7::byte)(v >> 8);
+        p[3] = (cc7::byte)(v);
+    }
+    
+    static void _SHA256_Blocks_Generic(cc7::U32 state[8], const cc7::byte * data, size_t blocks)
+    {
+        cc7::U32 W[16];
+        while (blocks-- > 0) {
+            cc7::U32 a = state[0], b = state[1], c = state[2], d = state[3];
+            cc7::U32 e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int t = 0; t < 64; t++) {
+                cc7::U32 w;
+                if (t < 16) {
+                    w = _LoadBE32(data + 4 * t);
+                } else {
+                    cc7::U32 w15 = W[(t - 15) & 15];
+                    cc7::U32 w2  = W[(t - 2) & 15];
+                    cc7::U32 s0 = _ROTR(w15, 7) ^ _ROTR(w15, 18) ^ (w15 >> 3);
+                    cc7::U32 s1 = _ROTR(w2, 17) ^ _ROTR(w2, 19) ^ (w2 >> 10);
+                    w = W[t & 15] + s0 + W[(t - 7) & 15] + s1;
+                }
+                W[t & 15] = w;
+                cc7::U32 S1 = _ROTR(e, 6) ^ _ROTR(e, 11) ^ _ROTR(e, 25);
+                cc7::U32 ch = (e & f) ^ (~e & g);
+                cc7::U32 t1 = h + S1 + ch + s_K[t] + w;
+                cc7::U32 S0 = _ROTR(a, 2) ^ _ROTR(a, 13) ^ _ROTR(a, 22);
+                cc7::U32 maj = (a & b) ^ (a & c) ^ (b & c);
+                cc7::U32 t2 = S0 + maj;
+                h = g; g = f; f = e; e = d + t1;
+                d = c; c = b; b = a; a = t1 + t2;
+            }
+            state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+            state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+            data += SHA256Context::BlockSize;
+        }
+        OPENSSL_cleanse(W, sizeof(W));
+    }
+    
+#if defined(PA_SHA256_X86)
+    // -------------------------------------------------------------------------------------------
+    // MARK: - Intel SHA extensions -
+    //
+    
+    static bool _SHA256_X86_IsSupported()
+    {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        const bool ssse3 = (ecx & (1u << 9)) != 0;
+        const bool sse41 = (ecx & (1u << 19)) != 0;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        const bool sha = (ebx & (1u << 29)) != 0;
+        return ssse3 && sse41 && sha;
+    }
+    
+    __attribute__((target("sha,sse4.1")))
+    static void _SHA256_Blocks_X86(cc7::U32 state[8], const cc7::byte * data, size_t blocks)
+    {
+        const __m128i BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+        // Load state and reorder it to ABEF, CDGH layout required by the instructions.
+        __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);     // CDAB
+        __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);  // EFGH
+        __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);                                       // ABEF
+        state1 = _mm_blend_epi16(state1, tmp, 0xF0);                                            // CDGH
+        
+        while (blocks-- > 0) {
+            const __m128i abef_save = state0;
+            const __m128i cdgh_save = state1;
+            __m128i W[4];
+            for (int j = 0; j < 16; j++) {
+                __m128i w;
+                if (j < 4) {
+                    w = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * j)), BSWAP);
+                } else {
+                    w = _mm_sha256msg1_epu32(W[j & 3], W[(j - 3) & 3]);
+                    w = _mm_add_epi32(w, _mm_alignr_epi8(W[(j - 1) & 3], W[(j - 2) & 3], 4));
+                    w = _mm_sha256msg2_epu32(w, W[(j - 1) & 3]);
+                }
+                W[j & 3] = w;
+                __m128i msg = _mm_add_epi32(w, _mm_load_si128((const __m128i*)&s_K[4 * j]));
+                state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+                msg = _mm_shuffle_epi32(msg, 0x0E);
+                state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            }
+            state0 = _mm_add_epi32(state0, abef_save);
+            state1 = _mm_add_epi32(state1, cdgh_save);
+            data += SHA256Context::BlockSize;
+        }
+        // Restore ABCD, EFGH layout.
+        tmp = _mm_shuffle_epi32(state0, 0x1B);              // FEBA
+        state1 = _mm_shuffle_epi32(state1, 0xB1);           // DCHG
+        state0 = _mm_blend_epi16(tmp, state1, 0xF0);        // DCBA
+        state1 = _mm_alignr_epi8(state1, tmp, 8);           // HGFE
+        _mm_storeu_si128((__m128i*)&state[0], state0);
+        _mm_storeu_si128((__m128i*)&state[4], state1);
+    }
+    
+#endif // PA_SHA256_X86
+    
+#if defined(PA_SHA256_ARMV8)
+    // -------------------------------------------------------------------------------------------
+    // MARK: - ARMv8 cryptographic extensions -
+    //
+    
+    static bool _SHA256_ARMv8_IsSupported()
+    {
+#if defined(__linux__) && defined(HWCAP_SHA2)
+        return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+#else
+        // The compiler already targets CPU with the extensions.
+        return true;
+#endif
+    }
+    
+    static void _SHA256_Blocks_ARMv8(cc7::U32 state[8], const cc7::byte * data, size_t blocks)
+    {
+        uint32x4_t state0 = vld1q_u32(&state[0]);
+        uint32x4_t state1 = vld1q_u32(&state[4]);
+        
+        while (blocks-- > 0) {
+            const uint32x4_t abcd_save = state0;
+            const uint32x4_t efgh_save = state1;
+            uint32x4_t W[4];
+            for (int j = 0; j < 16; j++) {
+                uint32x4_t w;
+                if (j < 4) {
+                    w = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * j)));
+                } else {
+                    w = vsha256su0q_u32(W[j & 3], W[(j - 3) & 3]);
+                    w = vsha256su1q_u32(w, W[(j - 2) & 3], W[(j - 1) & 3]);
+                }
+                W[j & 3] = w;
+                const uint32x4_t msg = vaddq_u32(w, vld1q_u32(&s_K[4 * j]));
+                const uint32x4_t tmp = state0;
+                state0 = vsha256hq_u32(state0, state1, msg);
+                state1 = vsha256h2q_u32(state1, tmp, msg);
+            }
+            state0 = vaddq_u32(state0, abcd_save);
+            state1 = vaddq_u32(state1, efgh_save);
+            data += SHA256Context::BlockSize;
+        }
+        vst1q_u32(&state[0], state0);
+        vst1q_u32(&state[4], state1);
+    }
+    
+#endif // PA_SHA256_ARMV8
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - Dispatch -
+    //
+    
+    struct _SHA256_Kernel
+    {
+        SHA256Implementation implementation;
+        _SHA256_BlockFunction blocks;
+        bool (*isSupported)();
+    };
+    
+    static bool _SHA256_Generic_IsSupported()
+    {
+        return true;
+    }
+    
+    /**
+     All compiled kernels, ordered from the most preferred one.
+     */
+    static const _SHA256_Kernel s_kernels[] =
+    {
+#if defined(PA_SHA256_X86)
+        { SHA256Impl_X86_SHA,       _SHA256_Blocks_X86,     _SHA256_X86_IsSupported },
+#endif
+#if defined(PA_SHA256_ARMV8)
+        { SHA256Impl_ARMv8_SHA2,    _SHA256_Blocks_ARMv8,   _SHA256_ARMv8_IsSupported },
+#endif
+        { SHA256Impl_Generic,       _SHA256_Blocks_Generic, _SHA256_Generic_IsSupported },
+    };
+    
+    static std::atomic<const _SHA256_Kernel*> s_active_kernel(nullptr);
+    
+    /**
+     Returns kernel for the current CPU. The detection is performed only once,
+     but it's harmless if multiple threads do the detection at the same time.
+     */
+    static const _SHA256_Kernel * _SHA256_ActiveKernel()
+    {
+        auto kernel = s_active_kernel.load(std::memory_order_acquire);
+        if (kernel == nullptr) {
+            for (const auto & k : s_kernels) {
+                if (k.isSupported()) {
+                    kernel = &k;
+                    break;
+                }
+            }
+            s_active_kernel.store(kernel, std::memory_order_release);
+        }
+        return kernel;
+    }
+    
+    SHA256Implementation SHA256_ActiveImplementation()
+    {
+        return _SHA256_ActiveKernel()->implementation;
+    }
+    
+    bool SHA256_SelectImplementation(SHA256Implementation implementation)
+    {
+        for (const auto & k : s_kernels) {
+            if (k.implementation == implementation) {
+                if (!k.isSupported()) {
+                    return false;
+                }
+                s_active_kernel.store(&k, std::memory_order_release);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    void SHA256_InitState(cc7::U32 state[8])
+    {
+        memcpy(state, s_IV, sizeof(s_IV));
+    }
+    
+    void SHA256_ProcessBlocks(cc7::U32 state[8], const cc7::byte * data, size_t blocks)
+    {
+        _SHA256_ActiveKernel()->blocks(state, data, blocks);
+    }
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - Padding -
+    //
+    
+    /**
+     Pads the last incomplete block stored in |buffer| with |buffer_size| bytes, processes
+     the final block or blocks and stores the digest into |out|. The |buffer| must be
+     one block long and is wiped after the use.
+     */
+    static void _SHA256_Finalize(_SHA256_BlockFunction blocks, cc7::U32 state[8], cc7::byte * buffer, size_t buffer_size, cc7::U64 message_size, cc7::byte * out)
+    {
+        const size_t bs = SHA256Context::BlockSize;
+        buffer[buffer_size++] = 0x80;
+        if (buffer_size > bs - 8) {
+            // No space for the length, so one more block is required.
+            memset(buffer + buffer_size, 0, bs - buffer_size);
+            blocks(state, buffer, 1);
+            buffer_size = 0;
+        }
+        memset(buffer + buffer_size, 0, bs - 8 - buffer_size);
+        const cc7::U64 bits = message_size << 3;
+        _StoreBE32(buffer + bs - 8, (cc7::U32)(bits >> 32));
+        _StoreBE32(buffer + bs - 4, (cc7::U32)bits);
+        blocks(state, buffer, 1);
+        for (size_t i = 0; i < 8; i++) {
+            _StoreBE32(out + 4 * i, state[i]);
+        }
+        OPENSSL_cleanse(buffer, bs);
+    }
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - SHA256Context -
+    //
+    
+    SHA256Context::SHA256Context()
+    {
+        reset();
+    }
+    
+    SHA256Context::~SHA256Context()
+    {
+        OPENSSL_cleanse(_state, sizeof(_state));
+        OPENSSL_cleanse(_buffer, sizeof(_buffer));
+    }
+    
+    void SHA256Context::reset()
+    {
+        memcpy(_state, s_IV, sizeof(_state));
+        _bufferSize = 0;
+        _messageSize = 0;
+    }
+    
+    void SHA256Context::update(const cc7::ByteRange & data)
+    {
+        const cc7::byte * p = data.data();
+        size_t size = data.size();
+        if (size == 0) {
+            return;
+        }
+        _messageSize += size;
+        auto blocks = _SHA256_ActiveKernel()->blocks;
+        if (_bufferSize > 0) {
+            // Complete the buffered block first.
+            size_t to_copy = std::min(size, BlockSize - _bufferSize);
+            memcpy(_buffer + _bufferSize, p, to_copy);
+            _bufferSize += to_copy;
+            p += to_copy;
+            size -= to_copy;
+            if (_bufferSize < BlockSize) {
+                return;
+            }
+            blocks(_state, _buffer, 1);
+            _bufferSize = 0;
+        }
+        // Process all complete blocks directly from the input.
+        const size_t full_blocks = size / BlockSize;
+        if (full_blocks > 0) {
+            blocks(_state, p, full_blocks);
+            p += full_blocks * BlockSize;
+            size -= full_blocks * BlockSize;
+        }
+        if (size > 0) {
+            memcpy(_buffer, p, size);
+            _bufferSize = size;
+        }
+    }
+    
+    void SHA256Context::finalize(cc7::byte * out)
+    {
+        _SHA256_Finalize(_SHA256_ActiveKernel()->blocks, _state, _buffer, _bufferSize, _messageSize, out);
+        reset();
+    }
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - One-shot -
+    //
+    
+    void SHA256_OneShot(const cc7::ByteRange & data, cc7::byte * out)
+    {
+        const size_t bs = SHA256Context::BlockSize;
+        auto blocks = _SHA256_ActiveKernel()->blocks;
+        cc7::U32 state[8];
+        memcpy(state, s_IV, sizeof(state));
+        // Process complete blocks directly from the input, without buffering.
+        const size_t full_blocks = data.size() / bs;
+        if (full_blocks > 0) {
+            blocks(state, data.data(), full_blocks);
+        }
+        // The rest is always shorter than one block, so it's padded on the stack.
+        // Messages shorter than 56 bytes are processed with a single block function call.
+        cc7::byte buffer[bs];
+        const size_t rest = data.size() - full_blocks * bs;
+        if (rest > 0) {
+            memcpy(buffer, data.data() + full_blocks * bs, rest);
+        }
+        _SHA256_Finalize(blocks, state, buffer, rest, data.size(), out);
+        OPENSSL_cleanse(state, sizeof(state));
+    }
+    
+} // com::wultra::powerAuth::crypto
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cc7/ByteArray.h>
+
+/*
+ Note that all functionality provided by this header will
+ be replaced with a similar cc7 implementation.
+ */
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace crypto
+{
+    /**
+     The SHA256Implementation enumeration identifies block compression
+     function used by the in-tree SHA-256 engine.
+     */
+    enum SHA256Implementation
+    {
+        /**
+         Portable implementation, available on all platforms.
+         */
+        SHA256Impl_Generic = 0,
+        /**
+         Intel SHA extensions (SHA-NI).
+         */
+        SHA256Impl_X86_SHA,
+        /**
+         ARMv8 cryptographic extensions.
+         */
+        SHA256Impl_ARMv8_SHA2,
+    };
+    
+    /**
+     Returns implementation of the SHA-256 block function selected for the
+     current CPU. The implementation is detected once, on the first use.
+     */
+    SHA256Implementation SHA256_ActiveImplementation();
+    
+    /**
+     Forces the SHA-256 engine to use the required |implementation|. Returns false
+     if the implementation is not supported by the current CPU or was not compiled
+     into the library. The function is intended for tests and benchmarks only.
+     */
+    bool SHA256_SelectImplementation(SHA256Implementation implementation);
+    
+    /**
+     Sets |state| to SHA-256 initial hash value.
+     */
+    void SHA256_InitState(cc7::U32 state[8]);
+    
+    /**
+     Processes |blocks| of 64 bytes from |data| with the active block function and
+     updates the |state|. This is a low level function, the caller is responsible
+     for the message padding.
+     */
+    void SHA256_ProcessBlocks(cc7::U32 state[8], const cc7::byte * data, size_t blocks);
+    
+    /**
+     The SHA256Context class implements streaming SHA-256 computation
+     with using the in-tree engine. The internal state is wiped when the
+     digest is calculated, or when the object is destroyed.
+     */
+    class SHA256Context
+    {
+    public:
+        static const size_t BlockSize = 64;
+        static const size_t DigestSize = 32;
+        
+        SHA256Context();
+        ~SHA256Context();
+        
+        /**
+         Resets the context to its initial state.
+         */
+        void reset();
+        
+        /**
+         Appends |data| to the hashed message.
+         */
+        void update(const cc7::ByteRange & data);
+        
+        /**
+         Calculates the final digest into |out| buffer, which must be at least
+         `DigestSize` bytes long. The context is reset after the call.
+         */
+        void finalize(cc7::byte * out);
+        
+    private:
+        cc7::U32    _state[8];
+        cc7::byte   _buffer[BlockSize];
+        size_t      _bufferSize;
+        cc7::U64    _messageSize;
+        
+        SHA256Context(const SHA256Context &) = delete;
+        SHA256Context & operator=(const SHA256Context &) = delete;
+    };
+    
+    /**
+     Calculates SHA-256 digest from |data| into |out| buffer, which must be at least
+     `SHA256Context::DigestSize` bytes long. Messages shorter than 56 bytes, like the
+     hash-based counter or the shared secrets, are processed with just one call
+     to the block function.
+     */
+    void SHA256_OneShot(const cc7::ByteRange & data, cc7::byte * out);
+    
+} // com::wultra::powerAuth::crypto
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
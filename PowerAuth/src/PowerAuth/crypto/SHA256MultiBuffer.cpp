@@ -0,0 +1,598 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "SHA256MultiBuffer.h"
+#include "SHA256Engine.h"
+#include "../utils/Statistics.h"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+// AVX2 and AVX-512 kernels are compiled with target attribute and enabled at runtime.
+#define PA_SHA256_MB_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace crypto
+{
+    static const size_t BLOCK_SIZE = 64;
+    static const size_t MAX_LANES = 16;
+    
+    /**
+     Multi-buffer block function. Processes exactly one block from each |blocks| pointer and
+     updates the transposed |state|, where word `w` of lane `l` is at `state[w * LANES + l]`.
+     The number of LANES is specific for each function.
+     */
+    typedef void (*_MB_BlockFunction)(cc7::U32 * state, const cc7::byte * const * blocks);
+    
+    static inline cc7::U32 _LoadBE32(const cc7::byte * p)
+    {
+        return ((cc7::U32)p[0] << 24) | ((cc7::U32)p[1] << 16) | ((cc7::U32)p[2] << 8) | (cc7::U32)p[3];
+    }
+    
+    static inline void _StoreBE32(cc7::byte * p, cc7::U32 v)
+    {
+        p[0] = (cc7::byte)(v >> 24);
+        p[1] = (cc7::byte)(v >> 16);
+        p[2] = (cc7::byte)(v >> 8);
+        p[3] = (cc7::byte)(v);
+    }
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - Scalar -
+    //
+    
+    static void _MB_Block_Scalar(cc7::U32 * state, const cc7::byte * const * blocks)
+    {
+        // Just one lane, so the state is not transposed and the single buffer engine can be used.
+        SHA256_ProcessBlocks(state, blocks[0], 1);
+    }
+    
+    static bool _MB_Scalar_IsSupported()
+    {
+        return true;
+    }
+    
+#if defined(PA_SHA256_MB_X86)
+    // -------------------------------------------------------------------------------------------
+    // MARK: - x86 SIMD -
+    //
+    
+    alignas(64) static const cc7::U32 s_K[64] =
+    {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+    
+    /**
+     Returns content of XCR0 register, describing register state enabled by the OS.
+     */
+    static cc7::U64 _XCR0()
+    {
+        cc7::U32 eax, edx;
+        __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((cc7::U64)edx << 32) | eax;
+    }
+    
+    /**
+     Returns true if CPU supports AVX and the OS preserves YMM registers. If |avx512| is true,
+     then the OS must also preserve the opmask and ZMM registers.
+     */
+    static bool _MB_OSSupportsAVX(bool avx512)
+    {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        const bool osxsave = (ecx & (1u << 27)) != 0;
+        const bool avx = (ecx & (1u << 28)) != 0;
+        if (!osxsave || !avx) {
+            return false;
+        }
+        const cc7::U64 mask = avx512 ? 0xE6 : 0x06;
+        return (_XCR0() & mask) == mask;
+    }
+    
+    static bool _MB_AVX2_IsSupported()
+    {
+        unsigned int eax, ebx, ecx, edx;
+        if (!_MB_OSSupportsAVX(false) || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (ebx & (1u << 5)) != 0;
+    }
+    
+    static bool _MB_AVX512_IsSupported()
+    {
+        unsigned int eax, ebx, ecx, edx;
+        if (!_MB_OSSupportsAVX(true) || !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        return (ebx & (1u << 16)) != 0;
+    }
+    
+    /**
+     Loads message words from all lanes into |words| array, transposed,
+     so word `t` of lane `l` is at `words[t * LANES + l]`.
+     */
+    template <size_t LANES>
+    static inline void _MB_TransposeMessage(cc7::U32 * words, const cc7::byte * const * blocks)
+    {
+        for (size_t l = 0; l < LANES; l++) {
+            const cc7::byte * block = blocks[l];
+            for (size_t t = 0; t < 16; t++) {
+                words[t * LANES + l] = _LoadBE32(block + 4 * t);
+            }
+        }
+    }
+    
+#define _AVX2_ROR(x, n)     _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define _AVX2_ADD(x, y)     _mm256_add_epi32(x, y)
+#define _AVX2_XOR(x, y)     _mm256_xor_si256(x, y)
+#define _AVX2_AND(x, y)     _mm256_and_si256(x, y)
+    
+    __attribute__((target("avx2")))
+    static void _MB_Block_AVX2(cc7::U32 * state, const cc7::byte * const * blocks)
+    {
+        alignas(32) cc7::U32 words[16 * 8];
+        _MB_TransposeMessage<8>(words, blocks);
+        
+        __m256i s[8];
+        for (size_t i = 0; i < 8; i++) {
+            s[i] = _mm256_loadu_si256((const __m256i*)(state + i * 8));
+        }
+        __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+        __m256i W[16];
+        for (int t = 0; t < 64; t++) {
+            __m256i w;
+            if (t < 16) {
+                w = _mm256_load_si256((const __m256i*)(words + t * 8));
+            } else {
+                const __m256i w15 = W[(t - 15) & 15];
+                const __m256i w2  = W[(t - 2) & 15];
+                const __m256i s0 = _AVX2_XOR(_AVX2_XOR(_AVX2_ROR(w15, 7), _AVX2_ROR(w15, 18)), _mm256_srli_epi32(w15, 3));
+                const __m256i s1 = _AVX2_XOR(_AVX2_XOR(_AVX2_ROR(w2, 17), _AVX2_ROR(w2, 19)), _mm256_srli_epi32(w2, 10));
+                w = _AVX2_ADD(_AVX2_ADD(W[t & 15], s0), _AVX2_ADD(W[(t - 7) & 15], s1));
+            }
+            W[t & 15] = w;
+            const __m256i S1 = _AVX2_XOR(_AVX2_XOR(_AVX2_ROR(e, 6), _AVX2_ROR(e, 11)), _AVX2_ROR(e, 25));
+            const __m256i ch = _AVX2_XOR(_AVX2_AND(e, f), _mm256_andnot_si256(e, g));
+            const __m256i t1 = _AVX2_ADD(_AVX2_ADD(h, S1), _AVX2_ADD(_AVX2_ADD(ch, _mm256_set1_epi32((int)s_K[t])), w));
+            const __m256i S0 = _AVX2_XOR(_AVX2_XOR(_AVX2_ROR(a, 2), _AVX2_ROR(a, 13)), _AVX2_ROR(a, 22));
+            const __m256i maj = _AVX2_XOR(_AVX2_XOR(_AVX2_AND(a, b), _AVX2_AND(a, c)), _AVX2_AND(b, c));
+            h = g; g = f; f = e; e = _AVX2_ADD(d, t1);
+            d = c; c = b; b = a; a = _AVX2_ADD(t1, _AVX2_ADD(S0, maj));
+        }
+        const __m256i r[8] = { a, b, c, d, e, f, g, h };
+        for (size_t i = 0; i < 8; i++) {
+            _mm256_storeu_si256((__m256i*)(state + i * 8), _AVX2_ADD(s[i], r[i]));
+        }
+        OPENSSL_cleanse(words, sizeof(words));
+        OPENSSL_cleanse(W, sizeof(W));
+    }
+    
+#undef _AVX2_ROR
+#undef _AVX2_ADD
+#undef _AVX2_XOR
+#undef _AVX2_AND
+    
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC reports false positive warnings for _mm512_undefined_epi32() used in the intrinsics.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    
+#define _AVX512_ROR(x, n)   _mm512_ror_epi32(x, n)
+#define _AVX512_ADD(x, y)   _mm512_add_epi32(x, y)
+#define _AVX512_XOR(x, y)   _mm512_xor_si512(x, y)
+#define _AVX512_AND(x, y)   _mm512_and_si512(x, y)
+    
+    __attribute__((target("avx512f")))
+    static void _MB_Block_AVX512(cc7::U32 * state, const cc7::byte * const * blocks)
+    {
+        alignas(64) cc7::U32 words[16 * 16];
+        _MB_TransposeMessage<16>(words, blocks);
+        
+        __m512i s[8];
+        for (size_t i = 0; i < 8; i++) {
+            s[i] = _mm512_loadu_si512((const void*)(state + i * 16));
+        }
+        __m512i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+        __m512i W[16];
+        for (int t = 0; t < 64; t++) {
+            __m512i w;
+            if (t < 16) {
+                w = _mm512_load_si512((const void*)(words + t * 16));
+            } else {
+                const __m512i w15 = W[(t - 15) & 15];
+                const __m512i w2  = W[(t - 2) & 15];
+                const __m512i s0 = _AVX512_XOR(_AVX512_XOR(_AVX512_ROR(w15, 7), _AVX512_ROR(w15, 18)), _mm512_srli_epi32(w15, 3));
+                const __m512i s1 = _AVX512_XOR(_AVX512_XOR(_AVX512_ROR(w2, 17), _AVX512_ROR(w2, 19)), _mm512_srli_epi32(w2, 10));
+                w = _AVX512_ADD(_AVX512_ADD(W[t & 15], s0), _AVX512_ADD(W[(t - 7) & 15], s1));
+            }
+            W[t & 15] = w;
+            const __m512i S1 = _AVX512_XOR(_AVX512_XOR(_AVX512_ROR(e, 6), _AVX512_ROR(e, 11)), _AVX512_ROR(e, 25));
+            // ch = (e & f) ^ (~e & g), maj = (a & b) ^ (a & c) ^ (b & c), both as a single ternary logic instruction.
+            const __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xCA);
+            const __m512i t1 = _AVX512_ADD(_AVX512_ADD(h, S1), _AVX512_ADD(_AVX512_ADD(ch, _mm512_set1_epi32((int)s_K[t])), w));
+            const __m512i S0 = _AVX512_XOR(_AVX512_XOR(_AVX512_ROR(a, 2), _AVX512_ROR(a, 13)), _AVX512_ROR(a, 22));
+            const __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xE8);
+            h = g; g = f; f = e; e = _AVX512_ADD(d, t1);
+            d = c; c = b; b = a; a = _AVX512_ADD(t1, _AVX512_ADD(S0, maj));
+        }
+        const __m512i r[8] = { a, b, c, d, e, f, g, h };
+        for (size_t i = 0; i < 8; i++) {
+            _mm512_storeu_si512((void*)(state + i * 16), _AVX512_ADD(s[i], r[i]));
+        }
+        OPENSSL_cleanse(words, sizeof(words));
+        OPENSSL_cleanse(W, sizeof(W));
+    }
+    
+#undef _AVX512_ROR
+#undef _AVX512_ADD
+#undef _AVX512_XOR
+#undef _AVX512_AND
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+    
+#endif // PA_SHA256_MB_X86
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - Dispatch -
+    //
+    
+    struct _MB_Kernel
+    {
+        SHA256MultiBufferImplementation implementation;
+        size_t lanes;
+        _MB_BlockFunction block;
+        bool (*isSupported)();
+    };
+    
+    /**
+     All compiled kernels, ordered from the widest one.
+     */
+    static const _MB_Kernel s_kernels[] =
+    {
+#if defined(PA_SHA256_MB_X86)
+        { SHA256MB_AVX512,  16, _MB_Block_AVX512,   _MB_AVX512_IsSupported },
+        { SHA256MB_AVX2,    8,  _MB_Block_AVX2,     _MB_AVX2_IsSupported },
+#endif
+        { SHA256MB_Scalar,  1,  _MB_Block_Scalar,   _MB_Scalar_IsSupported },
+    };
+    
+    static std::atomic<const _MB_Kernel*> s_active_kernel(nullptr);
+    
+    /**
+     Returns kernel for the current CPU. If the single buffer engine uses SHA instructions,
+     then one lane processed with these instructions is as fast as the widest SIMD kernel,
+     so the scalar kernel is preferred.
+     */
+    static const _MB_Kernel * _MB_ActiveKernel()
+    {
+        auto kernel = s_active_kernel.load(std::memory_order_acquire);
+        if (kernel == nullptr) {
+            const bool hw_sha = SHA256_ActiveImplementation() != SHA256Impl_Generic;
+            for (const auto & k : s_kernels) {
+                if ((!hw_sha || k.implementation == SHA256MB_Scalar) && k.isSupported()) {
+                    kernel = &k;
+                    break;
+                }
+            }
+            s_active_kernel.store(kernel, std::memory_order_release);
+        }
+        return kernel;
+    }
+    
+    SHA256MultiBufferImplementation SHA256MultiBuffer_ActiveImplementation()
+    {
+        return _MB_ActiveKernel()->implementation;
+    }
+    
+    bool SHA256MultiBuffer_SelectImplementation(SHA256MultiBufferImplementation implementation)
+    {
+        for (const auto & k : s_kernels) {
+            if (k.implementation == implementation) {
+                if (!k.isSupported()) {
+                    return false;
+                }
+                s_active_kernel.store(&k, std::memory_order_release);
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - Lanes -
+    //
+    
+    /**
+     The _MB_Stream structure describes sequence of blocks hashed in one lane:
+     an optional prefix block, followed by complete blocks of the message and
+     by the padded end of the message.
+     */
+    struct _MB_Stream
+    {
+        cc7::U32 state[8];
+        const cc7::byte * prefix;
+        const cc7::byte * body;
+        size_t bodyBlocks;
+        cc7::byte tail[2 * BLOCK_SIZE];
+        size_t tailBlocks;
+        
+        size_t blocksCount() const
+        {
+            return (prefix ? 1 : 0) + bodyBlocks + tailBlocks;
+        }
+        
+        const cc7::byte * block(size_t index) const
+        {
+            if (prefix) {
+                if (index == 0) {
+                    return prefix;
+                }
+                --index;
+            }
+            if (index < bodyBlocks) {
+                return body + index * BLOCK_SIZE;
+            }
+            return tail + (index - bodyBlocks) * BLOCK_SIZE;
+        }
+        
+        void init(const cc7::byte * prefix_block, const cc7::ByteRange & message)
+        {
+            SHA256_InitState(state);
+            prefix = prefix_block;
+            body = message.data();
+            bodyBlocks = message.size() / BLOCK_SIZE;
+            // Pad the rest of message
+            const size_t rest = message.size() - bodyBlocks * BLOCK_SIZE;
+            tailBlocks = rest + 9 > BLOCK_SIZE ? 2 : 1;
+            const size_t tail_size = tailBlocks * BLOCK_SIZE;
+            if (rest > 0) {
+                memcpy(tail, body + bodyBlocks * BLOCK_SIZE, rest);
+            }
+            tail[rest] = 0x80;
+            memset(tail + rest + 1, 0, tail_size - rest - 1 - 8);
+            const cc7::U64 bits = ((prefix ? BLOCK_SIZE : 0) + (cc7::U64)message.size()) << 3;
+            _StoreBE32(tail + tail_size - 8, (cc7::U32)(bits >> 32));
+            _StoreBE32(tail + tail_size - 4, (cc7::U32)bits);
+        }
+        
+        void digest(cc7::byte * out) const
+        {
+            for (size_t i = 0; i < 8; i++) {
+                _StoreBE32(out + 4 * i, state[i]);
+            }
+        }
+    };
+    
+    /**
+     Processes up to `kernel.lanes` |streams| in parallel. The lanes are processed in lock-step,
+     so unused lanes, or lanes whose stream is already complete, hash a dummy block and their
+     state is ignored.
+     */
+    static void _MB_RunLanes(const _MB_Kernel & kernel, _MB_Stream ** streams, size_t count)
+    {
+        static const cc7::byte s_dummy_block[BLOCK_SIZE] = { 0 };
+        
+        const size_t lanes = kernel.lanes;
+        const size_t state_size = 8 * lanes * sizeof(cc7::U32);
+        alignas(64) cc7::U32 state[8 * MAX_LANES];
+        const cc7::byte * blocks[MAX_LANES];
+        size_t max_blocks = 0;
+        if (count < lanes) {
+            memset(state, 0, state_size);
+        }
+        for (size_t l = 0; l < count; l++) {
+            for (size_t w = 0; w < 8; w++) {
+                state[w * lanes + l] = streams[l]->state[w];
+            }
+            max_blocks = std::max(max_blocks, streams[l]->blocksCount());
+        }
+        for (size_t b = 0; b < max_blocks; b++) {
+            for (size_t l = 0; l < lanes; l++) {
+                blocks[l] = l < count && b < streams[l]->blocksCount() ? streams[l]->block(b) : s_dummy_block;
+            }
+            kernel.block(state, blocks);
+            // Keep the state of streams completed in this step.
+            for (size_t l = 0; l < count; l++) {
+                if (b + 1 == streams[l]->blocksCount()) {
+                    for (size_t w = 0; w < 8; w++) {
+                        streams[l]->state[w] = state[w * lanes + l];
+                    }
+                }
+            }
+        }
+        OPENSSL_cleanse(state, state_size);
+    }
+    
+    // -------------------------------------------------------------------------------------------
+    // MARK: - SHA256MultiBuffer -
+    //
+    
+    /**
+     The _MB_Job structure contains one pending SHA-256 or HMAC-SHA256 job.
+     */
+    struct _MB_Job
+    {
+        cc7::ByteRange data;
+        cc7::byte * out;
+        bool isHMAC;
+        cc7::byte innerPad[BLOCK_SIZE];
+        cc7::byte outerPad[BLOCK_SIZE];
+        cc7::byte innerDigest[SHA256MultiBuffer::DigestSize];
+        _MB_Stream stream;
+        
+        void wipe()
+        {
+            OPENSSL_cleanse(innerPad, sizeof(innerPad));
+            OPENSSL_cleanse(outerPad, sizeof(outerPad));
+            OPENSSL_cleanse(innerDigest, sizeof(innerDigest));
+            OPENSSL_cleanse(stream.state, sizeof(stream.state));
+            OPENSSL_cleanse(stream.tail, sizeof(stream.tail));
+        }
+    };
+    
+    struct SHA256MultiBuffer::Jobs
+    {
+        const _MB_Kernel * kernel;
+        std::vector<_MB_Job> pending;
+        
+        Jobs() :
+            kernel(_MB_ActiveKernel())
+        {
+            pending.reserve(kernel->lanes);
+        }
+        
+        ~Jobs()
+        {
+            for (auto & job : pending) {
+                job.wipe();
+            }
+        }
+        
+        /**
+         Adds a new pending job.
+         */
+        _MB_Job & add()
+        {
+            pending.emplace_back();
+            return pending.back();
+        }
+        
+        /**
+         Processes all pending jobs if all lanes are occupied.
+         */
+        void processIfFull()
+        {
+            if (pending.size() >= kernel->lanes) {
+                process();
+            }
+        }
+        
+        /**
+         Processes all pending jobs.
+         */
+        void process()
+        {
+            if (pending.empty()) {
+                return;
+            }
+            _MB_Stream * streams[MAX_LANES];
+            // At first, calculate all plain hashes and inner hashes of HMAC jobs.
+            const size_t count = pending.size();
+            for (size_t i = 0; i < count; i++) {
+                _MB_Job & job = pending[i];
+                job.stream.init(job.isHMAC ? job.innerPad : nullptr, job.data);
+                streams[i] = &job.stream;
+            }
+            _MB_RunLanes(*kernel, streams, count);
+            // Then calculate outer hashes of HMAC jobs.
+            size_t hmac_count = 0;
+            for (size_t i = 0; i < count; i++) {
+                _MB_Job & job = pending[i];
+                if (job.isHMAC) {
+                    job.stream.digest(job.innerDigest);
+                    job.stream.init(job.outerPad, cc7::ByteRange(job.innerDigest, sizeof(job.innerDigest)));
+                    streams[hmac_count++] = &job.stream;
+                }
+            }
+            if (hmac_count > 0) {
+                _MB_RunLanes(*kernel, streams, hmac_count);
+            }
+            for (auto & job : pending) {
+                job.stream.digest(job.out);
+                job.wipe();
+            }
+            pending.clear();
+        }
+    };
+    
+    SHA256MultiBuffer::SHA256MultiBuffer() :
+        _jobs(new Jobs())
+    {
+    }
+    
+    SHA256MultiBuffer::~SHA256MultiBuffer()
+    {
+        delete _jobs;
+    }
+    
+    size_t SHA256MultiBuffer::lanes() const
+    {
+        return _jobs->kernel->lanes;
+    }
+    
+    void SHA256MultiBuffer::submitSHA256(const cc7::ByteRange & data, cc7::byte * out)
+    {
+        _MB_Job & job = _jobs->add();
+        job.data = data;
+        job.out = out;
+        job.isHMAC = false;
+        _jobs->processIfFull();
+    }
+    
+    void SHA256MultiBuffer::submitHMAC_SHA256(const cc7::ByteRange & key, const cc7::ByteRange & data, cc7::byte * out)
+    {
+        _MB_Job & job = _jobs->add();
+        job.data = data;
+        job.out = out;
+        job.isHMAC = true;
+        // Prepare padded keys. The key longer than block is hashed at first.
+        memset(job.innerPad, 0, BLOCK_SIZE);
+        if (key.size() > BLOCK_SIZE) {
+            SHA256_OneShot(key, job.innerPad);
+        } else if (!key.empty()) {
+            memcpy(job.innerPad, key.data(), key.size());
+        }
+        for (size_t i = 0; i < BLOCK_SIZE; i++) {
+            job.outerPad[i] = job.innerPad[i] ^ 0x5c;
+            job.innerPad[i] ^= 0x36;
+        }
+        _jobs->processIfFull();
+    }
+    
+    void SHA256MultiBuffer::flush()
+    {
+        utils::ScopedStatisticsTimer timer(utils::ST_Symmetric);
+        _jobs->process();
+    }
+    
+} // com::wultra::powerAuth::crypto
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
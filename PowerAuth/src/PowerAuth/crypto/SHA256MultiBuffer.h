@@ -0,0 +1,122 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cc7/ByteArray.h>
+
+/*
+ Note that all functionality provided by this header will
+ be replaced with a similar cc7 implementation.
+ */
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace crypto
+{
+    /**
+     The SHA256MultiBufferImplementation enumeration identifies kernel used
+     by the multi-buffer engine.
+     */
+    enum SHA256MultiBufferImplementation
+    {
+        /**
+         Jobs are processed one by one, with using the single buffer SHA-256 engine.
+         */
+        SHA256MB_Scalar = 0,
+        /**
+         8 lanes, processed with AVX2 instructions.
+         */
+        SHA256MB_AVX2,
+        /**
+         16 lanes, processed with AVX-512 instructions.
+         */
+        SHA256MB_AVX512,
+    };
+    
+    /**
+     Returns multi-buffer kernel selected for the current CPU. The kernel is
+     detected once, on the first use.
+     */
+    SHA256MultiBufferImplementation SHA256MultiBuffer_ActiveImplementation();
+    
+    /**
+     Forces the multi-buffer engine to use the required |implementation|. Returns false
+     if the implementation is not supported by the current CPU or was not compiled into
+     the library. The function is intended for tests and benchmarks only.
+     */
+    bool SHA256MultiBuffer_SelectImplementation(SHA256MultiBufferImplementation implementation);
+    
+    /**
+     The SHA256MultiBuffer class calculates many independent SHA-256 or HMAC-SHA256
+     digests at once. The jobs are submitted to the engine and are processed in groups,
+     each job in its own SIMD lane, once all lanes are occupied. The rest of jobs is
+     processed in `flush()`.
+     
+     All data referenced by a submitted job must stay valid until the job is processed,
+     so typically until `flush()` returns. The digest is then available in the output
+     buffer, provided to the job. The engine is not thread safe, so each thread must
+     use its own instance. Pending jobs are discarded when the engine is destroyed.
+     */
+    class SHA256MultiBuffer
+    {
+    public:
+        static const size_t DigestSize = 32;
+        
+        SHA256MultiBuffer();
+        ~SHA256MultiBuffer();
+        
+        /**
+         Returns number of jobs processed at once.
+         */
+        size_t lanes() const;
+        
+        /**
+         Submits job calculating SHA256(|data|) into |out| buffer, which must
+         be at least `DigestSize` bytes long.
+         */
+        void submitSHA256(const cc7::ByteRange & data, cc7::byte * out);
+        
+        /**
+         Submits job calculating HMAC_SHA256(|key|, |data|) into |out| buffer, which
+         must be at least `DigestSize` bytes long. Unlike the data, the key is copied
+         to the job, so it doesn't need to stay valid.
+         */
+        void submitHMAC_SHA256(const cc7::ByteRange & key, const cc7::ByteRange & data, cc7::byte * out);
+        
+        /**
+         Processes all pending jobs.
+         */
+        void flush();
+        
+    private:
+        
+        struct Jobs;
+        Jobs * _jobs;
+        
+        SHA256MultiBuffer(const SHA256MultiBuffer &) = delete;
+        SHA256MultiBuffer & operator=(const SHA256MultiBuffer &) = delete;
+    };
+    
+} // com::wultra::powerAuth::crypto
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
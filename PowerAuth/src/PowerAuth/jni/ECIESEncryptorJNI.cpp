@@ -15,7 +15,7 @@
  */
 
 #include "ECIESEncryptorJNI.h"
-#include <cc7/Base64.h>
+#include "../utils/Base64.h"
 
 // Package: com.wultra.android.powerauth.core
 #define CC7_JNI_CLASS_PATH          "com/wultra/android/powerauth/core"
@@ -100,7 +100,7 @@ CC7_JNI_METHOD_PARAMS(void, destroy, jlong handle)
 //
 CC7_JNI_METHOD_PARAMS(jlong, init, jstring publicKey, jbyteArray sharedInfo1, jbyteArray sharedInfo2)
 {
-    auto cppPublicKey = cc7::FromBase64String(cc7::jni::CopyFromJavaString(env, publicKey));
+    auto cppPublicKey = utils::FromBase64String(cc7::jni::CopyFromJavaString(env, publicKey));
     auto cppSharedInfo1 = cc7::jni::CopyFromJavaByteArray(env, sharedInfo1);
     auto cppSharedInfo2 = cc7::jni::CopyFromJavaByteArray(env, sharedInfo2);
     auto encryptor = new ECIESEncryptor(cppPublicKey, cppSharedInfo1, cppSharedInfo2);
@@ -140,7 +140,7 @@ CC7_JNI_METHOD(jstring, getPublicKey)
         CC7_ASSERT(false, "Missing internal handle.");
         return nullptr;
     }
-    auto publicKey = encryptor->publicKey().base64String();
+    auto publicKey = utils::ToBase64String(encryptor->publicKey());
     return cc7::jni::CopyToNullableJavaString(env, publicKey);
 }
 
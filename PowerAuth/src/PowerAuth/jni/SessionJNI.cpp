@@ -19,7 +19,8 @@
 #include "ProtocolVersionJNI.h"
 #include <PowerAuth/Session.h>
 #include <PowerAuth/Debug.h>
-#include <map>
+#include "../utils/Base64.h"
+#include <vector>
 
 // Package: com.wultra.android.powerauth.core
 #define CC7_JNI_CLASS_PATH          "com/wultra/android/powerauth/core"
@@ -394,22 +395,23 @@ CC7_JNI_METHOD_PARAMS(jbyteArray, prepareKeyValueDictionaryForDataSigning, jobje
         CC7_ASSERT(false, "Missing param or internal handle.");
         return NULL;
     }
-    // Copy java keys and values into std::map<string,string>
+    // Copy java keys and values into vector of pairs. The same key may appear multiple times.
     jsize keysCount = env->GetArrayLength(keys);
     if (keysCount != env->GetArrayLength(values)) {
         CC7_ASSERT(false, "Different number of keys and values.");
         return NULL;
     }
-    std::map<std::string, std::string> cppMap;
+    std::vector<std::pair<std::string, std::string>> cppPairs;
+    cppPairs.reserve(keysCount);
     for (jsize index = 0; index < keysCount; index++) {
         jstring javaKey      = (jstring) env->GetObjectArrayElement(keys, index);
         jstring javaValue    = (jstring) env->GetObjectArrayElement(values, index);
-        std::string cppKey   = cc7::jni::CopyFromJavaString(env, javaKey);
-        std::string cppValue = cc7::jni::CopyFromJavaString(env, javaValue);
-        cppMap[cppKey] = cppValue;
+        cppPairs.emplace_back(cc7::jni::CopyFromJavaString(env, javaKey), cc7::jni::CopyFromJavaString(env, javaValue));
+        env->DeleteLocalRef(javaKey);
+        env->DeleteLocalRef(javaValue);
     }
     // Call C++ session and return byte[]
-    cc7::ByteArray cppResult = Session::prepareKeyValueMapForDataSigning(cppMap);
+    cc7::ByteArray cppResult = Session::prepareKeyValuePairsForDataSigning(cppPairs);
     return cc7::jni::CopyToJavaByteArray(env, cppResult);
 }
 
@@ -731,7 +733,7 @@ CC7_JNI_METHOD(jbyteArray, generateSignatureUnlockKey)
 //
 CC7_JNI_METHOD(jstring, generateActivationStatusChallenge)
 {
-    return cc7::jni::CopyToJavaString(env, Session::generateSignatureUnlockKey().base64String());
+    return cc7::jni::CopyToJavaString(env, utils::ToBase64String(Session::generateSignatureUnlockKey()));
 }
 
 // ----------------------------------------------------------------------------
@@ -883,4 +885,84 @@ CC7_JNI_METHOD_PARAMS(jobject , getActivationRecoveryData, jstring cVaultKey, jo
     return resultObject;
 }
 
+// ----------------------------------------------------------------------------
+// Statistics
+// ----------------------------------------------------------------------------
+
+//
+// public native void setStatisticsEnabled(boolean enabled)
+//
+CC7_JNI_METHOD_PARAMS(void, setStatisticsEnabled, jboolean enabled)
+{
+    auto session = CC7_THIS_OBJ();
+    if (!session) {
+        CC7_ASSERT(false, "Missing internal handle.");
+        return;
+    }
+    session->setStatisticsEnabled(enabled);
+}
+
+//
+// public native boolean isStatisticsEnabled()
+//
+CC7_JNI_METHOD(jboolean, isStatisticsEnabled)
+{
+    auto session = CC7_THIS_OBJ();
+    if (!session) {
+        CC7_ASSERT(false, "Missing internal handle.");
+        return false;
+    }
+    return (jboolean) session->isStatisticsEnabled();
+}
+
+//
+// private native long[] getStatisticsValues()
+//
+CC7_JNI_METHOD(jlongArray, getStatisticsValues)
+{
+    auto session = CC7_THIS_OBJ();
+    if (!session) {
+        CC7_ASSERT(false, "Missing internal handle.");
+        return NULL;
+    }
+    // Keep the order in sync with SessionStatistics.java
+    SessionStatistics cppStatistics = session->statistics();
+    std::vector<jlong> values;
+    values.reserve(2 * SessionStatistics::SO_Count + 9);
+    for (auto && op : cppStatistics.operations) {
+        values.push_back((jlong)op.calls);
+    }
+    for (auto && op : cppStatistics.operations) {
+        values.push_back((jlong)op.time.count());
+    }
+    values.push_back((jlong)cppStatistics.lockWait.count());
+    values.push_back((jlong)cppStatistics.pbkdf2.count());
+    values.push_back((jlong)cppStatistics.ecc.count());
+    values.push_back((jlong)cppStatistics.symmetricCrypto.count());
+    values.push_back((jlong)cppStatistics.serialization.count());
+    values.push_back((jlong)cppStatistics.keyUnlocks);
+    values.push_back((jlong)cppStatistics.counterAdvances);
+    values.push_back((jlong)cppStatistics.lookAheadIterations);
+    values.push_back((jlong)cppStatistics.prngReseeds);
+    
+    jlongArray result = env->NewLongArray((jsize)values.size());
+    if (result) {
+        env->SetLongArrayRegion(result, 0, (jsize)values.size(), values.data());
+    }
+    return result;
+}
+
+//
+// public native void resetStatistics()
+//
+CC7_JNI_METHOD(void, resetStatistics)
+{
+    auto session = CC7_THIS_OBJ();
+    if (!session) {
+        CC7_ASSERT(false, "Missing internal handle.");
+        return;
+    }
+    session->resetStatistics();
+}
+
 CC7_JNI_MODULE_CLASS_END()
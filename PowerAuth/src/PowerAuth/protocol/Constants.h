@@ -71,6 +71,9 @@ namespace protocol
     // Length of key produced by ECDH
     const size_t SHARED_SECRET_KEY_SIZE = 32;
     
+    // Length of uncompressed public key point (0x04 || X || Y)
+    const size_t SERVER_PUBLIC_KEY_POINT_SIZE = 65;
+    
     // Length of decimalized signature, calculated from device public key
     const size_t ACTIVATION_FINGERPRINT_SIZE = 8;
     
@@ -91,6 +94,10 @@ namespace protocol
     const size_t LOOK_AHEAD_DEFAULT = 20;
     // Maximum supported look ahead.
     const size_t LOOK_AHEAD_MAX = 64;
+    // Maximum number of counter values reserved at once. Unused reserved values are
+    // skipped on the server's side, so the reservation must fit into the half of default
+    // look ahead window, to leave space for the regular signatures.
+    const size_t COUNTER_RESERVATION_MAX = LOOK_AHEAD_DEFAULT / 2;
     
 } // com::wultra::powerAuth::protocol
 } // com::wultra::powerAuth
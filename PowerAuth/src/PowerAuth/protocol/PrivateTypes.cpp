@@ -20,9 +20,10 @@
 #include "../crypto/AES.h"
 #include "../utils/DataReader.h"
 #include "../utils/DataWriter.h"
+#include "../utils/Base64.h"
+#include "../utils/Statistics.h"
 
 #include <PowerAuth/ActivationCode.h>
-#include <cc7/Base64.h>
 
 using namespace cc7;
 
@@ -46,13 +47,13 @@ namespace protocol
         if (result) {
             ByteArray foo_data;
             // app key
-            result = cc7::Base64_Decode(setup.applicationKey, 0, foo_data);
+            result = utils::Base64_Decode(setup.applicationKey, foo_data);
             result = result && !foo_data.empty();
             // app secret
-            result = result && cc7::Base64_Decode(setup.applicationSecret, 0, foo_data);
+            result = result && utils::Base64_Decode(setup.applicationSecret, foo_data);
             result = result && !foo_data.empty();
             // master pk
-            result = result && cc7::Base64_Decode(setup.masterServerPublicKey, 0, foo_data);
+            result = result && utils::Base64_Decode(setup.masterServerPublicKey, foo_data);
             result = result && !foo_data.empty();
             // optional eek
             if (result && !setup.externalEncryptionKey.empty()) {
@@ -81,6 +82,8 @@ namespace protocol
         result = result && pd.activationId.length()  > 0;
         result = result && pd.serverPublicKey.size() > 0; // && pd.devicePublicKey.size() > 0; // Check #51 issue
         result = result && pd.cDevicePrivateKey.size() > 0;
+        result = result && (!pd.flags.hasValidatedServerPublicKey || pd.serverPublicKeyPoint.size() == SERVER_PUBLIC_KEY_POINT_SIZE);
+        result = result && (pd.activationFingerprint.empty() || pd.activationFingerprint.size() == ACTIVATION_FINGERPRINT_SIZE);
         return result;
     }
     
@@ -163,6 +166,7 @@ namespace protocol
     const cc7::byte PD_VERSION_V3 = '4';    // + protocol V3
     const cc7::byte PD_VERSION_V4 = '5';    // + recovery codes
     const cc7::byte PD_VERSION_V5 = '6';    // + signature counter byte
+    const cc7::byte PD_VERSION_V6 = '7';    // + uncompressed server public key, activation fingerprint
 
     // WARNING: If you update PD_VERSION, then please update also routine
     //          located in PA2SessionStatusDataReader.m in iOS extensions project.
@@ -170,9 +174,10 @@ namespace protocol
     
     bool SerializePersistentData(const PersistentData & pd, utils::DataWriter & writer)
     {
+        utils::ScopedStatisticsTimer timer(utils::ST_Serialization);
         CC7_ASSERT(ValidatePersistentData(pd), "Invalid persistent data");
         
-        writer.openVersion(PD_TAG, pd.isV3() ? PD_VERSION_V5 : PD_VERSION_V2);
+        writer.openVersion(PD_TAG, pd.isV3() ? PD_VERSION_V6 : PD_VERSION_V2);
         
         // Serialize hash data or counter, depending on data version
         if (pd.isV3()) {
@@ -202,64 +207,108 @@ namespace protocol
         // Counter byte (PD v5)
         writer.writeByte    (pd.signatureCounterByte);
         
+        // Uncompressed server public key & activation fingerprint (PD v6)
+        writer.writeData    (pd.serverPublicKeyPoint);
+        writer.writeString  (pd.activationFingerprint);
+        
         writer.closeVersion();
         return true;
     }
     
     bool DeserializePersistentData(PersistentData & pd, utils::DataReader & reader)
     {
+        PersistentDataView view;
+        return DeserializePersistentDataView(view, reader) && MaterializePersistentData(view, pd);
+    }
+    
+    bool DeserializePersistentDataView(PersistentDataView & view, utils::DataReader & reader)
+    {
+        utils::ScopedStatisticsTimer timer(utils::ST_Serialization);
         // Open version with V2, which automatically allows deserialization of future variants.
         bool result = reader.openVersion(PD_TAG, PD_VERSION_V2);
         
         // Deserialize hash data or counter, depending on version stored in the header.
         if (reader.currentVersion() >= PD_VERSION_V3) {
-            result = result && reader.readData  (pd.signatureCounterData, SIGNATURE_KEY_SIZE);
-            pd.signatureCounter = 0;
+            result = result && reader.readRange (view.signatureCounterData, SIGNATURE_KEY_SIZE);
+            view.signatureCounter = 0;
         } else {
-            result = result && reader.readU64   (pd.signatureCounter);
-            pd.signatureCounterData.clear();
+            result = result && reader.readU64   (view.signatureCounter);
+            view.signatureCounterData = cc7::ByteRange();
         }
-        result = result && reader.readString    (pd.activationId);
-        result = result && reader.readU32       (pd.passwordIterations);
-        result = result && reader.readData      (pd.passwordSalt, PBKDF2_SALT_SIZE);
+        result = result && reader.readRange     (view.activationId);
+        result = result && reader.readU32       (view.passwordIterations);
+        result = result && reader.readRange     (view.passwordSalt, PBKDF2_SALT_SIZE);
         // signature keys
-        result = result && reader.readData      (pd.sk.possessionKey, SIGNATURE_KEY_SIZE);
-        result = result && reader.readData      (pd.sk.knowledgeKey, SIGNATURE_KEY_SIZE);
-        result = result && reader.readData      (pd.sk.biometryKey);
-        result = result && reader.readData      (pd.sk.transportKey, SIGNATURE_KEY_SIZE);
+        result = result && reader.readRange     (view.possessionKey, SIGNATURE_KEY_SIZE);
+        result = result && reader.readRange     (view.knowledgeKey, SIGNATURE_KEY_SIZE);
+        result = result && reader.readRange     (view.biometryKey);
+        result = result && reader.readRange     (view.transportKey, SIGNATURE_KEY_SIZE);
         // public keys
-        result = result && reader.readData      (pd.serverPublicKey);
-        result = result && reader.readData      (pd.devicePublicKey);
+        result = result && reader.readRange     (view.serverPublicKey);
+        result = result && reader.readRange     (view.devicePublicKey);
         // encrypted private key
-        result = result && reader.readData      (pd.cDevicePrivateKey);
+        result = result && reader.readRange     (view.cDevicePrivateKey);
         // flags
-        result = result && reader.readU32       (pd.flagsU32);
-        
-        // Copy external key flag to the SignatureKeys structure
-        pd.sk.usesExternalKey = pd.flags.usesExternalKey;
+        result = result && reader.readU32       (view.flagsU32);
         
         // encrypted recovery data (PD v4)
         if (reader.currentVersion() >= PD_VERSION_V4) {
-            result = result && reader.readData  (pd.cRecoveryData);
+            result = result && reader.readRange (view.cRecoveryData);
         } else {
-            pd.cRecoveryData.clear();
+            view.cRecoveryData = cc7::ByteRange();
         }
         
         // signature counter byte (PD v5)
         if (reader.currentVersion() >= PD_VERSION_V5) {
-            result = result && reader.readByte(pd.signatureCounterByte);
+            result = result && reader.readByte(view.signatureCounterByte);
         } else {
-            pd.flags.hasSignatureCounterByte = 0;
-            pd.signatureCounterByte = 0;
+            view.flags.hasSignatureCounterByte = 0;
+            view.signatureCounterByte = 0;
         }
         
-        // close versioned section & validate data
+        // uncompressed server public key & activation fingerprint (PD v6)
+        if (reader.currentVersion() >= PD_VERSION_V6) {
+            result = result && reader.readRange(view.serverPublicKeyPoint);
+            result = result && reader.readRange(view.activationFingerprint);
+        } else {
+            view.flags.hasValidatedServerPublicKey = 0;
+            view.serverPublicKeyPoint = cc7::ByteRange();
+            view.activationFingerprint = cc7::ByteRange();
+        }
+        
+        // close versioned section
         result = result && reader.closeVersion();
-        result = result && ValidatePersistentData(pd);
         
         return result;
     }
     
+    bool MaterializePersistentData(const PersistentDataView & view, PersistentData & pd)
+    {
+        utils::ScopedStatisticsTimer timer(utils::ST_Serialization);
+        pd.signatureCounter     = view.signatureCounter;
+        pd.signatureCounterData.assign(view.signatureCounterData.begin(), view.signatureCounterData.end());
+        pd.signatureCounterByte = view.signatureCounterByte;
+        pd.activationId         = view.activationIdString();
+        pd.passwordIterations   = view.passwordIterations;
+        pd.passwordSalt.assign(view.passwordSalt.begin(), view.passwordSalt.end());
+        pd.sk.possessionKey.assign(view.possessionKey.begin(), view.possessionKey.end());
+        pd.sk.knowledgeKey.assign(view.knowledgeKey.begin(), view.knowledgeKey.end());
+        pd.sk.biometryKey.assign(view.biometryKey.begin(), view.biometryKey.end());
+        pd.sk.transportKey.assign(view.transportKey.begin(), view.transportKey.end());
+        pd.serverPublicKey.assign(view.serverPublicKey.begin(), view.serverPublicKey.end());
+        pd.devicePublicKey.assign(view.devicePublicKey.begin(), view.devicePublicKey.end());
+        pd.cDevicePrivateKey.assign(view.cDevicePrivateKey.begin(), view.cDevicePrivateKey.end());
+        pd.cRecoveryData.assign(view.cRecoveryData.begin(), view.cRecoveryData.end());
+        pd.serverPublicKeyPoint.assign(view.serverPublicKeyPoint.begin(), view.serverPublicKeyPoint.end());
+        pd.activationFingerprint.assign(reinterpret_cast<const char*>(view.activationFingerprint.data()), view.activationFingerprint.size());
+        pd.flagsU32             = view.flagsU32;
+        
+        // Copy external key flag to the SignatureKeys structure
+        pd.sk.usesExternalKey = pd.flags.usesExternalKey;
+        
+        return ValidatePersistentData(pd);
+    }
+    
     
     //
     // MARK: - Recovery codes -
@@ -18,6 +18,7 @@
 
 #include <PowerAuth/PublicTypes.h>
 #include <openssl/ec.h>
+#include <chrono>
 
 // Forward declarations
 
@@ -77,6 +78,7 @@ namespace protocol
         
         std::string     activationCode;         // Step1: short activation ID
         std::string     activationId;           // Step2: Full activation ID
+        std::string     activationFingerprint;  // Step2: Activation fingerprint
         
         // Information generated or received during the activation
         
@@ -126,6 +128,154 @@ namespace protocol
     };
     
     
+    /**
+     The TransportKeys structure contains the transport key together with keys derived
+     from it, used for the activation status decryption and for the counter synchronization.
+     The keys are wiped from the memory when the structure is destroyed.
+     */
+    struct TransportKeys
+    {
+        /**
+         KEY_TRANSPORT
+         */
+        cc7::ByteArray      transportKey;
+        /**
+         KEY_TRANSPORT_IV, derived from KEY_TRANSPORT with index 3000.
+         */
+        cc7::ByteArray      transportIvKey;
+        /**
+         KEY_TRANSPORT_CTR, derived from KEY_TRANSPORT with index 4000.
+         */
+        cc7::ByteArray      transportCtrKey;
+        
+        ~TransportKeys()
+        {
+            clear();
+        }
+        
+        /**
+         Returns true if structure contains no keys.
+         */
+        bool empty() const
+        {
+            return transportKey.empty();
+        }
+        
+        /**
+         Wipes all keys from the memory.
+         */
+        void clear()
+        {
+            transportKey.secureClear();
+            transportIvKey.secureClear();
+            transportCtrKey.secureClear();
+        }
+    };
+    
+    
+    /**
+     The SignatureBatchItem structure contains input and output for one signature
+     calculated with `CalculateSignatures()`.
+     */
+    struct SignatureBatchItem
+    {
+        /**
+         Counter data for the signature.
+         */
+        cc7::ByteArray      ctrData;
+        /**
+         Normalized data for signing. The referenced data must exist
+         during the signature calculation.
+         */
+        cc7::ByteRange      data;
+        /**
+         If true, then online signature in Base64 format is calculated,
+         otherwise the decimalized format is used.
+         */
+        bool                base64Format;
+        /**
+         Calculated signature.
+         */
+        std::string         signature;
+        
+        SignatureBatchItem() :
+            base64Format(false)
+        {
+        }
+    };
+    
+    
+    /**
+     The UnlockedSignatureKeys structure keeps signature keys unlocked with
+     `Session::unlockSignatureKeys()` together with limits for their usage.
+     The keys are wiped from the memory when the structure is destroyed.
+     */
+    struct UnlockedSignatureKeys
+    {
+        /**
+         Unlocked keys. The transport key is available only if possession
+         factor was unlocked.
+         */
+        SignatureKeys keys;
+        /**
+         Factors unlocked in the keys structure.
+         */
+        SignatureFactor factor;
+        /**
+         Number of remaining operations. Valid only if hasUseLimit is true.
+         */
+        cc7::U32 remainingUseCount;
+        /**
+         Keys are no longer usable after this time. Valid only if hasTimeLimit is true.
+         */
+        std::chrono::steady_clock::time_point expirationTime;
+        
+        bool hasUseLimit;
+        bool hasTimeLimit;
+        
+        UnlockedSignatureKeys(SignatureFactor factor, const UnlockedSignatureKeysLimits & limits) :
+            factor(factor),
+            remainingUseCount(limits.maxUseCount),
+            expirationTime(std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.maxTimeInterval)),
+            hasUseLimit(limits.maxUseCount > 0),
+            hasTimeLimit(limits.maxTimeInterval > 0)
+        {
+        }
+        
+        ~UnlockedSignatureKeys()
+        {
+            keys.possessionKey.secureClear();
+            keys.knowledgeKey.secureClear();
+            keys.biometryKey.secureClear();
+            keys.transportKey.secureClear();
+        }
+        
+        /**
+         Returns true if keys can be used for next operation.
+         */
+        bool canBeUsed() const
+        {
+            if (hasUseLimit && remainingUseCount == 0) {
+                return false;
+            }
+            if (hasTimeLimit && std::chrono::steady_clock::now() >= expirationTime) {
+                return false;
+            }
+            return true;
+        }
+        
+        /**
+         Decreases number of remaining operations.
+         */
+        void markUsed()
+        {
+            if (hasUseLimit && remainingUseCount > 0) {
+                remainingUseCount--;
+            }
+        }
+    };
+    
+    
     /**
      The PersistentData structure contains information about valid activation.
      This data structure must be completely serialized into the persistent storage.
@@ -177,6 +327,15 @@ namespace protocol
          Encrypted recovery data.
          */
         cc7::ByteArray  cRecoveryData;
+        /**
+         V3.2: Server's public key in uncompressed form. The point is valid only
+         when `flags.hasValidatedServerPublicKey` is set.
+         */
+        cc7::ByteArray  serverPublicKeyPoint;
+        /**
+         V3.2: Cached activation fingerprint, or empty string if not calculated yet.
+         */
+        std::string     activationFingerprint;
 
         struct _Flags {
             /**
@@ -197,6 +356,10 @@ namespace protocol
              True if `signatureCounterByte` is valid and can be used for calculations.
              */
             cc7::U32    hasSignatureCounterByte : 1;
+            /**
+             True if `serverPublicKeyPoint` contains already validated server's public key.
+             */
+            cc7::U32    hasValidatedServerPublicKey : 1;
         };
         union {
             _Flags      flags;
@@ -229,6 +392,61 @@ namespace protocol
     };
     
     
+    /**
+     The PersistentDataView structure contains the same information as PersistentData,
+     but all variable length fields are only views into the serialized data. The structure
+     is produced by `DeserializePersistentDataView()` without any memory allocation, so the
+     serialized data must remain valid and unchanged while the view is in use.
+     */
+    struct PersistentDataView
+    {
+        cc7::U64        signatureCounter;
+        cc7::ByteRange  signatureCounterData;
+        cc7::byte       signatureCounterByte;
+        cc7::ByteRange  activationId;
+        cc7::U32        passwordIterations;
+        cc7::ByteRange  passwordSalt;
+        cc7::ByteRange  possessionKey;
+        cc7::ByteRange  knowledgeKey;
+        cc7::ByteRange  biometryKey;
+        cc7::ByteRange  transportKey;
+        cc7::ByteRange  serverPublicKey;
+        cc7::ByteRange  devicePublicKey;
+        cc7::ByteRange  cDevicePrivateKey;
+        cc7::ByteRange  cRecoveryData;
+        cc7::ByteRange  serverPublicKeyPoint;
+        cc7::ByteRange  activationFingerprint;
+        union {
+            PersistentData::_Flags  flags;
+            cc7::U32                flagsU32;
+        };
+        
+        PersistentDataView() :
+            signatureCounter(0),
+            signatureCounterByte(0),
+            passwordIterations(0),
+            flagsU32(0)
+        {
+        }
+        
+        /**
+         Returns version of protocol, depending on data referenced in the structure.
+         */
+        inline Version protocolVersion() const
+        {
+            return signatureCounterData.empty() ? Version_V2 : Version_V3;
+        }
+        
+        /**
+         Returns activation identifier as a string.
+         */
+        inline std::string activationIdString() const
+        {
+            return std::string(reinterpret_cast<const char*>(activationId.data()), activationId.size());
+        }
+    };
+    
+    
     /**
      The SignatureUnlockKeysReq is internal structure and helps with internal keys
      locking & unlocking. All objects referenced in the structure must still exist and
@@ -317,6 +535,19 @@ namespace protocol
      Returns false if the byte stream contains invalid data.
      */
     bool DeserializePersistentData(PersistentData & pd, utils::DataReader & reader);
+    
+    /**
+     Deserializes a persistent data from the |reader| into the |view|. Unlike `DeserializePersistentData()`,
+     the function doesn't copy any data and validates only the structure of the byte stream. The content
+     is validated later, in `MaterializePersistentData()`. Returns false if the byte stream is malformed.
+     */
+    bool DeserializePersistentDataView(PersistentDataView & view, utils::DataReader & reader);
+    
+    /**
+     Copies all data referenced in |view| into the |pd| structure and validates the result.
+     Returns false if the persistent data is not valid.
+     */
+    bool MaterializePersistentData(const PersistentDataView & view, PersistentData & pd);
 
     
     //
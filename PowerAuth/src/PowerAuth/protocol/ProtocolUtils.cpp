@@ -18,8 +18,12 @@
 #include "Constants.h"
 #include "../crypto/CryptoUtils.h"
 #include "../utils/DataReader.h"
-#include <cc7/Base64.h>
+#include "../utils/Base64.h"
+#include "../utils/Statistics.h"
+#include "../utils/Tracing.h"
 #include <cc7/Endian.h>
+#include <openssl/crypto.h>
+#include <algorithm>
 
 namespace com
 {
@@ -45,7 +49,7 @@ namespace protocol
             return true;
         }
         cc7::ByteArray signature;
-        bool result = signature.readFromBase64String(sig);
+        bool result = utils::Base64_Decode(sig, signature);
         if (!result || signature.empty()) {
             return false;
         }
@@ -232,6 +236,8 @@ namespace protocol
     // TODO: return ErrorCode
     bool UnlockSignatureKeys(SignatureKeys & plain, const SignatureKeys & secret, const SignatureUnlockKeysReq & request)
     {
+        PA_TRACE_SCOPE(TP_UnlockSignatureKeys, request.factor);
+        utils::Statistics_Count(utils::SC_KeyUnlock);
         if (request.keys == nullptr) {
             CC7_ASSERT(false, "request.keys pointer is required parameter");
             return false;
@@ -362,11 +368,20 @@ namespace protocol
      */
     inline cc7::ByteArray _NextCounterValue(const cc7::ByteRange & prev)
     {
-        return ReduceSharedSecret(crypto::SHA256(prev));
+        // The counter fits into one SHA256 block, so hash it on the stack and reduce
+        // the digest directly, without intermediate allocations.
+        cc7::byte hash[crypto::SHA256Context::DigestSize];
+        crypto::SHA256_OneShot(prev, hash);
+        cc7::ByteArray next(sizeof(hash) / 2, 0);
+        for (size_t i = 0; i < next.size(); i++) {
+            next[i] = hash[i] ^ hash[i + sizeof(hash) / 2];
+        }
+        return next;
     }
     
     void CalculateNextCounterValue(PersistentData & pd)
     {
+        utils::Statistics_Count(utils::SC_CounterAdvance);
         if (pd.isV3()) {
             // Move hash-based counter forward. Vault unlock is ignored in V3
             pd.signatureCounterData = _NextCounterValue(pd.signatureCounterData);
@@ -381,73 +396,262 @@ namespace protocol
         }
     }
     
+    cc7::ByteArray CalculateNextCounterData(const cc7::ByteRange & ctr_data)
+    {
+        return _NextCounterValue(ctr_data);
+    }
     
-    std::string CalculateSignature(const SignatureKeys & sk, SignatureFactor factor, const cc7::ByteRange & ctr_data, const cc7::ByteRange & data, bool base64_format)
+    
+    //
+    // MARK: - Signature calculation kernels -
+    //
+    
+    /**
+     Returns number of keys involved in the signature calculated for |factor|.
+     */
+    static constexpr size_t _FactorKeysCount(SignatureFactor factor)
+    {
+        return ((factor & SF_Possession) != 0 ? 1 : 0) +
+               ((factor & SF_Knowledge)  != 0 ? 1 : 0) +
+               ((factor & SF_Biometry)   != 0 ? 1 : 0);
+    }
+    
+    /**
+     Returns factor bit for key index (0 for possession, 1 for knowledge, 2 for biometry).
+     */
+    static constexpr SignatureFactor _KeyIndexToFactor(int key_index)
+    {
+        return key_index == 0 ? SF_Possession : (key_index == 1 ? SF_Knowledge : SF_Biometry);
+    }
+    
+    /**
+     Returns key index (0 for possession, 1 for knowledge, 2 for biometry) of key at |position|
+     in linear sequence of keys involved in the signature calculated for |factor|.
+     */
+    static constexpr int _FactorKeyIndex(SignatureFactor factor, size_t position, int key_index = 0)
+    {
+        return key_index > 2
+                ? -1
+                : ((factor & _KeyIndexToFactor(key_index)) != 0
+                    ? (position == 0 ? key_index : _FactorKeyIndex(factor, position - 1, key_index + 1))
+                    : _FactorKeyIndex(factor, position, key_index + 1));
+    }
+    
+    /**
+     Returns signature key for given key index.
+     */
+    static inline const cc7::ByteArray & _SignatureKey(const SignatureKeys & sk, int key_index)
+    {
+        return key_index == 0 ? sk.possessionKey : (key_index == 1 ? sk.knowledgeKey : sk.biometryKey);
+    }
+    
+    /**
+     Writes 8 digits long decimalized signature calculated from 32 bytes long |signature|
+     into |out| buffer. The algorithm is the same as in `CalculateDecimalizedSignature()`.
+     */
+    static inline void _WriteDecimalizedSignature(const cc7::byte * signature, char * out)
     {
-        // Prepare keys into one linear vector
-        std::vector<const cc7::ByteArray*> keys;
-        if ((factor & SF_Possession) != 0) {
-            keys.push_back(&sk.possessionKey);
+        const cc7::byte * p = signature + 32 - 4;
+        cc7::U32 dbc = (p[0] & 0x7F) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+        dbc = dbc % 100000000;
+        for (int i = 7; i >= 0; i--) {
+            out[i] = (char)('0' + dbc % 10);
+            dbc /= 10;
         }
-        if ((factor & SF_Knowledge) != 0) {
-            keys.push_back(&sk.knowledgeKey);
+    }
+    
+    /**
+     Signature calculation kernel specialized for one combination of factors and
+     for one output format. The number of keys and the keys selection is resolved
+     in compile time, so all loops have constant bounds and all intermediate results
+     are kept in fixed size stack buffers.
+     */
+    template <SignatureFactor Factor, bool Base64Format>
+    static std::string _SignatureKernel(const SignatureKeys & sk, const cc7::ByteRange & ctr_data, const cc7::ByteRange & data)
+    {
+        static constexpr size_t KEYS_COUNT = _FactorKeysCount(Factor);
+        static constexpr size_t BUFFER_COUNT = KEYS_COUNT > 0 ? KEYS_COUNT : 1;
+        static constexpr size_t HMAC_SIZE = 32;
+        static constexpr size_t DECIMAL_SIZE = 8;
+        
+        cc7::byte base_keys[BUFFER_COUNT][HMAC_SIZE];
+        cc7::byte derived_key[HMAC_SIZE];
+        cc7::byte hmac_result[HMAC_SIZE];
+        cc7::byte signature_bytes[BUFFER_COUNT * 16];
+        char signature_chars[BUFFER_COUNT * (DECIMAL_SIZE + 1)];
+        
+        bool result = true;
+        // Derive keys from counter and from each involved factor's key. Each such key
+        // is used several times in the chain below, so it's calculated only once.
+        for (size_t i = 0; i < KEYS_COUNT && result; i++) {
+            result = crypto::HMAC_SHA256_ToBuffer(ctr_data, _SignatureKey(sk, _FactorKeyIndex(Factor, i)), base_keys[i]);
         }
-        if ((factor & SF_Biometry) != 0) {
-            keys.push_back(&sk.biometryKey);
+        // Now calculate signature for all involved factors.
+        for (size_t i = 0; i < KEYS_COUNT && result; i++) {
+            memcpy(derived_key, base_keys[i], HMAC_SIZE);
+            for (size_t j = 0; j < i && result; j++) {
+                // Note that the chain is using key at "j + 1" position. This is how
+                // the algorithm is specified, so the server calculates the same.
+                result = crypto::HMAC_SHA256_ToBuffer(cc7::ByteRange(derived_key, HMAC_SIZE), cc7::ByteRange(base_keys[j + 1], HMAC_SIZE), hmac_result);
+                memcpy(derived_key, hmac_result, HMAC_SIZE);
+            }
+            // Calculate HMAC for given data
+            result = result && crypto::HMAC_SHA256_ToBuffer(data, cc7::ByteRange(derived_key, HMAC_SIZE), hmac_result);
+            if (result) {
+                if (Base64Format) {
+                    // For new online signature, just keep last 16 bytes of HMAC result.
+                    memcpy(signature_bytes + i * 16, hmac_result + 16, 16);
+                } else {
+                    // Offline signature is using old, decimalized format.
+                    char * out = signature_chars + i * (DECIMAL_SIZE + 1);
+                    if (i > 0) {
+                        out[-1] = DASH[0];
+                    }
+                    _WriteDecimalizedSignature(hmac_result, out);
+                }
+            }
         }
-        
-        // Pepare byte array for online signature or final string for offline signature.
-        cc7::ByteArray signature_bytes;
         std::string signature_string;
+        if (result) {
+            if (Base64Format) {
+                signature_string.resize(utils::Base64_EncodedLength(KEYS_COUNT * 16));
+                utils::Base64_EncodeToBuffer(cc7::ByteRange(signature_bytes, KEYS_COUNT * 16), &signature_string[0]);
+            } else if (KEYS_COUNT > 0) {
+                signature_string.assign(signature_chars, KEYS_COUNT * (DECIMAL_SIZE + 1) - 1);
+            }
+        } else {
+            CC7_ASSERT(false, "HMAC_SHA256() calculation failed.");
+        }
+        // Keep no sensitive data on the stack
+        OPENSSL_cleanse(base_keys, sizeof(base_keys));
+        OPENSSL_cleanse(derived_key, sizeof(derived_key));
+        OPENSSL_cleanse(hmac_result, sizeof(hmac_result));
+        OPENSSL_cleanse(signature_bytes, sizeof(signature_bytes));
+        OPENSSL_cleanse(signature_chars, sizeof(signature_chars));
+        return signature_string;
+    }
+    
+    typedef std::string (*SignatureKernel)(const SignatureKeys & sk, const cc7::ByteRange & ctr_data, const cc7::ByteRange & data);
+    
+    /**
+     Table of signature kernels, indexed by `_SignatureKernelIndex()` and by output format.
+     The table contains also combinations not available in the public interface, to keep
+     the behavior of `CalculateSignature()` defined for an arbitrary factor.
+     */
+    static const SignatureKernel s_signature_kernels[8][2] =
+    {
+        { _SignatureKernel<0, false>,                                   _SignatureKernel<0, true>                                   },
+        { _SignatureKernel<SF_Possession, false>,                       _SignatureKernel<SF_Possession, true>                       },
+        { _SignatureKernel<SF_Knowledge, false>,                        _SignatureKernel<SF_Knowledge, true>                        },
+        { _SignatureKernel<SF_Possession_Knowledge, false>,             _SignatureKernel<SF_Possession_Knowledge, true>             },
+        { _SignatureKernel<SF_Biometry, false>,                         _SignatureKernel<SF_Biometry, true>                         },
+        { _SignatureKernel<SF_Possession_Biometry, false>,              _SignatureKernel<SF_Possession_Biometry, true>              },
+        { _SignatureKernel<SF_Knowledge | SF_Biometry, false>,          _SignatureKernel<SF_Knowledge | SF_Biometry, true>          },
+        { _SignatureKernel<SF_Possession_Knowledge_Biometry, false>,    _SignatureKernel<SF_Possession_Knowledge_Biometry, true>    },
+    };
+    
+    /**
+     Returns index to `s_signature_kernels` table for given |factor|. Bits other than
+     possession, knowledge and biometry are ignored.
+     */
+    static inline size_t _SignatureKernelIndex(SignatureFactor factor)
+    {
+        return ((factor & SF_Possession) != 0 ? 1 : 0) |
+               ((factor & SF_Knowledge)  != 0 ? 2 : 0) |
+               ((factor & SF_Biometry)   != 0 ? 4 : 0);
+    }
+    
+    std::string CalculateSignature(const SignatureKeys & sk, SignatureFactor factor, const cc7::ByteRange & ctr_data, const cc7::ByteRange & data, bool base64_format)
+    {
+        PA_TRACE_SCOPE(TP_CalculateSignature, 1);
+        SignatureKernel kernel = s_signature_kernels[_SignatureKernelIndex(factor)][base64_format ? 1 : 0];
+        return kernel(sk, ctr_data, data);
+    }
+    
+    /**
+     Formats signature from |keys_count| HMAC results, stored in |hmac_results| buffer.
+     The format is the same as in `_SignatureKernel()`.
+     */
+    static std::string _FormatSignature(const cc7::byte * hmac_results, size_t keys_count, bool base64_format)
+    {
+        std::string signature;
         if (base64_format) {
-            signature_bytes.reserve(keys.size() * 16);
+            // Keep last 16 bytes of each HMAC result.
+            cc7::byte signature_bytes[3 * 16];
+            for (size_t i = 0; i < keys_count; i++) {
+                memcpy(signature_bytes + i * 16, hmac_results + i * 32 + 16, 16);
+            }
+            signature = utils::ToBase64String(cc7::ByteRange(signature_bytes, keys_count * 16));
+            OPENSSL_cleanse(signature_bytes, sizeof(signature_bytes));
         } else {
-            signature_string.reserve(keys.size() * 8 + keys.size() - 1);
+            char decimal[8];
+            for (size_t i = 0; i < keys_count; i++) {
+                if (i > 0) {
+                    signature.push_back(DASH[0]);
+                }
+                _WriteDecimalizedSignature(hmac_results + i * 32, decimal);
+                signature.append(decimal, sizeof(decimal));
+            }
+            OPENSSL_cleanse(decimal, sizeof(decimal));
         }
-        // Now calculate signature for all involved factors.
-        for (size_t i = 0; i < keys.size(); i++) {
-            // Outer loop, for over key in the vector.
-            const cc7::ByteArray & signature_key = *keys[i];
-            auto derived_key = crypto::HMAC_SHA256(ctr_data, signature_key);
-            if (derived_key.size() == 0) {
-                CC7_ASSERT(false, "HMAC_SHA256() calculation failed.");
-                return std::string();
+        return signature;
+    }
+    
+    bool CalculateSignatures(const SignatureKeys & sk, SignatureFactor factor, std::vector<SignatureBatchItem> & items)
+    {
+        PA_TRACE_SCOPE(TP_CalculateSignature, items.size());
+        static const size_t HMAC_SIZE = 32;
+        const size_t keys_count = _FactorKeysCount(factor);
+        const size_t count = items.size();
+        if (keys_count == 0) {
+            CC7_ASSERT(false, "No signature key for factor.");
+            return false;
+        }
+        // The algorithm is the same as in `_SignatureKernel()`, but each step is calculated for
+        // all items and all keys at once. The buffer contains base keys, derived keys and HMAC
+        // results, for each item and each involved key.
+        enum { BASE_KEY = 0, DERIVED_KEY = 1, HMAC_RESULT = 2 };
+        std::vector<cc7::byte> buffer(3 * count * keys_count * HMAC_SIZE);
+        auto slot = [&](size_t kind, size_t item, size_t key) -> cc7::byte * {
+            return buffer.data() + ((kind * count + item) * keys_count + key) * HMAC_SIZE;
+        };
+        crypto::SHA256MultiBuffer engine;
+        // Derive keys from counter and from each involved factor's key.
+        for (size_t n = 0; n < count; n++) {
+            for (size_t i = 0; i < keys_count; i++) {
+                engine.submitHMAC_SHA256(_SignatureKey(sk, _FactorKeyIndex(factor, i)), items[n].ctrData, slot(BASE_KEY, n, i));
             }
-            for (size_t j = 0; j < i; j++) {
-                const cc7::ByteArray & signature_key_inner = *keys[j + 1];
-                auto derived_key_inner = crypto::HMAC_SHA256(ctr_data, signature_key_inner);
-                derived_key = crypto::HMAC_SHA256(derived_key, derived_key_inner);
-                if (derived_key.size() == 0) {
-                    CC7_ASSERT(false, "HMAC_SHA256() calculation failed.");
-                    return std::string();
+        }
+        engine.flush();
+        for (size_t n = 0; n < count; n++) {
+            memcpy(slot(DERIVED_KEY, n, 0), slot(BASE_KEY, n, 0), keys_count * HMAC_SIZE);
+        }
+        // Key at position i is chained with keys at positions 1...i, so in step j,
+        // all keys at position greater than j are moved forward.
+        for (size_t j = 0; j + 1 < keys_count; j++) {
+            for (size_t n = 0; n < count; n++) {
+                for (size_t i = j + 1; i < keys_count; i++) {
+                    engine.submitHMAC_SHA256(cc7::ByteRange(slot(BASE_KEY, n, j + 1), HMAC_SIZE), cc7::ByteRange(slot(DERIVED_KEY, n, i), HMAC_SIZE), slot(HMAC_RESULT, n, i));
                 }
             }
-            // Calculate HMAC for given data
-            auto signature_factor_bytes = crypto::HMAC_SHA256(data, derived_key);
-            if (signature_factor_bytes.size() == 0) {
-                CC7_ASSERT(false, "HMAC_SHA256() calculation failed.");
-                return std::string();
+            engine.flush();
+            for (size_t n = 0; n < count; n++) {
+                memcpy(slot(DERIVED_KEY, n, j + 1), slot(HMAC_RESULT, n, j + 1), (keys_count - j - 1) * HMAC_SIZE);
             }
-            if (base64_format) {
-                // For new online signature, just append last 16 bytes of HMAC result.
-                // We'll calculate final signature string later.
-                signature_bytes.append(signature_factor_bytes.byteRange().subRangeFrom(16));
-            } else {
-                // Offline signature is using old, decimalized format.
-                auto signature_factor = CalculateDecimalizedSignature(signature_factor_bytes);
-                if (!signature_string.empty()) {
-                    signature_string.append(DASH);
-                }
-                signature_string.append(signature_factor);
+        }
+        // Calculate HMAC for data
+        for (size_t n = 0; n < count; n++) {
+            for (size_t i = 0; i < keys_count; i++) {
+                engine.submitHMAC_SHA256(cc7::ByteRange(slot(DERIVED_KEY, n, i), HMAC_SIZE), items[n].data, slot(HMAC_RESULT, n, i));
             }
         }
-        if (base64_format) {
-            // Now calculate a final Base64 string for online signature
-            cc7::Base64_Encode(signature_bytes, 0, signature_string);
+        engine.flush();
+        for (size_t n = 0; n < count; n++) {
+            items[n].signature = _FormatSignature(slot(HMAC_RESULT, n, 0), keys_count, items[n].base64Format);
         }
-        // Otherwise, for offline signature, just return the result which already
-        // contains the final string.
-        return signature_string;
+        // Keep no sensitive data in the memory
+        OPENSSL_cleanse(buffer.data(), buffer.size());
+        return true;
     }
     
     
@@ -457,22 +661,24 @@ namespace protocol
                                              const cc7::ByteRange & body,
                                              const std::string & app_secret)
     {
-        std::string body_b64 = cc7::ToBase64String(body);
-        std::string uri_b64  = cc7::ToBase64String(cc7::MakeRange(uri));
+        const size_t uri_b64_size  = utils::Base64_EncodedLength(uri.size());
+        const size_t body_b64_size = utils::Base64_EncodedLength(body.size());
         
-        cc7::ByteArray data_for_signing;
-        data_for_signing.reserve(method.size() + uri_b64.size() + nonce_b64.size() + body_b64.size() + app_secret.size() + 5);
+        // Allocate the whole buffer at once. Both URI and body are then encoded
+        // directly into the buffer, so no temporary strings are required.
+        cc7::ByteArray data_for_signing(method.size() + uri_b64_size + nonce_b64.size() + body_b64_size + app_secret.size() + 4, '&');
+        char * out = reinterpret_cast<char*>(data_for_signing.data());
         
         // Construct data for signing
-        data_for_signing.assign(method.begin(), method.end());
-        data_for_signing.push_back('&');
-        data_for_signing.append(uri_b64.begin(), uri_b64.end());
-        data_for_signing.push_back('&');
-        data_for_signing.append(nonce_b64.begin(), nonce_b64.end());
-        data_for_signing.push_back('&');
-        data_for_signing.append(body_b64.begin(), body_b64.end());
-        data_for_signing.push_back('&');
-        data_for_signing.append(app_secret.begin(), app_secret.end());
+        out = std::copy(method.begin(), method.end(), out);
+        out += 1;   // '&'
+        out += utils::Base64_EncodeToBuffer(cc7::MakeRange(uri), out);
+        out += 1;   // '&'
+        out = std::copy(nonce_b64.begin(), nonce_b64.end(), out);
+        out += 1;   // '&'
+        out += utils::Base64_EncodeToBuffer(body, out);
+        out += 1;   // '&'
+        std::copy(app_secret.begin(), app_secret.end(), out);
         
         return data_for_signing;
     }
@@ -542,8 +748,6 @@ namespace protocol
         EC_KEY * device_public_key = nullptr;
         EC_KEY * server_public_key = nullptr;
         do {
-            crypto::BNContext ctx;
-            
             // Import device's public key
             device_public_key = crypto::ECC_ImportPublicKey(nullptr, device_pub_key, ctx);
             auto device_coord_x = crypto::ECC_ExportPublicKeyToNormalizedForm(device_public_key, ctx);
@@ -589,23 +793,48 @@ namespace protocol
     // MARK: - Encrypted status -
     //
 
+    bool DeriveTransportKeys(const cc7::ByteRange & transport_key, TransportKeys & out)
+    {
+        out.transportKey    = transport_key;
+        out.transportIvKey  = DeriveSecretKey(transport_key, 3000);
+        out.transportCtrKey = DeriveSecretKey(transport_key, 4000);
+        if (out.transportKey.empty() || out.transportIvKey.empty() || out.transportCtrKey.empty()) {
+            out.clear();
+            return false;
+        }
+        return true;
+    }
+    
     ErrorCode DecryptEncryptedStatusBlob(const cc7::ByteRange & encrypted_status_blob,
                                          const cc7::ByteRange & challenge,
                                          const cc7::ByteRange & nonce,
                                          const cc7::ByteRange & transport_key,
                                          ActivationStatus & out_status)
+    {
+        TransportKeys transport_keys;
+        if (!DeriveTransportKeys(transport_key, transport_keys)) {
+            return EC_Encryption;
+        }
+        return DecryptEncryptedStatusBlob(encrypted_status_blob, challenge, nonce, transport_keys, out_status);
+    }
+    
+    ErrorCode DecryptEncryptedStatusBlob(const cc7::ByteRange & encrypted_status_blob,
+                                         const cc7::ByteRange & challenge,
+                                         const cc7::ByteRange & nonce,
+                                         const TransportKeys & transport_keys,
+                                         ActivationStatus & out_status)
     {
         if (encrypted_status_blob.size() != protocol::STATUS_BLOB_SIZE) {
             // Considered as an attack on protocol
             return EC_Encryption;
         }
         // Prepare IV for status blob decryption
-        auto status_iv = protocol::DeriveIVForStatusBlobDecryption(challenge, nonce, transport_key);
+        auto status_iv = protocol::DeriveIVForStatusBlobDecryption(challenge, nonce, transport_keys);
         if (status_iv.empty()) {
             return EC_Encryption;
         }
         // Decrypt blob and initialize reader for data parsing.
-        utils::DataReader reader(crypto::AES_CBC_Decrypt(transport_key, status_iv, encrypted_status_blob));
+        utils::DataReader reader(crypto::AES_CBC_Decrypt(transport_keys.transportKey, status_iv, encrypted_status_blob));
         cc7::ByteRange hdr;
         cc7::ByteArray server_ctr_data;
         cc7::byte state = 0xdd, fail_ctr = 0xdd, max_fail_ctr = 0xdd;
@@ -655,15 +884,24 @@ namespace protocol
     cc7::ByteArray DeriveIVForStatusBlobDecryption(const cc7::ByteRange & challenge,
                                                    const cc7::ByteRange & nonce,
                                                    const cc7::ByteRange & transport_key)
+    {
+        // Derive base IV key from transport key
+        TransportKeys transport_keys;
+        transport_keys.transportKey = transport_key;
+        transport_keys.transportIvKey = DeriveSecretKey(transport_key, 3000);
+        return DeriveIVForStatusBlobDecryption(challenge, nonce, transport_keys);
+    }
+    
+    cc7::ByteArray DeriveIVForStatusBlobDecryption(const cc7::ByteRange & challenge,
+                                                   const cc7::ByteRange & nonce,
+                                                   const TransportKeys & transport_keys)
     {
         if (CC7_CHECK(challenge.size() == STATUS_BLOB_CHALLENGE_SIZE && nonce.size() == STATUS_BLOB_NONCE_SIZE)) {
-            // Derive base IV key from transport key
-            auto key_transport_iv = DeriveSecretKey(transport_key, 3000);
             // Prepare STATUS_IV_DATA
             cc7::ByteArray status_iv_data = challenge;
             status_iv_data.append(nonce);
             // KDF_INTERNAL
-            return DeriveSecretKeyFromIndex(key_transport_iv, status_iv_data);
+            return DeriveSecretKeyFromIndex(transport_keys.transportIvKey, status_iv_data);
         }
         // In case of failure, return empty array.
         return cc7::ByteArray();
@@ -674,16 +912,51 @@ namespace protocol
                                      const cc7::ByteRange & transport_key,
                                      int max_iterations)
     {
-        auto key_transport_ctr = DeriveSecretKey(transport_key, 4000);
+        TransportKeys transport_keys;
+        transport_keys.transportKey = transport_key;
+        transport_keys.transportCtrKey = DeriveSecretKey(transport_key, 4000);
+        return CalculateHashCounterDistance(local_ctr_data, server_ctr_data_hash, transport_keys, max_iterations);
+    }
+    
+    int CalculateHashCounterDistance(cc7::ByteArray & local_ctr_data,
+                                     const cc7::ByteRange & server_ctr_data_hash,
+                                     const TransportKeys & transport_keys,
+                                     int max_iterations)
+    {
+        PA_TRACE_SCOPE(TP_CalculateHashCounterDistance, max_iterations);
+        const cc7::ByteArray & key_transport_ctr = transport_keys.transportCtrKey;
+        if (key_transport_ctr.size() != SIGNATURE_KEY_SIZE || local_ctr_data.size() < SIGNATURE_KEY_SIZE) {
+            CC7_ASSERT(false, "Provided key or counter data has wrong size.");
+            return -1;
+        }
+        // Counter values are calculated one by one, but the hashes of counters in the look ahead
+        // window are independent, so they're calculated in groups, as wide as multi-buffer engine.
+        crypto::SHA256MultiBuffer engine;
+        const size_t lanes = engine.lanes();
+        std::vector<cc7::ByteArray> group_ctr_data(lanes);
+        std::vector<cc7::byte> group_hashes(lanes * crypto::SHA256MultiBuffer::DigestSize);
         int iteration = 0;
-        while (max_iterations > 0) {
-            auto local_ctr_data_hash = DeriveSecretKeyFromIndex(key_transport_ctr, local_ctr_data);
-            if (local_ctr_data_hash == server_ctr_data_hash) {
-                return iteration;
+        while (iteration < max_iterations) {
+            const size_t group_size = std::min(lanes, (size_t)(max_iterations - iteration));
+            for (size_t g = 0; g < group_size; g++) {
+                group_ctr_data[g] = local_ctr_data;
+                engine.submitHMAC_SHA256(key_transport_ctr, group_ctr_data[g], &group_hashes[g * crypto::SHA256MultiBuffer::DigestSize]);
+                local_ctr_data = _NextCounterValue(local_ctr_data);
+            }
+            engine.flush();
+            utils::Statistics_Count(utils::SC_LookAheadIteration, group_size);
+            for (size_t g = 0; g < group_size; g++) {
+                // Reduce HMAC in the same way as DeriveSecretKeyFromIndex() does.
+                cc7::byte * hash = &group_hashes[g * crypto::SHA256MultiBuffer::DigestSize];
+                for (size_t i = 0; i < SIGNATURE_KEY_SIZE; i++) {
+                    hash[i] ^= hash[i + SIGNATURE_KEY_SIZE];
+                }
+                if (server_ctr_data_hash.size() == SIGNATURE_KEY_SIZE && memcmp(hash, server_ctr_data_hash.data(), SIGNATURE_KEY_SIZE) == 0) {
+                    local_ctr_data = group_ctr_data[g];
+                    return iteration + (int)g;
+                }
             }
-            local_ctr_data = _NextCounterValue(local_ctr_data);
-            ++iteration;
-            --max_iterations;
+            iteration += (int)group_size;
         }
         return -1;
     }
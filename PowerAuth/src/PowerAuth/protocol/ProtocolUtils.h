@@ -93,6 +93,11 @@ namespace protocol
      */
     void CalculateNextCounterValue(PersistentData & pd);
     
+    /**
+     Returns V3 hash-based counter value, following the |ctr_data|.
+     */
+    cc7::ByteArray CalculateNextCounterData(const cc7::ByteRange & ctr_data);
+    
     /**
      Calculates multi-factor online or offline signature from given |data|, for using |ctr_data| and |keys|.
      */
@@ -102,6 +107,15 @@ namespace protocol
                                    const cc7::ByteRange & data,
                                    bool base64_format);
     
+    /**
+     Calculates multi-factor signatures for all |items|, with using the same |keys| and |factor|.
+     The HMAC calculations for all items are processed together, with using the multi-buffer
+     SHA-256 engine. Returns false if some signature calculation failed.
+     */
+    bool CalculateSignatures(const SignatureKeys & sk,
+                             SignatureFactor factor,
+                             std::vector<SignatureBatchItem> & items);
+    
     /**
      Prepares exact data for signature calculation:
      REQ = ${method}&${B64(uri)}&${nonceB64}&${B64(body)}&${secret}
@@ -137,6 +151,12 @@ namespace protocol
     // MARK: - Encrypted status -
     //
     
+    /**
+     Derives KEY_TRANSPORT_IV and KEY_TRANSPORT_CTR from |transport_key| and stores all keys
+     into |out| structure. Returns false if derivation failed.
+     */
+    bool DeriveTransportKeys(const cc7::ByteRange & transport_key, TransportKeys & out);
+    
     /**
      Decrypts received encrypted status blob into provided ActivationStatus structure.
      */
@@ -145,6 +165,16 @@ namespace protocol
                                          const cc7::ByteRange & nonce,
                                          const cc7::ByteRange & transport_key,
                                          ActivationStatus & out_status);
+    
+    /**
+     Decrypts received encrypted status blob into provided ActivationStatus structure. Unlike
+     the variant with plain transport key, this function uses already derived |transport_keys|.
+     */
+    ErrorCode DecryptEncryptedStatusBlob(const cc7::ByteRange & encrypted_status_blob,
+                                         const cc7::ByteRange & challenge,
+                                         const cc7::ByteRange & nonce,
+                                         const TransportKeys & transport_keys,
+                                         ActivationStatus & out_status);
 
     /**
      Derives IV (initialization vector) used for encrypted status blob decryption.
@@ -153,6 +183,14 @@ namespace protocol
                                                    const cc7::ByteRange & nonce,
                                                    const cc7::ByteRange & transport_key);
     
+    /**
+     Derives IV (initialization vector) used for encrypted status blob decryption, with using
+     already derived |transport_keys|.
+     */
+    cc7::ByteArray DeriveIVForStatusBlobDecryption(const cc7::ByteRange & challenge,
+                                                   const cc7::ByteRange & nonce,
+                                                   const TransportKeys & transport_keys);
+    
     /**
      Calculates distance between |in_out_local_ctr_data| and |server_ctr_data_hash| (e.g. how many interations is required to
      move from in_out_local_ctr_data to server_ctr_data_hash). The |max_iterations| limits number of iterations to be performed.
@@ -162,6 +200,15 @@ namespace protocol
                                      const cc7::ByteRange & server_ctr_data_hash,
                                      const cc7::ByteRange & transport_key,
                                      int max_iterations);
+    
+    /**
+     Calculates distance between |in_out_local_ctr_data| and |server_ctr_data_hash|, with using already
+     derived |transport_keys|. See the variant with plain transport key for details.
+     */
+    int CalculateHashCounterDistance(cc7::ByteArray & in_out_local_ctr_data,
+                                     const cc7::ByteRange & server_ctr_data_hash,
+                                     const TransportKeys & transport_keys,
+                                     int max_iterations);
 
     /**
      Calculates distance between local and server counters. If the local counter is ahead, then the returned value is positive.
@@ -0,0 +1,561 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Base64.h"
+#include <atomic>
+
+// Select SIMD kernels available for the target architecture. On x86, the SSSE3
+// and AVX2 kernels are compiled with function level target attributes and
+// the best one is selected at runtime. On AArch64, NEON is always available.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    #define PA_BASE64_X86 1
+    #include <immintrin.h>
+#elif defined(__aarch64__)
+    #define PA_BASE64_NEON 1
+    #include <arm_neon.h>
+#endif
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace utils
+{
+    // Encoder's alphabet
+    static const char s_encode_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    // Decoder's table, 0xFF marks invalid character.
+    static const cc7::byte s_decode_table[256] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,   62, 0xFF, 0xFF, 0xFF,   63,
+          52,   53,   54,   55,   56,   57,   58,   59,   60,   61, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF,    0,    1,    2,    3,    4,    5,    6,    7,    8,    9,   10,   11,   12,   13,   14,
+          15,   16,   17,   18,   19,   20,   21,   22,   23,   24,   25, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF,   26,   27,   28,   29,   30,   31,   32,   33,   34,   35,   36,   37,   38,   39,   40,
+          41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    };
+
+    //
+    // MARK: - Kernels -
+    //
+    // Each bulk kernel processes as many full blocks as possible, advances
+    // |in| & |out| pointers and returns the number of processed input bytes.
+    // The rest of the data is then processed by the scalar code.
+    //
+
+    typedef size_t (*EncodeKernel)(const cc7::byte * in, size_t in_size, char * out);
+    typedef size_t (*DecodeKernel)(const cc7::byte * in, size_t in_size, cc7::byte * out);
+
+    static size_t _EncodeScalar(const cc7::byte * in, size_t in_size, char * out)
+    {
+        size_t processed = 0;
+        while (in_size - processed >= 3) {
+            const cc7::U32 v = ((cc7::U32)in[0] << 16) | ((cc7::U32)in[1] << 8) | in[2];
+            out[0] = s_encode_table[(v >> 18) & 0x3F];
+            out[1] = s_encode_table[(v >> 12) & 0x3F];
+            out[2] = s_encode_table[(v >> 6)  & 0x3F];
+            out[3] = s_encode_table[v & 0x3F];
+            in  += 3;
+            out += 4;
+            processed += 3;
+        }
+        return processed;
+    }
+
+    static size_t _DecodeScalar(const cc7::byte * in, size_t in_size, cc7::byte * out)
+    {
+        size_t processed = 0;
+        while (in_size - processed >= 4) {
+            const cc7::U32 a = s_decode_table[in[0]];
+            const cc7::U32 b = s_decode_table[in[1]];
+            const cc7::U32 c = s_decode_table[in[2]];
+            const cc7::U32 d = s_decode_table[in[3]];
+            if ((a | b | c | d) & 0x80) {
+                break;
+            }
+            const cc7::U32 v = (a << 18) | (b << 12) | (c << 6) | d;
+            out[0] = (cc7::byte)(v >> 16);
+            out[1] = (cc7::byte)(v >> 8);
+            out[2] = (cc7::byte)v;
+            in  += 4;
+            out += 3;
+            processed += 4;
+        }
+        return processed;
+    }
+
+#if defined(PA_BASE64_X86)
+
+    // The x86 kernels are based on the vectorized algorithms published by
+    // Wojciech Mula and Daniel Lemire ("Faster Base64 Encoding and Decoding
+    // Using AVX2 Instructions").
+
+    __attribute__((target("ssse3")))
+    static inline __m128i _EncodeSSSE3_Block(__m128i in)
+    {
+        // Move 3 source bytes into each 32-bit lane as [b1, b0, b2, b1]
+        in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        // Split into 6-bit indices
+        const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+        const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+        const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        const __m128i indices = _mm_or_si128(t1, t3);
+        // Translate indices to ASCII
+        const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                '/' - 63, 'A', 0, 0);
+        __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        reduced = _mm_or_si128(reduced, _mm_and_si128(less, _mm_set1_epi8(13)));
+        return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, reduced), indices);
+    }
+
+    __attribute__((target("ssse3")))
+    static size_t _EncodeSSSE3(const cc7::byte * in, size_t in_size, char * out)
+    {
+        // 12 bytes are encoded in one round, but 16 bytes are loaded.
+        size_t processed = 0;
+        while (in_size - processed >= 16) {
+            const __m128i block = _mm_loadu_si128((const __m128i*)in);
+            _mm_storeu_si128((__m128i*)out, _EncodeSSSE3_Block(block));
+            in  += 12;
+            out += 16;
+            processed += 12;
+        }
+        return processed;
+    }
+
+    __attribute__((target("ssse3")))
+    static inline bool _DecodeSSSE3_Block(__m128i in, __m128i & out)
+    {
+        const __m128i lut_lo   = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                               0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m128i lut_hi   = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                               0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m128i mask_2f  = _mm_set1_epi8(0x2F);
+        // Validate characters. Any non-zero bit in (lo & hi) means that there's
+        // a character outside of Base64 alphabet.
+        const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+        const __m128i lo_nibbles = _mm_and_si128(in, mask_2f);
+        const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        const __m128i invalid = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+        if (_mm_movemask_epi8(invalid) != 0xFFFF) {
+            return false;
+        }
+        // Translate ASCII to 6-bit values
+        const __m128i eq_2f = _mm_cmpeq_epi8(in, mask_2f);
+        const __m128i roll  = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+        const __m128i values = _mm_add_epi8(in, roll);
+        // Pack 4x6 bits into 3 bytes in each 32-bit lane
+        const __m128i merged_ab_bc = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        const __m128i merged = _mm_madd_epi16(merged_ab_bc, _mm_set1_epi32(0x00011000));
+        out = _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        return true;
+    }
+
+    __attribute__((target("ssse3")))
+    static size_t _DecodeSSSE3(const cc7::byte * in, size_t in_size, cc7::byte * out)
+    {
+        // 16 characters are decoded in one round, but 16 bytes are stored. The loop keeps at least
+        // 8 characters for the scalar code, so the store never overflows the output buffer
+        // and the padding is never processed here.
+        size_t processed = 0;
+        while (in_size - processed >= 24) {
+            __m128i block;
+            if (!_DecodeSSSE3_Block(_mm_loadu_si128((const __m128i*)in), block)) {
+                break;
+            }
+            _mm_storeu_si128((__m128i*)out, block);
+            in  += 16;
+            out += 12;
+            processed += 16;
+        }
+        return processed;
+    }
+
+    __attribute__((target("avx2")))
+    static size_t _EncodeAVX2(const cc7::byte * in, size_t in_size, char * out)
+    {
+        // 24 bytes are encoded in one round, but 28 bytes are loaded.
+        const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                                 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+        const __m256i shift_lut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                   '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                   '/' - 63, 'A', 0, 0,
+                                                   'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                                   '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                                   '/' - 63, 'A', 0, 0);
+        size_t processed = 0;
+        while (in_size - processed >= 28) {
+            const __m128i lo = _mm_loadu_si128((const __m128i*)in);
+            const __m128i hi = _mm_loadu_si128((const __m128i*)(in + 12));
+            __m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            block = _mm256_shuffle_epi8(block, shuffle);
+            const __m256i t0 = _mm256_and_si256(block, _mm256_set1_epi32(0x0fc0fc00));
+            const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+            const __m256i t2 = _mm256_and_si256(block, _mm256_set1_epi32(0x003f03f0));
+            const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+            const __m256i indices = _mm256_or_si256(t1, t3);
+            __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+            const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+            reduced = _mm256_or_si256(reduced, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+            const __m256i result = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, reduced), indices);
+            _mm256_storeu_si256((__m256i*)out, result);
+            in  += 24;
+            out += 32;
+            processed += 24;
+        }
+        return processed;
+    }
+
+    __attribute__((target("avx2")))
+    static size_t _DecodeAVX2(const cc7::byte * in, size_t in_size, cc7::byte * out)
+    {
+        const __m256i lut_lo   = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                                  0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                                  0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                                  0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m256i lut_hi   = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                                  0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                                  0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                                  0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                  0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i shuffle  = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                  2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        const __m256i mask_2f  = _mm256_set1_epi8(0x2F);
+        // 32 characters are decoded in one round and 24 bytes are stored. The loop keeps at least
+        // 8 characters for the scalar code, to never process the padding.
+        size_t processed = 0;
+        while (in_size - processed >= 40) {
+            const __m256i block = _mm256_loadu_si256((const __m256i*)in);
+            const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(block, 4), mask_2f);
+            const __m256i lo_nibbles = _mm256_and_si256(block, mask_2f);
+            const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+            const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+            if (!_mm256_testz_si256(lo, hi)) {
+                break;
+            }
+            const __m256i eq_2f  = _mm256_cmpeq_epi8(block, mask_2f);
+            const __m256i roll   = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+            const __m256i values = _mm256_add_epi8(block, roll);
+            const __m256i merged_ab_bc = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+            __m256i merged = _mm256_madd_epi16(merged_ab_bc, _mm256_set1_epi32(0x00011000));
+            merged = _mm256_shuffle_epi8(merged, shuffle);
+            _mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(merged));
+            _mm_storeu_si128((__m128i*)(out + 12), _mm256_extracti128_si256(merged, 1));
+            in  += 32;
+            out += 24;
+            processed += 32;
+        }
+        return processed;
+    }
+
+#endif // PA_BASE64_X86
+
+#if defined(PA_BASE64_NEON)
+
+    static size_t _EncodeNEON(const cc7::byte * in, size_t in_size, char * out)
+    {
+        const uint8x16x4_t table = {{
+            vld1q_u8((const cc7::byte*)s_encode_table),
+            vld1q_u8((const cc7::byte*)s_encode_table + 16),
+            vld1q_u8((const cc7::byte*)s_encode_table + 32),
+            vld1q_u8((const cc7::byte*)s_encode_table + 48)
+        }};
+        const uint8x16_t mask_3f = vdupq_n_u8(0x3F);
+        size_t processed = 0;
+        while (in_size - processed >= 48) {
+            // De-interleave 16 triplets and split them into 4 vectors with 6-bit indices
+            const uint8x16x3_t src = vld3q_u8(in);
+            uint8x16x4_t idx;
+            idx.val[0] = vshrq_n_u8(src.val[0], 2);
+            idx.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(src.val[1], 4), vshlq_n_u8(src.val[0], 4)), mask_3f);
+            idx.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(src.val[2], 6), vshlq_n_u8(src.val[1], 2)), mask_3f);
+            idx.val[3] = vandq_u8(src.val[2], mask_3f);
+            uint8x16x4_t dst;
+            dst.val[0] = vqtbl4q_u8(table, idx.val[0]);
+            dst.val[1] = vqtbl4q_u8(table, idx.val[1]);
+            dst.val[2] = vqtbl4q_u8(table, idx.val[2]);
+            dst.val[3] = vqtbl4q_u8(table, idx.val[3]);
+            vst4q_u8((cc7::byte*)out, dst);
+            in  += 48;
+            out += 64;
+            processed += 48;
+        }
+        return processed;
+    }
+
+    static size_t _DecodeNEON(const cc7::byte * in, size_t in_size, cc7::byte * out)
+    {
+        // The decoder's table is split into two halves. The first covers characters 0..63,
+        // the second one covers 64..127 shifted by one, to keep index 0 for all lower characters.
+        cc7::byte upper[64];
+        upper[0] = 0;
+        for (size_t i = 1; i < 64; i++) {
+            upper[i] = s_decode_table[63 + i];
+        }
+        const uint8x16x4_t table_lo = {{
+            vld1q_u8(s_decode_table),      vld1q_u8(s_decode_table + 16),
+            vld1q_u8(s_decode_table + 32), vld1q_u8(s_decode_table + 48)
+        }};
+        const uint8x16x4_t table_hi = {{
+            vld1q_u8(upper),      vld1q_u8(upper + 16),
+            vld1q_u8(upper + 32), vld1q_u8(upper + 48)
+        }};
+        const uint8x16_t offset = vdupq_n_u8(63);
+        size_t processed = 0;
+        // 64 characters are decoded in one round. The loop keeps at least 4 characters
+        // for the scalar code, to never process the padding.
+        while (in_size - processed >= 68) {
+            const uint8x16x4_t src = vld4q_u8(in);
+            uint8x16x4_t v;
+            for (int i = 0; i < 4; i++) {
+                // Characters >= 128 stay out of range of the second lookup, so they're invalid.
+                const uint8x16_t lo = vqtbl4q_u8(table_lo, src.val[i]);
+                const uint8x16_t shifted = vqsubq_u8(src.val[i], offset);
+                const uint8x16_t hi = vqtbx4q_u8(shifted, table_hi, shifted);
+                v.val[i] = vorrq_u8(lo, hi);
+            }
+            const uint8x16_t all = vorrq_u8(vorrq_u8(v.val[0], v.val[1]), vorrq_u8(v.val[2], v.val[3]));
+            if (vmaxvq_u8(all) > 63) {
+                break;
+            }
+            uint8x16x3_t dst;
+            dst.val[0] = vorrq_u8(vshlq_n_u8(v.val[0], 2), vshrq_n_u8(v.val[1], 4));
+            dst.val[1] = vorrq_u8(vshlq_n_u8(v.val[1], 4), vshrq_n_u8(v.val[2], 2));
+            dst.val[2] = vorrq_u8(vshlq_n_u8(v.val[2], 6), v.val[3]);
+            vst3q_u8(out, dst);
+            in  += 64;
+            out += 48;
+            processed += 64;
+        }
+        return processed;
+    }
+
+#endif // PA_BASE64_NEON
+
+    //
+    // MARK: - Kernel selection -
+    //
+
+    struct Base64Kernels
+    {
+        Base64Implementation implementation;
+        EncodeKernel encode;
+        DecodeKernel decode;
+        bool (*isSupported)();
+    };
+
+    static bool _Scalar_IsSupported()
+    {
+        return true;
+    }
+
+#if defined(PA_BASE64_X86)
+    static bool _SSSE3_IsSupported()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3");
+    }
+
+    static bool _AVX2_IsSupported()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#elif defined(PA_BASE64_NEON)
+    static bool _NEON_IsSupported()
+    {
+        return true;
+    }
+#endif
+
+    /**
+     All compiled kernels, ordered from the most preferred one.
+     */
+    static const Base64Kernels s_kernels[] =
+    {
+#if defined(PA_BASE64_X86)
+        { Base64Impl_AVX2,   _EncodeAVX2,   _DecodeAVX2,   _AVX2_IsSupported },
+        { Base64Impl_SSSE3,  _EncodeSSSE3,  _DecodeSSSE3,  _SSSE3_IsSupported },
+#elif defined(PA_BASE64_NEON)
+        { Base64Impl_NEON,   _EncodeNEON,   _DecodeNEON,   _NEON_IsSupported },
+#endif
+        { Base64Impl_Scalar, _EncodeScalar, _DecodeScalar, _Scalar_IsSupported },
+    };
+
+    static std::atomic<const Base64Kernels*> s_active_kernels(nullptr);
+
+    /**
+     Returns kernels for the current CPU. The detection is performed only once,
+     but it's harmless if multiple threads do the detection at the same time.
+     */
+    static const Base64Kernels & _Kernels()
+    {
+        auto kernels = s_active_kernels.load(std::memory_order_acquire);
+        if (kernels == nullptr) {
+            for (const auto & k : s_kernels) {
+                if (k.isSupported()) {
+                    kernels = &k;
+                    break;
+                }
+            }
+            s_active_kernels.store(kernels, std::memory_order_release);
+        }
+        return *kernels;
+    }
+
+    Base64Implementation Base64_ActiveImplementation()
+    {
+        return _Kernels().implementation;
+    }
+
+    bool Base64_SelectImplementation(Base64Implementation implementation)
+    {
+        for (const auto & k : s_kernels) {
+            if (k.implementation == implementation) {
+                if (!k.isSupported()) {
+                    return false;
+                }
+                s_active_kernels.store(&k, std::memory_order_release);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //
+    // MARK: - Public functions -
+    //
+
+    size_t Base64_EncodeToBuffer(const cc7::ByteRange & data, char * out)
+    {
+        const cc7::byte * in = data.data();
+        const size_t in_size = data.size();
+        char * begin = out;
+
+        // Bulk data
+        size_t processed = _Kernels().encode(in, in_size, out);
+        out += (processed / 3) * 4;
+        processed += _EncodeScalar(in + processed, in_size - processed, out);
+        out = begin + (processed / 3) * 4;
+
+        // Remaining 1 or 2 bytes, with padding
+        const size_t remaining = in_size - processed;
+        if (remaining > 0) {
+            const cc7::byte * tail = in + processed;
+            const cc7::U32 v = ((cc7::U32)tail[0] << 16) | (remaining > 1 ? ((cc7::U32)tail[1] << 8) : 0);
+            out[0] = s_encode_table[(v >> 18) & 0x3F];
+            out[1] = s_encode_table[(v >> 12) & 0x3F];
+            out[2] = remaining > 1 ? s_encode_table[(v >> 6) & 0x3F] : '=';
+            out[3] = '=';
+            out += 4;
+        }
+        return out - begin;
+    }
+
+    void Base64_Encode(const cc7::ByteRange & data, std::string & out)
+    {
+        const size_t offset = out.size();
+        out.resize(offset + Base64_EncodedLength(data.size()));
+        if (!data.empty()) {
+            Base64_EncodeToBuffer(data, &out[offset]);
+        }
+    }
+
+    std::string ToBase64String(const cc7::ByteRange & data)
+    {
+        std::string result;
+        Base64_Encode(data, result);
+        return result;
+    }
+
+    bool Base64_Decode(const cc7::ByteRange & b64, cc7::ByteArray & out)
+    {
+        const size_t in_size = b64.size();
+        if (in_size == 0) {
+            out.clear();
+            return true;
+        }
+        if (in_size & 3) {
+            // Wrong length
+            out.clear();
+            return false;
+        }
+        const cc7::byte * in = b64.data();
+        // Determine padding. Only the last quad can contain '=' characters.
+        size_t padding = 0;
+        if (in[in_size - 1] == '=') {
+            padding = in[in_size - 2] == '=' ? 2 : 1;
+        }
+        out.resize((in_size / 4) * 3);
+        cc7::byte * out_ptr = out.data();
+
+        // Decode all full quads except the last one, which is processed separately.
+        const size_t body_size = in_size - 4;
+        size_t processed = _Kernels().decode(in, body_size, out_ptr);
+        processed += _DecodeScalar(in + processed, body_size - processed, out_ptr + (processed / 4) * 3);
+        if (processed != body_size) {
+            // Invalid character
+            out.clear();
+            return false;
+        }
+        // Last quad
+        const cc7::byte * tail = in + body_size;
+        cc7::byte * tail_out = out_ptr + (body_size / 4) * 3;
+        const cc7::U32 a = s_decode_table[tail[0]];
+        const cc7::U32 b = s_decode_table[tail[1]];
+        const cc7::U32 c = padding < 2 ? s_decode_table[tail[2]] : 0;
+        const cc7::U32 d = padding < 1 ? s_decode_table[tail[3]] : 0;
+        if ((a | b | c | d) & 0x80) {
+            // Invalid character
+            out.clear();
+            return false;
+        }
+        const cc7::U32 v = (a << 18) | (b << 12) | (c << 6) | d;
+        tail_out[0] = (cc7::byte)(v >> 16);
+        tail_out[1] = (cc7::byte)(v >> 8);
+        tail_out[2] = (cc7::byte)v;
+        out.resize(out.size() - padding);
+        return true;
+    }
+
+    cc7::ByteArray FromBase64String(const std::string & b64)
+    {
+        cc7::ByteArray result;
+        Base64_Decode(cc7::MakeRange(b64), result);
+        return result;
+    }
+
+} // com::wultra::powerAuth::utils
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cc7/ByteArray.h>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace utils
+{
+    /**
+     The Base64Implementation enumeration identifies bulk kernels used
+     by the Base64 encoder and decoder.
+     */
+    enum Base64Implementation
+    {
+        /**
+         Portable implementation, available on all platforms.
+         */
+        Base64Impl_Scalar = 0,
+        /**
+         x86 SSSE3 kernels.
+         */
+        Base64Impl_SSSE3,
+        /**
+         x86 AVX2 kernels.
+         */
+        Base64Impl_AVX2,
+        /**
+         AArch64 NEON kernels.
+         */
+        Base64Impl_NEON,
+    };
+
+    /**
+     Returns implementation of the Base64 kernels selected for the current CPU.
+     The implementation is detected once, on the first use.
+     */
+    Base64Implementation Base64_ActiveImplementation();
+
+    /**
+     Forces the Base64 encoder and decoder to use the required |implementation|. Returns
+     false if the implementation is not supported by the current CPU or was not compiled
+     into the library. The function is intended for tests and benchmarks only.
+     */
+    bool Base64_SelectImplementation(Base64Implementation implementation);
+
+    /**
+     Returns length of Base64 string produced from |data_size| bytes. The length
+     already includes the padding characters.
+     */
+    inline size_t Base64_EncodedLength(size_t data_size)
+    {
+        return ((data_size + 2) / 3) * 4;
+    }
+
+    /**
+     Encodes |data| into Base64 format and stores the result into |out| buffer.
+     The buffer must be at least `Base64_EncodedLength(data.size())` bytes long.
+     The output is not terminated with zero character. Returns number of
+     characters written to the buffer.
+     */
+    size_t Base64_EncodeToBuffer(const cc7::ByteRange & data, char * out);
+
+    /**
+     Encodes |data| into Base64 format and appends the result to |out| string.
+     */
+    void Base64_Encode(const cc7::ByteRange & data, std::string & out);
+
+    /**
+     Returns Base64 string created from given |data|.
+     */
+    std::string ToBase64String(const cc7::ByteRange & data);
+
+    /**
+     Decodes Base64 encoded |b64| sequence into |out| byte array. Unlike cc7 implementation,
+     the validation is strict: the length of input must be aligned to 4, only the standard
+     alphabet is accepted (no whitespaces or line breaks) and the padding may appear only
+     at the end of the sequence. Returns false if input is not valid and in this case,
+     the |out| array is cleared.
+     */
+    bool Base64_Decode(const cc7::ByteRange & b64, cc7::ByteArray & out);
+
+    /**
+     Decodes Base64 encoded string |b64| into |out| byte array. Returns false
+     if the string is not valid. See `Base64_Decode()` for validation details.
+     */
+    inline bool Base64_Decode(const std::string & b64, cc7::ByteArray & out)
+    {
+        return Base64_Decode(cc7::MakeRange(b64), out);
+    }
+
+    /**
+     Returns bytes decoded from |b64| string, or empty array if the string is not valid.
+     */
+    cc7::ByteArray FromBase64String(const std::string & b64);
+
+} // com::wultra::powerAuth::utils
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
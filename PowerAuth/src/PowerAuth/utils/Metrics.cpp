@@ -0,0 +1,487 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Metrics.h"
+#include <mutex>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdarg>
+#include <algorithm>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace utils
+{
+    /**
+     Names of histograms, used as values of "operation" label in Prometheus format
+     and as keys in JSON format.
+     */
+    static const char * s_histogram_names[MH_Count] =
+    {
+        "aes", "hmac", "pbkdf2", "ecdh", "ecdsa_sign", "ecdsa_verify", "ecc_keygen"
+    };
+    
+    /**
+     Names of counters, used as keys in JSON format.
+     */
+    static const char * s_counter_names[MC_Count] =
+    {
+        "ecies_encrypted_bytes", "ecies_decrypted_bytes", "prng_reseeds"
+    };
+    
+    /**
+     Returns monotonic time in nanoseconds.
+     */
+    static inline cc7::U64 _Now()
+    {
+        return (cc7::U64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    // MARK: - Histogram buckets -
+    
+    unsigned Metrics_BucketIndex(cc7::U64 value)
+    {
+        if (value < METRICS_SUB_BUCKET_COUNT) {
+            return (unsigned)value;
+        }
+        const unsigned exponent = 63 - __builtin_clzll(value);
+        if (exponent > METRICS_MAX_EXPONENT) {
+            return METRICS_BUCKET_COUNT - 1;
+        }
+        const unsigned shift = exponent - METRICS_SUB_BUCKET_BITS;
+        const unsigned sub_bucket = (unsigned)(value >> shift) & (METRICS_SUB_BUCKET_COUNT - 1);
+        return (shift + 1) * METRICS_SUB_BUCKET_COUNT + sub_bucket;
+    }
+    
+    cc7::U64 Metrics_BucketLowestValue(unsigned index)
+    {
+        if (index < METRICS_SUB_BUCKET_COUNT) {
+            return index;
+        }
+        const unsigned shift = index / METRICS_SUB_BUCKET_COUNT - 1;
+        const cc7::U64 sub_bucket = index % METRICS_SUB_BUCKET_COUNT;
+        return (METRICS_SUB_BUCKET_COUNT + sub_bucket) << shift;
+    }
+    
+    cc7::U64 Metrics_BucketHighestValue(unsigned index)
+    {
+        if (index < METRICS_SUB_BUCKET_COUNT) {
+            return index;
+        }
+        if (index >= METRICS_BUCKET_COUNT - 1) {
+            return UINT64_MAX;
+        }
+        const unsigned shift = index / METRICS_SUB_BUCKET_COUNT - 1;
+        return Metrics_BucketLowestValue(index) + (1ULL << shift) - 1;
+    }
+    
+    // MARK: - Shards -
+    
+    /**
+     The MetricsShard structure contains values recorded by one thread. Only the owning
+     thread modifies the values, so the update doesn't need an atomic read-modify-write.
+     The atomics only guarantee that the exporting thread reads untorn values.
+     */
+    struct MetricsShard
+    {
+        std::atomic<cc7::U64> buckets[MH_Count][METRICS_BUCKET_COUNT];
+        std::atomic<cc7::U64> sums[MH_Count];
+        std::atomic<cc7::U64> counters[MC_Count];
+        
+        MetricsShard()
+        {
+            for (size_t h = 0; h < MH_Count; h++) {
+                for (size_t i = 0; i < METRICS_BUCKET_COUNT; i++) {
+                    buckets[h][i].store(0, std::memory_order_relaxed);
+                }
+                sums[h].store(0, std::memory_order_relaxed);
+            }
+            for (size_t c = 0; c < MC_Count; c++) {
+                counters[c].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+    
+    /**
+     Adds |count| to |value| owned by the current thread.
+     */
+    static inline void _Add(std::atomic<cc7::U64> & value, cc7::U64 count)
+    {
+        value.store(value.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+    
+    /**
+     Adds all values from |shard| to |out| snapshot.
+     */
+    static void _Accumulate(const MetricsShard & shard, MetricsSnapshot & out)
+    {
+        for (size_t h = 0; h < MH_Count; h++) {
+            auto & histogram = out.histograms[h];
+            for (size_t i = 0; i < METRICS_BUCKET_COUNT; i++) {
+                const cc7::U64 count = shard.buckets[h][i].load(std::memory_order_relaxed);
+                histogram.buckets[i] += count;
+                histogram.count += count;
+            }
+            histogram.sum += shard.sums[h].load(std::memory_order_relaxed);
+        }
+        for (size_t c = 0; c < MC_Count; c++) {
+            out.counters[c] += shard.counters[c].load(std::memory_order_relaxed);
+        }
+    }
+    
+    /**
+     Clears all values in |out| snapshot.
+     */
+    static void _ClearSnapshot(MetricsSnapshot & out)
+    {
+        for (size_t h = 0; h < MH_Count; h++) {
+            out.histograms[h].count = 0;
+            out.histograms[h].sum = 0;
+            out.histograms[h].buckets.assign(METRICS_BUCKET_COUNT, 0);
+        }
+        for (size_t c = 0; c < MC_Count; c++) {
+            out.counters[c] = 0;
+        }
+    }
+    
+    /**
+     The MetricsRegistry class keeps shards of all living threads. Values from shards
+     of finished threads are moved to the retired shard. The lock is acquired only when
+     the thread records its first sample, when the thread exits, and by export or reset.
+     */
+    class MetricsRegistry
+    {
+    public:
+        /**
+         Returns the registry instance. The instance is never destroyed, so threads
+         finishing after the static objects destruction can still retire their shards.
+         */
+        static MetricsRegistry & instance()
+        {
+            static MetricsRegistry * s_registry = new MetricsRegistry();
+            return *s_registry;
+        }
+        
+        MetricsShard * addShard()
+        {
+            MetricsShard * shard = new MetricsShard();
+            std::lock_guard<std::mutex> guard(_lock);
+            _shards.push_back(shard);
+            return shard;
+        }
+        
+        void retireShard(MetricsShard * shard)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            for (size_t h = 0; h < MH_Count; h++) {
+                for (size_t i = 0; i < METRICS_BUCKET_COUNT; i++) {
+                    _Add(_retired.buckets[h][i], shard->buckets[h][i].load(std::memory_order_relaxed));
+                }
+                _Add(_retired.sums[h], shard->sums[h].load(std::memory_order_relaxed));
+            }
+            for (size_t c = 0; c < MC_Count; c++) {
+                _Add(_retired.counters[c], shard->counters[c].load(std::memory_order_relaxed));
+            }
+            for (auto it = _shards.begin(); it != _shards.end(); ++it) {
+                if (*it == shard) {
+                    _shards.erase(it);
+                    break;
+                }
+            }
+            delete shard;
+        }
+        
+        void snapshot(MetricsSnapshot & out)
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _totals(out);
+            for (size_t h = 0; h < MH_Count; h++) {
+                auto & histogram = out.histograms[h];
+                const auto & base = _baseline.histograms[h];
+                for (size_t i = 0; i < METRICS_BUCKET_COUNT; i++) {
+                    histogram.buckets[i] -= base.buckets[i];
+                }
+                histogram.count -= base.count;
+                histogram.sum -= base.sum;
+            }
+            for (size_t c = 0; c < MC_Count; c++) {
+                out.counters[c] -= _baseline.counters[c];
+            }
+        }
+        
+        void reset()
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            _totals(_baseline);
+        }
+        
+    private:
+        
+        MetricsRegistry()
+        {
+            _ClearSnapshot(_baseline);
+        }
+        
+        /**
+         Stores total values, including values recorded before the last reset, into |out|.
+         The lock must be acquired.
+         */
+        void _totals(MetricsSnapshot & out)
+        {
+            _ClearSnapshot(out);
+            _Accumulate(_retired, out);
+            for (auto shard : _shards) {
+                _Accumulate(*shard, out);
+            }
+        }
+        
+        std::mutex _lock;
+        std::vector<MetricsShard*> _shards;
+        MetricsShard _retired;
+        /**
+         Totals at the time of the last reset. The shards are never modified by other
+         than the owning thread, so the reset only moves the baseline.
+         */
+        MetricsSnapshot _baseline;
+    };
+    
+    /**
+     The ThreadMetricsShard structure owns the shard of the current thread and
+     retires it once the thread finishes.
+     */
+    struct ThreadMetricsShard
+    {
+        MetricsShard * shard = nullptr;
+        
+        ~ThreadMetricsShard()
+        {
+            if (shard) {
+                MetricsRegistry::instance().retireShard(shard);
+            }
+        }
+    };
+    
+    static thread_local ThreadMetricsShard s_thread_shard;
+    
+    /**
+     Returns the shard owned by the current thread, and creates one if doesn't exist yet.
+     */
+    static inline MetricsShard * _ThreadShard()
+    {
+        ThreadMetricsShard & thread_shard = s_thread_shard;
+        if (!thread_shard.shard) {
+            thread_shard.shard = MetricsRegistry::instance().addShard();
+        }
+        return thread_shard.shard;
+    }
+    
+    // MARK: - Recording -
+    
+    void Metrics_RecordLatency(MetricsHistogram histogram, cc7::U64 ns)
+    {
+        MetricsShard * shard = _ThreadShard();
+        _Add(shard->buckets[histogram][Metrics_BucketIndex(ns)], 1);
+        _Add(shard->sums[histogram], ns);
+    }
+    
+    void Metrics_Count(MetricsCounter counter, cc7::U64 count)
+    {
+        _Add(_ThreadShard()->counters[counter], count);
+    }
+    
+    ScopedMetricsTimer::ScopedMetricsTimer(MetricsHistogram histogram) :
+        _histogram(histogram),
+        _start(_Now())
+    {
+    }
+    
+    ScopedMetricsTimer::~ScopedMetricsTimer()
+    {
+        Metrics_RecordLatency(_histogram, _Now() - _start);
+    }
+    
+    // MARK: - Snapshot -
+    
+    cc7::U64 MetricsSnapshot::Histogram::valueAtQuantile(double quantile) const
+    {
+        if (count == 0) {
+            return 0;
+        }
+        cc7::U64 target = (cc7::U64)std::ceil(quantile * (double)count);
+        if (target < 1) {
+            target = 1;
+        } else if (target > count) {
+            target = count;
+        }
+        cc7::U64 accumulated = 0;
+        for (unsigned i = 0; i < buckets.size(); i++) {
+            accumulated += buckets[i];
+            if (accumulated >= target) {
+                return Metrics_BucketHighestValue(i);
+            }
+        }
+        return 0;
+    }
+    
+    cc7::U64 MetricsSnapshot::Histogram::maxValue() const
+    {
+        for (size_t i = buckets.size(); i > 0; i--) {
+            if (buckets[i - 1] > 0) {
+                return Metrics_BucketHighestValue((unsigned)(i - 1));
+            }
+        }
+        return 0;
+    }
+    
+    void Metrics_Snapshot(MetricsSnapshot & out)
+    {
+        MetricsRegistry::instance().snapshot(out);
+    }
+    
+    // MARK: - Export -
+    
+    /**
+     Appends formatted string to |out|.
+     */
+    static void _Append(std::string & out, const char * format, ...) __attribute__((format(printf, 2, 3)));
+    static void _Append(std::string & out, const char * format, ...)
+    {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length > 0) {
+            out.append(buffer, std::min((size_t)length, sizeof(buffer) - 1));
+        }
+    }
+    
+    /**
+     Bucket bounds in Prometheus export are fixed powers of two nanoseconds, from ~1 us
+     to ~34 s, so each histogram always exports the same series. The values above the
+     highest bound are covered by the "+Inf" bucket.
+     */
+    static const unsigned PROMETHEUS_MIN_EXPONENT = 10;
+    static const unsigned PROMETHEUS_MAX_EXPONENT = 35;
+    
+    static std::string _ExportPrometheus(const MetricsSnapshot & snapshot)
+    {
+        std::string out;
+        out.reserve(4096);
+        out.append("# HELP powerauth_crypto_duration_seconds Duration of cryptographic primitives.\n");
+        out.append("# TYPE powerauth_crypto_duration_seconds histogram\n");
+        for (size_t h = 0; h < MH_Count; h++) {
+            const auto & histogram = snapshot.histograms[h];
+            const char * name = s_histogram_names[h];
+            cc7::U64 accumulated = 0;
+            unsigned i = 0;
+            for (unsigned exponent = PROMETHEUS_MIN_EXPONENT; exponent <= PROMETHEUS_MAX_EXPONENT; exponent++) {
+                // Power of two is always the upper bound of some bucket, so the buckets are merged exactly.
+                const cc7::U64 bound = 1ULL << exponent;
+                while (i < METRICS_BUCKET_COUNT - 1 && Metrics_BucketHighestValue(i) < bound) {
+                    accumulated += histogram.buckets[i++];
+                }
+                _Append(out, "powerauth_crypto_duration_seconds_bucket{operation=\"%s\",le=\"%.11g\"} %llu\n", name, (double)bound * 1e-9, (unsigned long long)accumulated);
+            }
+            _Append(out, "powerauth_crypto_duration_seconds_bucket{operation=\"%s\",le=\"+Inf\"} %llu\n", name, (unsigned long long)histogram.count);
+            _Append(out, "powerauth_crypto_duration_seconds_sum{operation=\"%s\"} %.9g\n", name, (double)histogram.sum * 1e-9);
+            _Append(out, "powerauth_crypto_duration_seconds_count{operation=\"%s\"} %llu\n", name, (unsigned long long)histogram.count);
+        }
+        out.append("# HELP powerauth_ecies_bytes_total Number of bytes processed by ECIES.\n");
+        out.append("# TYPE powerauth_ecies_bytes_total counter\n");
+        _Append(out, "powerauth_ecies_bytes_total{direction=\"encrypt\"} %llu\n", (unsigned long long)snapshot.counters[MC_ECIES_EncryptedBytes]);
+        _Append(out, "powerauth_ecies_bytes_total{direction=\"decrypt\"} %llu\n", (unsigned long long)snapshot.counters[MC_ECIES_DecryptedBytes]);
+        out.append("# HELP powerauth_prng_reseeds_total Number of PRNG reseeds.\n");
+        out.append("# TYPE powerauth_prng_reseeds_total counter\n");
+        _Append(out, "powerauth_prng_reseeds_total %llu\n", (unsigned long long)snapshot.counters[MC_PRNG_Reseeds]);
+        return out;
+    }
+    
+    static std::string _ExportJSON(const MetricsSnapshot & snapshot)
+    {
+        std::string out;
+        out.reserve(4096);
+        out.append("{\"histograms\":{");
+        for (size_t h = 0; h < MH_Count; h++) {
+            const auto & histogram = snapshot.histograms[h];
+            _Append(out, "%s\"%s\":{\"count\":%llu,\"sum_ns\":%llu,\"max_ns\":%llu",
+                    h > 0 ? "," : "", s_histogram_names[h],
+                    (unsigned long long)histogram.count,
+                    (unsigned long long)histogram.sum,
+                    (unsigned long long)histogram.maxValue());
+            _Append(out, ",\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu",
+                    (unsigned long long)histogram.valueAtQuantile(0.5),
+                    (unsigned long long)histogram.valueAtQuantile(0.9),
+                    (unsigned long long)histogram.valueAtQuantile(0.99),
+                    (unsigned long long)histogram.valueAtQuantile(0.999));
+            out.append(",\"buckets\":[");
+            bool first = true;
+            for (unsigned i = 0; i < METRICS_BUCKET_COUNT; i++) {
+                if (histogram.buckets[i] == 0) {
+                    continue;
+                }
+                _Append(out, "%s{\"lowest_ns\":%llu,\"count\":%llu}", first ? "" : ",",
+                        (unsigned long long)Metrics_BucketLowestValue(i),
+                        (unsigned long long)histogram.buckets[i]);
+                first = false;
+            }
+            out.append("]}");
+        }
+        out.append("},\"counters\":{");
+        for (size_t c = 0; c < MC_Count; c++) {
+            _Append(out, "%s\"%s\":%llu", c > 0 ? "," : "", s_counter_names[c], (unsigned long long)snapshot.counters[c]);
+        }
+        out.append("}}");
+        return out;
+    }
+    
+} // com::wultra::powerAuth::utils
+
+    // MARK: - Public interface -
+    
+    bool MetricsAvailable()
+    {
+#if defined(PA_ENABLE_METRICS)
+        return true;
+#else
+        return false;
+#endif
+    }
+    
+    std::string ExportMetrics(MetricsFormat format)
+    {
+        utils::MetricsSnapshot snapshot;
+        utils::Metrics_Snapshot(snapshot);
+        if (format == MF_JSON) {
+            return utils::_ExportJSON(snapshot);
+        }
+        return utils::_ExportPrometheus(snapshot);
+    }
+    
+    void ResetMetrics()
+    {
+        utils::MetricsRegistry::instance().reset();
+    }
+    
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
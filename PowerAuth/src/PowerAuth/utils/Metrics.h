@@ -0,0 +1,169 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <PowerAuth/Metrics.h>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace utils
+{
+    /**
+     The MetricsHistogram enumeration defines primitives with latency recorded
+     in the process-wide metrics.
+     */
+    enum MetricsHistogram
+    {
+        MH_AES,
+        MH_HMAC,
+        MH_PBKDF2,
+        MH_ECDH,
+        MH_ECDSA_Sign,
+        MH_ECDSA_Verify,
+        MH_ECC_KeyGen,
+        MH_Count
+    };
+    
+    /**
+     The MetricsCounter enumeration defines events counted in the process-wide metrics.
+     */
+    enum MetricsCounter
+    {
+        MC_ECIES_EncryptedBytes,
+        MC_ECIES_DecryptedBytes,
+        MC_PRNG_Reseeds,
+        MC_Count
+    };
+    
+    // MARK: - Histogram buckets -
+    
+    /**
+     Number of bits used for linear sub-buckets in each power of two. With 3 bits,
+     the value recorded in histogram has relative error up to 12.5%.
+     */
+    const unsigned METRICS_SUB_BUCKET_BITS = 3;
+    const unsigned METRICS_SUB_BUCKET_COUNT = 1 << METRICS_SUB_BUCKET_BITS;
+    /**
+     Highest power of two distinguished in histograms. Larger values, in nanoseconds
+     it's approximately 18 minutes, are recorded into the last bucket.
+     */
+    const unsigned METRICS_MAX_EXPONENT = 39;
+    /**
+     Number of buckets in each histogram.
+     */
+    const unsigned METRICS_BUCKET_COUNT = (METRICS_MAX_EXPONENT - METRICS_SUB_BUCKET_BITS + 2) * METRICS_SUB_BUCKET_COUNT;
+    
+    /**
+     Returns index of histogram bucket for |value|. Values lower than `METRICS_SUB_BUCKET_COUNT`
+     have their own bucket. Each higher power of two is split into `METRICS_SUB_BUCKET_COUNT`
+     buckets of the same width.
+     */
+    unsigned Metrics_BucketIndex(cc7::U64 value);
+    
+    /**
+     Returns the lowest value stored in bucket at |index|.
+     */
+    cc7::U64 Metrics_BucketLowestValue(unsigned index);
+    
+    /**
+     Returns the highest value stored in bucket at |index|.
+     */
+    cc7::U64 Metrics_BucketHighestValue(unsigned index);
+    
+    // MARK: - Recording -
+    
+    /**
+     Records |ns| nanoseconds into |histogram|. The sample is stored into the shard
+     owned by the current thread, so the function never blocks.
+     */
+    void Metrics_RecordLatency(MetricsHistogram histogram, cc7::U64 ns);
+    
+    /**
+     Adds |count| to |counter|. Like `Metrics_RecordLatency()`, the function updates
+     only the shard owned by the current thread.
+     */
+    void Metrics_Count(MetricsCounter counter, cc7::U64 count = 1);
+    
+    /**
+     The ScopedMetricsTimer class records the time spent in its scope into |histogram|.
+     */
+    class ScopedMetricsTimer
+    {
+    public:
+        ScopedMetricsTimer(MetricsHistogram histogram);
+        ~ScopedMetricsTimer();
+        
+    private:
+        MetricsHistogram _histogram;
+        cc7::U64 _start;
+        
+        ScopedMetricsTimer(const ScopedMetricsTimer &) = delete;
+        ScopedMetricsTimer & operator=(const ScopedMetricsTimer &) = delete;
+    };
+    
+    // MARK: - Snapshot -
+    
+    /**
+     The MetricsSnapshot structure contains metrics aggregated from all threads.
+     */
+    struct MetricsSnapshot
+    {
+        struct Histogram
+        {
+            cc7::U64 count;
+            cc7::U64 sum;
+            std::vector<cc7::U64> buckets;
+            
+            /**
+             Returns the highest value equivalent to |quantile| of recorded values,
+             or 0 if histogram is empty.
+             */
+            cc7::U64 valueAtQuantile(double quantile) const;
+            /**
+             Returns the highest value equivalent to the maximum recorded value,
+             or 0 if histogram is empty.
+             */
+            cc7::U64 maxValue() const;
+        };
+        Histogram histograms[MH_Count];
+        cc7::U64 counters[MC_Count];
+    };
+    
+    /**
+     Stores metrics aggregated from all threads into |out| structure.
+     */
+    void Metrics_Snapshot(MetricsSnapshot & out);
+    
+} // com::wultra::powerAuth::utils
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
+
+// MARK: - Measurement points -
+
+#if defined(PA_ENABLE_METRICS)
+    #define PA_METRICS_TIMER(histogram)         com::wultra::powerAuth::utils::ScopedMetricsTimer __pa_metrics_timer(com::wultra::powerAuth::utils::histogram)
+    #define PA_METRICS_COUNT(counter, count)    com::wultra::powerAuth::utils::Metrics_Count(com::wultra::powerAuth::utils::counter, count)
+#else
+    #define PA_METRICS_TIMER(histogram)
+    #define PA_METRICS_COUNT(counter, count)
+#endif
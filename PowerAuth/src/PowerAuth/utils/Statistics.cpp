@@ -0,0 +1,162 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Statistics.h"
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace utils
+{
+    /**
+     Collector installed for the current thread.
+     */
+    static thread_local StatisticsCollector * s_collector = nullptr;
+    
+    /**
+     The innermost timer running on the current thread.
+     */
+    static thread_local ScopedStatisticsTimer * s_timer = nullptr;
+    
+    /**
+     Returns monotonic time in nanoseconds.
+     */
+    static inline cc7::U64 _Now()
+    {
+        return (cc7::U64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    
+    /**
+     Converts nanoseconds to microseconds.
+     */
+    static inline std::chrono::microseconds _ToMicroseconds(cc7::U64 ns)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(ns));
+    }
+    
+    // MARK: - StatisticsCollector -
+    
+    StatisticsCollector::StatisticsCollector() :
+        enabled(false)
+    {
+        reset();
+    }
+    
+    void StatisticsCollector::reset()
+    {
+        for (size_t i = 0; i < SessionStatistics::SO_Count; i++) {
+            operationCalls[i] = 0;
+            operationTime[i] = 0;
+        }
+        for (size_t i = 0; i < ST_Count; i++) {
+            timers[i] = 0;
+        }
+        for (size_t i = 0; i < SC_Count; i++) {
+            counters[i] = 0;
+        }
+    }
+    
+    void StatisticsCollector::snapshot(SessionStatistics & out) const
+    {
+        for (size_t i = 0; i < SessionStatistics::SO_Count; i++) {
+            out.operations[i].calls = operationCalls[i];
+            out.operations[i].time  = _ToMicroseconds(operationTime[i]);
+        }
+        out.lockWait            = _ToMicroseconds(timers[ST_LockWait]);
+        out.pbkdf2              = _ToMicroseconds(timers[ST_PBKDF2]);
+        out.ecc                 = _ToMicroseconds(timers[ST_ECC]);
+        out.symmetricCrypto     = _ToMicroseconds(timers[ST_Symmetric]);
+        out.serialization       = _ToMicroseconds(timers[ST_Serialization]);
+        out.keyUnlocks          = counters[SC_KeyUnlock];
+        out.counterAdvances     = counters[SC_CounterAdvance];
+        out.lookAheadIterations = counters[SC_LookAheadIteration];
+        out.prngReseeds         = counters[SC_PRNGReseed];
+    }
+    
+    // MARK: - ScopedStatisticsOperation -
+    
+    ScopedStatisticsOperation::ScopedStatisticsOperation(StatisticsCollector * collector, SessionStatistics::Operation operation) :
+        _collector(nullptr),
+        _previous(s_collector),
+        _operation(operation),
+        _start(0)
+    {
+        if (collector && collector != _previous && collector->enabled.load(std::memory_order_relaxed)) {
+            _collector = collector;
+            _start = _Now();
+            s_collector = collector;
+        }
+    }
+    
+    ScopedStatisticsOperation::~ScopedStatisticsOperation()
+    {
+        if (_collector) {
+            _collector->operationCalls[_operation].fetch_add(1, std::memory_order_relaxed);
+            _collector->operationTime[_operation].fetch_add(_Now() - _start, std::memory_order_relaxed);
+            s_collector = _previous;
+        }
+    }
+    
+    // MARK: - ScopedStatisticsTimer -
+    
+    ScopedStatisticsTimer::ScopedStatisticsTimer(StatisticsTimer timer) :
+        _collector(s_collector),
+        _outer(nullptr),
+        _timer(timer),
+        _start(0)
+    {
+        if (_collector) {
+            _start = _Now();
+            _outer = s_timer;
+            if (_outer && _outer->_collector == _collector) {
+                // Pause the outer timer.
+                _collector->timers[_outer->_timer].fetch_add(_start - _outer->_start, std::memory_order_relaxed);
+            }
+            s_timer = this;
+        }
+    }
+    
+    ScopedStatisticsTimer::~ScopedStatisticsTimer()
+    {
+        if (_collector) {
+            const cc7::U64 now = _Now();
+            _collector->timers[_timer].fetch_add(now - _start, std::memory_order_relaxed);
+            if (_outer && _outer->_collector == _collector) {
+                // Resume the outer timer.
+                _outer->_start = now;
+            }
+            s_timer = _outer;
+        }
+    }
+    
+    // MARK: - Counters -
+    
+    void Statistics_Count(StatisticsCounter counter, cc7::U64 count)
+    {
+        StatisticsCollector * collector = s_collector;
+        if (collector) {
+            collector->counters[counter].fetch_add(count, std::memory_order_relaxed);
+        }
+    }
+    
+} // com::wultra::powerAuth::utils
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <PowerAuth/SessionStatistics.h>
+#include <atomic>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace utils
+{
+    /**
+     The StatisticsTimer enumeration defines categories of time measured
+     in the low level operations.
+     */
+    enum StatisticsTimer
+    {
+        ST_LockWait,
+        ST_PBKDF2,
+        ST_ECC,
+        ST_Symmetric,
+        ST_Serialization,
+        ST_Count
+    };
+    
+    /**
+     The StatisticsCounter enumeration defines events counted in the low level operations.
+     */
+    enum StatisticsCounter
+    {
+        SC_KeyUnlock,
+        SC_CounterAdvance,
+        SC_LookAheadIteration,
+        SC_PRNGReseed,
+        SC_Count
+    };
+    
+    /**
+     The StatisticsCollector structure accumulates statistics for one Session. All values are
+     updated atomically, so the collector can be shared by all threads using the session.
+     */
+    struct StatisticsCollector
+    {
+        /**
+         If false, then the collection is disabled.
+         */
+        std::atomic<bool> enabled;
+        
+        std::atomic<cc7::U64> operationCalls[SessionStatistics::SO_Count];
+        std::atomic<cc7::U64> operationTime[SessionStatistics::SO_Count];
+        std::atomic<cc7::U64> timers[ST_Count];
+        std::atomic<cc7::U64> counters[SC_Count];
+        
+        StatisticsCollector();
+        
+        /**
+         Sets all accumulated values to zero.
+         */
+        void reset();
+        
+        /**
+         Stores accumulated values into |out| structure.
+         */
+        void snapshot(SessionStatistics & out) const;
+    };
+    
+    /**
+     The ScopedStatisticsOperation class installs |collector| for the current thread and measures
+     the time spent in the public |operation|, until the object is destroyed. If |collector| is null
+     or disabled, or if other operation of the same collector is already measured on this thread,
+     then the object does nothing.
+     */
+    class ScopedStatisticsOperation
+    {
+    public:
+        ScopedStatisticsOperation(StatisticsCollector * collector, SessionStatistics::Operation operation);
+        ~ScopedStatisticsOperation();
+        
+    private:
+        StatisticsCollector * _collector;
+        StatisticsCollector * _previous;
+        SessionStatistics::Operation _operation;
+        cc7::U64 _start;
+        
+        ScopedStatisticsOperation(const ScopedStatisticsOperation &) = delete;
+        ScopedStatisticsOperation & operator=(const ScopedStatisticsOperation &) = delete;
+    };
+    
+    /**
+     The ScopedStatisticsTimer class measures the time spent in |timer| category, until the object
+     is destroyed. The time is accounted to the collector installed for the current thread. If the
+     timers are nested, then the outer timer is paused while the inner one is running. If there's
+     no installed collector, then the object does nothing.
+     */
+    class ScopedStatisticsTimer
+    {
+    public:
+        ScopedStatisticsTimer(StatisticsTimer timer);
+        ~ScopedStatisticsTimer();
+        
+    private:
+        StatisticsCollector * _collector;
+        ScopedStatisticsTimer * _outer;
+        StatisticsTimer _timer;
+        cc7::U64 _start;
+        
+        ScopedStatisticsTimer(const ScopedStatisticsTimer &) = delete;
+        ScopedStatisticsTimer & operator=(const ScopedStatisticsTimer &) = delete;
+    };
+    
+    /**
+     Adds |count| to |counter| in the collector installed for the current thread.
+     */
+    void Statistics_Count(StatisticsCounter counter, cc7::U64 count = 1);
+    
+} // com::wultra::powerAuth::utils
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Tracing.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+    #include <sys/sdt.h>
+    #define PA_TRACING_USDT
+#endif
+#endif
+
+#if defined(PA_TRACING_USDT)
+    #define PA_USDT_PROBE(name, point, argument)    DTRACE_PROBE3(powerauth, name, s_trace_point_names[point], (int)point, argument)
+#else
+    #define PA_USDT_PROBE(name, point, argument)
+#endif
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+    static const char * s_trace_point_names[TP_Count] =
+    {
+        "SessionOperation",
+        "UnlockSignatureKeys",
+        "CalculateSignature",
+        "CalculateHashCounterDistance",
+        "ECIESEncrypt",
+        "ECIESDecrypt",
+        "PBKDF2",
+    };
+    
+    /**
+     Listener registered with SetTraceListener().
+     */
+    static std::atomic<TraceListener*> s_trace_listener(nullptr);
+    
+    const char * TracePointName(TracePoint point)
+    {
+        if (point >= 0 && point < TP_Count) {
+            return s_trace_point_names[point];
+        }
+        return "Unknown";
+    }
+    
+    bool TracingAvailable()
+    {
+#if defined(PA_ENABLE_TRACING)
+        return true;
+#else
+        return false;
+#endif
+    }
+    
+    void SetTraceListener(TraceListener * listener)
+    {
+        s_trace_listener.store(listener, std::memory_order_release);
+    }
+    
+namespace utils
+{
+    /**
+     Object whose operation is traced on the current thread.
+     */
+    static thread_local const void * s_traced_object = nullptr;
+    
+    ScopedTrace::ScopedTrace(TracePoint point, cc7::U64 argument) :
+        _listener(s_trace_listener.load(std::memory_order_acquire)),
+        _point(point),
+        _argument(argument)
+    {
+        PA_USDT_PROBE(begin, point, argument);
+        if (_listener) {
+            _listener->traceBegin(point, argument);
+        }
+    }
+    
+    ScopedTrace::~ScopedTrace()
+    {
+        if (_listener) {
+            _listener->traceEnd(_point, _argument);
+        }
+        PA_USDT_PROBE(end, _point, _argument);
+    }
+    
+    ScopedOperationTrace::ScopedOperationTrace(const void * object, TracePoint point, cc7::U64 argument) :
+        _object(nullptr),
+        _previous(s_traced_object),
+        _listener(nullptr),
+        _point(point),
+        _argument(argument)
+    {
+        if (object != _previous) {
+            _object = object;
+            _listener = s_trace_listener.load(std::memory_order_acquire);
+            s_traced_object = object;
+            PA_USDT_PROBE(begin, point, argument);
+            if (_listener) {
+                _listener->traceBegin(point, argument);
+            }
+        }
+    }
+    
+    ScopedOperationTrace::~ScopedOperationTrace()
+    {
+        if (_object) {
+            if (_listener) {
+                _listener->traceEnd(_point, _argument);
+            }
+            PA_USDT_PROBE(end, _point, _argument);
+            s_traced_object = _previous;
+        }
+    }
+    
+} // com::wultra::powerAuth::utils
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
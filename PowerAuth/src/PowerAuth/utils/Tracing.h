@@ -0,0 +1,86 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <PowerAuth/Tracing.h>
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuth
+{
+namespace utils
+{
+    /**
+     The ScopedTrace class reports begin of trace |point| when constructed and its
+     end when destroyed. Use PA_TRACE_SCOPE() macro instead of direct use of the class,
+     so the trace point is compiled out when the tracing is disabled.
+     */
+    class ScopedTrace
+    {
+    public:
+        ScopedTrace(TracePoint point, cc7::U64 argument);
+        ~ScopedTrace();
+        
+    private:
+        TraceListener * _listener;
+        TracePoint _point;
+        cc7::U64 _argument;
+        
+        ScopedTrace(const ScopedTrace &) = delete;
+        ScopedTrace & operator=(const ScopedTrace &) = delete;
+    };
+    
+    /**
+     The ScopedOperationTrace class reports trace |point| for the public operation of |object|,
+     like ScopedTrace does. If other operation of the same object is already traced on this
+     thread, then the object does nothing, so the nested calls of public methods are not reported.
+     Use PA_TRACE_OPERATION() macro instead of direct use of the class.
+     */
+    class ScopedOperationTrace
+    {
+    public:
+        ScopedOperationTrace(const void * object, TracePoint point, cc7::U64 argument);
+        ~ScopedOperationTrace();
+        
+    private:
+        const void * _object;
+        const void * _previous;
+        TraceListener * _listener;
+        TracePoint _point;
+        cc7::U64 _argument;
+        
+        ScopedOperationTrace(const ScopedOperationTrace &) = delete;
+        ScopedOperationTrace & operator=(const ScopedOperationTrace &) = delete;
+    };
+    
+} // com::wultra::powerAuth::utils
+} // com::wultra::powerAuth
+} // com::wultra
+} // com
+
+// MARK: - Trace points -
+
+#if defined(PA_ENABLE_TRACING)
+    #define PA_TRACE_SCOPE(point, argument)                 com::wultra::powerAuth::utils::ScopedTrace pa_trace_scope_(com::wultra::powerAuth::point, (cc7::U64)(argument))
+    #define PA_TRACE_OPERATION(object, point, argument)     com::wultra::powerAuth::utils::ScopedOperationTrace pa_trace_operation_(object, com::wultra::powerAuth::point, (cc7::U64)(argument))
+#else
+    #define PA_TRACE_SCOPE(point, argument)
+    #define PA_TRACE_OPERATION(object, point, argument)
+#endif
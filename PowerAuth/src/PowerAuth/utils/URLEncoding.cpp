@@ -16,6 +16,15 @@
 
 #include "URLEncoding.h"
 
+// SIMD classifier used for runs of characters, which doesn't need to be escaped.
+#if defined(__SSE2__)
+    #define PA_URLENCODING_SSE2 1
+    #include <emmintrin.h>
+#elif defined(__aarch64__)
+    #define PA_URLENCODING_NEON 1
+    #include <arm_neon.h>
+#endif
+
 namespace com
 {
 namespace wultra
@@ -24,86 +33,135 @@ namespace powerAuth
 {
 namespace utils
 {
-    static size_t _URLEncodingEstimateResultLength(std::string::const_iterator begin, std::string::const_iterator end)
+    // Table with encoded characters. Zero means that character must be escaped with %XX,
+    // otherwise the value is directly stored to the output.
+    static const cc7::byte s_url_encoding_table[256] = {
+        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+        '+', 0,   0,   0,   0,   0,   0,   0,   0,   0,   '*', 0,   0,   '-', '.', 0,
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0,   0,   0,   0,   0,   0,
+        0,   'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
+        'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 0,   0,   0,   0,   '_',
+        0,   'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+        'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+        0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    };
+    
+    static const char s_hex_chars[] = "0123456789ABCDEF";
+    
+    /**
+     Copies the longest run of characters that doesn't need to be escaped, from |in| to |out|.
+     The output buffer must be at least `URLEncodingMaxLength(end - in)` bytes long.
+     Returns number of copied bytes.
+     */
+    static inline size_t _CopySafeCharactersRun(const cc7::byte * in, const cc7::byte * end, cc7::byte * out)
     {
-        size_t result = 0;
-        bool escape = false;
-        while (begin != end) {
-            cc7::byte c = (cc7::byte)*begin++;
-            if ((c >= '0' && c <= '9') ||
-                (c >= 'A' && c <= 'Z') ||
-                (c >= 'a' && c <= 'z') ||
-                (c == '-' || c == '_' || c == '.' || c == '*')
-                )
-            {
-                result++;
+        size_t copied = 0;
+#if defined(PA_URLENCODING_SSE2)
+        const __m128i lower_a   = _mm_set1_epi8('a' - 1);
+        const __m128i upper_z   = _mm_set1_epi8('z' + 1);
+        const __m128i lower_0   = _mm_set1_epi8('0' - 1);
+        const __m128i upper_9   = _mm_set1_epi8('9' + 1);
+        const __m128i case_bit  = _mm_set1_epi8(0x20);
+        while (end - in >= 16) {
+            const __m128i v = _mm_loadu_si128((const __m128i*)in);
+            // Letters are tested case insensitive. Bytes >= 0x80 are negative, so never match.
+            const __m128i lower = _mm_or_si128(v, case_bit);
+            const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, lower_a), _mm_cmpgt_epi8(upper_z, lower));
+            const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, lower_0), _mm_cmpgt_epi8(upper_9, v));
+            const __m128i sym1  = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('-')), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+            const __m128i sym2  = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('.')), _mm_cmpeq_epi8(v, _mm_set1_epi8('*')));
+            const int mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), _mm_or_si128(sym1, sym2)));
+            // It's safe to store whole block, because output buffer is 3 times longer than input.
+            _mm_storeu_si128((__m128i*)out, v);
+            if (mask != 0xFFFF) {
+                return copied + __builtin_ctz(~mask);
             }
-            else if (c == ' ')
-            {
-                result++;
-                escape = true;
+            in  += 16;
+            out += 16;
+            copied += 16;
+        }
+#elif defined(PA_URLENCODING_NEON)
+        const uint8x16_t case_bit = vdupq_n_u8(0x20);
+        while (end - in >= 16) {
+            const uint8x16_t v = vld1q_u8(in);
+            const uint8x16_t lower = vorrq_u8(v, case_bit);
+            const uint8x16_t alpha = vandq_u8(vcgeq_u8(lower, vdupq_n_u8('a')), vcleq_u8(lower, vdupq_n_u8('z')));
+            const uint8x16_t digit = vandq_u8(vcgeq_u8(v, vdupq_n_u8('0')), vcleq_u8(v, vdupq_n_u8('9')));
+            const uint8x16_t sym1  = vorrq_u8(vceqq_u8(v, vdupq_n_u8('-')), vceqq_u8(v, vdupq_n_u8('_')));
+            const uint8x16_t sym2  = vorrq_u8(vceqq_u8(v, vdupq_n_u8('.')), vceqq_u8(v, vdupq_n_u8('*')));
+            const uint8x16_t safe  = vorrq_u8(vorrq_u8(alpha, digit), vorrq_u8(sym1, sym2));
+            if (vminvq_u8(safe) != 0xFF) {
+                break;
             }
-            else
-            {
-                result += 3;    // %xx
-                escape = true;
+            vst1q_u8(out, v);
+            in  += 16;
+            out += 16;
+            copied += 16;
+        }
+#endif
+        // Scalar tail, or the block with the first escaped character.
+        while (in < end) {
+            const cc7::byte c = *in;
+            if (c == ' ' || s_url_encoding_table[c] == 0) {
+                break;
             }
+            *out++ = c;
+            ++in;
+            ++copied;
         }
-        return !escape ? 0 : result;
+        return copied;
     }
     
-    static inline cc7::byte _HexadecimalChar(cc7::byte c)
+    size_t ConvertStringToUrlEncodedBuffer(const cc7::ByteRange & str, cc7::byte * out)
     {
-        if (c < 10) {
-            return c + '0';
+        const cc7::byte * in  = str.data();
+        const cc7::byte * end = in + str.size();
+        cc7::byte * begin = out;
+        while (in < end) {
+            // Bulk copy of characters which doesn't need to be escaped
+            const size_t copied = _CopySafeCharactersRun(in, end, out);
+            in  += copied;
+            out += copied;
+            if (in == end) {
+                break;
+            }
+            // Escape the next character
+            const cc7::byte c = *in++;
+            const cc7::byte encoded = s_url_encoding_table[c];
+            if (encoded) {
+                // space is escaped with '+'
+                *out++ = encoded;
+            } else {
+                // escaped characters, %XX
+                out[0] = '%';
+                out[1] = s_hex_chars[c >> 4];
+                out[2] = s_hex_chars[c & 0xf];
+                out += 3;
+            }
         }
-        return 'A' - 10 + c;
+        return out - begin;
+    }
+    
+    void AppendUrlEncodedData(const cc7::ByteRange & str, cc7::ByteArray & out)
+    {
+        const size_t offset = out.size();
+        out.resize(offset + URLEncodingMaxLength(str.size()));
+        const size_t written = ConvertStringToUrlEncodedBuffer(str, out.data() + offset);
+        out.resize(offset + written);
     }
     
     cc7::ByteArray ConvertStringToUrlEncodedData(const std::string & str)
     {
-        if (str.size() == 0) {
-            return cc7::ByteArray();
-        }
-        
-        // Calculate expected length
-        size_t buffer_length = _URLEncodingEstimateResultLength(str.cbegin(), str.cend());
-        if (buffer_length == 0) {
-            // There's no escaping, we can return input string directly.
-            return cc7::ByteArray(str.cbegin(), str.cend());
-        }
-        
-        // Prepare buffer with expected length
         cc7::ByteArray buffer;
-        buffer.reserve(buffer_length);
-        
-        // Convert to encoded string
-        auto it  = str.cbegin();
-        auto end = str.cend();
-        while (it != end) {
-            cc7::byte c = (cc7::byte)*it++;
-            if ((c >= '0' && c <= '9') ||
-                (c >= 'A' && c <= 'Z') ||
-                (c >= 'a' && c <= 'z') ||
-                (c == '-' || c == '_' || c == '.' || c == '*')
-                )
-            {
-                // no escape
-                buffer.push_back(c);
-            }
-            else if (c == ' ')
-            {
-                // space is escaped with '+'
-                buffer.push_back('+');
-            }
-            else
-            {
-                // escaped characters, %XX
-                buffer.push_back('%');
-                buffer.push_back(_HexadecimalChar((c >> 4) & 0xf));
-                buffer.push_back(_HexadecimalChar(c & 0xf));
-            }
-        }
+        AppendUrlEncodedData(cc7::MakeRange(str), buffer);
         return buffer;
     }
     
@@ -27,6 +27,28 @@ namespace powerAuth
 namespace utils
 {
 
+    /**
+     Returns maximum length of URL encoded data, produced from |length| bytes.
+     */
+    inline size_t URLEncodingMaxLength(size_t length)
+    {
+        return length * 3;
+    }
+    
+    /**
+     Converts UTF8 string in |str| into URL encoded data and stores the result into
+     |out| buffer. The buffer must be at least `URLEncodingMaxLength(str.size())` bytes
+     long. The input is processed in one pass. Returns number of bytes written
+     to the buffer.
+     */
+    size_t ConvertStringToUrlEncodedBuffer(const cc7::ByteRange & str, cc7::byte * out);
+    
+    /**
+     Converts UTF8 string in |str| into URL encoded data and appends the result
+     at the end of |out| byte array.
+     */
+    void AppendUrlEncodedData(const cc7::ByteRange & str, cc7::ByteArray & out);
+    
     /**
      Converts UTF8 string into URL encoded data.
      */
@@ -31,6 +31,10 @@ namespace powerAuthTests
         // High level objects
         CC7_ADD_UNIT_TEST(pa2DataWriterReaderTests, list);
         CC7_ADD_UNIT_TEST(pa2SessionTests, list);
+        CC7_ADD_UNIT_TEST(pa2AsyncSessionTests, list);
+        CC7_ADD_UNIT_TEST(pa2SessionManagerTests, list);
+        CC7_ADD_UNIT_TEST(pa2SessionStoreTests, list);
+        CC7_ADD_UNIT_TEST(pa2WarmUpTests, list);
         CC7_ADD_UNIT_TEST(pa2PasswordTests, list);
         CC7_ADD_UNIT_TEST(pa2ActivationCodeTests, list);
         CC7_ADD_UNIT_TEST(pa2ECIESTests, list);
@@ -38,15 +42,18 @@ namespace powerAuthTests
         // Crypto tests
         CC7_ADD_UNIT_TEST(pa2CryptoPKCS7PaddingTests, list);
         CC7_ADD_UNIT_TEST(pa2CryptoAESTests, list);
+        CC7_ADD_UNIT_TEST(pa2CryptoSHA256Tests, list);
         CC7_ADD_UNIT_TEST(pa2CryptoHMACTests, list);
         CC7_ADD_UNIT_TEST(pa2CryptoECDHKDFTests, list);
         CC7_ADD_UNIT_TEST(pa2CryptoECCTests, list);
         CC7_ADD_UNIT_TEST(pa2CryptoECDSATests, list);
+        CC7_ADD_UNIT_TEST(pa2CryptoProviderTests, list);
         
         // Protocol tests
         CC7_ADD_UNIT_TEST(pa2ProtocolUtilsTests, list);
         CC7_ADD_UNIT_TEST(pa2RecoveryCodeTests, list);
         CC7_ADD_UNIT_TEST(pa2URLEncodingTests, list);
+        CC7_ADD_UNIT_TEST(pa2Base64Tests, list);
         CC7_ADD_UNIT_TEST(pa2SignatureKeysDerivationTest, list);
         CC7_ADD_UNIT_TEST(pa2MasterSecretKeyComputation, list);
         CC7_ADD_UNIT_TEST(pa2SignatureCalculationTests, list);
@@ -55,6 +62,8 @@ namespace powerAuthTests
         
         // Misc
         CC7_ADD_UNIT_TEST(pa2CRC16Tests, list);
+        CC7_ADD_UNIT_TEST(pa2MetricsTests, list);
+        CC7_ADD_UNIT_TEST(pa2TracingTests, list);
 
         return list;
     }
@@ -57,6 +57,10 @@ namespace powerAuthTests
                     ccstFailure("Doesn't match: Expected %s vs %s", expectedIV.hexString().c_str(), calculatedIV.hexString().c_str());
                     break;
                 }
+                // The same with already derived keys
+                protocol::TransportKeys transportKeys;
+                ccstAssertTrue(protocol::DeriveTransportKeys(transportKey, transportKeys));
+                ccstAssertEqual(protocol::DeriveIVForStatusBlobDecryption(challenge, nonce, transportKeys), expectedIV);
             }
         }
         
@@ -102,6 +106,16 @@ namespace powerAuthTests
                 auto local_ctr_data = ctrData;
                 int distance = protocol::CalculateHashCounterDistance(local_ctr_data, status.ctrDataHash, transportKey, status.lookAheadCount);
                 ccstAssertEqual(expCounterDistance, std::to_string(distance));
+                
+                // The same with already derived keys
+                protocol::TransportKeys transportKeys;
+                ccstAssertTrue(protocol::DeriveTransportKeys(transportKey, transportKeys));
+                ActivationStatus status2;
+                result = protocol::DecryptEncryptedStatusBlob(cStatusBlob, challenge, nonce, transportKeys, status2);
+                ccstAssertEqual(EC_Ok, result);
+                ccstAssertEqual(status2.ctrDataHash, status.ctrDataHash);
+                local_ctr_data = ctrData;
+                ccstAssertEqual(distance, protocol::CalculateHashCounterDistance(local_ctr_data, status2.ctrDataHash, transportKeys, status2.lookAheadCount));
             }
         }
         
@@ -0,0 +1,273 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cc7tests/CC7Tests.h>
+#include <PowerAuth/AsyncSession.h>
+#include "crypto/CryptoUtils.h"
+#include "crypto/KDF.h"
+#include "pa2SessionTestUtils.h"
+#include <atomic>
+#include <future>
+#include <thread>
+
+using namespace cc7;
+using namespace cc7::tests;
+using namespace com::wultra::powerAuth;
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuthTests
+{
+    class pa2AsyncSessionTests : public UnitTest
+    {
+    public:
+        
+        pa2AsyncSessionTests()
+        {
+            CC7_REGISTER_TEST_METHOD(testThreadPoolExecutor)
+            CC7_REGISTER_TEST_METHOD(testProgressivePBKDF2)
+            CC7_REGISTER_TEST_METHOD(testAsyncOperations)
+            CC7_REGISTER_TEST_METHOD(testCancelBeforeStart)
+            CC7_REGISTER_TEST_METHOD(testCancelRunningDerivation)
+        }
+        
+        EC_KEY * _masterServerPrivateKey;
+        SessionSetup _setup;
+        
+        void setUp() override
+        {
+            _masterServerPrivateKey = crypto::ECC_GenerateKeyPair();
+            ccstAssertNotNull(_masterServerPrivateKey);
+            _setup = TestSessionSetup(crypto::ECC_ExportPublicKeyToB64(_masterServerPrivateKey));
+        }
+        
+        void tearDown() override
+        {
+            EC_KEY_free(_masterServerPrivateKey);
+            _masterServerPrivateKey = nullptr;
+        }
+        
+        /**
+         Waits until |op| is finished. The operation is marked as finished after its completion
+         returns, so the result delivered from the completion can arrive a little earlier.
+         */
+        bool waitUntilFinished(const AsyncOperationPtr & op)
+        {
+            for (int i = 0; i < 5000 && !op->isFinished(); i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return op->isFinished();
+        }
+        
+        // unit tests
+        
+        void testThreadPoolExecutor()
+        {
+            std::atomic<int> counter(0);
+            {
+                ThreadPoolExecutor executor(4);
+                ccstAssertEqual(executor.threadsCount(), 4);
+                for (int i = 0; i < 1000; i++) {
+                    executor.execute([&counter]() {
+                        counter++;
+                    });
+                }
+                // Destructor must process all scheduled tasks.
+            }
+            ccstAssertEqual(counter.load(), 1000);
+            ccstAssertNotNull(Executor::defaultExecutor().get());
+            ccstAssertTrue(Executor::defaultExecutor() == Executor::defaultExecutor());
+        }
+        
+        class TestDelegate : public crypto::KDFProgressDelegate
+        {
+        public:
+            cc7::U32 cancelAt = 0;
+            cc7::U32 lastCompleted = 0;
+            size_t calls = 0;
+            bool monotonic = true;
+            
+            bool kdfProgress(cc7::U32 completed, cc7::U32 total) override
+            {
+                if (completed < lastCompleted || completed > total) {
+                    monotonic = false;
+                }
+                lastCompleted = completed;
+                calls++;
+                return cancelAt == 0 || completed < cancelAt;
+            }
+        };
+        
+        void testProgressivePBKDF2()
+        {
+            const cc7::U32 iterations[] = { 1, 2, 1023, 1024, 1025, 5000 };
+            const size_t lengths[] = { 16, 20, 32, 48, 65 };
+            cc7::ByteArray pass = crypto::GetRandomData(12);
+            cc7::ByteArray salt = crypto::GetRandomData(16);
+            for (auto iter : iterations) {
+                for (auto length : lengths) {
+                    auto expected1 = crypto::PBKDF2_HMAC_SHA1(pass, salt, iter, length);
+                    auto expected256 = crypto::PBKDF2_HMAC_SHA256(pass, salt, iter, length);
+                    ccstAssertEqual(expected1.size(), length);
+                    TestDelegate delegate1, delegate256;
+                    {
+                        crypto::ScopedKDFProgressDelegate scope(&delegate1);
+                        ccstAssertEqual(crypto::PBKDF2_HMAC_SHA1(pass, salt, iter, length), expected1);
+                        {
+                            crypto::ScopedKDFProgressDelegate nested_scope(&delegate256);
+                            ccstAssertEqual(crypto::PBKDF2_HMAC_SHA256(pass, salt, iter, length), expected256);
+                        }
+                    }
+                    ccstAssertTrue(delegate1.monotonic);
+                    ccstAssertTrue(delegate256.monotonic);
+                    ccstAssertTrue(delegate1.calls >= 1);
+                    ccstAssertTrue(delegate256.calls >= 1);
+                    ccstAssertEqual(delegate1.lastCompleted, iter * ((length + 19) / 20));
+                    ccstAssertEqual(delegate256.lastCompleted, iter * ((length + 31) / 32));
+                }
+            }
+            // Password longer than the digest's block size
+            cc7::ByteArray long_pass = crypto::GetRandomData(200);
+            TestDelegate long_pass_delegate;
+            auto expected_long = crypto::PBKDF2_HMAC_SHA256(long_pass, salt, 1500, 32);
+            {
+                crypto::ScopedKDFProgressDelegate scope(&long_pass_delegate);
+                ccstAssertEqual(crypto::PBKDF2_HMAC_SHA256(long_pass, salt, 1500, 32), expected_long);
+            }
+            // Cancellation
+            TestDelegate delegate;
+            delegate.cancelAt = 2048;
+            {
+                crypto::ScopedKDFProgressDelegate scope(&delegate);
+                ccstAssertTrue(crypto::PBKDF2_HMAC_SHA1(pass, salt, 10000, 16).empty());
+            }
+            ccstAssertEqual(delegate.lastCompleted, 2048);
+            // Delegate is no longer installed
+            ccstAssertEqual(crypto::PBKDF2_HMAC_SHA1(pass, salt, 10000, 16).size(), 16);
+            ccstAssertEqual(delegate.lastCompleted, 2048);
+        }
+        
+        void testAsyncOperations()
+        {
+            Session session(_setup);
+            AsyncSession async_session(session, std::make_shared<ThreadPoolExecutor>(2));
+            
+            // Operations on session without activation
+            {
+                std::promise<ErrorCode> promise;
+                HTTPRequestData request(cc7::MakeRange("hello"), "POST", "/hello/world");
+                SignatureUnlockKeys keys;
+                keys.possessionUnlockKey = Session::generateSignatureUnlockKey();
+                auto op = async_session.signHTTPRequestData(request, keys, SF_Possession, [&promise](ErrorCode code, const HTTPRequestDataSignature & signature) {
+                    promise.set_value(code);
+                });
+                ccstAssertEqual(promise.get_future().get(), EC_WrongState);
+                ccstAssertFalse(op->isCancelled());
+            }
+            {
+                std::promise<ErrorCode> promise;
+                async_session.changeUserPassword(cc7::MakeRange("old"), cc7::MakeRange("new"), [&promise](ErrorCode code) {
+                    promise.set_value(code);
+                });
+                ccstAssertEqual(promise.get_future().get(), EC_WrongState);
+            }
+            // Start activation
+            {
+                std::promise<ErrorCode> promise;
+                std::string device_public_key;
+                auto op = async_session.startActivation(ActivationStep1Param(), [&](ErrorCode code, const ActivationStep1Result & result) {
+                    device_public_key = result.devicePublicKey;
+                    promise.set_value(code);
+                });
+                ccstAssertEqual(promise.get_future().get(), EC_Ok);
+                ccstAssertTrue(waitUntilFinished(op));
+                ccstAssertFalse(device_public_key.empty());
+                ccstAssertTrue(session.hasPendingActivation());
+            }
+        }
+        
+        void testCancelBeforeStart()
+        {
+            Session session(_setup);
+            auto executor = std::make_shared<ThreadPoolExecutor>(1);
+            AsyncSession async_session(session, executor);
+            
+            // Block the only worker thread
+            std::promise<void> blocker;
+            std::shared_future<void> blocker_future = blocker.get_future().share();
+            executor->execute([blocker_future]() {
+                blocker_future.wait();
+            });
+            std::promise<ErrorCode> promise;
+            auto op = async_session.startActivation(ActivationStep1Param(), [&promise](ErrorCode code, const ActivationStep1Result & result) {
+                promise.set_value(code);
+            });
+            op->cancel();
+            ccstAssertTrue(op->isCancelled());
+            ccstAssertFalse(op->isFinished());
+            blocker.set_value();
+            
+            ccstAssertEqual(promise.get_future().get(), EC_Cancelled);
+            ccstAssertTrue(waitUntilFinished(op));
+            ccstAssertTrue(session.canStartActivation());
+            ccstAssertFalse(session.hasPendingActivation());
+        }
+        
+        void testCancelRunningDerivation()
+        {
+            Session session(TestSessionSetup());
+            ccstAssertEqual(session.loadSessionState(TestActivatedSessionState()), EC_Ok);
+            ccstAssertTrue(session.hasValidActivation());
+            auto state_before = session.saveSessionState();
+            
+            AsyncSession async_session(session, std::make_shared<ThreadPoolExecutor>(1));
+            
+            // Cancel the operation from its first progress report, so the password
+            // derivation is already running.
+            std::promise<AsyncOperationPtr> op_promise;
+            std::shared_future<AsyncOperationPtr> op_future = op_promise.get_future().share();
+            std::atomic<bool> progress_reported(false);
+            std::promise<ErrorCode> promise;
+            HTTPRequestData request(cc7::MakeRange("hello"), "POST", "/hello/world");
+            SignatureUnlockKeys keys;
+            keys.possessionUnlockKey = Session::generateSignatureUnlockKey();
+            keys.userPassword = cc7::MakeRange("1234");
+            auto op = async_session.signHTTPRequestData(request, keys, SF_Possession_Knowledge, [&promise](ErrorCode code, const HTTPRequestDataSignature & signature) {
+                promise.set_value(code);
+            }, [&](double progress) {
+                if (!progress_reported.exchange(true)) {
+                    op_future.get()->cancel();
+                }
+            });
+            op_promise.set_value(op);
+            
+            ccstAssertEqual(promise.get_future().get(), EC_Cancelled);
+            ccstAssertTrue(waitUntilFinished(op));
+            ccstAssertTrue(op->isCancelled());
+            ccstAssertTrue(progress_reported);
+            // Neither the state, nor the signature counter has been changed.
+            ccstAssertTrue(session.hasValidActivation());
+            ccstAssertEqual(session.saveSessionState(), state_before);
+        }
+    };
+    
+    CC7_CREATE_UNIT_TEST(pa2AsyncSessionTests, "pa2")
+    
+} // com::wultra::powerAuthTests
+} // com::wultra
+} // com
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cc7tests/CC7Tests.h>
+#include <cc7/Base64.h>
+#include "utils/Base64.h"
+
+using namespace cc7;
+using namespace cc7::tests;
+using namespace com::wultra::powerAuth;
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuthTests
+{
+    class pa2Base64Tests : public UnitTest
+    {
+    public:
+
+        pa2Base64Tests()
+        {
+            CC7_REGISTER_TEST_METHOD(testTestVectors)
+            CC7_REGISTER_TEST_METHOD(testLongSequences)
+            CC7_REGISTER_TEST_METHOD(testInvalidSequences)
+            CC7_REGISTER_TEST_METHOD(testAllImplementations)
+        }
+
+        /**
+         Restores the kernels selected for the current CPU when the test is finished.
+         */
+        struct ScopedImplementation
+        {
+            const utils::Base64Implementation implementation;
+
+            ScopedImplementation() :
+                implementation(utils::Base64_ActiveImplementation())
+            {
+            }
+
+            ~ScopedImplementation()
+            {
+                utils::Base64_SelectImplementation(implementation);
+            }
+        };
+
+        void testTestVectors()
+        {
+            // RFC 4648, section 10
+            const struct {
+                const char * plain;
+                const char * encoded;
+            } tests[] =
+            {
+                { "",       ""          },
+                { "f",      "Zg=="      },
+                { "fo",     "Zm8="      },
+                { "foo",    "Zm9v"      },
+                { "foob",   "Zm9vYg=="  },
+                { "fooba",  "Zm9vYmE="  },
+                { "foobar", "Zm9vYmFy"  },
+                // end
+                { nullptr, nullptr }
+            };
+
+            auto td = tests;
+            while (td->plain) {
+                std::string encoded = utils::ToBase64String(cc7::MakeRange(td->plain));
+                ccstAssertEqual(encoded, td->encoded);
+                cc7::ByteArray decoded;
+                ccstAssertTrue(utils::Base64_Decode(std::string(td->encoded), decoded));
+                ccstAssertEqual(decoded, cc7::MakeRange(td->plain));
+                td++;
+            }
+            // Whole alphabet
+            cc7::ByteArray all_values;
+            for (int i = 0; i < 64; i++) {
+                all_values.push_back((cc7::byte)(i << 2));
+            }
+            ccstAssertEqual(utils::ToBase64String(all_values), cc7::ToBase64String(all_values));
+        }
+
+        void testLongSequences()
+        {
+            // Test all lengths long enough to involve all bulk encoders and decoders
+            for (size_t length = 0; length < 300; length++) {
+                cc7::ByteArray data = getTestRandomData(length);
+                std::string encoded = utils::ToBase64String(data);
+                ccstAssertEqual(encoded.size(), utils::Base64_EncodedLength(length));
+                ccstAssertEqual(encoded, cc7::ToBase64String(data));
+                cc7::ByteArray decoded;
+                ccstAssertTrue(utils::Base64_Decode(encoded, decoded));
+                ccstAssertEqual(decoded, data);
+                // Encode into buffer
+                std::string buffer(encoded.size() + 1, '#');
+                size_t written = utils::Base64_EncodeToBuffer(data, &buffer[0]);
+                ccstAssertEqual(written, encoded.size());
+                ccstAssertEqual(buffer.substr(0, written), encoded);
+                ccstAssertEqual(buffer[written], '#');
+            }
+        }
+
+        void testInvalidSequences()
+        {
+            const char * tests[] =
+            {
+                "A", "AA", "AAA", "AA=", "A===", "====", "AA=A", "=AAA", "Zm9v=",
+                "Zm9vYg=\n", "Zm9v\nYg==", " Zm9vYg==", "Zm9-Yg==", "Zm9_Yg==",
+                "Zm9vYmFyZm9vYmFyZm9vYmFyZm9vYmFyZm9vYmFyZm9vYmFyZm9vYmFy=m9vYmFyZm9vYmFy",
+                "Zm9vYmFyZm9vYmFyZm9vYmFyZm9vYmFyZm9vYmFyZm9vYmFy.m9vYmFyZm9vYmFyZm9vYmFy",
+                nullptr
+            };
+            auto td = tests;
+            while (*td) {
+                cc7::ByteArray decoded;
+                bool result = utils::Base64_Decode(std::string(*td), decoded);
+                ccstAssertFalse(result, "Sequence '%s' should not be decoded", *td);
+                ccstAssertTrue(decoded.empty());
+                td++;
+            }
+            // Each invalid character, at each position of a long sequence.
+            const std::string valid = utils::ToBase64String(getTestRandomData(96));
+            for (size_t pos = 0; pos < valid.size(); pos++) {
+                for (int c = 0; c < 256; c++) {
+                    if (isalnum(c) || c == '+' || c == '/' || c == '=') {
+                        continue;
+                    }
+                    std::string invalid = valid;
+                    invalid[pos] = (char)c;
+                    cc7::ByteArray decoded;
+                    ccstAssertFalse(utils::Base64_Decode(invalid, decoded));
+                }
+            }
+        }
+
+        void testAllImplementations()
+        {
+            const utils::Base64Implementation implementations[] = {
+                utils::Base64Impl_Scalar, utils::Base64Impl_SSSE3, utils::Base64Impl_AVX2, utils::Base64Impl_NEON
+            };
+            // Prepare the same inputs for all kernels. Each encoded sequence is also
+            // damaged at a position depending on its length, so the decoders have to
+            // detect an invalid character in the bulk loop as well as in the tail.
+            std::vector<cc7::ByteArray> inputs;
+            std::vector<std::string> invalid_inputs;
+            for (size_t length = 0; length < 300; length++) {
+                inputs.push_back(getTestRandomData(length));
+                std::string invalid = cc7::ToBase64String(inputs.back());
+                if (!invalid.empty()) {
+                    invalid[(length * 7) % invalid.size()] = '.';
+                }
+                invalid_inputs.push_back(invalid);
+            }
+            ScopedImplementation restore_implementation;
+            for (auto impl : implementations) {
+                if (!utils::Base64_SelectImplementation(impl)) {
+                    ccstMessage("Base64 implementation %d is not available", (int)impl);
+                    continue;
+                }
+                ccstAssertEqual(utils::Base64_ActiveImplementation(), impl);
+                for (size_t i = 0; i < inputs.size(); i++) {
+                    const cc7::ByteArray & data = inputs[i];
+                    const std::string expected = cc7::ToBase64String(data);
+                    std::string encoded = utils::ToBase64String(data);
+                    ccstAssertEqual(encoded, expected, "Implementation %d, length %d", (int)impl, (int)i);
+                    cc7::ByteArray decoded;
+                    ccstAssertTrue(utils::Base64_Decode(encoded, decoded));
+                    ccstAssertEqual(decoded, data, "Implementation %d, length %d", (int)impl, (int)i);
+                    if (!invalid_inputs[i].empty()) {
+                        ccstAssertFalse(utils::Base64_Decode(invalid_inputs[i], decoded));
+                        ccstAssertTrue(decoded.empty());
+                    }
+                }
+            }
+        }
+    };
+
+    CC7_CREATE_UNIT_TEST(pa2Base64Tests, "pa2")
+
+} // com::wultra::powerAuthTests
+} // com::wultra
+} // com
@@ -19,6 +19,7 @@
 #include <cc7/Base64.h>
 #include "crypto/CryptoUtils.h"
 #include <openssl/err.h>
+#include <thread>
 
 using namespace cc7;
 using namespace cc7::tests;
@@ -38,6 +39,8 @@ namespace powerAuthTests
         {
             CC7_REGISTER_TEST_METHOD(testKeyImportExport)
             CC7_REGISTER_TEST_METHOD(testPubKeyImport)
+            CC7_REGISTER_TEST_METHOD(testValidatedPubKeyImport)
+            CC7_REGISTER_TEST_METHOD(testThreadContext)
             //CC7_REGISTER_TEST_METHOD(testImportPerformance)
         }
 
@@ -81,6 +84,92 @@ namespace powerAuthTests
             EC_KEY_free(public_key);
         }
                 
+        void testValidatedPubKeyImport()
+        {
+            auto key_pair = crypto::ECC_GenerateKeyPair();
+            if (!key_pair) {
+                ccstFailure();
+                return;
+            }
+            auto compressed = crypto::ECC_ExportPublicKey(key_pair);
+            auto uncompressed = crypto::ECC_ExportPublicKeyUncompressed(key_pair);
+            EC_KEY_free(key_pair);
+            ccstAssertEqual(uncompressed.size(), 65);
+            ccstAssertEqual(uncompressed[0], 0x04);
+            
+            // Import uncompressed point, the result must be the same key.
+            auto public_key = crypto::ECC_ImportValidatedPublicKey(nullptr, uncompressed);
+            if (!public_key) {
+                ccstFailure();
+                return;
+            }
+            ccstAssertEqual(compressed, crypto::ECC_ExportPublicKey(public_key));
+            ccstAssertEqual(uncompressed, crypto::ECC_ExportPublicKeyUncompressed(public_key));
+            EC_KEY_free(public_key);
+            
+            // Regular import accepts uncompressed point too.
+            public_key = crypto::ECC_ImportPublicKey(nullptr, uncompressed);
+            ccstAssertNotNull(public_key);
+            EC_KEY_free(public_key);
+            
+            // Compressed point, wrong length, or point not on curve.
+            ccstAssertNull(crypto::ECC_ImportValidatedPublicKey(nullptr, compressed));
+            ccstAssertNull(crypto::ECC_ImportValidatedPublicKey(nullptr, cc7::ByteRange(uncompressed).subRangeTo(64)));
+            auto invalid = uncompressed;
+            invalid[64] ^= 1;
+            ccstAssertNull(crypto::ECC_ImportValidatedPublicKey(nullptr, invalid));
+        }
+        
+        void testThreadContext()
+        {
+            // Helpers without explicit context share the thread's context.
+            BN_CTX * thread_ctx = crypto::BNContext::threadContext();
+            ccstAssertNotNull(thread_ctx);
+            {
+                crypto::BNContext ctx1;
+                crypto::BNContext ctx2;
+                ccstAssertEqual(ctx1.ctx(), thread_ctx);
+                ccstAssertEqual(ctx2.ctx(), thread_ctx);
+                ccstAssertNotNull(BN_CTX_get(ctx2));
+            }
+            // Explicit context is used as it is.
+            BN_CTX * own_ctx = BN_CTX_new();
+            {
+                crypto::BNContext ctx(own_ctx);
+                ccstAssertEqual(ctx.ctx(), own_ctx);
+            }
+            BN_CTX_free(own_ctx);
+            
+            // Each thread has its own context.
+            BN_CTX * other_ctx = nullptr;
+            std::thread([&other_ctx] {
+                other_ctx = crypto::BNContext::threadContext();
+            }).join();
+            ccstAssertNotNull(other_ctx);
+            ccstAssertNotEqual(other_ctx, thread_ctx);
+            
+            // Frames are released, so repeated use doesn't exhaust the context.
+            auto key_pair = crypto::ECC_GenerateKeyPair();
+            if (!key_pair) {
+                ccstFailure();
+                return;
+            }
+            auto public_key_data = crypto::ECC_ExportPublicKey(key_pair);
+            auto private_key_data = crypto::ECC_ExportPrivateKey(key_pair);
+            EC_KEY_free(key_pair);
+            crypto::BNContext ctx;
+            for (int i = 0; i < 200; i++) {
+                auto public_key = crypto::ECC_ImportPublicKey(nullptr, public_key_data, ctx);
+                auto private_key = crypto::ECC_ImportPrivateKey(nullptr, private_key_data, ctx);
+                ccstAssertNotNull(public_key);
+                ccstAssertNotNull(private_key);
+                ccstAssertEqual(public_key_data, crypto::ECC_ExportPublicKey(public_key, ctx));
+                ccstAssertEqual(private_key_data, crypto::ECC_ExportPrivateKey(private_key, ctx));
+                EC_KEY_free(public_key);
+                EC_KEY_free(private_key);
+            }
+        }
+        
         void testPubKeyImport()
         {
             const test_data test_vectors[] = {
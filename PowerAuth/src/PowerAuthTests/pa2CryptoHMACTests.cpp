@@ -18,6 +18,7 @@
 #include <cc7/HexString.h>
 #include "crypto/CryptoUtils.h"
 #include "crypto/PKCS7Padding.h"
+#include <future>
 
 using namespace cc7;
 using namespace cc7::tests;
@@ -37,6 +38,7 @@ namespace powerAuthTests
         {
             CC7_REGISTER_TEST_METHOD(testPBKDF2_HMAC_SHA1)
             CC7_REGISTER_TEST_METHOD(testHMAC_SHA256)
+            CC7_REGISTER_TEST_METHOD(testContextReuse)
         }
         
         // unit tests
@@ -195,6 +197,35 @@ namespace powerAuthTests
                 td++;
             }
         }
+        
+        void testContextReuse()
+        {
+            // Contexts are reused on the same thread, so the previous key must not affect the next result.
+            const cc7::ByteArray key  = cc7::FromHexString("0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b");
+            const cc7::ByteArray data = cc7::FromHexString("4869205468657265");
+            const cc7::ByteArray exp  = cc7::FromHexString("b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+            const cc7::ByteArray exp_empty = cc7::FromHexString("b613679a0814d9ec772f95d778c35fc5ff1697c493715653c6c712144292c5ad");
+            const cc7::ByteArray exp_sha = cc7::FromHexString("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+            auto worker = [&]() -> bool {
+                bool result = true;
+                for (int i = 0; i < 100; i++) {
+                    result &= crypto::HMAC_SHA256(data, key) == exp;
+                    result &= crypto::HMAC_SHA256(cc7::ByteRange(), cc7::ByteRange()) == exp_empty;
+                    result &= crypto::SHA256(cc7::MakeRange("abc")) == exp_sha;
+                    auto encrypted = crypto::AES_CBC_Encrypt_Padding(key.byteRange().subRangeTo(16), crypto::GetRandomData(16), data);
+                    result &= encrypted.size() == 16;
+                }
+                return result;
+            };
+            ccstAssertTrue(worker());
+            std::vector<std::future<bool>> results;
+            for (int t = 0; t < 4; t++) {
+                results.push_back(std::async(std::launch::async, worker));
+            }
+            for (auto && r : results) {
+                ccstAssertTrue(r.get());
+            }
+        }
 
     };
     
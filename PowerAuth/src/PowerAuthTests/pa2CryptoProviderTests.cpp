@@ -0,0 +1,111 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cc7tests/CC7Tests.h>
+#include "crypto/CryptoUtils.h"
+#include "crypto/CryptoProvider.h"
+
+using namespace cc7;
+using namespace cc7::tests;
+using namespace com::wultra::powerAuth;
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuthTests
+{
+    class pa2CryptoProviderTests : public UnitTest
+    {
+    public:
+        
+        pa2CryptoProviderTests()
+        {
+            CC7_REGISTER_TEST_METHOD(testSymmetricCrypto)
+            CC7_REGISTER_TEST_METHOD(testEllipticCurve)
+        }
+        
+        // unit tests
+        
+        void testSymmetricCrypto()
+        {
+            ccstMessage("Active crypto provider: %s", crypto::CryptoProvider::name());
+            // The active provider must produce the same results as the common implementation.
+            for (size_t i = 0; i < 64; i++) {
+                ByteArray key = getTestRandomData(16 + (i % 3) * 8);
+                ByteArray iv = getTestRandomData(16);
+                ByteArray data = getTestRandomData(16 * (i % 5));
+                ByteArray out1(data.size(), 0);
+                ByteArray out2(data.size(), 0);
+                // AES
+                ccstAssertTrue(crypto::CryptoProvider::AES_CBC(key, iv, data, true, out1.data()));
+                ccstAssertTrue(crypto::OpenSSLCommonProvider::AES_CBC(key, iv, data, true, out2.data()));
+                ccstAssertEqual(out1, out2);
+                ccstAssertTrue(crypto::CryptoProvider::AES_CBC(key, iv, out1, false, out2.data()));
+                ccstAssertEqual(out2, data);
+                // HMAC
+                ByteArray mac1(32, 0);
+                ByteArray mac2(32, 0);
+                ByteArray mac_key = getTestRandomData(i);
+                ccstAssertTrue(crypto::CryptoProvider::HMAC_SHA256(mac_key, data, mac1.data()));
+                ccstAssertTrue(crypto::OpenSSLCommonProvider::HMAC_SHA256(mac_key, data, mac2.data()));
+                ccstAssertEqual(mac1, mac2);
+                // PBKDF2
+                ccstAssertTrue(crypto::CryptoProvider::PBKDF2_HMAC(crypto::EVP_SHA256_Digest(), key, iv, (cc7::U32)(1 + i), mac1.data(), mac1.size()));
+                ccstAssertTrue(crypto::OpenSSLCommonProvider::PBKDF2_HMAC(crypto::EVP_SHA256_Digest(), key, iv, (cc7::U32)(1 + i), mac2.data(), mac2.size()));
+                ccstAssertEqual(mac1, mac2);
+            }
+            // Invalid parameters
+            ByteArray out(16, 0);
+            ccstAssertFalse(crypto::CryptoProvider::AES_CBC(getTestRandomData(15), getTestRandomData(16), getTestRandomData(16), true, out.data()));
+            ccstAssertFalse(crypto::CryptoProvider::AES_CBC(getTestRandomData(16), getTestRandomData(15), getTestRandomData(16), true, out.data()));
+        }
+        
+        void testEllipticCurve()
+        {
+            EC_KEY * key1 = crypto::ECC_GenerateKeyPair();
+            EC_KEY * key2 = crypto::ECC_GenerateKeyPair();
+            ccstAssertNotNull(key1);
+            ccstAssertNotNull(key2);
+            if (!key1 || !key2) {
+                return;
+            }
+            // Signatures must be interchangeable with the common implementation.
+            ByteArray digest = crypto::SHA256(getTestRandomData(100));
+            ByteArray signature1, signature2;
+            ccstAssertTrue(crypto::CryptoProvider::ECDSA_Sign(digest, key1, signature1));
+            ccstAssertTrue(crypto::OpenSSLCommonProvider::ECDSA_Sign(digest, key1, signature2));
+            ccstAssertTrue(crypto::OpenSSLCommonProvider::ECDSA_Verify(digest, signature1, key1));
+            ccstAssertTrue(crypto::CryptoProvider::ECDSA_Verify(digest, signature2, key1));
+            ccstAssertFalse(crypto::CryptoProvider::ECDSA_Verify(digest, signature1, key2));
+            // Shared secret must be the same for both parties.
+            ByteArray secret1(32, 0);
+            ByteArray secret2(32, 0);
+            ccstAssertTrue(crypto::CryptoProvider::ECDH(key1, key2, secret1.data(), secret1.size()));
+            ccstAssertTrue(crypto::OpenSSLCommonProvider::ECDH(key2, key1, secret2.data(), secret2.size()));
+            ccstAssertEqual(secret1, secret2);
+            
+            EC_KEY_free(key1);
+            EC_KEY_free(key2);
+        }
+    };
+    
+    CC7_CREATE_UNIT_TEST(pa2CryptoProviderTests, "pa2")
+    
+} // com::wultra::powerAuthTests
+} // com::wultra
+} // com
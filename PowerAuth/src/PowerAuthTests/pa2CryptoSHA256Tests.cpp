@@ -0,0 +1,186 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cc7tests/CC7Tests.h>
+#include <cc7/HexString.h>
+#include "crypto/CryptoUtils.h"
+#include "crypto/SHA256MultiBuffer.h"
+#include <openssl/sha.h>
+#include <openssl/hmac.h>
+
+using namespace cc7;
+using namespace cc7::tests;
+using namespace com::wultra::powerAuth;
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuthTests
+{
+    class pa2CryptoSHA256Tests : public UnitTest
+    {
+    public:
+        
+        pa2CryptoSHA256Tests()
+        {
+            CC7_REGISTER_TEST_METHOD(testTestVectors)
+            CC7_REGISTER_TEST_METHOD(testAllImplementations)
+            CC7_REGISTER_TEST_METHOD(testMultiBuffer)
+        }
+        
+        /**
+         Saves the active SHA-256 implementations and restores them when destroyed,
+         so the implementations forced by the test don't leak into other tests.
+         */
+        struct ScopedImplementations
+        {
+            const crypto::SHA256Implementation implementation;
+            const crypto::SHA256MultiBufferImplementation multiBufferImplementation;
+            
+            ScopedImplementations() :
+                implementation(crypto::SHA256_ActiveImplementation()),
+                multiBufferImplementation(crypto::SHA256MultiBuffer_ActiveImplementation())
+            {
+            }
+            
+            ~ScopedImplementations()
+            {
+                crypto::SHA256_SelectImplementation(implementation);
+                crypto::SHA256MultiBuffer_SelectImplementation(multiBufferImplementation);
+            }
+        };
+        
+        // unit tests
+        
+        void testTestVectors()
+        {
+            // FIPS 180-2 examples
+            const struct {
+                const char * message;
+                const char * digest;
+            } tests[] =
+            {
+                { "",
+                  "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+                { "abc",
+                  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+                { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+                  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+                { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+                  "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+                // end
+                { nullptr, nullptr }
+            };
+            auto td = tests;
+            while (td->message) {
+                auto expected = cc7::FromHexString(td->digest);
+                ccstAssertEqual(crypto::SHA256(cc7::MakeRange(td->message)), expected);
+                td++;
+            }
+            // One million of 'a'
+            cc7::ByteArray million(1000000, 'a');
+            crypto::SHA256Context ctx;
+            cc7::byte digest[crypto::SHA256Context::DigestSize];
+            for (size_t offset = 0; offset < million.size(); offset += 999) {
+                ctx.update(million.byteRange().subRange(offset, std::min<size_t>(999, million.size() - offset)));
+            }
+            ctx.finalize(digest);
+            auto expected = cc7::FromHexString("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+            ccstAssertEqual(cc7::ByteRange(digest, sizeof(digest)), expected);
+            ccstAssertEqual(crypto::SHA256(million), expected);
+        }
+        
+        void testAllImplementations()
+        {
+            const crypto::SHA256Implementation implementations[] = {
+                crypto::SHA256Impl_Generic, crypto::SHA256Impl_X86_SHA, crypto::SHA256Impl_ARMv8_SHA2
+            };
+            ScopedImplementations restore_implementations;
+            for (auto impl : implementations) {
+                if (!crypto::SHA256_SelectImplementation(impl)) {
+                    ccstMessage("SHA256 implementation %d is not available", (int)impl);
+                    continue;
+                }
+                ccstAssertEqual(crypto::SHA256_ActiveImplementation(), impl);
+                // Compare results with OpenSSL, for all lengths around block boundaries.
+                cc7::ByteArray data = getTestRandomData(300);
+                crypto::SHA256Context ctx;
+                for (size_t length = 0; length <= data.size(); length++) {
+                    auto message = data.byteRange().subRangeTo(length);
+                    cc7::ByteArray expected(SHA256_DIGEST_LENGTH, 0);
+                    ::SHA256(message.data(), message.size(), expected.data());
+                    // One-shot
+                    ccstAssertEqual(crypto::SHA256(message), expected);
+                    // Streaming, split into two parts
+                    const size_t split = (length * 7) % (length + 1);
+                    cc7::byte digest[crypto::SHA256Context::DigestSize];
+                    ctx.update(message.subRangeTo(split));
+                    ctx.update(message.subRangeFrom(split));
+                    ctx.finalize(digest);
+                    ccstAssertEqual(cc7::ByteRange(digest, sizeof(digest)), expected);
+                }
+            }
+        }
+        
+        void testMultiBuffer()
+        {
+            const crypto::SHA256MultiBufferImplementation implementations[] = {
+                crypto::SHA256MB_Scalar, crypto::SHA256MB_AVX2, crypto::SHA256MB_AVX512
+            };
+            ScopedImplementations restore_implementations;
+            for (auto impl : implementations) {
+                if (!crypto::SHA256MultiBuffer_SelectImplementation(impl)) {
+                    ccstMessage("SHA256 multi-buffer implementation %d is not available", (int)impl);
+                    continue;
+                }
+                crypto::SHA256MultiBuffer engine;
+                // Jobs with different lengths, mixed SHA256 and HMAC, the count is not aligned to lanes.
+                const size_t count = 3 * engine.lanes() + 5;
+                std::vector<cc7::ByteArray> data(count), keys(count), digests(count);
+                for (size_t i = 0; i < count; i++) {
+                    data[i] = getTestRandomData((i * 37) % 200);
+                    keys[i] = getTestRandomData((i * 13) % 100);
+                    digests[i].resize(crypto::SHA256MultiBuffer::DigestSize);
+                    if (i & 1) {
+                        engine.submitHMAC_SHA256(keys[i], data[i], digests[i].data());
+                    } else {
+                        engine.submitSHA256(data[i], digests[i].data());
+                    }
+                }
+                engine.flush();
+                for (size_t i = 0; i < count; i++) {
+                    cc7::ByteArray expected(SHA256_DIGEST_LENGTH, 0);
+                    if (i & 1) {
+                        unsigned int length = 0;
+                        HMAC(EVP_sha256(), keys[i].data(), (int)keys[i].size(), data[i].data(), data[i].size(), expected.data(), &length);
+                    } else {
+                        ::SHA256(data[i].data(), data[i].size(), expected.data());
+                    }
+                    ccstAssertEqual(digests[i], expected, "Job %zu", i);
+                }
+                // Flush without pending jobs does nothing.
+                engine.flush();
+            }
+        }
+    };
+    
+    CC7_CREATE_UNIT_TEST(pa2CryptoSHA256Tests, "pa2")
+    
+} // com::wultra::powerAuthTests
+} // com::wultra
+} // com
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cc7tests/CC7Tests.h>
+#include "utils/Metrics.h"
+#include "crypto/CryptoUtils.h"
+#include <thread>
+
+using namespace cc7;
+using namespace cc7::tests;
+using namespace com::wultra::powerAuth;
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuthTests
+{
+    class pa2MetricsTests : public UnitTest
+    {
+    public:
+        
+        pa2MetricsTests()
+        {
+            CC7_REGISTER_TEST_METHOD(testBuckets)
+            CC7_REGISTER_TEST_METHOD(testRecording)
+            CC7_REGISTER_TEST_METHOD(testExport)
+        }
+        
+        // unit tests
+        
+        void testBuckets()
+        {
+            ccstAssertEqual(utils::Metrics_BucketIndex(0), 0);
+            ccstAssertEqual(utils::Metrics_BucketIndex(UINT64_MAX), utils::METRICS_BUCKET_COUNT - 1);
+            // Each value fits into its bucket and the index grows with the value.
+            for (U64 base = 1; base < (1ULL << 44); base <<= 1) {
+                unsigned prev_index = utils::Metrics_BucketIndex(base - 1);
+                for (U64 value = base - 1; value <= base + 17; value++) {
+                    unsigned index = utils::Metrics_BucketIndex(value);
+                    ccstAssertTrue(index >= prev_index);
+                    ccstAssertTrue(utils::Metrics_BucketLowestValue(index) <= value);
+                    ccstAssertTrue(utils::Metrics_BucketHighestValue(index) >= value);
+                    prev_index = index;
+                }
+            }
+            // Buckets are continuous.
+            for (unsigned index = 1; index < utils::METRICS_BUCKET_COUNT; index++) {
+                ccstAssertEqual(utils::Metrics_BucketLowestValue(index), utils::Metrics_BucketHighestValue(index - 1) + 1);
+                ccstAssertEqual(utils::Metrics_BucketIndex(utils::Metrics_BucketLowestValue(index)), index);
+                // Relative error is limited by number of sub-buckets.
+                const U64 lowest = utils::Metrics_BucketLowestValue(index);
+                const U64 width = utils::Metrics_BucketHighestValue(index) - lowest;
+                if (index < utils::METRICS_BUCKET_COUNT - 1) {
+                    ccstAssertTrue(width * utils::METRICS_SUB_BUCKET_COUNT <= lowest);
+                }
+            }
+        }
+        
+        void testRecording()
+        {
+            ResetMetrics();
+            utils::MetricsSnapshot snapshot;
+            utils::Metrics_Snapshot(snapshot);
+            ccstAssertEqual(snapshot.histograms[utils::MH_HMAC].count, 0);
+            ccstAssertEqual(snapshot.histograms[utils::MH_HMAC].maxValue(), 0);
+            ccstAssertEqual(snapshot.counters[utils::MC_ECIES_EncryptedBytes], 0);
+            
+            for (U64 i = 1; i <= 1000; i++) {
+                utils::Metrics_RecordLatency(utils::MH_HMAC, i * 1000);
+            }
+            utils::Metrics_Count(utils::MC_ECIES_EncryptedBytes, 10);
+            // Values from finished threads are kept.
+            std::thread thread([] {
+                for (U64 i = 0; i < 100; i++) {
+                    utils::Metrics_RecordLatency(utils::MH_ECDH, 50000);
+                }
+                utils::Metrics_Count(utils::MC_ECIES_EncryptedBytes, 5);
+            });
+            thread.join();
+            
+            utils::Metrics_Snapshot(snapshot);
+            const auto & hmac = snapshot.histograms[utils::MH_HMAC];
+            ccstAssertEqual(hmac.count, 1000);
+            ccstAssertEqual(hmac.sum, 500500000);
+            ccstAssertTrue(hmac.valueAtQuantile(0.5) >= 500000);
+            ccstAssertTrue(hmac.valueAtQuantile(0.5) <= 500000 * 9 / 8);
+            ccstAssertTrue(hmac.valueAtQuantile(0.99) >= 990000);
+            ccstAssertTrue(hmac.maxValue() >= 1000000);
+            ccstAssertTrue(hmac.maxValue() <= 1000000 * 9 / 8);
+            const auto & ecdh = snapshot.histograms[utils::MH_ECDH];
+            ccstAssertEqual(ecdh.count, 100);
+            ccstAssertEqual(ecdh.sum, 5000000);
+            ccstAssertEqual(snapshot.counters[utils::MC_ECIES_EncryptedBytes], 15);
+            
+            ResetMetrics();
+            utils::Metrics_Snapshot(snapshot);
+            for (size_t h = 0; h < utils::MH_Count; h++) {
+                ccstAssertEqual(snapshot.histograms[h].count, 0);
+                ccstAssertEqual(snapshot.histograms[h].sum, 0);
+            }
+            ccstAssertEqual(snapshot.counters[utils::MC_ECIES_EncryptedBytes], 0);
+            utils::Metrics_Count(utils::MC_ECIES_EncryptedBytes, 3);
+            utils::Metrics_Snapshot(snapshot);
+            ccstAssertEqual(snapshot.counters[utils::MC_ECIES_EncryptedBytes], 3);
+        }
+        
+        void testExport()
+        {
+            ccstMessage("Metrics collection available: %s", MetricsAvailable() ? "YES" : "NO");
+            ResetMetrics();
+            utils::Metrics_RecordLatency(utils::MH_PBKDF2, 1000);
+            utils::Metrics_RecordLatency(utils::MH_PBKDF2, 3000);
+            utils::Metrics_Count(utils::MC_ECIES_DecryptedBytes, 42);
+            
+            std::string prometheus = ExportMetrics(MF_Prometheus);
+            ccstAssertTrue(prometheus.find("# TYPE powerauth_crypto_duration_seconds histogram\n") != std::string::npos);
+            ccstAssertTrue(prometheus.find("powerauth_crypto_duration_seconds_bucket{operation=\"pbkdf2\",le=\"1.024e-06\"} 1\n") != std::string::npos);
+            ccstAssertTrue(prometheus.find("powerauth_crypto_duration_seconds_bucket{operation=\"pbkdf2\",le=\"2.048e-06\"} 1\n") != std::string::npos);
+            ccstAssertTrue(prometheus.find("powerauth_crypto_duration_seconds_bucket{operation=\"pbkdf2\",le=\"4.096e-06\"} 2\n") != std::string::npos);
+            ccstAssertTrue(prometheus.find("powerauth_crypto_duration_seconds_bucket{operation=\"pbkdf2\",le=\"34.359738368\"} 2\n") != std::string::npos);
+            ccstAssertTrue(prometheus.find("powerauth_crypto_duration_seconds_bucket{operation=\"pbkdf2\",le=\"+Inf\"} 2\n") != std::string::npos);
+            ccstAssertTrue(prometheus.find("powerauth_crypto_duration_seconds_sum{operation=\"pbkdf2\"} 4e-06\n") != std::string::npos);
+            ccstAssertTrue(prometheus.find("powerauth_crypto_duration_seconds_count{operation=\"pbkdf2\"} 2\n") != std::string::npos);
+            ccstAssertTrue(prometheus.find("powerauth_ecies_bytes_total{direction=\"decrypt\"} 42\n") != std::string::npos);
+            // Empty histograms export the same buckets.
+            ccstAssertTrue(prometheus.find("powerauth_crypto_duration_seconds_bucket{operation=\"hmac\",le=\"1.024e-06\"} 0\n") != std::string::npos);
+            ccstAssertTrue(prometheus.find("powerauth_crypto_duration_seconds_bucket{operation=\"hmac\",le=\"34.359738368\"} 0\n") != std::string::npos);
+            
+            std::string json = ExportMetrics(MF_JSON);
+            ccstAssertTrue(json.find("\"pbkdf2\":{\"count\":2,\"sum_ns\":4000,\"max_ns\":3071,\"p50_ns\":1023") != std::string::npos);
+            ccstAssertTrue(json.find("\"buckets\":[{\"lowest_ns\":960,\"count\":1},{\"lowest_ns\":2816,\"count\":1}]") != std::string::npos);
+            ccstAssertTrue(json.find("\"ecies_decrypted_bytes\":42") != std::string::npos);
+            ccstAssertEqual(json.front(), '{');
+            ccstAssertEqual(json.back(), '}');
+            
+            // Instrumented primitives record only if the collection is compiled in.
+            ResetMetrics();
+            crypto::HMAC_SHA256(getTestRandomData(32), getTestRandomData(32));
+            utils::MetricsSnapshot snapshot;
+            utils::Metrics_Snapshot(snapshot);
+            ccstAssertEqual(snapshot.histograms[utils::MH_HMAC].count, MetricsAvailable() ? 1 : 0);
+            ResetMetrics();
+        }
+    };
+    
+    CC7_CREATE_UNIT_TEST(pa2MetricsTests, "pa2")
+    
+} // com::wultra::powerAuthTests
+} // com::wultra
+} // com
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cc7tests/CC7Tests.h>
+#include <PowerAuth/SessionManager.h>
+#include "pa2SessionTestUtils.h"
+
+using namespace cc7;
+using namespace cc7::tests;
+using namespace com::wultra::powerAuth;
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuthTests
+{
+    class pa2SessionManagerTests : public UnitTest
+    {
+    public:
+        
+        pa2SessionManagerTests()
+        {
+            CC7_REGISTER_TEST_METHOD(testSetupAndSessions)
+            CC7_REGISTER_TEST_METHOD(testBulkOperations)
+        }
+        
+        const std::string ACTIVATION_ID = "FULL-BUT-FAKE-ACTIVATION-ID";
+        
+        SessionSetup makeSetup(const std::string & application_key)
+        {
+            return TestSessionSetup(TEST_MASTER_SERVER_PUBLIC_KEY, application_key);
+        }
+        
+        // unit tests
+        
+        void testSetupAndSessions()
+        {
+            SessionManager manager;
+            ccstAssertEqual(manager.registerSetup(SessionSetup()), EC_WrongParam);
+            ccstAssertEqual(manager.registerSetup(makeSetup("APP-1")), EC_Ok);
+            ccstAssertNotNull(manager.sessionSetup("APP-1").get());
+            ccstAssertNull(manager.sessionSetup("APP-2").get());
+            
+            // Only activated sessions can be added
+            auto session = std::make_shared<Session>(makeSetup("APP-1"));
+            ccstAssertEqual(manager.addSession(nullptr), EC_WrongParam);
+            ccstAssertEqual(manager.addSession(session), EC_WrongState);
+            ccstAssertEqual(session->loadSessionState(TestActivatedSessionState()), EC_Ok);
+            ccstAssertEqual(manager.addSession(session, false), EC_Ok);
+            ccstAssertEqual(manager.sessionsCount(), 1);
+            
+            ccstAssertTrue(manager.findSession("APP-1", ACTIVATION_ID) == session);
+            ccstAssertNull(manager.findSession("APP-2", ACTIVATION_ID).get());
+            ccstAssertNull(manager.findSession("APP-1", "OTHER").get());
+            
+            // Nothing to save, until the session is marked as dirty
+            std::vector<SessionStateRecord> records;
+            ccstAssertEqual(manager.saveDirtySessions(records), 0);
+            ccstAssertFalse(manager.markDirty("APP-1", "OTHER"));
+            ccstAssertTrue(manager.markDirty("APP-1", ACTIVATION_ID));
+            ccstAssertEqual(manager.saveDirtySessions(records), 1);
+            ccstAssertEqual(records[0].applicationKey, "APP-1");
+            ccstAssertEqual(records[0].activationId, ACTIVATION_ID);
+            ccstAssertEqual(records[0].state, session->saveSessionState());
+            ccstAssertEqual(manager.saveDirtySessions(records), 0);
+            
+            ccstAssertFalse(manager.removeSession("APP-2", ACTIVATION_ID));
+            ccstAssertTrue(manager.removeSession("APP-1", ACTIVATION_ID));
+            ccstAssertEqual(manager.sessionsCount(), 0);
+        }
+        
+        void testBulkOperations()
+        {
+            const size_t APPS_COUNT = 50;
+            SessionManager manager(std::make_shared<ThreadPoolExecutor>(4));
+            std::vector<SessionStateRecord> records;
+            for (size_t i = 0; i < APPS_COUNT; i++) {
+                std::string app_key = "APP-" + std::to_string(i);
+                ccstAssertEqual(manager.registerSetup(makeSetup(app_key)), EC_Ok);
+                SessionStateRecord record;
+                record.applicationKey = app_key;
+                record.state = TestActivatedSessionState();
+                records.push_back(record);
+            }
+            std::vector<ErrorCode> results;
+            ccstAssertEqual(manager.loadSessions(records, results), EC_Ok);
+            ccstAssertEqual(results.size(), APPS_COUNT);
+            ccstAssertEqual(manager.sessionsCount(), APPS_COUNT);
+            
+            // Invalid records
+            std::vector<SessionStateRecord> invalid_records(4);
+            invalid_records[0].applicationKey = "UNKNOWN";
+            invalid_records[0].state = TestActivatedSessionState();
+            invalid_records[1].applicationKey = "APP-0";
+            invalid_records[1].state = cc7::MakeRange("Not a state");
+            invalid_records[2].applicationKey = "APP-1";
+            invalid_records[2].activationId = "DIFFERENT-ID";
+            invalid_records[2].state = TestActivatedSessionState();
+            invalid_records[3].applicationKey = "APP-2";
+            invalid_records[3].activationId = ACTIVATION_ID;
+            invalid_records[3].state = TestActivatedSessionState();
+            ccstAssertEqual(manager.loadSessions(invalid_records, results), EC_WrongSetup);
+            ccstAssertEqual(results.size(), 4);
+            ccstAssertEqual(results[0], EC_WrongSetup);
+            ccstAssertEqual(results[1], EC_WrongData);
+            ccstAssertEqual(results[2], EC_WrongData);
+            ccstAssertEqual(results[3], EC_Ok);
+            ccstAssertEqual(manager.sessionsCount(), APPS_COUNT);
+            
+            // Status decoding
+            std::vector<SessionStatusRequest> requests(2);
+            requests[0].applicationKey = "UNKNOWN";
+            requests[0].activationId = ACTIVATION_ID;
+            requests[1].applicationKey = "APP-3";
+            requests[1].activationId = ACTIVATION_ID;
+            std::vector<SessionStatusResult> status_results;
+            manager.decodeActivationStatuses(requests, status_results);
+            ccstAssertEqual(status_results.size(), 2);
+            ccstAssertEqual(status_results[0].code, EC_WrongState);
+            ccstAssertEqual(status_results[1].code, EC_WrongParam);
+            
+            // Save all dirty sessions
+            for (size_t i = 0; i < APPS_COUNT; i += 2) {
+                ccstAssertTrue(manager.markDirty("APP-" + std::to_string(i), ACTIVATION_ID));
+            }
+            std::vector<SessionStateRecord> saved;
+            ccstAssertEqual(manager.saveDirtySessions(saved), APPS_COUNT / 2);
+            for (auto && record : saved) {
+                ccstAssertEqual(record.activationId, ACTIVATION_ID);
+                ccstAssertEqual(record.state, manager.findSession(record.applicationKey, ACTIVATION_ID)->saveSessionState());
+            }
+        }
+    };
+    
+    CC7_CREATE_UNIT_TEST(pa2SessionManagerTests, "pa2")
+    
+} // com::wultra::powerAuthTests
+} // com::wultra
+} // com
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cc7tests/CC7Tests.h>
+#include <PowerAuth/SessionStore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cc7;
+using namespace cc7::tests;
+using namespace com::wultra::powerAuth;
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuthTests
+{
+    class pa2SessionStoreTests : public UnitTest
+    {
+    public:
+        
+        pa2SessionStoreTests()
+        {
+            CC7_REGISTER_TEST_METHOD(testStoreAndLoad)
+            CC7_REGISTER_TEST_METHOD(testInterruptedUpdate)
+            CC7_REGISTER_TEST_METHOD(testCompaction)
+        }
+        
+        std::string _path;
+        
+        void setUp() override
+        {
+            const char * tmp_dir = getenv("TMPDIR");
+            if (!tmp_dir) {
+#if defined(__ANDROID__)
+                tmp_dir = "/data/local/tmp";
+#else
+                tmp_dir = "/tmp";
+#endif
+            }
+            _path = std::string(tmp_dir) + "/pa2SessionStoreTests.store";
+            ::remove(_path.c_str());
+        }
+        
+        void tearDown() override
+        {
+            ::remove(_path.c_str());
+        }
+        
+        /**
+         Overwrites |size| bytes at |offset| in the store's file.
+         */
+        void corruptFile(long offset, size_t size)
+        {
+            FILE * f = fopen(_path.c_str(), "r+b");
+            ccstAssertNotNull(f);
+            fseek(f, offset, SEEK_SET);
+            std::vector<char> garbage(size, 'X');
+            fwrite(garbage.data(), 1, size, f);
+            fclose(f);
+        }
+        
+        // unit tests
+        
+        void testStoreAndLoad()
+        {
+            cc7::ByteArray state1 = getTestRandomData(100);
+            cc7::ByteArray state2 = getTestRandomData(200);
+            cc7::ByteArray state3 = getTestRandomData(300);
+            cc7::ByteArray loaded;
+            {
+                SessionStore store;
+                ccstAssertFalse(store.isOpened());
+                ccstAssertEqual(store.store("ID-1", state1), EC_WrongState);
+                ccstAssertEqual(store.open(_path), EC_Ok);
+                ccstAssertEqual(store.open(_path), EC_WrongState);
+                ccstAssertTrue(store.activationIds().empty());
+                
+                ccstAssertEqual(store.store("ID-1", state1), EC_Ok);
+                ccstAssertEqual(store.store("ID-2", state2), EC_Ok);
+                ccstAssertEqual(store.store("", state2), EC_WrongParam);
+                ccstAssertEqual(store.store("ID-3", cc7::ByteArray()), EC_WrongParam);
+                ccstAssertEqual(store.load("ID-1", loaded), EC_Ok);
+                ccstAssertEqual(loaded, state1);
+                ccstAssertEqual(store.load("ID-3", loaded), EC_WrongParam);
+                
+                // Replace & remove in one update
+                std::map<std::string, cc7::ByteArray> states;
+                states["ID-1"] = state3;
+                states["ID-3"] = state3;
+                ccstAssertEqual(store.update(states, std::vector<std::string>(1, "ID-2")), EC_Ok);
+                ccstAssertTrue(store.unusedSize() > 0);
+            }
+            // Reopen
+            SessionStore store;
+            ccstAssertEqual(store.open(_path), EC_Ok);
+            auto ids = store.activationIds();
+            ccstAssertEqual(ids.size(), 2);
+            ccstAssertEqual(ids[0], "ID-1");
+            ccstAssertEqual(ids[1], "ID-3");
+            ccstAssertFalse(store.contains("ID-2"));
+            ccstAssertEqual(store.load("ID-1", loaded), EC_Ok);
+            ccstAssertEqual(loaded, state3);
+            ccstAssertEqual(store.load("ID-3", loaded), EC_Ok);
+            ccstAssertEqual(loaded, state3);
+            ccstAssertEqual(store.remove("ID-1"), EC_Ok);
+            ccstAssertEqual(store.remove("ID-1"), EC_Ok);
+            ccstAssertFalse(store.contains("ID-1"));
+            store.close();
+            ccstAssertFalse(store.isOpened());
+            
+            // Not a store
+            corruptFile(0, 200);
+            ccstAssertEqual(store.open(_path), EC_WrongData);
+        }
+        
+        void testInterruptedUpdate()
+        {
+            cc7::ByteArray state1 = getTestRandomData(100);
+            cc7::ByteArray state2 = getTestRandomData(100);
+            cc7::ByteArray loaded;
+            {
+                // Empty store is committed to slot A, the first update to slot B,
+                // and the second update to slot A again.
+                SessionStore store;
+                ccstAssertEqual(store.open(_path), EC_Ok);
+                ccstAssertEqual(store.store("ID-1", state1), EC_Ok);
+                ccstAssertEqual(store.store("ID-2", state2), EC_Ok);
+            }
+            // Damaged slot A, so the store falls back to the previous update.
+            corruptFile(0, 64);
+            {
+                SessionStore store;
+                ccstAssertEqual(store.open(_path), EC_Ok);
+                ccstAssertTrue(store.contains("ID-1"));
+                ccstAssertFalse(store.contains("ID-2"));
+                ccstAssertEqual(store.load("ID-1", loaded), EC_Ok);
+                ccstAssertEqual(loaded, state1);
+                // The next update continues from the valid state
+                ccstAssertEqual(store.store("ID-2", state2), EC_Ok);
+                ccstAssertEqual(store.load("ID-2", loaded), EC_Ok);
+                ccstAssertEqual(loaded, state2);
+            }
+            // Damaged record is detected on load
+            {
+                SessionStore store;
+                ccstAssertEqual(store.open(_path), EC_Ok);
+                ccstAssertEqual(store.load("ID-1", loaded), EC_Ok);
+                corruptFile(128 + 20, 10);
+                ccstAssertEqual(store.load("ID-1", loaded), EC_WrongData);
+                ccstAssertEqual(store.load("ID-2", loaded), EC_Ok);
+            }
+        }
+        
+        void testCompaction()
+        {
+            SessionStore store;
+            ccstAssertEqual(store.open(_path), EC_Ok);
+            cc7::ByteArray state;
+            // Repeated updates must not grow the file infinitely.
+            for (int i = 0; i < 200; i++) {
+                state = getTestRandomData(4096);
+                ccstAssertEqual(store.store("ID-1", state), EC_Ok);
+                ccstAssertEqual(store.store("ID-2", state), EC_Ok);
+                ccstAssertTrue(store.fileSize() < 128 * 1024);
+            }
+            ccstAssertEqual(store.compact(), EC_Ok);
+            ccstAssertEqual(store.unusedSize(), 0);
+            cc7::ByteArray loaded;
+            ccstAssertEqual(store.load("ID-1", loaded), EC_Ok);
+            ccstAssertEqual(loaded, state);
+            store.close();
+            ccstAssertEqual(store.open(_path), EC_Ok);
+            ccstAssertEqual(store.load("ID-2", loaded), EC_Ok);
+            ccstAssertEqual(loaded, state);
+            
+            // Failed compaction keeps the store opened with the old file.
+            const std::string temp_path = _path + ".compact";
+            ccstAssertEqual(mkdir(temp_path.c_str(), 0700), 0);
+            ccstAssertEqual(store.store("ID-1", state), EC_Ok);
+            ccstAssertEqual(store.compact(), EC_GeneralFailure);
+            rmdir(temp_path.c_str());
+            ccstAssertTrue(store.isOpened());
+            ccstAssertEqual(store.load("ID-1", loaded), EC_Ok);
+            ccstAssertEqual(loaded, state);
+            ccstAssertEqual(store.store("ID-2", state), EC_Ok);
+            ccstAssertEqual(store.compact(), EC_Ok);
+            ccstAssertEqual(store.load("ID-2", loaded), EC_Ok);
+            ccstAssertEqual(loaded, state);
+        }
+    };
+    
+    CC7_CREATE_UNIT_TEST(pa2SessionStoreTests, "pa2")
+    
+} // com::wultra::powerAuthTests
+} // com::wultra
+} // com
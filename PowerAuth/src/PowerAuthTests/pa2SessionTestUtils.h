@@ -0,0 +1,75 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <PowerAuth/Session.h>
+
+/*
+ Constants and helpers shared by unit tests working with Session objects.
+ */
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuthTests
+{
+    /**
+     Application key used in the test session setups.
+     */
+    const char * const TEST_APPLICATION_KEY = "MDEyMzQ1Njc4OUFCQ0RFRg==";
+    /**
+     Application secret used in the test session setups.
+     */
+    const char * const TEST_APPLICATION_SECRET = "QUJDREVGMDEyMzQ1Njc4OQ==";
+    /**
+     Master server public key, matching the `TestActivatedSessionState()` data.
+     */
+    const char * const TEST_MASTER_SERVER_PUBLIC_KEY = "AuCDGp3fAHL695yWxCP6d+jZEzwZleOdmCU+qFIImjBs";
+    
+    /**
+     Returns SessionSetup with the test application key and secret, and with
+     |master_server_public_key| in Base64 format.
+     */
+    inline com::wultra::powerAuth::SessionSetup TestSessionSetup(const std::string & master_server_public_key = TEST_MASTER_SERVER_PUBLIC_KEY,
+                                                                 const std::string & application_key = TEST_APPLICATION_KEY)
+    {
+        com::wultra::powerAuth::SessionSetup setup;
+        setup.applicationKey        = application_key;
+        setup.applicationSecret     = TEST_APPLICATION_SECRET;
+        setup.masterServerPublicKey = master_server_public_key;
+        return setup;
+    }
+    
+    /**
+     Returns persistent data (V4) of the session with fake, but complete activation
+     "FULL-BUT-FAKE-ACTIVATION-ID", with biometry factor. Use the data with setup
+     returned from `TestSessionSetup()` with the default parameters.
+     */
+    inline cc7::ByteArray TestActivatedSessionState()
+    {
+        return cc7::FromBase64String("UEECUDUQcXKzF7KLEfVzcb6F7dQ2jhtGVUxMLUJVVC1GQUtFLUFDVElWQVRJT04tSUQAA"
+                                     "CcQEFxD134A7jgrfXqjmzRSNEoQ+WilNdYscLQ/pbrYJqh9bhDqVVY8lLy2ZvMAtpwZwG"
+                                     "rtEGAsKs9Rh8mZL1u+aQ3kdsgQKe2HE5aMUP+3mc0Zgzo1XSEC+N8Q8lTW59BH/5x6H+e"
+                                     "ahxi9n7A4ajzLgtaC3tTJhD8AMA3jUBawHBE2zowK9ThJL4kCPJPfzZVEcZhh6v1+IrQy"
+                                     "bj5WeD2HhFLwEJr1nHvmSQAAAAAA");
+    }
+    
+} // com::wultra::powerAuthTests
+} // com::wultra
+} // com
@@ -23,10 +23,14 @@
 #include "protocol/ProtocolUtils.h"
 #include "protocol/Constants.h"
 #include "utils/DataReader.h"
+#include "utils/DataWriter.h"
 
 #include <PowerAuth/Session.h>
 #include <PowerAuth/ECIES.h>
+#include "pa2SessionTestUtils.h"
+#include <PowerAuth/CounterJournal.h>
 #include <map>
+#include <thread>
 
 using namespace cc7;
 using namespace cc7::tests;
@@ -47,6 +51,7 @@ namespace powerAuthTests
         pa2SessionTests()
         {
             CC7_REGISTER_TEST_METHOD(testKeyValueMapNormalization);
+            CC7_REGISTER_TEST_METHOD(testKeyValuePairsNormalization);
             CC7_REGISTER_TEST_METHOD(testBeforeActivation);
             CC7_REGISTER_TEST_METHOD(testActivationWithoutEEK);
             CC7_REGISTER_TEST_METHOD(testActivationWithEEKUsingSetup);
@@ -55,6 +60,8 @@ namespace powerAuthTests
             CC7_REGISTER_TEST_METHOD(testPersistentDataUpgradeFromV2ToV5);
             CC7_REGISTER_TEST_METHOD(testPersistentDataUpgradeFromV3ToV5);
             CC7_REGISTER_TEST_METHOD(testPersistentDataUpgradeFromV4ToV5);
+            CC7_REGISTER_TEST_METHOD(testLazyStateLoading);
+            CC7_REGISTER_TEST_METHOD(testStatistics);
         }
         
         EC_KEY *    _masterServerPrivateKey;
@@ -117,6 +124,36 @@ namespace powerAuthTests
             }
         }
         
+        void testKeyValuePairsNormalization()
+        {
+            // Without duplicit keys, the result must be equal to map based normalization
+            std::vector<std::pair<std::string, std::string>> pairs = {
+                { "zingly", "is da best" },
+                { "420", "is equal to 10*42" },
+                { "hello", "world" },
+                { "hell0", "w0rld" }
+            };
+            const char * expected = "420=is+equal+to+10*42&hell0=w0rld&hello=world&zingly=is+da+best";
+            cc7::ByteArray normalized_data = Session::prepareKeyValuePairsForDataSigning(pairs);
+            ccstAssertEqual(normalized_data, cc7::MakeRange(expected));
+            
+            // Duplicit keys, values are sorted as well
+            pairs = {
+                { "array[]", "3" },
+                { "name", "PowerAuth" },
+                { "array[]", "1" },
+                { "array[]", "2" },
+                { "array[]", "1" }
+            };
+            expected = "array%5B%5D=1&array%5B%5D=1&array%5B%5D=2&array%5B%5D=3&name=PowerAuth";
+            normalized_data = Session::prepareKeyValuePairsForDataSigning(pairs);
+            ccstAssertEqual(normalized_data, cc7::MakeRange(expected));
+            
+            // Empty input
+            normalized_data = Session::prepareKeyValuePairsForDataSigning(nullptr, 0);
+            ccstAssertTrue(normalized_data.empty());
+        }
+        
         void testBeforeActivation()
         {
             // valid setup
@@ -457,6 +494,49 @@ namespace powerAuthTests
                     ccstAssertEqual(s1.activationFingerprint(), ACTIVATION_FINGERPRINT);
                     // Validate existence of recovery data
                     ccstAssertTrue(s1.hasActivationRecoveryData() == USE_RECOVERY_CODE);
+                    
+                    // The state contains the cached fingerprint and the validated server public key.
+                    protocol::PersistentData pd;
+                    utils::DataReader data_reader(state_active1);
+                    data_reader.openVersion('P', 'A');
+                    data_reader.skipBytes(1);
+                    ccstAssertTrue(protocol::DeserializePersistentData(pd, data_reader));
+                    ccstAssertEqual(pd.activationFingerprint, ACTIVATION_FINGERPRINT);
+                    ccstAssertTrue(pd.flags.hasValidatedServerPublicKey == 1);
+                    ccstAssertEqual(pd.serverPublicKeyPoint.size(), protocol::SERVER_PUBLIC_KEY_POINT_SIZE);
+                    EC_KEY * server_key = crypto::ECC_ImportValidatedPublicKey(nullptr, pd.serverPublicKeyPoint);
+                    ccstAssertEqual(crypto::ECC_ExportPublicKey(server_key), pd.serverPublicKey);
+                    EC_KEY_free(server_key);
+                    
+                    // State without cached values, like after the upgrade from older version. The values
+                    // are calculated on first use and then stored to the state.
+                    auto server_public_key_point = pd.serverPublicKeyPoint;
+                    pd.activationFingerprint.clear();
+                    pd.serverPublicKeyPoint.clear();
+                    pd.flags.hasValidatedServerPublicKey = 0;
+                    utils::DataWriter writer;
+                    writer.openVersion('P', 'A');
+                    writer.writeByte(1 << 1);
+                    protocol::SerializePersistentData(pd, writer);
+                    writer.closeVersion();
+                    ec = s1.loadSessionState(writer.serializedData());
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertEqual(s1.activationFingerprint(), ACTIVATION_FINGERPRINT);
+                    SignedData signed_data;
+                    signed_data.signingKey = SignedData::ECDSA_PersonalizedKey;
+                    signed_data.data = cc7::MakeRange("Hello");
+                    signed_data.signature = cc7::MakeRange("Invalid signature");
+                    ccstAssertEqual(s1.verifyServerSignedData(signed_data), EC_WrongSignature);
+                    protocol::PersistentData pd_cached;
+                    utils::DataReader cached_reader(s1.saveSessionState());
+                    cached_reader.openVersion('P', 'A');
+                    cached_reader.skipBytes(1);
+                    ccstAssertTrue(protocol::DeserializePersistentData(pd_cached, cached_reader));
+                    ccstAssertEqual(pd_cached.activationFingerprint, ACTIVATION_FINGERPRINT);
+                    ccstAssertTrue(pd_cached.flags.hasValidatedServerPublicKey == 1);
+                    ccstAssertEqual(pd_cached.serverPublicKeyPoint, server_public_key_point);
+                    ec = s1.loadSessionState(state_active1);
+                    ccstAssertEqual(ec, EC_Ok);
                 }
                 // Signature test #1
                 {
@@ -603,6 +683,354 @@ namespace powerAuthTests
                     ccstAssertEqual(signature, our_signature);
                 }
                 
+                // Batch signature test. The state is restored after the test, to keep the counter for next tests.
+                {
+                    cc7::ByteArray state_before_batch = s1.saveSessionState();
+                    
+                    SignatureUnlockKeys keys;
+                    keys.possessionUnlockKey = possessionUnlock;
+                    keys.userPassword        = cc7::MakeRange(new_password);
+                    
+                    std::vector<HTTPRequestData> requests;
+                    requests.push_back(HTTPRequestData(cc7::MakeRange("Batch #1"), "POST", "/batch/1"));
+                    requests.push_back(HTTPRequestData(cc7::MakeRange("Batch #2"), "POST", "/batch/2", "Q2hhcm1pbmdOb25jZTEyMw=="));
+                    requests.push_back(HTTPRequestData(cc7::MakeRange("Batch #3"), "GET", "/batch/3"));
+                    
+                    // Invalid offline nonce in the batch must not move the counter.
+                    std::vector<HTTPRequestData> invalid_requests = requests;
+                    invalid_requests[2].offlineNonce = "Not*a*valid*Base64*nonce";
+                    std::vector<HTTPRequestDataSignature> signatures;
+                    ec = s1.signHTTPRequestDataBatch(invalid_requests, keys, SF_Possession_Knowledge, signatures);
+                    ccstAssertEqual(ec, EC_Encryption);
+                    ccstAssertTrue(signatures.empty());
+                    ec = s1.signHTTPRequestDataBatch(std::vector<HTTPRequestData>(), keys, SF_Possession_Knowledge, signatures);
+                    ccstAssertEqual(ec, EC_WrongParam);
+                    
+                    ec = s1.signHTTPRequestDataBatch(requests, keys, SF_Possession_Knowledge, signatures);
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertEqual(signatures.size(), requests.size());
+                    for (size_t i = 0; i < requests.size(); i++) {
+                        const HTTPRequestData & rq = requests[i];
+                        const bool offline = rq.isOfflineRequest();
+                        StringMap parsedSignature = T_parseSignature(signatures[i].buildAuthHeaderValue());
+                        ccstAssertEqual(parsedSignature["pa_signature_type"], "possession_knowledge");
+                        ccstAssertEqual(parsedSignature["pa_application_key"], offline ? "offline" : _setup.applicationKey);
+                        std::string nonceB64 = parsedSignature["pa_nonce"];
+                        std::string our_signature = T_calculateSignatureForData(rq.body, rq.method, rq.uri, MASTER_SHARED_SECRET, nonceB64, offline ? "offline" : _setup.applicationSecret, SF_Possession_Knowledge, 4 + i, CTR_DATA, offline);
+                        ccstAssertEqual(parsedSignature["pa_signature"], our_signature);
+                    }
+                    
+                    s1.resetSession();
+                    ec = s1.loadSessionState(state_before_batch);
+                    ccstAssertEqual(ec, EC_Ok);
+                }
+                
+                // Counter reservation test. The state is restored after the test, to keep the counter for next tests.
+                {
+                    cc7::ByteArray state_before_reservation = s1.saveSessionState();
+                    
+                    SignatureUnlockKeys keys;
+                    keys.possessionUnlockKey = possessionUnlock;
+                    keys.userPassword        = cc7::MakeRange(new_password);
+                    
+                    SignatureCounterReservation reservation;
+                    ec = s1.reserveSignatureCounters(0, reservation);
+                    ccstAssertEqual(ec, EC_WrongParam);
+                    ec = s1.reserveSignatureCounters(11, reservation);
+                    ccstAssertEqual(ec, EC_WrongParam);
+                    ec = s1.reserveSignatureCounters(4, reservation);
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertEqual(reservation.count(), 4);
+                    
+                    // Sign slots 0..2 in parallel, slot 3 stays unused.
+                    const size_t used_slots = 3;
+                    std::vector<HTTPRequestData> requests;
+                    std::vector<HTTPRequestDataSignature> signatures(used_slots);
+                    std::vector<ErrorCode> results(used_slots, EC_GeneralFailure);
+                    for (size_t i = 0; i < used_slots; i++) {
+                        requests.push_back(HTTPRequestData(cc7::MakeRange("Reserved " + std::to_string(i)), "POST", "/reserved"));
+                    }
+                    std::vector<std::thread> threads;
+                    for (size_t i = 0; i < used_slots; i++) {
+                        threads.push_back(std::thread([&, i]() {
+                            results[i] = s1.signHTTPRequestDataWithReservation(reservation, i, requests[i], keys, SF_Possession_Knowledge, signatures[i]);
+                        }));
+                    }
+                    for (auto & thread : threads) {
+                        thread.join();
+                    }
+                    for (size_t i = 0; i < used_slots; i++) {
+                        ccstAssertEqual(results[i], EC_Ok);
+                        ccstAssertTrue(reservation.isSlotUsed(i));
+                        StringMap parsedSignature = T_parseSignature(signatures[i].buildAuthHeaderValue());
+                        ccstAssertEqual(parsedSignature["pa_activation_id"], _activation_id);
+                        std::string our_signature = T_calculateSignatureForData(requests[i].body, requests[i].method, requests[i].uri, MASTER_SHARED_SECRET, parsedSignature["pa_nonce"], _setup.applicationSecret, SF_Possession_Knowledge, 4 + i, CTR_DATA, false);
+                        ccstAssertEqual(parsedSignature["pa_signature"], our_signature);
+                    }
+                    ccstAssertFalse(reservation.isSlotUsed(3));
+                    // Each slot can be used only once
+                    HTTPRequestDataSignature sigData;
+                    ec = s1.signHTTPRequestDataWithReservation(reservation, 0, requests[0], keys, SF_Possession_Knowledge, sigData);
+                    ccstAssertEqual(ec, EC_WrongParam);
+                    ec = s1.signHTTPRequestDataWithReservation(reservation, 4, requests[0], keys, SF_Possession_Knowledge, sigData);
+                    ccstAssertEqual(ec, EC_WrongParam);
+                    
+                    // Release returns the last slot back to the session.
+                    ec = s1.releaseSignatureCounters(reservation);
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertTrue(reservation.empty());
+                    ec = s1.releaseSignatureCounters(reservation);
+                    ccstAssertEqual(ec, EC_WrongParam);
+                    ec = s1.signHTTPRequestData(requests[0], keys, SF_Possession_Knowledge, sigData);
+                    ccstAssertEqual(ec, EC_Ok);
+                    StringMap parsedSignature = T_parseSignature(sigData.buildAuthHeaderValue());
+                    std::string our_signature = T_calculateSignatureForData(requests[0].body, requests[0].method, requests[0].uri, MASTER_SHARED_SECRET, parsedSignature["pa_nonce"], _setup.applicationSecret, SF_Possession_Knowledge, 4 + used_slots, CTR_DATA, false);
+                    ccstAssertEqual(parsedSignature["pa_signature"], our_signature);
+                    
+                    // If the counter is moved after the reservation, then unused slots are skipped.
+                    ec = s1.reserveSignatureCounters(2, reservation);
+                    ccstAssertEqual(ec, EC_Ok);
+                    ec = s1.signHTTPRequestData(requests[0], keys, SF_Possession_Knowledge, sigData);
+                    ccstAssertEqual(ec, EC_Ok);
+                    parsedSignature = T_parseSignature(sigData.buildAuthHeaderValue());
+                    our_signature = T_calculateSignatureForData(requests[0].body, requests[0].method, requests[0].uri, MASTER_SHARED_SECRET, parsedSignature["pa_nonce"], _setup.applicationSecret, SF_Possession_Knowledge, 4 + used_slots + 3, CTR_DATA, false);
+                    ccstAssertEqual(parsedSignature["pa_signature"], our_signature);
+                    ec = s1.releaseSignatureCounters(reservation);
+                    ccstAssertEqual(ec, EC_Ok);
+                    ec = s1.signHTTPRequestData(requests[0], keys, SF_Possession_Knowledge, sigData);
+                    ccstAssertEqual(ec, EC_Ok);
+                    parsedSignature = T_parseSignature(sigData.buildAuthHeaderValue());
+                    our_signature = T_calculateSignatureForData(requests[0].body, requests[0].method, requests[0].uri, MASTER_SHARED_SECRET, parsedSignature["pa_nonce"], _setup.applicationSecret, SF_Possession_Knowledge, 4 + used_slots + 4, CTR_DATA, false);
+                    ccstAssertEqual(parsedSignature["pa_signature"], our_signature);
+                    
+                    // Release can race with signing. Signatures for the released slots fail and the counter
+                    // is moved back right after the last successfully signed slot.
+                    const size_t race_base = 4 + used_slots + 5;
+                    const size_t race_slots = 10;
+                    ec = s1.reserveSignatureCounters(race_slots, reservation);
+                    ccstAssertEqual(ec, EC_Ok);
+                    const size_t signed_slots = 2;
+                    std::vector<HTTPRequestDataSignature> race_signatures(race_slots);
+                    std::vector<ErrorCode> race_results(race_slots, EC_GeneralFailure);
+                    for (size_t i = 0; i < signed_slots; i++) {
+                        race_results[i] = s1.signHTTPRequestDataWithReservation(reservation, i, requests[0], keys, SF_Possession_Knowledge, race_signatures[i]);
+                        ccstAssertEqual(race_results[i], EC_Ok);
+                    }
+                    threads.clear();
+                    for (size_t i = signed_slots; i < race_slots; i++) {
+                        threads.push_back(std::thread([&, i]() {
+                            race_results[i] = s1.signHTTPRequestDataWithReservation(reservation, i, requests[0], keys, SF_Possession_Knowledge, race_signatures[i]);
+                        }));
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    ec = s1.releaseSignatureCounters(reservation);
+                    ccstAssertEqual(ec, EC_Ok);
+                    for (auto & thread : threads) {
+                        thread.join();
+                    }
+                    size_t race_tail = 0;
+                    for (size_t i = 0; i < race_slots; i++) {
+                        ccstAssertTrue(race_results[i] == EC_Ok || race_results[i] == EC_WrongParam);
+                        ccstAssertTrue(reservation.isSlotUsed(i));
+                        if (race_results[i] == EC_Ok) {
+                            parsedSignature = T_parseSignature(race_signatures[i].buildAuthHeaderValue());
+                            our_signature = T_calculateSignatureForData(requests[0].body, requests[0].method, requests[0].uri, MASTER_SHARED_SECRET, parsedSignature["pa_nonce"], _setup.applicationSecret, SF_Possession_Knowledge, race_base + i, CTR_DATA, false);
+                            ccstAssertEqual(parsedSignature["pa_signature"], our_signature);
+                            race_tail = i + 1;
+                        }
+                    }
+                    ccstAssertTrue(race_tail >= signed_slots);
+                    ccstAssertTrue(reservation.empty());
+                    ec = s1.signHTTPRequestDataWithReservation(reservation, 0, requests[0], keys, SF_Possession_Knowledge, sigData);
+                    ccstAssertEqual(ec, EC_WrongParam);
+                    ec = s1.signHTTPRequestData(requests[0], keys, SF_Possession_Knowledge, sigData);
+                    ccstAssertEqual(ec, EC_Ok);
+                    parsedSignature = T_parseSignature(sigData.buildAuthHeaderValue());
+                    our_signature = T_calculateSignatureForData(requests[0].body, requests[0].method, requests[0].uri, MASTER_SHARED_SECRET, parsedSignature["pa_nonce"], _setup.applicationSecret, SF_Possession_Knowledge, race_base + race_tail, CTR_DATA, false);
+                    ccstAssertEqual(parsedSignature["pa_signature"], our_signature);
+                    
+                    s1.resetSession();
+                    ec = s1.loadSessionState(state_before_reservation);
+                    ccstAssertEqual(ec, EC_Ok);
+                }
+                
+                // Unlocked keys test. The state is restored after the test, to keep the counter for next tests.
+                {
+                    cc7::ByteArray state_before_unlock = s1.saveSessionState();
+                    
+                    SignatureUnlockKeys keys;
+                    keys.possessionUnlockKey = possessionUnlock;
+                    keys.userPassword        = cc7::MakeRange(new_password);
+                    
+                    HTTPRequestDataSignature sigData;
+                    HTTPRequestData requestData(cc7::MakeRange("Unlocked keys"), "POST", "/unlocked/keys");
+                    ccstAssertFalse(s1.hasUnlockedSignatureKeys());
+                    ec = s1.signHTTPRequestDataWithUnlockedKeys(requestData, sigData);
+                    ccstAssertEqual(ec, EC_WrongState);
+                    ec = s1.unlockSignatureKeys(keys, SF_Possession_Knowledge, UnlockedSignatureKeysLimits());
+                    ccstAssertEqual(ec, EC_WrongParam);
+                    ec = s1.unlockSignatureKeys(keys, SF_Possession_Knowledge, UnlockedSignatureKeysLimits(2));
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertTrue(s1.hasUnlockedSignatureKeys());
+                    // Failed operations don't consume the uses.
+                    {
+                        EncryptedActivationStatus invalid_status;
+                        invalid_status.challenge            = "Not*a*valid*Base64";
+                        invalid_status.encryptedStatusBlob  = "Not*a*valid*Base64";
+                        invalid_status.nonce                = "Not*a*valid*Base64";
+                        ActivationStatus status;
+                        for (size_t i = 0; i < 3; i++) {
+                            ec = s1.decodeActivationStatusWithUnlockedKeys(invalid_status, status);
+                            ccstAssertEqual(ec, EC_Encryption);
+                        }
+                        ccstAssertTrue(s1.hasUnlockedSignatureKeys());
+                    }
+                    // Two signatures with consecutive counters, then the keys are gone.
+                    for (size_t i = 0; i < 2; i++) {
+                        ec = s1.signHTTPRequestDataWithUnlockedKeys(requestData, sigData);
+                        ccstAssertEqual(ec, EC_Ok);
+                        StringMap parsedSignature = T_parseSignature(sigData.buildAuthHeaderValue());
+                        ccstAssertEqual(parsedSignature["pa_signature_type"], "possession_knowledge");
+                        std::string our_signature = T_calculateSignatureForData(requestData.body, requestData.method, requestData.uri, MASTER_SHARED_SECRET, parsedSignature["pa_nonce"], _setup.applicationSecret, SF_Possession_Knowledge, 4 + i, CTR_DATA, false);
+                        ccstAssertEqual(parsedSignature["pa_signature"], our_signature);
+                    }
+                    ccstAssertFalse(s1.hasUnlockedSignatureKeys());
+                    ec = s1.signHTTPRequestDataWithUnlockedKeys(requestData, sigData);
+                    ccstAssertEqual(ec, EC_WrongState);
+                    // Password change must invalidate unlocked keys
+                    ec = s1.unlockSignatureKeys(keys, SF_Possession_Knowledge, UnlockedSignatureKeysLimits(0, 60000));
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertTrue(s1.hasUnlockedSignatureKeys());
+                    ec = s1.changeUserPassword(cc7::MakeRange(new_password), cc7::MakeRange(password));
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertFalse(s1.hasUnlockedSignatureKeys());
+                    // Wrong unlock keys
+                    ec = s1.unlockSignatureKeys(SignatureUnlockKeys(), SF_Possession, UnlockedSignatureKeysLimits(1));
+                    ccstAssertEqual(ec, EC_Encryption);
+                    ccstAssertFalse(s1.hasUnlockedSignatureKeys());
+                    
+                    s1.resetSession();
+                    ec = s1.loadSessionState(state_before_unlock);
+                    ccstAssertEqual(ec, EC_Ok);
+                }
+                
+                // Counter journal test. The state is restored after the test, to keep the counter for next tests.
+                {
+                    cc7::ByteArray state_before_journal = s1.saveSessionState();
+                    
+                    const char * tmp_dir = getenv("TMPDIR");
+                    if (!tmp_dir) {
+#if defined(__ANDROID__)
+                        tmp_dir = "/data/local/tmp";
+#else
+                        tmp_dir = "/tmp";
+#endif
+                    }
+                    const std::string journal_path = std::string(tmp_dir) + "/pa2SessionTests.journal";
+                    ::remove(journal_path.c_str());
+                    
+                    // Too short MAC key
+                    auto invalid_journal = std::make_shared<CounterJournal>(journal_path, crypto::GetRandomData(8));
+                    ccstAssertFalse(invalid_journal->isValid());
+                    
+                    const cc7::ByteArray journal_key = crypto::GetRandomData(32);
+                    auto journal = std::make_shared<CounterJournal>(journal_path, journal_key, CounterJournal::JSP_Always, 16, 3);
+                    ccstAssertTrue(journal->isValid());
+                    ccstAssertEqual(journal->recordsCount(), 0);
+                    s1.setCounterJournal(journal);
+                    ccstAssertTrue(s1.counterJournal() == journal);
+                    
+                    SignatureUnlockKeys keys;
+                    keys.possessionUnlockKey = possessionUnlock;
+                    keys.userPassword        = cc7::MakeRange(new_password);
+                    HTTPRequestData requestData(cc7::MakeRange("Journaled"), "POST", "/journal");
+                    HTTPRequestDataSignature sigData;
+                    
+                    auto sign_and_check = [&](size_t expected_counter) {
+                        ErrorCode code = s1.signHTTPRequestData(requestData, keys, SF_Possession_Knowledge, sigData);
+                        ccstAssertEqual(code, EC_Ok);
+                        StringMap parsedSignature = T_parseSignature(sigData.buildAuthHeaderValue());
+                        std::string our_signature = T_calculateSignatureForData(requestData.body, requestData.method, requestData.uri, MASTER_SHARED_SECRET, parsedSignature["pa_nonce"], _setup.applicationSecret, SF_Possession_Knowledge, expected_counter, CTR_DATA, false);
+                        ccstAssertEqual(parsedSignature["pa_signature"], our_signature);
+                    };
+                    
+                    // Sign without saving the state
+                    for (size_t i = 0; i < 3; i++) {
+                        sign_and_check(4 + i);
+                    }
+                    ccstAssertEqual(journal->recordsCount(), 3);
+                    ccstAssertTrue(journal->shouldWriteSnapshot());
+                    
+                    // Load the old state, the counter must continue from the journal.
+                    s1.resetSession();
+                    ec = s1.loadSessionState(state_before_journal);
+                    ccstAssertEqual(ec, EC_Ok);
+                    sign_and_check(7);
+                    ccstAssertEqual(journal->recordsCount(), 4);
+                    
+                    // Tampered record is ignored
+                    FILE * f = fopen(journal_path.c_str(), "r+b");
+                    ccstAssertNotNull(f);
+                    if (f) {
+                        fseek(f, 3 * 48 + 20, SEEK_SET);
+                        int byte = fgetc(f);
+                        fseek(f, 3 * 48 + 20, SEEK_SET);
+                        fputc(byte ^ 0x55, f);
+                        fclose(f);
+                    }
+                    s1.resetSession();
+                    ec = s1.loadSessionState(state_before_journal);
+                    ccstAssertEqual(ec, EC_Ok);
+                    sign_and_check(7);
+                    
+                    // Incomplete record is removed on open, so the following records are still valid.
+                    f = fopen(journal_path.c_str(), "ab");
+                    ccstAssertNotNull(f);
+                    if (f) {
+                        const cc7::ByteArray partial = crypto::GetRandomData(20);
+                        fwrite(partial.data(), 1, partial.size(), f);
+                        fclose(f);
+                    }
+                    auto reopened_journal = std::make_shared<CounterJournal>(journal_path, journal_key, CounterJournal::JSP_Always, 16, 3);
+                    ccstAssertTrue(reopened_journal->isValid());
+                    ccstAssertEqual(reopened_journal->recordsCount(), 5);
+                    s1.setCounterJournal(reopened_journal);
+                    s1.resetSession();
+                    ec = s1.loadSessionState(state_before_journal);
+                    ccstAssertEqual(ec, EC_Ok);
+                    sign_and_check(8);
+                    s1.resetSession();
+                    ec = s1.loadSessionState(state_before_journal);
+                    ccstAssertEqual(ec, EC_Ok);
+                    sign_and_check(9);
+                    
+                    // Journal with different MAC key is ignored
+                    s1.setCounterJournal(std::make_shared<CounterJournal>(journal_path, crypto::GetRandomData(32)));
+                    s1.resetSession();
+                    ec = s1.loadSessionState(state_before_journal);
+                    ccstAssertEqual(ec, EC_Ok);
+                    sign_and_check(4);
+                    
+                    // Reset the journal, then the state is loaded as it is.
+                    s1.setCounterJournal(journal);
+                    ec = journal->reset();
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertEqual(journal->recordsCount(), 0);
+                    ccstAssertFalse(journal->shouldWriteSnapshot());
+                    s1.resetSession();
+                    ec = s1.loadSessionState(state_before_journal);
+                    ccstAssertEqual(ec, EC_Ok);
+                    sign_and_check(4);
+                    
+                    s1.setCounterJournal(nullptr);
+                    ccstAssertTrue(s1.counterJournal() == nullptr);
+                    s1.resetSession();
+                    ec = s1.loadSessionState(state_before_journal);
+                    ccstAssertEqual(ec, EC_Ok);
+                    journal.reset();
+                    ::remove(journal_path.c_str());
+                }
+                
                 // Add / Remove EEK (2nd test)
                 if (eek) {
                     // Add EEK
@@ -905,6 +1333,18 @@ namespace powerAuthTests
                     ec = decryptor.decryptRequest(request_enc, request_data);
                     ccstAssertEqual(ec, EC_Ok);
                     ccstAssertEqual(request_data, cc7::MakeRange("Hello!"));
+                    
+                    // Cached values must be invalidated after the setup change.
+                    SessionSetup setup2 = _setup;
+                    setup2.applicationSecret = "ZGVyaXZlZC1jb25zdGFudHM=";
+                    Session s_app(_setup);
+                    ec = s_app.getEciesEncryptor(ECIES_ApplicationScope, foo, cc7::MakeRange("/pa/test"), encryptor);
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertEqual(encryptor.sharedInfo2(), crypto::SHA256(cc7::MakeRange(_setup.applicationSecret)));
+                    ccstAssertTrue(s_app.setSessionSetup(setup2));
+                    ec = s_app.getEciesEncryptor(ECIES_ApplicationScope, foo, cc7::MakeRange("/pa/test"), encryptor);
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertEqual(encryptor.sharedInfo2(), crypto::SHA256(cc7::MakeRange(setup2.applicationSecret)));
                 }
                 // ECIES "activation" scope
                 {                   
@@ -931,6 +1371,17 @@ namespace powerAuthTests
                     ec = decryptor.decryptRequest(request_enc, request_data);
                     ccstAssertEqual(ec, EC_Ok);
                     ccstAssertEqual(request_data, cc7::MakeRange("Plan9!"));
+                    
+                    // The cached sharedInfo2 must not be used for a different possession key.
+                    SignatureUnlockKeys wrong_keys;
+                    wrong_keys.possessionUnlockKey = crypto::GetRandomData(16);
+                    ec = s1.getEciesEncryptor(ECIES_ActivationScope, wrong_keys, cc7::MakeRange("/pa/activation/test"), encryptor);
+                    if (ec == EC_Ok) {
+                        ccstAssertNotEqual(encryptor.sharedInfo2(), decryptor.sharedInfo2());
+                    }
+                    ec = s1.getEciesEncryptor(ECIES_ActivationScope, keys, cc7::MakeRange("/pa/activation/test"), encryptor);
+                    ccstAssertEqual(ec, EC_Ok);
+                    ccstAssertEqual(encryptor.sharedInfo2(), decryptor.sharedInfo2());
                 }
                 // Recovery codes
                 if (USE_RECOVERY_CODE) {
@@ -1159,8 +1610,137 @@ namespace powerAuthTests
             auto b_result = protocol::DeserializePersistentData(pd, data_reader);
             ccstAssertTrue(b_result);
             ccstAssertEqual(pd.flags.hasSignatureCounterByte, 0);
+            ccstAssertEqual(pd.flags.hasValidatedServerPublicKey, 0);
+            ccstAssertTrue(pd.activationFingerprint.empty());
+        }
+        
+        void testLazyStateLoading()
+        {
+            SessionSetup setup = TestSessionSetup();
+            
+            Session eager(setup);
+            auto v4_data = TestActivatedSessionState();
+            auto ec = eager.loadSessionState(v4_data);
+            ccstAssertEqual(ec, EC_Ok);
+            ccstAssertFalse(eager.hasLazySessionState());
+            auto v5_data = eager.saveSessionState();
+            
+            // State probing doesn't need the materialization.
+            Session s1(setup);
+            ec = s1.loadSessionStateLazily(v5_data);
+            ccstAssertEqual(ec, EC_Ok);
+            ccstAssertTrue(s1.hasLazySessionState());
+            ccstAssertTrue(s1.hasValidActivation());
+            ccstAssertFalse(s1.canStartActivation());
+            ccstAssertEqual(s1.protocolVersion(), Version_V3);
+            ccstAssertEqual(s1.activationIdentifier(), "FULL-BUT-FAKE-ACTIVATION-ID");
+            ccstAssertEqual(Version_NA, s1.pendingProtocolUpgradeVersion());
+            ccstAssertTrue(s1.hasBiometryFactor());
+            ccstAssertFalse(s1.hasActivationRecoveryData());
+            // Saving the lazy state returns the loaded data.
+            ccstAssertEqual(s1.saveSessionState(), v5_data);
+            ccstAssertTrue(s1.hasLazySessionState());
+            // Materialization produces the same state as the regular load.
+            ec = s1.materializeSessionState();
+            ccstAssertEqual(ec, EC_Ok);
+            ccstAssertFalse(s1.hasLazySessionState());
+            ccstAssertEqual(s1.saveSessionState(), v5_data);
+            ccstAssertEqual(s1.activationIdentifier(), "FULL-BUT-FAKE-ACTIVATION-ID");
+            
+            // Any operation with the keys materializes the state.
+            ec = s1.loadSessionStateLazily(v5_data);
+            ccstAssertEqual(ec, EC_Ok);
+            ccstAssertTrue(s1.hasLazySessionState());
+            ec = s1.removeBiometryFactor();
+            ccstAssertEqual(ec, EC_Ok);
+            ccstAssertFalse(s1.hasLazySessionState());
+            ccstAssertFalse(s1.hasBiometryFactor());
+            
+            // Reset releases the lazy state.
+            ec = s1.loadSessionStateLazily(v5_data);
+            ccstAssertEqual(ec, EC_Ok);
+            s1.resetSession();
+            ccstAssertFalse(s1.hasLazySessionState());
+            ccstAssertFalse(s1.hasValidActivation());
+            ec = s1.materializeSessionState();
+            ccstAssertEqual(ec, EC_WrongState);
+            
+            // Malformed data is rejected immediately.
+            ec = s1.loadSessionStateLazily(cc7::ByteRange(v5_data).subRangeTo(v5_data.size() - 10));
+            ccstAssertEqual(ec, EC_WrongParam);
+            ccstAssertFalse(s1.hasValidActivation());
+            ccstAssertFalse(s1.hasLazySessionState());
+            
+            // Invalid content is detected when the data is materialized. Set PBKDF2 iterations to 0.
+            protocol::PersistentDataView view;
+            utils::DataReader data_reader((cc7::ByteRange(v5_data)));
+            data_reader.openVersion('P', 'A');
+            data_reader.skipBytes(1);
+            ccstAssertTrue(protocol::DeserializePersistentDataView(view, data_reader));
+            ccstAssertEqual(view.passwordIterations, protocol::PBKDF2_PASS_ITERATIONS);
+            cc7::ByteArray invalid_data = v5_data;
+            const size_t iterations_offset = view.passwordSalt.data() - v5_data.data() - 1 - sizeof(cc7::U32);
+            memset(invalid_data.data() + iterations_offset, 0, sizeof(cc7::U32));
+            ec = eager.loadSessionState(invalid_data);
+            ccstAssertEqual(ec, EC_WrongParam);
+            
+            ec = s1.loadSessionStateLazily(invalid_data);
+            ccstAssertEqual(ec, EC_Ok);
+            ccstAssertTrue(s1.hasValidActivation());
+            ccstAssertEqual(s1.activationIdentifier(), "FULL-BUT-FAKE-ACTIVATION-ID");
+            ec = s1.materializeSessionState();
+            ccstAssertEqual(ec, EC_WrongParam);
+            ccstAssertTrue(s1.hasLazySessionState());
+            ec = s1.removeBiometryFactor();
+            ccstAssertEqual(ec, EC_WrongState);
         }
+
         
+        void testStatistics()
+        {
+            SessionSetup setup = TestSessionSetup();
+            
+            auto v4_data = TestActivatedSessionState();
+            Session s1(setup);
+            
+            // Nothing is collected by default.
+            ccstAssertFalse(s1.isStatisticsEnabled());
+            ccstAssertEqual(s1.loadSessionState(v4_data), EC_Ok);
+            auto stats = s1.statistics();
+            ccstAssertEqual(stats.operations[SessionStatistics::SO_LoadSessionState].calls, 0);
+            ccstAssertEqual(stats.serialization.count(), 0);
+            
+            s1.setStatisticsEnabled(true);
+            ccstAssertTrue(s1.isStatisticsEnabled());
+            ccstAssertEqual(s1.loadSessionState(v4_data), EC_Ok);
+            auto v5_data = s1.saveSessionState();
+            ccstAssertEqual(s1.loadSessionStateLazily(v5_data), EC_Ok);
+            ccstAssertEqual(s1.removeBiometryFactor(), EC_Ok);
+            ccstAssertEqual(s1.saveSessionState(), s1.saveSessionState());
+            stats = s1.statistics();
+            ccstAssertEqual(stats.operations[SessionStatistics::SO_LoadSessionState].calls, 1);
+            ccstAssertEqual(stats.operations[SessionStatistics::SO_SaveSessionState].calls, 3);
+            ccstAssertEqual(stats.operations[SessionStatistics::SO_LoadSessionStateLazily].calls, 1);
+            ccstAssertEqual(stats.operations[SessionStatistics::SO_RemoveBiometryFactor].calls, 1);
+            ccstAssertEqual(stats.operations[SessionStatistics::SO_SignHTTPRequestData].calls, 0);
+            ccstAssertEqual(stats.keyUnlocks, 0);
+            ccstAssertEqual(stats.counterAdvances, 0);
+            
+            // Disabled collector keeps the values.
+            s1.setStatisticsEnabled(false);
+            ccstAssertEqual(s1.loadSessionState(v4_data), EC_Ok);
+            ccstAssertEqual(s1.statistics().operations[SessionStatistics::SO_LoadSessionState].calls, 1);
+            
+            // Reset clears everything.
+            s1.resetStatistics();
+            stats = s1.statistics();
+            for (size_t op = 0; op < SessionStatistics::SO_Count; op++) {
+                ccstAssertEqual(stats.operations[op].calls, 0);
+                ccstAssertEqual(stats.operations[op].time.count(), 0);
+            }
+            ccstAssertEqual(stats.lockWait.count(), 0);
+            ccstAssertEqual(stats.serialization.count(), 0);
+        }        
         
         // Helper methods
         
@@ -40,6 +40,7 @@ namespace powerAuthTests
             CC7_REGISTER_TEST_METHOD(testV3Signatures)
             CC7_REGISTER_TEST_METHOD(testV31Signatures)
             CC7_REGISTER_TEST_METHOD(testDataNormalization)
+            CC7_REGISTER_TEST_METHOD(testBatchSignatures)
         }
         
         void testV2Signatures()
@@ -141,6 +142,47 @@ namespace powerAuthTests
             }
         }
         
+        void testBatchSignatures()
+        {
+            static const SignatureFactor allFactors[] = {
+                SF_Possession, SF_Knowledge, SF_Biometry,
+                SF_Possession_Knowledge, SF_Possession_Biometry,
+                SF_Possession_Knowledge_Biometry
+            };
+            static const crypto::SHA256MultiBufferImplementation allImplementations[] = {
+                crypto::SHA256MB_Scalar, crypto::SHA256MB_AVX2, crypto::SHA256MB_AVX512
+            };
+            auto original_impl = crypto::SHA256MultiBuffer_ActiveImplementation();
+            
+            protocol::SignatureKeys keys;
+            keys.possessionKey = getTestRandomData(16);
+            keys.knowledgeKey  = getTestRandomData(16);
+            keys.biometryKey   = getTestRandomData(16);
+            
+            for (auto impl : allImplementations) {
+                if (!crypto::SHA256MultiBuffer_SelectImplementation(impl)) {
+                    continue;
+                }
+                for (auto factor : allFactors) {
+                    // Enough items to fill more than one group of lanes, with mixed output formats.
+                    std::vector<protocol::SignatureBatchItem> items(37);
+                    std::vector<cc7::ByteArray> datas(items.size());
+                    for (size_t i = 0; i < items.size(); i++) {
+                        datas[i] = getTestRandomData(i * 7);
+                        items[i].ctrData = getTestRandomData(16);
+                        items[i].data = datas[i];
+                        items[i].base64Format = (i & 1) != 0;
+                    }
+                    ccstAssertTrue(protocol::CalculateSignatures(keys, factor, items));
+                    for (auto && item : items) {
+                        auto expected = protocol::CalculateSignature(keys, factor, item.ctrData, item.data, item.base64Format);
+                        ccstAssertEqual(item.signature, expected);
+                    }
+                }
+            }
+            crypto::SHA256MultiBuffer_SelectImplementation(original_impl);
+        }
+        
         SignatureFactor factorFromString(const std::string & factor)
         {
             static const SignatureFactor allFactors[] = {
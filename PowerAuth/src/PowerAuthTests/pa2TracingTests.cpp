@@ -0,0 +1,158 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cc7tests/CC7Tests.h>
+#include <PowerAuth/Session.h>
+#include <PowerAuth/ECIES.h>
+#include "utils/Tracing.h"
+#include "crypto/CryptoUtils.h"
+#include "pa2SessionTestUtils.h"
+#include <vector>
+
+using namespace cc7;
+using namespace cc7::tests;
+using namespace com::wultra::powerAuth;
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuthTests
+{
+    /**
+     Listener that records all trace events reported from the current thread.
+     */
+    class TestTraceListener : public TraceListener
+    {
+    public:
+        struct Event
+        {
+            bool begin;
+            TracePoint point;
+            U64 argument;
+        };
+        std::vector<Event> events;
+        
+        void traceBegin(TracePoint point, U64 argument) override
+        {
+            events.push_back({ true, point, argument });
+        }
+        
+        void traceEnd(TracePoint point, U64 argument) override
+        {
+            events.push_back({ false, point, argument });
+        }
+        
+        size_t count(TracePoint point) const
+        {
+            size_t result = 0;
+            for (const auto & e : events) {
+                if (e.begin && e.point == point) {
+                    result++;
+                }
+            }
+            return result;
+        }
+    };
+    
+    class pa2TracingTests : public UnitTest
+    {
+    public:
+        
+        pa2TracingTests()
+        {
+            CC7_REGISTER_TEST_METHOD(testTracePointNames)
+            CC7_REGISTER_TEST_METHOD(testTraceListener)
+        }
+        
+        // unit tests
+        
+        void testTracePointNames()
+        {
+            ccstMessage("Tracing available: %s", TracingAvailable() ? "YES" : "NO");
+            ccstAssertEqual(std::string(TracePointName(TP_SessionOperation)), "SessionOperation");
+            ccstAssertEqual(std::string(TracePointName(TP_PBKDF2)), "PBKDF2");
+            ccstAssertEqual(std::string(TracePointName(TP_Count)), "Unknown");
+        }
+        
+        void testTraceListener()
+        {
+            TestTraceListener listener;
+            SetTraceListener(&listener);
+            
+            // PBKDF2
+            crypto::PBKDF2_HMAC_SHA256(getTestRandomData(16), getTestRandomData(16), 1000, 16);
+            // ECIES
+            EC_KEY * keypair = crypto::ECC_GenerateKeyPair();
+            ccstAssertNotNull(keypair);
+            cc7::ByteArray public_key = crypto::ECC_ExportPublicKey(keypair);
+            cc7::ByteArray private_key = crypto::ECC_ExportPrivateKey(keypair);
+            EC_KEY_free(keypair);
+            ECIESEncryptor encryptor(public_key, cc7::ByteRange(), cc7::ByteRange());
+            ECIESDecryptor decryptor(private_key, cc7::ByteRange(), cc7::ByteRange());
+            ECIESCryptogram cryptogram;
+            cc7::ByteArray plain_data = getTestRandomData(33);
+            cc7::ByteArray decrypted_data;
+            ccstAssertEqual(encryptor.encryptRequest(plain_data, cryptogram), EC_Ok);
+            ccstAssertEqual(decryptor.decryptRequest(cryptogram, decrypted_data), EC_Ok);
+            ccstAssertEqual(decrypted_data, plain_data);
+            // Session, nested lockSignatureKeys() is not reported.
+            Session session(TestSessionSetup());
+            session.resetSession();
+            SignatureUnlockKeys keys;
+            keys.possessionUnlockKey = Session::generateSignatureUnlockKey();
+            ccstAssertEqual(session.unlockSignatureKeys(keys, SF_Possession, UnlockedSignatureKeysLimits()), EC_WrongState);
+            
+            SetTraceListener(nullptr);
+            session.resetSession();
+            
+            if (!TracingAvailable()) {
+                ccstAssertTrue(listener.events.empty());
+                return;
+            }
+            ccstAssertEqual(listener.count(TP_PBKDF2), 1);
+            ccstAssertEqual(listener.count(TP_ECIESEncrypt), 1);
+            ccstAssertEqual(listener.count(TP_ECIESDecrypt), 1);
+            ccstAssertEqual(listener.count(TP_SessionOperation), 2);
+            // Each begin has matching end, in the reverse order.
+            std::vector<TestTraceListener::Event> stack;
+            for (const auto & e : listener.events) {
+                if (e.begin) {
+                    stack.push_back(e);
+                } else {
+                    ccstAssertFalse(stack.empty());
+                    ccstAssertEqual(stack.back().point, e.point);
+                    ccstAssertEqual(stack.back().argument, e.argument);
+                    stack.pop_back();
+                }
+                if (e.point == TP_PBKDF2) {
+                    ccstAssertEqual(e.argument, 1000);
+                } else if (e.point == TP_ECIESEncrypt) {
+                    ccstAssertEqual(e.argument, plain_data.size());
+                } else if (e.point == TP_SessionOperation) {
+                    ccstAssertTrue(e.argument == SessionStatistics::SO_ResetSession || e.argument == SessionStatistics::SO_UnlockSignatureKeys);
+                }
+            }
+            ccstAssertTrue(stack.empty());
+        }
+    };
+    
+    CC7_CREATE_UNIT_TEST(pa2TracingTests, "pa2")
+    
+} // com::wultra::powerAuthTests
+} // com::wultra
+} // com
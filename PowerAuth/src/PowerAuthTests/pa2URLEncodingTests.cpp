@@ -34,6 +34,7 @@ namespace powerAuthTests
         pa2URLEncodingTests()
         {
             CC7_REGISTER_TEST_METHOD(testEncoding)
+            CC7_REGISTER_TEST_METHOD(testLongStrings)
         }
         
         void testEncoding()
@@ -89,6 +90,26 @@ namespace powerAuthTests
             }
         }
         
+        void testLongStrings()
+        {
+            // Long runs of safe characters, interrupted by escaped characters at various positions.
+            const std::string safe_run("ABCDEFGHIJKLMNOPQRSTUVWXYZ-abcdefghijklmnopqrstuvwxyz_0123456789.*");
+            for (size_t pos = 0; pos <= safe_run.size(); pos++) {
+                std::string source = safe_run;
+                std::string expected = safe_run;
+                source.insert(pos, "\xC3\xA1 /");
+                expected.insert(pos, "%C3%A1+%2F");
+                source += source;
+                expected += expected;
+                cc7::ByteArray result = utils::ConvertStringToUrlEncodedData(source);
+                ccstAssertEqual(result, cc7::MakeRange(expected));
+                // Append to existing data
+                cc7::ByteArray appended = cc7::MakeRange("prefix=");
+                utils::AppendUrlEncodedData(cc7::MakeRange(source), appended);
+                ccstAssertEqual(appended, cc7::MakeRange("prefix=" + expected));
+            }
+        }
+        
     };
     
     CC7_CREATE_UNIT_TEST(pa2URLEncodingTests, "pa2")
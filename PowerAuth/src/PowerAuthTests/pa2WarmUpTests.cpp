@@ -0,0 +1,108 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include <cc7tests/CC7Tests.h>
+#include <PowerAuth/WarmUp.h>
+#include <PowerAuth/SessionManager.h>
+#include "crypto/CryptoUtils.h"
+#include "pa2SessionTestUtils.h"
+#include <future>
+
+using namespace cc7;
+using namespace cc7::tests;
+using namespace com::wultra::powerAuth;
+
+namespace com
+{
+namespace wultra
+{
+namespace powerAuthTests
+{
+    class pa2WarmUpTests : public UnitTest
+    {
+    public:
+        
+        pa2WarmUpTests()
+        {
+            CC7_REGISTER_TEST_METHOD(testWarmUp)
+            CC7_REGISTER_TEST_METHOD(testWarmUpInBackground)
+            CC7_REGISTER_TEST_METHOD(testSessionManagerWarmUp)
+        }
+        
+        std::string _masterServerPublicKey;
+        
+        void setUp() override
+        {
+            EC_KEY * master_key = crypto::ECC_GenerateKeyPair();
+            ccstAssertNotNull(master_key);
+            _masterServerPublicKey = crypto::ECC_ExportPublicKeyToB64(master_key);
+            EC_KEY_free(master_key);
+        }
+        
+        // unit tests
+        
+        void testWarmUp()
+        {
+            WarmUpTimings timings;
+            ErrorCode ec = WarmUp({ _masterServerPublicKey }, timings);
+            ccstAssertEqual(ec, EC_Ok);
+            ccstAssertTrue(timings.total >= timings.prngSeed + timings.cryptoLibrary + timings.ellipticCurve + timings.masterKeys);
+            
+            // Repeated warm-up is allowed
+            ec = WarmUp(std::vector<std::string>(), timings);
+            ccstAssertEqual(ec, EC_Ok);
+            ccstAssertEqual(timings.masterKeys.count(), 0);
+            
+            // Invalid master key is reported, but the rest is still performed
+            ec = WarmUp({ _masterServerPublicKey, "QUJDRA==", "" }, timings);
+            ccstAssertEqual(ec, EC_WrongParam);
+        }
+        
+        void testWarmUpInBackground()
+        {
+            auto executor = std::make_shared<ThreadPoolExecutor>(1);
+            std::promise<ErrorCode> result;
+            WarmUpInBackground({ _masterServerPublicKey }, [&result](ErrorCode code, const WarmUpTimings & timings) {
+                result.set_value(code);
+            }, executor);
+            ccstAssertEqual(result.get_future().get(), EC_Ok);
+            
+            // Without completion, on the default executor
+            WarmUpInBackground({ _masterServerPublicKey });
+        }
+        
+        void testSessionManagerWarmUp()
+        {
+            SessionManager manager;
+            SessionSetup setup = TestSessionSetup(_masterServerPublicKey);
+            ccstAssertEqual(manager.registerSetup(setup), EC_Ok);
+            
+            WarmUpTimings timings;
+            ccstAssertEqual(manager.warmUp(timings), EC_Ok);
+            
+            setup.applicationKey         = "RkVEQ0JBOTg3NjU0MzIxMA==";
+            setup.masterServerPublicKey  = "QUJDRA==";
+            ccstAssertEqual(manager.registerSetup(setup), EC_Ok);
+            ccstAssertEqual(manager.warmUp(timings), EC_WrongParam);
+        }
+    };
+    
+    CC7_CREATE_UNIT_TEST(pa2WarmUpTests, "pa2")
+    
+} // com::wultra::powerAuthTests
+} // com::wultra
+} // com
@@ -21,6 +21,7 @@ import androidx.annotation.IntDef;
 import java.lang.annotation.Retention;
 import java.lang.annotation.RetentionPolicy;
 
+import static com.wultra.android.powerauth.core.ErrorCode.CANCELLED;
 import static com.wultra.android.powerauth.core.ErrorCode.ENCRYPTION;
 import static com.wultra.android.powerauth.core.ErrorCode.GENERAL_FAILURE;
 import static com.wultra.android.powerauth.core.ErrorCode.MISSING_REQUESTED_FACTOR;
@@ -43,7 +44,7 @@ import static com.wultra.android.powerauth.core.ErrorCode.WRONG_STATE;
  */
 @Retention(RetentionPolicy.SOURCE)
 @IntDef({OK, WRONG_SETUP, WRONG_STATE, WRONG_PARAM, WRONG_CODE, WRONG_DATA, ENCRYPTION,
-        MISSING_REQUESTED_FACTOR, MISSING_REQUIRED_FACTOR, GENERAL_FAILURE})
+        MISSING_REQUESTED_FACTOR, MISSING_REQUIRED_FACTOR, GENERAL_FAILURE, CANCELLED})
 public @interface ErrorCode
 {
     /**
@@ -112,4 +113,8 @@ public @interface ErrorCode
      * generator could not produce a sequence of bytes.
      */
     int GENERAL_FAILURE = 10;
+    /**
+     * The operation has been cancelled before it could complete.
+     */
+    int CANCELLED = 11;
 }
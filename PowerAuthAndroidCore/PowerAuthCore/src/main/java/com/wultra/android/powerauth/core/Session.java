@@ -19,6 +19,7 @@ package com.wultra.android.powerauth.core;
 import androidx.annotation.NonNull;
 
 import java.util.ArrayList;
+import java.util.List;
 import java.util.Map;
 
 public class Session {
@@ -273,6 +274,28 @@ public class Session {
         return prepareKeyValueDictionaryForDataSigning(keys.toArray(new String[0]), values.toArray(new String[0]));
     }
 
+    /**
+     * Converts list of key-value pairs into normalized data, suitable for data signing. Unlike the map based
+     * variant, the list may contain multiple values for the same key, so it's useful for GET requests
+     * with arrays in parameters. The result doesn't depend on order of pairs in the list.
+     * <p>
+     * For a POST requests it's recommended to sign a whole POST body.
+     *
+     * @param keyValueList list with GET parameters
+     * @return normalized byte array, prepared for data signing
+     */
+    public byte[] prepareKeyValueDictionaryForDataSigning(List<Map.Entry<String, String>> keyValueList) {
+        final String[] keys = new String[keyValueList.size()];
+        final String[] values = new String[keyValueList.size()];
+        int index = 0;
+        for (Map.Entry<String, String> entry : keyValueList) {
+            keys[index] = entry.getKey();
+            values[index] = entry.getValue();
+            index++;
+        }
+        return prepareKeyValueDictionaryForDataSigning(keys, values);
+    }
+
     /**
      * Internal JNI implementation for key-value data normalization. You have to provide two arrays,
      * where the related keys and values are at the same indexes.
@@ -656,4 +679,42 @@ public class Session {
      */
     public native RecoveryData getActivationRecoveryData(String cVaultKey, SignatureUnlockKeys unlockKeys);
 
+    //
+    // Statistics
+    //
+
+    /**
+     * Enables or disables collection of the session's statistics. The collection is disabled
+     * by default. Disabling the collection keeps already collected values.
+     *
+     * @param enabled true to enable the collection.
+     */
+    public native void setStatisticsEnabled(boolean enabled);
+
+    /**
+     * @return true if collection of the session's statistics is enabled.
+     */
+    public native boolean isStatisticsEnabled();
+
+    /**
+     * @return {@link SessionStatistics} object with snapshot of the collected statistics.
+     */
+    @NonNull
+    public SessionStatistics getStatistics() {
+        return new SessionStatistics(getStatisticsValues());
+    }
+
+    /**
+     * Internal JNI function returning all statistics values in one array.
+     *
+     * @return Array with values, in order expected by {@link SessionStatistics} constructor.
+     */
+    @NonNull
+    private native long[] getStatisticsValues();
+
+    /**
+     * Sets all collected statistics to zero.
+     */
+    public native void resetStatistics();
+
 }
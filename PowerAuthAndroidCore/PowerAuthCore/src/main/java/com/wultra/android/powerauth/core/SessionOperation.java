@@ -0,0 +1,118 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+package com.wultra.android.powerauth.core;
+
+import androidx.annotation.IntDef;
+
+import java.lang.annotation.Retention;
+import java.lang.annotation.RetentionPolicy;
+
+import static com.wultra.android.powerauth.core.SessionOperation.SetSessionSetup;
+import static com.wultra.android.powerauth.core.SessionOperation.ResetSession;
+import static com.wultra.android.powerauth.core.SessionOperation.SaveSessionState;
+import static com.wultra.android.powerauth.core.SessionOperation.LoadSessionState;
+import static com.wultra.android.powerauth.core.SessionOperation.LoadSessionStateLazily;
+import static com.wultra.android.powerauth.core.SessionOperation.MaterializeSessionState;
+import static com.wultra.android.powerauth.core.SessionOperation.ActivationFingerprint;
+import static com.wultra.android.powerauth.core.SessionOperation.StartActivation;
+import static com.wultra.android.powerauth.core.SessionOperation.ValidateActivationResponse;
+import static com.wultra.android.powerauth.core.SessionOperation.CompleteActivation;
+import static com.wultra.android.powerauth.core.SessionOperation.DecodeActivationStatus;
+import static com.wultra.android.powerauth.core.SessionOperation.SignHTTPRequestData;
+import static com.wultra.android.powerauth.core.SessionOperation.SignHTTPRequestDataBatch;
+import static com.wultra.android.powerauth.core.SessionOperation.VerifyServerSignedData;
+import static com.wultra.android.powerauth.core.SessionOperation.UnlockSignatureKeys;
+import static com.wultra.android.powerauth.core.SessionOperation.LockSignatureKeys;
+import static com.wultra.android.powerauth.core.SessionOperation.SignHTTPRequestDataWithUnlockedKeys;
+import static com.wultra.android.powerauth.core.SessionOperation.DecodeActivationStatusWithUnlockedKeys;
+import static com.wultra.android.powerauth.core.SessionOperation.ReserveSignatureCounters;
+import static com.wultra.android.powerauth.core.SessionOperation.SignHTTPRequestDataWithReservation;
+import static com.wultra.android.powerauth.core.SessionOperation.ReleaseSignatureCounters;
+import static com.wultra.android.powerauth.core.SessionOperation.ChangeUserPassword;
+import static com.wultra.android.powerauth.core.SessionOperation.AddBiometryFactor;
+import static com.wultra.android.powerauth.core.SessionOperation.RemoveBiometryFactor;
+import static com.wultra.android.powerauth.core.SessionOperation.DeriveCryptographicKeyFromVaultKey;
+import static com.wultra.android.powerauth.core.SessionOperation.SignDataWithDevicePrivateKey;
+import static com.wultra.android.powerauth.core.SessionOperation.SetExternalEncryptionKey;
+import static com.wultra.android.powerauth.core.SessionOperation.AddExternalEncryptionKey;
+import static com.wultra.android.powerauth.core.SessionOperation.RemoveExternalEncryptionKey;
+import static com.wultra.android.powerauth.core.SessionOperation.GetEciesEncryptor;
+import static com.wultra.android.powerauth.core.SessionOperation.StartProtocolUpgrade;
+import static com.wultra.android.powerauth.core.SessionOperation.ApplyProtocolUpgradeData;
+import static com.wultra.android.powerauth.core.SessionOperation.FinishProtocolUpgrade;
+import static com.wultra.android.powerauth.core.SessionOperation.GetActivationRecoveryData;
+
+/**
+ * The SessionOperation constants identify public operations of the {@link Session},
+ * measured in {@link SessionStatistics}. The values are indexes to the arrays
+ * in the statistics object.
+ */
+@Retention(RetentionPolicy.SOURCE)
+@IntDef({SetSessionSetup, ResetSession, SaveSessionState,
+        LoadSessionState, LoadSessionStateLazily, MaterializeSessionState,
+        ActivationFingerprint, StartActivation, ValidateActivationResponse,
+        CompleteActivation, DecodeActivationStatus, SignHTTPRequestData,
+        SignHTTPRequestDataBatch, VerifyServerSignedData, UnlockSignatureKeys,
+        LockSignatureKeys, SignHTTPRequestDataWithUnlockedKeys, DecodeActivationStatusWithUnlockedKeys,
+        ReserveSignatureCounters, SignHTTPRequestDataWithReservation, ReleaseSignatureCounters,
+        ChangeUserPassword, AddBiometryFactor, RemoveBiometryFactor,
+        DeriveCryptographicKeyFromVaultKey, SignDataWithDevicePrivateKey, SetExternalEncryptionKey,
+        AddExternalEncryptionKey, RemoveExternalEncryptionKey, GetEciesEncryptor,
+        StartProtocolUpgrade, ApplyProtocolUpgradeData, FinishProtocolUpgrade,
+        GetActivationRecoveryData})
+public @interface SessionOperation {
+    int SetSessionSetup = 0;
+    int ResetSession = 1;
+    int SaveSessionState = 2;
+    int LoadSessionState = 3;
+    int LoadSessionStateLazily = 4;
+    int MaterializeSessionState = 5;
+    int ActivationFingerprint = 6;
+    int StartActivation = 7;
+    int ValidateActivationResponse = 8;
+    int CompleteActivation = 9;
+    int DecodeActivationStatus = 10;
+    int SignHTTPRequestData = 11;
+    int SignHTTPRequestDataBatch = 12;
+    int VerifyServerSignedData = 13;
+    int UnlockSignatureKeys = 14;
+    int LockSignatureKeys = 15;
+    int SignHTTPRequestDataWithUnlockedKeys = 16;
+    int DecodeActivationStatusWithUnlockedKeys = 17;
+    int ReserveSignatureCounters = 18;
+    int SignHTTPRequestDataWithReservation = 19;
+    int ReleaseSignatureCounters = 20;
+    int ChangeUserPassword = 21;
+    int AddBiometryFactor = 22;
+    int RemoveBiometryFactor = 23;
+    int DeriveCryptographicKeyFromVaultKey = 24;
+    int SignDataWithDevicePrivateKey = 25;
+    int SetExternalEncryptionKey = 26;
+    int AddExternalEncryptionKey = 27;
+    int RemoveExternalEncryptionKey = 28;
+    int GetEciesEncryptor = 29;
+    int StartProtocolUpgrade = 30;
+    int ApplyProtocolUpgradeData = 31;
+    int FinishProtocolUpgrade = 32;
+    int GetActivationRecoveryData = 33;
+
+    /**
+     * Number of operations. This is not a valid operation.
+     */
+    int COUNT = 34;
+}
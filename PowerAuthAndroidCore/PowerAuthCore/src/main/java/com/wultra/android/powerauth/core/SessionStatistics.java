@@ -0,0 +1,96 @@
+/*
+ * Copyright 2021 Wultra s.r.o.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+package com.wultra.android.powerauth.core;
+
+import androidx.annotation.NonNull;
+
+/**
+ * The {@code SessionStatistics} is a snapshot of statistics collected by the {@link Session},
+ * after the collection is enabled with {@link Session#setStatisticsEnabled(boolean)}. All times
+ * are in microseconds.
+ */
+public class SessionStatistics {
+
+    /**
+     * Number of calls for each operation, indexed by {@link SessionOperation} constants.
+     */
+    public final long[] operationCalls;
+    /**
+     * Total time spent in each operation, indexed by {@link SessionOperation} constants.
+     */
+    public final long[] operationTimes;
+    /**
+     * Time spent waiting for the session's lock, when the lock was already acquired by other thread.
+     */
+    public final long lockWaitTime;
+    /**
+     * Time spent in PBKDF2 calculations.
+     */
+    public final long pbkdf2Time;
+    /**
+     * Time spent in elliptic curve operations, like key import, ECDSA or ECDH.
+     */
+    public final long eccTime;
+    /**
+     * Time spent in symmetric cryptography, like AES or HMAC.
+     */
+    public final long symmetricCryptoTime;
+    /**
+     * Time spent in the session's state serialization and deserialization.
+     */
+    public final long serializationTime;
+    /**
+     * Number of signature keys unlocks.
+     */
+    public final long keyUnlocks;
+    /**
+     * Number of signature counter advances.
+     */
+    public final long counterAdvances;
+    /**
+     * Number of counter values evaluated in the look ahead window, during the counter synchronization.
+     */
+    public final long lookAheadIterations;
+    /**
+     * Number of PRNG reseeds.
+     */
+    public final long prngReseeds;
+
+    /**
+     * Constructs statistics from values in the order produced by the JNI code.
+     *
+     * @param values Array with operation calls, operation times, and then with all other values.
+     */
+    SessionStatistics(@NonNull long[] values) {
+        final int count = SessionOperation.COUNT;
+        this.operationCalls = new long[count];
+        this.operationTimes = new long[count];
+        System.arraycopy(values, 0, operationCalls, 0, count);
+        System.arraycopy(values, count, operationTimes, 0, count);
+        int index = 2 * count;
+        this.lockWaitTime = values[index++];
+        this.pbkdf2Time = values[index++];
+        this.eccTime = values[index++];
+        this.symmetricCryptoTime = values[index++];
+        this.serializationTime = values[index++];
+        this.keyUnlocks = values[index++];
+        this.counterAdvances = values[index++];
+        this.lookAheadIterations = values[index++];
+        this.prngReseeds = values[index];
+    }
+}
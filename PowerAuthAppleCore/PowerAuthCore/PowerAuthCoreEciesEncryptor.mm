@@ -21,6 +21,7 @@
 #import <PowerAuthCore/PowerAuthCoreSession.h>
 #import "PrivateFunctions.h"
 #import "PrivateInterfaces.h"
+#include "Base64.h"                 // Accessing private header
 
 using namespace com::wultra::powerAuth;
 
@@ -196,38 +197,38 @@ using namespace com::wultra::powerAuth;
 
 - (void) setBodyBase64:(NSString *)bodyBase64
 {
-    _c.body.readFromBase64String(cc7::objc::CopyFromNSString(bodyBase64));
+    utils::Base64_Decode(cc7::objc::CopyFromNSString(bodyBase64), _c.body);
 }
 - (NSString*) bodyBase64
 {
-    return cc7::objc::CopyToNullableNSString(_c.body.base64String());
+    return cc7::objc::CopyToNullableNSString(utils::ToBase64String(_c.body));
 }
 
 - (void) setMacBase64:(NSString *)macBase64
 {
-    _c.mac.readFromBase64String(cc7::objc::CopyFromNSString(macBase64));
+    utils::Base64_Decode(cc7::objc::CopyFromNSString(macBase64), _c.mac);
 }
 - (NSString*) macBase64
 {
-    return cc7::objc::CopyToNullableNSString(_c.mac.base64String());
+    return cc7::objc::CopyToNullableNSString(utils::ToBase64String(_c.mac));
 }
 
 - (void) setKeyBase64:(NSString *)keyBase64
 {
-    _c.key.readFromBase64String(cc7::objc::CopyFromNSString(keyBase64));
+    utils::Base64_Decode(cc7::objc::CopyFromNSString(keyBase64), _c.key);
 }
 - (NSString*) keyBase64
 {
-    return cc7::objc::CopyToNullableNSString(_c.key.base64String());
+    return cc7::objc::CopyToNullableNSString(utils::ToBase64String(_c.key));
 }
 
 - (void) setNonceBase64:(NSString *)nonceBase64
 {
-    _c.nonce.readFromBase64String(cc7::objc::CopyFromNSString(nonceBase64));
+    utils::Base64_Decode(cc7::objc::CopyFromNSString(nonceBase64), _c.nonce);
 }
 - (NSString*) nonceBase64
 {
-    return cc7::objc::CopyToNullableNSString(_c.nonce.base64String());
+    return cc7::objc::CopyToNullableNSString(utils::ToBase64String(_c.nonce));
 }
 
 @end
@@ -99,7 +99,11 @@ typedef NS_ENUM(NSInteger, PowerAuthCoreErrorCode) {
      returned when underlying implementation fails. For example, if PRNG
      generator could not produce a sequence of bytes.
      */
-    PowerAuthCoreErrorCode_GeneralFailure   = 10
+    PowerAuthCoreErrorCode_GeneralFailure   = 10,
+    /**
+     The operation has been cancelled before it could complete.
+     */
+    PowerAuthCoreErrorCode_Cancelled        = 11
     
 } NS_SWIFT_NAME(ErrorCode);
 
@@ -57,6 +57,8 @@ static NSString * _GetDefaultErrorDescription(PowerAuthCoreErrorCode ec, NSStrin
             return @"Mandatory signature factor key is missing.";
         case PowerAuthCoreErrorCode_GeneralFailure:
             return @"General failure";
+        case PowerAuthCoreErrorCode_Cancelled:
+            return @"Operation has been cancelled";
         default:
             return nil;
     }
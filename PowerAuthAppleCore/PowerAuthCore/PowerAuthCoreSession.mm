@@ -20,6 +20,7 @@
 
 #include <PowerAuth/Session.h>
 #include <PowerAuth/Debug.h>
+#include "Base64.h"                 // Accessing private header
 
 using namespace com::wultra::powerAuth;
 
@@ -382,7 +383,7 @@ using namespace com::wultra::powerAuth;
 
 - (NSString*) generateActivationStatusChallenge
 {
-    return cc7::objc::CopyToNSString(Session::generateSignatureUnlockKey().base64String());
+    return cc7::objc::CopyToNSString(utils::ToBase64String(Session::generateSignatureUnlockKey()));
 }
 
 
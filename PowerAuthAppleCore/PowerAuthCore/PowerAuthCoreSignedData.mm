@@ -16,6 +16,7 @@
 
 #import "PowerAuthCoreSignedData.h"
 #import "PrivateInterfaces.h"
+#include "Base64.h"                 // Accessing private header
 
 using namespace com::wultra::powerAuth;
 
@@ -63,22 +64,22 @@ using namespace com::wultra::powerAuth;
 
 - (NSString*) dataBase64
 {
-    return cc7::objc::CopyToNSString(_signedData.data.base64String());
+    return cc7::objc::CopyToNSString(utils::ToBase64String(_signedData.data));
 }
 
 - (void) setDataBase64:(NSString *)dataBase64
 {
-    _signedData.data.readFromBase64String(cc7::objc::CopyFromNSString(dataBase64));
+    utils::Base64_Decode(cc7::objc::CopyFromNSString(dataBase64), _signedData.data);
 }
 
 - (NSString*) signatureBase64
 {
-    return cc7::objc::CopyToNSString(_signedData.signature.base64String());
+    return cc7::objc::CopyToNSString(utils::ToBase64String(_signedData.signature));
 }
 
 - (void) setSignatureBase64:(NSString *)signatureBase64
 {
-    _signedData.signature.readFromBase64String(cc7::objc::CopyFromNSString(signatureBase64));
+    utils::Base64_Decode(cc7::objc::CopyFromNSString(signatureBase64), _signedData.signature);
 }
 
 @end